@@ -54,12 +54,18 @@ void *Finisher::finisher_thread_entry()
       list<pair<Context*,int> > ls_rval;
       ls.swap(finisher_queue);
       ls_rval.swap(finisher_queue_rval);
+      utime_t since = finisher_queue_since;
       finisher_running = true;
       finisher_lock.Unlock();
       ldout(cct, 10) << "finisher_thread doing " << ls << dendl;
 
-      if (logger)
+      if (logger) {
 	start = ceph_clock_now();
+	utime_t lat = start - since;
+	logger->tinc(l_finisher_queue_lat, lat);
+	logger->hinc(l_finisher_queue_lat_hist, lat.to_nsec() / 1000,
+		     ls.size());
+      }
 
       // Now actually process the contexts.
       for (vector<Context*>::iterator p = ls.begin();
@@ -78,12 +84,13 @@ void *Finisher::finisher_thread_entry()
 	  ls_rval.pop_front();
 	}
 	if (logger) {
-	  logger->dec(l_finisher_queue_len);
 	  end = ceph_clock_now();
 	  logger->tinc(l_finisher_complete_lat, end - start);
 	  start = end;
         }
       }
+      if (logger)
+	logger->dec(l_finisher_queue_len, ls.size());
       ldout(cct, 10) << "finisher_thread done with " << ls << dendl;
       ls.clear();
 
@@ -108,3 +115,37 @@ void *Finisher::finisher_thread_entry()
   return 0;
 }
 
+ShardedFinisher::ShardedFinisher(CephContext *cct, const string& name,
+				 const string& tn, unsigned num_lanes)
+{
+  assert(num_lanes > 0);
+  for (unsigned i = 0; i < num_lanes; ++i) {
+    ostringstream oss;
+    oss << name << "-" << i;
+    lanes.push_back(new Finisher(cct, oss.str(), tn));
+  }
+}
+
+ShardedFinisher::~ShardedFinisher()
+{
+  for (auto f : lanes)
+    delete f;
+}
+
+void ShardedFinisher::start()
+{
+  for (auto f : lanes)
+    f->start();
+}
+
+void ShardedFinisher::stop()
+{
+  for (auto f : lanes)
+    f->stop();
+}
+
+void ShardedFinisher::wait_for_empty()
+{
+  for (auto f : lanes)
+    f->wait_for_empty();
+}
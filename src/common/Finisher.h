@@ -28,6 +28,8 @@ enum {
   l_finisher_first = 997082,
   l_finisher_queue_len,
   l_finisher_complete_lat,
+  l_finisher_queue_lat,
+  l_finisher_queue_lat_hist,
   l_finisher_last
 };
 
@@ -54,6 +56,10 @@ class Finisher {
   /// with a parameter other than 0.
   list<pair<Context*,int> > finisher_queue_rval;
 
+  /// When finisher_queue last went from empty to non-empty; only kept
+  /// for named finishers.
+  utime_t finisher_queue_since;
+
   /// Performance counter for the finisher's queue length.
   /// Only active for named finishers.
   PerfCounters *logger;
@@ -66,12 +72,18 @@ class Finisher {
     void* entry() { return (void*)fin->finisher_thread_entry(); }
   } finisher_thread;
 
+  void _queue_started() {
+    finisher_cond.Signal();
+    if (logger)
+      finisher_queue_since = ceph_clock_now();
+  }
+
  public:
   /// Add a context to complete, optionally specifying a parameter for the complete function.
   void queue(Context *c, int r = 0) {
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
-      finisher_cond.Signal();
+      _queue_started();
     }
     if (r) {
       finisher_queue_rval.push_back(pair<Context*, int>(c, r));
@@ -85,7 +97,7 @@ class Finisher {
   void queue(vector<Context*>& ls) {
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
-      finisher_cond.Signal();
+      _queue_started();
     }
     finisher_queue.insert(finisher_queue.end(), ls.begin(), ls.end());
     if (logger)
@@ -96,7 +108,7 @@ class Finisher {
   void queue(deque<Context*>& ls) {
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
-      finisher_cond.Signal();
+      _queue_started();
     }
     finisher_queue.insert(finisher_queue.end(), ls.begin(), ls.end());
     if (logger)
@@ -107,7 +119,7 @@ class Finisher {
   void queue(list<Context*>& ls) {
     finisher_lock.Lock();
     if (finisher_queue.empty()) {
-      finisher_cond.Signal();
+      _queue_started();
     }
     finisher_queue.insert(finisher_queue.end(), ls.begin(), ls.end());
     if (logger)
@@ -150,6 +162,16 @@ class Finisher {
 			  l_finisher_first, l_finisher_last);
     b.add_u64(l_finisher_queue_len, "queue_len");
     b.add_time_avg(l_finisher_complete_lat, "complete_latency");
+    b.add_time_avg(l_finisher_queue_lat, "queue_latency",
+		   "Time the oldest context of a batch spent queued");
+    b.add_histogram(l_finisher_queue_lat_hist, "queue_latency_histogram",
+		    PerfHistogramCommon::axis_config_d(
+		      "queue_latency_usec", PerfHistogramCommon::SCALE_LOG2,
+		      0, 1, 32),
+		    PerfHistogramCommon::axis_config_d(
+		      "batch_size", PerfHistogramCommon::SCALE_LOG2,
+		      0, 1, 16),
+		    "Histogram of queue latency and contexts completed per batch");
     logger = b.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
     logger->set(l_finisher_queue_len, 0);
@@ -164,6 +186,49 @@ class Finisher {
   }
 };
 
+/**
+ * Several Finishers ("lanes"), each with its own lock and thread.
+ *
+ * Contexts queued with the same ordering token always go to the same lane,
+ * so they complete in the order they were queued; contexts with different
+ * tokens may complete in any order.  Each lane keeps the usual finisher
+ * perf counters, named finisher-<name>-<lane>.
+ */
+class ShardedFinisher {
+  vector<Finisher*> lanes;
+
+public:
+  ShardedFinisher(CephContext *cct, const string& name, const string& tn,
+		  unsigned num_lanes);
+  ~ShardedFinisher();
+
+  unsigned get_num_lanes() const {
+    return lanes.size();
+  }
+  Finisher *get_lane(uint64_t token) {
+    return lanes[token % lanes.size()];
+  }
+
+  void queue(uint64_t token, Context *c, int r = 0) {
+    get_lane(token)->queue(c, r);
+  }
+  void queue(uint64_t token, vector<Context*>& ls) {
+    get_lane(token)->queue(ls);
+  }
+  void queue(uint64_t token, deque<Context*>& ls) {
+    get_lane(token)->queue(ls);
+  }
+  void queue(uint64_t token, list<Context*>& ls) {
+    get_lane(token)->queue(ls);
+  }
+
+  void start();
+  /// Stop all lanes; see Finisher::stop().
+  void stop();
+  /// Block until every lane has nothing left to process.
+  void wait_for_empty();
+};
+
 /// Context that is completed asynchronously on the supplied finisher.
 class C_OnFinisher : public Context {
   Context *con;
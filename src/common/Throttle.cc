@@ -59,7 +59,7 @@ Throttle::Throttle(CephContext *cct, const std::string& n, int64_t m, bool _use_
 
     logger = b.create_perf_counters();
     cct->get_perfcounters_collection()->add(logger);
-    logger->set(l_throttle_max, max.read());
+    logger->set(l_throttle_max, max.load());
   }
 }
 
@@ -83,50 +83,54 @@ Throttle::~Throttle()
 void Throttle::_reset_max(int64_t m)
 {
   assert(lock.is_locked());
-  if ((int64_t)max.read() == m)
+  if (max.load() == m)
     return;
   if (!cond.empty())
     cond.front()->SignalOne();
   if (logger)
     logger->set(l_throttle_max, m);
-  max.set((size_t)m);
+  max = m;
 }
 
-bool Throttle::_wait(int64_t c)
+bool Throttle::_get(int64_t c)
 {
+  assert(lock.is_locked());
+  if (cond.empty() && _try_get(c))
+    return false;
+
+  // always wait behind other waiters.
   utime_t start;
-  bool waited = false;
-  if (_should_wait(c) || !cond.empty()) { // always wait behind other waiters.
-    Cond *cv = new Cond;
-    cond.push_back(cv);
-    waited = true;
-    ldout(cct, 2) << "_wait waiting..." << dendl;
-    if (logger)
-      start = ceph_clock_now();
+  Cond *cv = new Cond;
+  cond.push_back(cv);
+  // pairs with the load in put(): either put() sees us, or we see its
+  // count
+  num_waiters++;
+  ldout(cct, 2) << "_get waiting..." << dendl;
+  if (logger)
+    start = ceph_clock_now();
 
-    do {
-      cv->Wait(lock);
-    } while (_should_wait(c) || cv != cond.front());
+  while (cv != cond.front() || !_try_get(c))
+    cv->Wait(lock);
 
-    ldout(cct, 2) << "_wait finished waiting" << dendl;
-    if (logger) {
-      utime_t dur = ceph_clock_now() - start;
-      logger->tinc(l_throttle_wait, dur);
-    }
+  ldout(cct, 2) << "_get finished waiting" << dendl;
+  if (logger) {
+    utime_t dur = ceph_clock_now() - start;
+    logger->tinc(l_throttle_wait, dur);
+  }
 
-    delete cv;
-    cond.pop_front();
+  delete cv;
+  cond.pop_front();
+  num_waiters--;
 
-    // wake up the next guy
-    if (!cond.empty())
-      cond.front()->SignalOne();
-  }
-  return waited;
+  // wake up the next guy
+  if (!cond.empty())
+    cond.front()->SignalOne();
+  return true;
 }
 
 bool Throttle::wait(int64_t m)
 {
-  if (0 == max.read() && 0 == m) {
+  if (0 == max.load() && 0 == m) {
     return false;
   }
 
@@ -136,53 +140,49 @@ bool Throttle::wait(int64_t m)
     _reset_max(m);
   }
   ldout(cct, 10) << "wait" << dendl;
-  return _wait(0);
+  return _get(0);
 }
 
 int64_t Throttle::take(int64_t c)
 {
-  if (0 == max.read()) {
+  if (0 == max.load()) {
     return 0;
   }
   assert(c >= 0);
   ldout(cct, 10) << "take " << c << dendl;
-  {
-    Mutex::Locker l(lock);
-    count.add(c);
-  }
+  int64_t v = count += c;
   if (logger) {
     logger->inc(l_throttle_take);
     logger->inc(l_throttle_take_sum, c);
-    logger->set(l_throttle_val, count.read());
+    logger->set(l_throttle_val, v);
   }
-  return count.read();
+  return v;
 }
 
 bool Throttle::get(int64_t c, int64_t m)
 {
-  if (0 == max.read() && 0 == m) {
+  if (0 == max.load() && 0 == m) {
     return false;
   }
 
   assert(c >= 0);
-  ldout(cct, 10) << "get " << c << " (" << count.read() << " -> " << (count.read() + c) << ")" << dendl;
+  ldout(cct, 10) << "get " << c << " (" << count.load() << " -> " << (count.load() + c) << ")" << dendl;
   if (logger) {
     logger->inc(l_throttle_get_started);
   }
   bool waited = false;
-  {
+  if (m || num_waiters.load() || !_try_get(c)) {
     Mutex::Locker l(lock);
     if (m) {
       assert(m > 0);
       _reset_max(m);
     }
-    waited = _wait(c);
-    count.add(c);
+    waited = _get(c);
   }
   if (logger) {
     logger->inc(l_throttle_get);
     logger->inc(l_throttle_get_sum, c);
-    logger->set(l_throttle_val, count.read());
+    logger->set(l_throttle_val, count.load());
   }
   return waited;
 }
@@ -192,26 +192,24 @@ bool Throttle::get(int64_t c, int64_t m)
  */
 bool Throttle::get_or_fail(int64_t c)
 {
-  if (0 == max.read()) {
+  if (0 == max.load()) {
     return true;
   }
 
   assert (c >= 0);
-  Mutex::Locker l(lock);
-  if (_should_wait(c) || !cond.empty()) {
+  if (num_waiters.load() || !_try_get(c)) {
     ldout(cct, 10) << "get_or_fail " << c << " failed" << dendl;
     if (logger) {
       logger->inc(l_throttle_get_or_fail_fail);
     }
     return false;
   } else {
-    ldout(cct, 10) << "get_or_fail " << c << " success (" << count.read() << " -> " << (count.read() + c) << ")" << dendl;
-    count.add(c);
+    ldout(cct, 10) << "get_or_fail " << c << " success (" << count.load() - c << " -> " << count.load() << ")" << dendl;
     if (logger) {
       logger->inc(l_throttle_get_or_fail_success);
       logger->inc(l_throttle_get);
       logger->inc(l_throttle_get_sum, c);
-      logger->set(l_throttle_val, count.read());
+      logger->set(l_throttle_val, count.load());
     }
     return true;
   }
@@ -219,25 +217,29 @@ bool Throttle::get_or_fail(int64_t c)
 
 int64_t Throttle::put(int64_t c)
 {
-  if (0 == max.read()) {
+  if (0 == max.load()) {
     return 0;
   }
 
   assert(c >= 0);
-  ldout(cct, 10) << "put " << c << " (" << count.read() << " -> " << (count.read()-c) << ")" << dendl;
-  Mutex::Locker l(lock);
+  ldout(cct, 10) << "put " << c << " (" << count.load() << " -> " << (count.load()-c) << ")" << dendl;
+  int64_t v = count.load();
   if (c) {
-    if (!cond.empty())
-      cond.front()->SignalOne();
-    assert(((int64_t)count.read()) >= c); //if count goes negative, we failed somewhere!
-    count.sub(c);
+    v = count.fetch_sub(c);
+    assert(v >= c); //if count goes negative, we failed somewhere!
+    v -= c;
+    if (num_waiters.load()) {
+      Mutex::Locker l(lock);
+      if (!cond.empty())
+	cond.front()->SignalOne();
+    }
     if (logger) {
       logger->inc(l_throttle_put);
       logger->inc(l_throttle_put_sum, c);
-      logger->set(l_throttle_val, count.read());
+      logger->set(l_throttle_val, v);
     }
   }
-  return count.read();
+  return v;
 }
 
 void Throttle::reset()
@@ -245,7 +247,7 @@ void Throttle::reset()
   Mutex::Locker l(lock);
   if (!cond.empty())
     cond.front()->SignalOne();
-  count.set(0);
+  count = 0;
   if (logger) {
     logger->set(l_throttle_val, 0);
   }
@@ -6,6 +6,7 @@
 
 #include "Mutex.h"
 #include "Cond.h"
+#include <atomic>
 #include <list>
 #include <map>
 #include <iostream>
@@ -24,14 +25,19 @@ class PerfCounters;
  * This class defines the maximum number of slots currently taken away. The
  * excessive requests for more of them are delayed, until some slots are put
  * back, so @p get_current() drops below the limit after fulfills the requests.
+ *
+ * As long as nobody is waiting, get(), get_or_fail(), take() and put() are
+ * a compare-and-swap on count and do not take the lock.  Requests that
+ * would exceed the limit queue up behind the lock, and are served in order.
  */
 class Throttle {
   CephContext *cct;
   const std::string name;
   PerfCounters *logger;
-  ceph::atomic_t count, max;
+  std::atomic<int64_t> count = { 0 }, max = { 0 };
   Mutex lock;
   list<Cond*> cond;
+  std::atomic<unsigned> num_waiters = { 0 };  ///< cond.size()
   const bool use_perf;
 
 public:
@@ -40,16 +46,27 @@ public:
 
 private:
   void _reset_max(int64_t m);
-  bool _should_wait(int64_t c) const {
-    int64_t m = max.read();
-    int64_t cur = count.read();
+  static bool _should_wait(int64_t m, int64_t cur, int64_t c) {
     return
       m &&
       ((c <= m && cur + c > m) || // normally stay under max
        (c >= m && cur > m));     // except for large c
   }
+  bool _should_wait(int64_t c) const {
+    return _should_wait(max.load(), count.load(), c);
+  }
+  /// take c slots if that does not exceed the limit; never blocks
+  bool _try_get(int64_t c) {
+    int64_t cur = count.load();
+    do {
+      if (_should_wait(max.load(), cur, c))
+	return false;
+    } while (!count.compare_exchange_weak(cur, cur + c));
+    return true;
+  }
 
-  bool _wait(int64_t c);
+  /// get c slots, waiting in line if needed; returns true if we waited
+  bool _get(int64_t c);
 
 public:
   /**
@@ -57,14 +74,14 @@ public:
    * @returns the number of taken slots
    */
   int64_t get_current() const {
-    return count.read();
+    return count.load();
   }
 
   /**
    * get the max number of slots
    * @returns the max number of slots
    */
-  int64_t get_max() const { return max.read(); }
+  int64_t get_max() const { return max.load(); }
 
   /**
    * set the new max number, and wait until the number of taken slots drains
@@ -12,6 +12,7 @@
 
 #include "TrackedOp.h"
 #include "common/Formatter.h"
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include "common/debug.h"
@@ -88,11 +89,75 @@ void OpHistory::dump_ops(utime_t now, Formatter *f)
   f->close_section();
 }
 
+/*
+ * A shard's in-flight ops.  Slots are handed out with a CAS, starting
+ * from a rotating cursor, and cleared with a store; chunks of slots are
+ * added as needed and only freed with the tracker.
+ */
 struct ShardedTrackingData {
-  Mutex ops_in_flight_lock_sharded;
-  TrackedOp::tracked_op_list_t ops_in_flight_sharded;
-  explicit ShardedTrackingData(string lock_name):
-      ops_in_flight_lock_sharded(lock_name.c_str()) {}
+  static const unsigned CHUNK = 256;
+  static const unsigned MAX_CHUNKS = 1024;
+  typedef std::atomic<TrackedOp*> slot_t;
+
+  std::atomic<slot_t*> chunks[MAX_CHUNKS];
+  std::atomic<unsigned> num_chunks = {0};
+  std::atomic<unsigned> cursor = {0};
+
+  ShardedTrackingData() {
+    for (unsigned i = 0; i < MAX_CHUNKS; ++i)
+      chunks[i] = nullptr;
+  }
+  ~ShardedTrackingData() {
+    for (unsigned i = 0; i < num_chunks; ++i) {
+      for (unsigned j = 0; j < CHUNK; ++j)
+	assert(chunks[i].load()[j].load() == nullptr);
+      delete[] chunks[i].load();
+    }
+  }
+
+  slot_t& get_slot(unsigned i) {
+    return chunks[i / CHUNK].load(std::memory_order_acquire)[i % CHUNK];
+  }
+
+  bool insert(TrackedOp *op) {
+    unsigned n = num_chunks.load(std::memory_order_acquire);
+    while (true) {
+      unsigned cap = n * CHUNK;
+      if (cap) {
+	unsigned start = cursor.fetch_add(1, std::memory_order_relaxed);
+	for (unsigned k = 0; k < cap; ++k) {
+	  slot_t& s = get_slot((start + k) % cap);
+	  TrackedOp *expected = nullptr;
+	  if (s.load(std::memory_order_relaxed) == nullptr &&
+	      s.compare_exchange_strong(expected, op)) {
+	    op->slot = &s;
+	    return true;
+	  }
+	}
+      }
+      // full; add a chunk (or use the one someone else just added)
+      if (n == MAX_CHUNKS)
+	return false;
+      slot_t *c = new slot_t[CHUNK];
+      for (unsigned j = 0; j < CHUNK; ++j)
+	c[j] = nullptr;
+      slot_t *expected = nullptr;
+      if (!chunks[n].compare_exchange_strong(expected, c))
+	delete[] c;
+      num_chunks.compare_exchange_strong(n, n + 1);
+      n = num_chunks.load(std::memory_order_acquire);
+    }
+  }
+
+  template<typename F>
+  void for_each(F f) {
+    unsigned n = num_chunks.load(std::memory_order_acquire);
+    for (unsigned i = 0; i < n * CHUNK; ++i) {
+      TrackedOp *op = get_slot(i).load();
+      if (op)
+	f(op);
+    }
+  }
 };
 
 OpTracker::OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards):
@@ -100,26 +165,60 @@ OpTracker::OpTracker(CephContext *cct_, bool tracking, uint32_t num_shards):
   num_optracker_shards(num_shards),
   complaint_time(0), log_threshold(0),
   tracking_enabled(tracking),
-  lock("OpTracker::lock"), cct(cct_) {
+  scan_lock("OpTracker::scan_lock"), cct(cct_) {
     for (uint32_t i = 0; i < num_optracker_shards; i++) {
-      char lock_name[32] = {0};
-      snprintf(lock_name, sizeof(lock_name), "%s:%d", "OpTracker::ShardedLock", i);
-      ShardedTrackingData* one_shard = new ShardedTrackingData(lock_name);
+      ShardedTrackingData* one_shard = new ShardedTrackingData;
       sharded_in_flight_list.push_back(one_shard);
     }
 }
 
 OpTracker::~OpTracker() {
+  _reap_zombies();
   while (!sharded_in_flight_list.empty()) {
-    assert((sharded_in_flight_list.back())->ops_in_flight_sharded.empty());
     delete sharded_in_flight_list.back();
     sharded_in_flight_list.pop_back();
   }
 }
 
+void OpTracker::on_shutdown()
+{
+  {
+    Mutex::Locker l(scan_lock);
+    _reap_zombies();
+  }
+  history.on_shutdown();
+}
+
+void OpTracker::with_ops_in_flight(
+  std::function<void(vector<TrackedOp*>&)> f)
+{
+  Mutex::Locker l(scan_lock);
+  vector<TrackedOp*> ops;
+  // nothing we see in a slot from here on is freed until scanning is
+  // cleared again; see unregister_inflight_op()
+  scanning = true;
+  for (auto sdata : sharded_in_flight_list)
+    sdata->for_each([&](TrackedOp *op) { ops.push_back(op); });
+  std::sort(ops.begin(), ops.end(), [](TrackedOp *a, TrackedOp *b) {
+      return a->get_initiated() < b->get_initiated();
+    });
+  f(ops);
+  scanning = false;
+  _reap_zombies();
+}
+
+void OpTracker::_reap_zombies()
+{
+  TrackedOp *z = zombies.exchange(nullptr);
+  while (z) {
+    TrackedOp *next = z->next_zombie;
+    _finish_unregister(z);
+    z = next;
+  }
+}
+
 bool OpTracker::dump_historic_ops(Formatter *f)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
@@ -130,7 +229,6 @@ bool OpTracker::dump_historic_ops(Formatter *f)
 
 bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
@@ -138,19 +236,16 @@ bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked)
   uint64_t total_ops_in_flight = 0;
   f->open_array_section("ops"); // list of TrackedOps
   utime_t now = ceph_clock_now();
-  for (uint32_t i = 0; i < num_optracker_shards; i++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[i];
-    assert(NULL != sdata); 
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    for (auto& op : sdata->ops_in_flight_sharded) {
-      if (print_only_blocked && (now - op.get_initiated() <= complaint_time))
-	break;
-      f->open_object_section("op");
-      op.dump(now, f);
-      f->close_section(); // this TrackedOp
-      total_ops_in_flight++;
-    }
-  }
+  with_ops_in_flight([&](vector<TrackedOp*>& ops) {
+      for (auto op : ops) {
+	if (print_only_blocked && (now - op->get_initiated() <= complaint_time))
+	  break;
+	f->open_object_section("op");
+	op->dump(now, f);
+	f->close_section(); // this TrackedOp
+	total_ops_in_flight++;
+      }
+    });
   f->close_section(); // list of TrackedOps
   if (print_only_blocked) {
     f->dump_float("complaint_time", complaint_time);
@@ -163,7 +258,6 @@ bool OpTracker::dump_ops_in_flight(Formatter *f, bool print_only_blocked)
 
 bool OpTracker::register_inflight_op(TrackedOp *i)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
@@ -171,12 +265,10 @@ bool OpTracker::register_inflight_op(TrackedOp *i)
   uint32_t shard_index = current_seq % num_optracker_shards;
   ShardedTrackingData* sdata = sharded_in_flight_list[shard_index];
   assert(NULL != sdata);
-  {
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    sdata->ops_in_flight_sharded.push_back(*i);
-    i->seq = current_seq;
-  }
-  return true;
+  i->seq = current_seq;
+  uint32_t rate = sample_rate;
+  i->sampled = rate <= 1 || current_seq % rate == 0;
+  return sdata->insert(i);
 }
 
 void OpTracker::unregister_inflight_op(TrackedOp *i)
@@ -184,18 +276,23 @@ void OpTracker::unregister_inflight_op(TrackedOp *i)
   // caller checks;
   assert(i->state);
 
-  uint32_t shard_index = i->seq % num_optracker_shards;
-  ShardedTrackingData* sdata = sharded_in_flight_list[shard_index];
-  assert(NULL != sdata);
-  {
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    auto p = sdata->ops_in_flight_sharded.iterator_to(*i);
-    sdata->ops_in_flight_sharded.erase(p);
+  i->slot->store(nullptr);
+  if (scanning) {
+    // someone may be looking at us; with_ops_in_flight() will finish up
+    i->next_zombie = zombies.load(std::memory_order_relaxed);
+    while (!zombies.compare_exchange_weak(i->next_zombie, i))
+      ;
+    return;
   }
+  _finish_unregister(i);
+}
+
+void OpTracker::_finish_unregister(TrackedOp *i)
+{
   i->_unregistered();
 
-  RWLock::RLocker l(lock);
-  if (!tracking_enabled)
+  if (!tracking_enabled ||
+      (!i->sampled && i->get_duration() <= complaint_time))
     delete i;
   else {
     i->state = TrackedOp::STATE_HISTORY;
@@ -206,45 +303,12 @@ void OpTracker::unregister_inflight_op(TrackedOp *i)
 
 bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector, int *slow)
 {
-  RWLock::RLocker l(lock);
   if (!tracking_enabled)
     return false;
 
   utime_t now = ceph_clock_now();
   utime_t too_old = now;
   too_old -= complaint_time;
-  utime_t oldest_op = now;
-  uint64_t total_ops_in_flight = 0;
-
-  for (uint32_t i = 0; i < num_optracker_shards; i++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[i];
-    assert(NULL != sdata);
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    if (!sdata->ops_in_flight_sharded.empty()) {
-      utime_t oldest_op_tmp =
-	sdata->ops_in_flight_sharded.front().get_initiated();
-      if (oldest_op_tmp < oldest_op) {
-        oldest_op = oldest_op_tmp;
-      }
-    }
-    total_ops_in_flight += sdata->ops_in_flight_sharded.size();
-  }
-
-  if (0 == total_ops_in_flight)
-    return false;
-
-  utime_t oldest_secs = now - oldest_op;
-
-  dout(10) << "ops_in_flight.size: " << total_ops_in_flight
-           << "; oldest is " << oldest_secs
-           << " seconds old" << dendl;
-
-  if (oldest_secs < complaint_time)
-    return false;
-
-  warning_vector.reserve(log_threshold + 1);
-  //store summary message
-  warning_vector.push_back("");
 
   int _slow = 0;    // total slow
   if (!slow)
@@ -252,38 +316,60 @@ bool OpTracker::check_ops_in_flight(std::vector<string> &warning_vector, int *sl
   else
     *slow = _slow;  // start from 0 anyway
   int warned = 0;   // total logged
-  for (uint32_t iter = 0; iter < num_optracker_shards; iter++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[iter];
-    assert(NULL != sdata);
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-    if (sdata->ops_in_flight_sharded.empty())
-      continue;
-    auto i = sdata->ops_in_flight_sharded.begin();
-    while (i != sdata->ops_in_flight_sharded.end() &&
-	   i->get_initiated() < too_old) {
-      (*slow)++;
-
-      // exponential backoff of warning intervals
-      if (warned < log_threshold &&
-	  (i->get_initiated() + (complaint_time *
-				 i->warn_interval_multiplier)) < now) {
-        // will warn, increase counter
-        warned++;
-
-        utime_t age = now - i->get_initiated();
-        stringstream ss;
-        ss << "slow request " << age << " seconds old, received at "
-           << i->get_initiated() << ": " << i->get_desc()
-	   << " currently "
-	   << (i->current ? i->current : i->state_string());
-        warning_vector.push_back(ss.str());
-
-        // only those that have been shown will backoff
-        i->warn_interval_multiplier *= 2;
+  utime_t oldest_secs;
+
+  with_ops_in_flight([&](vector<TrackedOp*>& ops) {
+      if (ops.empty())
+	return;
+
+      oldest_secs = now - ops.front()->get_initiated();
+
+      dout(10) << "ops_in_flight.size: " << ops.size()
+	       << "; oldest is " << oldest_secs
+	       << " seconds old" << dendl;
+
+      if (oldest_secs < complaint_time)
+	return;
+
+      warning_vector.reserve(log_threshold + 1);
+      //store summary message
+      warning_vector.push_back("");
+
+      for (auto i : ops) {
+	if (!(i->get_initiated() < too_old))
+	  break;
+	(*slow)++;
+
+	if (!i->sampled) {
+	  // record the rest of this one's life
+	  Mutex::Locker l(i->lock);
+	  if (i->events.empty())
+	    i->events.push_back(
+	      TrackedOp::Event(i->get_initiated(), "initiated"));
+	  i->sampled = true;
+	}
+
+	// exponential backoff of warning intervals
+	if (warned < log_threshold &&
+	    (i->get_initiated() + (complaint_time *
+				   i->warn_interval_multiplier)) < now) {
+	  // will warn, increase counter
+	  warned++;
+
+	  utime_t age = now - i->get_initiated();
+	  stringstream ss;
+	  const char *current = i->current;
+	  ss << "slow request " << age << " seconds old, received at "
+	     << i->get_initiated() << ": " << i->get_desc()
+	     << " currently "
+	     << (current ? current : i->state_string());
+	  warning_vector.push_back(ss.str());
+
+	  // only those that have been shown will backoff
+	  i->warn_interval_multiplier *= 2;
+	}
       }
-      ++i;
-    }
-  }
+    });
 
   // only summarize if we warn about any.  if everything has backed
   // off, we will stay silent.
@@ -302,17 +388,13 @@ void OpTracker::get_age_ms_histogram(pow2_hist_t *h)
   h->clear();
   utime_t now = ceph_clock_now();
 
-  for (uint32_t iter = 0; iter < num_optracker_shards; iter++) {
-    ShardedTrackingData* sdata = sharded_in_flight_list[iter];
-    assert(NULL != sdata);
-    Mutex::Locker locker(sdata->ops_in_flight_lock_sharded);
-
-    for (auto& i : sdata->ops_in_flight_sharded) {
-      utime_t age = now - i.get_initiated();
-      uint32_t ms = (long)(age * 1000.0);
-      h->add(ms);
-    }
-  }
+  with_ops_in_flight([&](vector<TrackedOp*>& ops) {
+      for (auto i : ops) {
+	utime_t age = now - i->get_initiated();
+	uint32_t ms = (long)(age * 1000.0);
+	h->add(ms);
+      }
+    });
 }
 
 
@@ -321,7 +403,7 @@ void OpTracker::get_age_ms_histogram(pow2_hist_t *h)
 
 void TrackedOp::mark_event_string(const string &event, utime_t stamp)
 {
-  if (!state)
+  if (!state || !sampled)
     return;
 
   {
@@ -341,6 +423,11 @@ void TrackedOp::mark_event(const char *event, utime_t stamp)
 {
   if (!state)
     return;
+  if (!sampled) {
+    current = event;
+    _event_marked();
+    return;
+  }
 
   {
     Mutex::Locker l(lock);
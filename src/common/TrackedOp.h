@@ -17,6 +17,7 @@
 #include <stdint.h>
 #include <boost/intrusive/list.hpp>
 #include <atomic>
+#include <functional>
 
 #include "include/utime.h"
 #include "common/Mutex.h"
@@ -56,6 +57,20 @@ public:
 };
 
 struct ShardedTrackingData;
+
+/**
+ * In-flight ops live in lock-free slot arrays, one per shard, so that
+ * registering and unregistering an op is a CAS and a store.  Walking the
+ * ops (dumps, slow op checks) is serialized by scan_lock; an op that is
+ * unregistered while a walk is in progress is parked on a zombie list
+ * and only handed to the history (or freed) once the walk is over.
+ *
+ * With a sample rate of N, only one op in N records its events; the
+ * others just remember their current state.  Every op is still in flight
+ * for the slow op checks, an op that turns out to be slow starts
+ * recording events when it is noticed, and completed ops that were slow
+ * go to the history whether or not they were sampled.
+ */
 class OpTracker {
   friend class OpHistory;
   atomic64_t seq;
@@ -64,8 +79,17 @@ class OpTracker {
   OpHistory history;
   float complaint_time;
   int log_threshold;
-  bool tracking_enabled;
-  RWLock       lock;
+  std::atomic<bool> tracking_enabled;
+  std::atomic<uint32_t> sample_rate = {1};
+
+  Mutex scan_lock;                      ///< serializes walks of the ops
+  std::atomic<bool> scanning = {false}; ///< a walk is in progress
+  std::atomic<TrackedOp*> zombies = {nullptr};
+
+  /// call f with all ops in flight, oldest first
+  void with_ops_in_flight(std::function<void(vector<TrackedOp*>&)> f);
+  void _finish_unregister(TrackedOp *i);
+  void _reap_zombies();
 
 public:
   CephContext *cct;
@@ -79,9 +103,12 @@ public:
     history.set_size_and_duration(new_size, new_duration);
   }
   void set_tracking(bool enable) {
-    RWLock::WLocker l(lock);
     tracking_enabled = enable;
   }
+  /// record events for one op in n (plus slow ops); 0 or 1 for every op
+  void set_sample_rate(uint32_t n) {
+    sample_rate = n;
+  }
   bool dump_ops_in_flight(Formatter *f, bool print_only_blocked=false);
   bool dump_historic_ops(Formatter *f);
   bool register_inflight_op(TrackedOp *i);
@@ -100,9 +127,7 @@ public:
   bool check_ops_in_flight(std::vector<string> &warning_strings,
 			   int *slow = NULL);
 
-  void on_shutdown() {
-    history.on_shutdown();
-  }
+  void on_shutdown();
   ~OpTracker();
 
   template <typename T, typename U>
@@ -119,17 +144,12 @@ class TrackedOp : public boost::intrusive::list_base_hook<> {
 private:
   friend class OpHistory;
   friend class OpTracker;
+  friend struct ShardedTrackingData;
 
-  boost::intrusive::list_member_hook<> tracker_item;
+  std::atomic<TrackedOp*> *slot = nullptr; ///< our in-flight registry slot
+  TrackedOp *next_zombie = nullptr;
 
 public:
-  typedef boost::intrusive::list<
-  TrackedOp,
-  boost::intrusive::member_hook<
-    TrackedOp,
-    boost::intrusive::list_member_hook<>,
-    &TrackedOp::tracker_item> > tracked_op_list_t;
-
   // for use when clearing lists.  e.g.,
   //   ls.clear_and_dispose(TrackedOp::Putter());
   struct Putter {
@@ -174,8 +194,10 @@ protected:
 
   vector<Event> events;    ///< list of events and their times
   mutable Mutex lock = {"TrackedOp::lock"}; ///< to protect the events list
-  const char *current = 0; ///< the current state the event is in
+  std::atomic<const char*> current = {nullptr}; ///< the current state
   uint64_t seq = 0;        ///< a unique value set by the OpTracker
+  std::atomic<bool> sampled = {false}; ///< recording events
+  utime_t completed_at;    ///< when we were marked done
 
   uint32_t warn_interval_multiplier = 1; //< limits output of a given op warning
 
@@ -193,7 +215,6 @@ protected:
     tracker(_tracker),
     initiated_at(initiated)
   {
-    events.reserve(OPTRACKER_PREALLOC_EVENTS);
   }
 
   /// output any type-specific data you want to get when dump() is called
@@ -220,7 +241,8 @@ public:
 	break;
 
       case STATE_LIVE:
-	mark_event("done");
+	completed_at = ceph_clock_now();
+	mark_event("done", completed_at);
 	tracker->unregister_inflight_op(this);
 	break;
 
@@ -258,9 +280,8 @@ public:
   }
 
   double get_duration() const {
-    Mutex::Locker l(lock);
-    if (!events.empty() && events.rbegin()->compare("done") == 0)
-      return events.rbegin()->stamp - get_initiated();
+    if (completed_at != utime_t())
+      return completed_at - get_initiated();
     else
       return ceph_clock_now() - get_initiated();
   }
@@ -272,6 +293,10 @@ public:
 
   virtual const char *state_string() const {
     Mutex::Locker l(lock);
+    if (events.empty()) {
+      const char *c = current;
+      return c ? c : "unsampled";
+    }
     return events.rbegin()->c_str();
   }
 
@@ -279,7 +304,11 @@ public:
 
   void tracking_start() {
     if (tracker->register_inflight_op(this)) {
-      events.push_back(Event(initiated_at, "initiated"));
+      if (sampled) {
+	Mutex::Locker l(lock);
+	events.reserve(OPTRACKER_PREALLOC_EVENTS);
+	events.push_back(Event(initiated_at, "initiated"));
+      }
       state = STATE_LIVE;
     }
   }
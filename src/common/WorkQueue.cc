@@ -101,7 +101,25 @@ void ThreadPool::worker(WorkThread *wt)
   ss << name << " thread " << name;
   heartbeat_handle_d *hb = cct->get_heartbeat_map()->add_worker(ss.str(), pthread_self());
 
-  while (!_stop) {
+  // processed since we last held the lock
+  vector<work_item_t> done;
+
+  while (true) {
+    if (!done.empty()) {
+      for (auto& p : done) {
+	p.first->_void_process_finish(p.second);
+	processing--;
+	ldout(cct,15) << "worker wq " << p.first->name << " done processing "
+		      << p.second << " (" << processing << " active)" << dendl;
+      }
+      done.clear();
+      if (_pause || _draining)
+	_wait_cond.Signal();
+    }
+
+    // wt->local is always empty here
+    if (_stop)
+      break;
 
     // manage dynamic thread pool
     join_old_threads();
@@ -112,47 +130,49 @@ void ThreadPool::worker(WorkThread *wt)
       break;
     }
 
+    const md_config_snapshot_t *conf = cct->_conf->snapshot();
+    unsigned got = 0;
     if (!_pause && !work_queues.empty()) {
-      WorkQueue_* wq;
-      int tries = work_queues.size();
-      bool did = false;
-      while (tries--) {
-	last_work_queue++;
-	last_work_queue %= work_queues.size();
-	wq = work_queues[last_work_queue];
-	
-	void *item = wq->_void_dequeue();
-	if (item) {
-	  processing++;
-	  ldout(cct,12) << "worker wq " << wq->name << " start processing " << item
-			<< " (" << processing << " active)" << dendl;
-	  TPHandle tp_handle(cct, hb, wq->timeout_interval, wq->suicide_interval);
-	  tp_handle.reset_tp_timeout();
-	  _lock.Unlock();
-	  wq->_void_process(item, tp_handle);
-	  _lock.Lock();
-	  wq->_void_process_finish(item);
-	  processing--;
-	  ldout(cct,15) << "worker wq " << wq->name << " done processing " << item
-			<< " (" << processing << " active)" << dendl;
-	  if (_pause || _draining)
-	    _wait_cond.Signal();
-	  did = true;
+      int batch = conf->threadpool_dequeue_batch;
+      got = _dequeue_batch(wt, batch > 1 ? batch : 1);
+      if (got > 1 && _num_idle.load() > 0)
+	_cond.Signal();  // there is something to steal
+    }
+    if (!got && !_steal(wt)) {
+      ldout(cct,20) << "worker waiting" << dendl;
+      cct->get_heartbeat_map()->reset_timeout(
+	hb,
+	conf->threadpool_default_timeout,
+	0);
+      // pairs with the push in PointerWQ::queue() and the load in _kick()
+      _num_idle++;
+      if (_pause || !_has_pending())
+	_cond.WaitInterval(_lock,
+	  utime_t(
+	    conf->threadpool_empty_queue_max_wait, 0));
+      _num_idle--;
+      continue;
+    }
+
+    _lock.Unlock();
+    while (true) {
+      work_item_t p;
+      {
+	std::lock_guard<std::mutex> l(wt->local_lock);
+	if (wt->local.empty())
 	  break;
-	}
+	p = wt->local.front();
+	wt->local.pop_front();
       }
-      if (did)
-	continue;
+      WorkQueue_ *wq = p.first;
+      ldout(cct,12) << "worker wq " << wq->name << " start processing "
+		    << p.second << dendl;
+      TPHandle tp_handle(cct, hb, wq->timeout_interval, wq->suicide_interval);
+      tp_handle.reset_tp_timeout();
+      wq->_void_process(p.second, tp_handle);
+      done.push_back(p);
     }
-
-    ldout(cct,20) << "worker waiting" << dendl;
-    cct->get_heartbeat_map()->reset_timeout(
-      hb,
-      cct->_conf->threadpool_default_timeout,
-      0);
-    _cond.WaitInterval(_lock,
-      utime_t(
-	cct->_conf->threadpool_empty_queue_max_wait, 0));
+    _lock.Lock();
   }
   ldout(cct,1) << "worker finish" << dendl;
 
@@ -161,6 +181,65 @@ void ThreadPool::worker(WorkThread *wt)
   _lock.Unlock();
 }
 
+unsigned ThreadPool::_dequeue_batch(WorkThread *wt, unsigned max)
+{
+  assert(_lock.is_locked());
+  unsigned got = 0;
+  int tries = work_queues.size();
+  while (got < max && tries-- > 0 && !work_queues.empty()) {
+    last_work_queue++;
+    last_work_queue %= work_queues.size();
+    WorkQueue_ *wq = work_queues[last_work_queue];
+
+    void *item = wq->_void_dequeue();
+    if (item) {
+      processing++;
+      ldout(cct,12) << "worker wq " << wq->name << " dequeued " << item
+		    << " (" << processing << " active)" << dendl;
+      {
+	std::lock_guard<std::mutex> l(wt->local_lock);
+	wt->local.push_back(work_item_t(wq, item));
+      }
+      ++got;
+      // move on to the next queue, for fairness, but keep going
+      tries = work_queues.size();
+    }
+  }
+  return got;
+}
+
+bool ThreadPool::_steal(WorkThread *wt)
+{
+  assert(_lock.is_locked());
+  for (auto victim : _threads) {
+    if (victim == wt)
+      continue;
+    work_item_t p;
+    {
+      std::lock_guard<std::mutex> l(victim->local_lock);
+      if (victim->local.empty())
+	continue;
+      p = victim->local.back();
+      victim->local.pop_back();
+    }
+    ldout(cct,15) << "worker stole " << p.second << " from wq "
+		  << p.first->name << dendl;
+    std::lock_guard<std::mutex> l(wt->local_lock);
+    wt->local.push_back(p);
+    return true;
+  }
+  return false;
+}
+
+bool ThreadPool::_has_pending()
+{
+  assert(_lock.is_locked());
+  for (auto wq : work_queues)
+    if (wq->_has_pending())
+      return true;
+  return false;
+}
+
 void ThreadPool::start_threads()
 {
   assert(_lock.is_locked());
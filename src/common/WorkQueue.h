@@ -15,6 +15,10 @@
 #ifndef CEPH_WORKQUEUE_H
 #define CEPH_WORKQUEUE_H
 
+#include <atomic>
+#include <deque>
+#include <mutex>
+
 #include "Mutex.h"
 #include "Cond.h"
 #include "Thread.h"
@@ -24,7 +28,17 @@
 
 class CephContext;
 
-/// Pool of threads that share work submitted to multiple work queues.
+/**
+ * Pool of threads that share work submitted to multiple work queues.
+ *
+ * Work queue hooks (_enqueue, _dequeue, _void_process_finish, ...) run
+ * with the pool lock held.  A worker dequeues up to
+ * threadpool_dequeue_batch items per trip through the lock into its own
+ * deque, processes them without the lock, and finishes them the next time
+ * it takes the lock.  Idle workers steal from the back of other workers'
+ * deques before going to sleep.  PointerWQ::queue() does not take the
+ * pool lock at all.
+ */
 class ThreadPool : public md_config_obs_t {
   CephContext *cct;
   string name;
@@ -80,6 +94,10 @@ private:
      * so at most one copy will execute simultaneously for a given thread pool.
      * It can be used for non-thread-safe finalization. */
     virtual void _void_process_finish(void *) = 0;
+    /// Whether items were queued without the pool lock (lock may not be held).
+    virtual bool _has_pending() {
+      return false;
+    }
   };
 
   // track thread pool size changes
@@ -343,28 +361,39 @@ public:
 
   };
 
+  /** @brief Template by-pointer work queue with a lock-free queue().
+   * Items are pushed onto a lock-free inbox and moved to m_items, in order,
+   * the next time the queue is looked at with the pool lock held. */
   template<typename T>
   class PointerWQ : public WorkQueue_ {
   public:
     ~PointerWQ() {
       m_pool->remove_work_queue(this);
       assert(m_processing == 0);
+      Item *i = m_inbox.exchange(nullptr);
+      while (i) {
+        Item *next = i->next;
+        delete i;
+        i = next;
+      }
     }
     void drain() {
       {
         // if this queue is empty and not processing, don't wait for other
         // queues to finish processing
         Mutex::Locker l(m_pool->_lock);
-        if (m_processing == 0 && m_items.empty()) {
+        if (m_processing == 0 && _empty()) {
           return;
         }
       }
       m_pool->drain(this);
     }
     void queue(T *item) {
-      Mutex::Locker l(m_pool->_lock);
-      m_items.push_back(item);
-      m_pool->_cond.SignalOne();
+      Item *i = new Item(item);
+      i->next = m_inbox.load();
+      while (!m_inbox.compare_exchange_weak(i->next, i))
+        ;
+      m_pool->_kick();
     }
     bool empty() {
       Mutex::Locker l(m_pool->_lock);
@@ -376,14 +405,20 @@ public:
     }
     virtual void _clear() {
       assert(m_pool->_lock.is_locked());
+      _take_inbox();
       m_items.clear();
     }
     virtual bool _empty() {
       assert(m_pool->_lock.is_locked());
+      _take_inbox();
       return m_items.empty();
     }
+    virtual bool _has_pending() {
+      return m_inbox.load() != nullptr;
+    }
     virtual void *_void_dequeue() {
       assert(m_pool->_lock.is_locked());
+      _take_inbox();
       if (m_items.empty()) {
         return NULL;
       }
@@ -410,6 +445,7 @@ public:
 
     T *front() {
       assert(m_pool->_lock.is_locked());
+      _take_inbox();
       if (m_items.empty()) {
         return NULL;
       }
@@ -428,18 +464,46 @@ public:
       return m_pool->_lock;
     }
   private:
+    struct Item {
+      T *item;
+      Item *next = nullptr;
+      explicit Item(T *i) : item(i) {}
+    };
+
     ThreadPool *m_pool;
     std::list<T *> m_items;
+    std::atomic<Item*> m_inbox = { nullptr };  ///< newest first
     uint32_t m_processing;
+
+    /// move everything queue()d since the last call to m_items
+    void _take_inbox() {
+      Item *i = m_inbox.exchange(nullptr);
+      if (!i) {
+        return;
+      }
+      auto pos = m_items.end();
+      while (i) {
+        pos = m_items.insert(pos, i->item);
+        Item *next = i->next;
+        delete i;
+        i = next;
+      }
+    }
   };
 private:
   vector<WorkQueue_*> work_queues;
   int last_work_queue;
  
 
+  typedef std::pair<WorkQueue_*, void*> work_item_t;
+
   // threads
   struct WorkThread : public Thread {
     ThreadPool *pool;
+    /// dequeued, not yet processed; the owner pops the front, thieves
+    /// the back
+    std::mutex local_lock;
+    std::deque<work_item_t> local;
     // cppcheck-suppress noExplicitConstructor
     WorkThread(ThreadPool *p) : pool(p) {}
     void *entry() {
@@ -450,11 +514,22 @@ private:
   
   set<WorkThread*> _threads;
   list<WorkThread*> _old_threads;  ///< need to be joined
-  int processing;
+  int processing;  ///< dequeued but not finished, including queued locally
+  std::atomic<int> _num_idle = { 0 };  ///< workers waiting on _cond
 
   void start_threads();
   void join_old_threads();
   void worker(WorkThread *wt);
+  unsigned _dequeue_batch(WorkThread *wt, unsigned max);
+  bool _steal(WorkThread *wt);
+  bool _has_pending();
+  /// wake an idle worker, if there is one (without lock held)
+  void _kick() {
+    if (_num_idle.load() > 0) {
+      Mutex::Locker l(_lock);
+      _cond.SignalOne();
+    }
+  }
 
 public:
   ThreadPool(CephContext *cct_, string nm, string tn, int n, const char *option = NULL);
@@ -0,0 +1,385 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+/*
+ * Slab allocator for page aligned buffer::raw data.
+ *
+ * Data buffers of a few fixed sizes (a page, the usual 64K messenger read
+ * size and the 4M object size) are allocated and freed at a high rate by
+ * the messengers and the object stores.  Rather than going back to the
+ * system allocator each time they are recycled through a small per-thread
+ * cache per size class, which spills over into (and refills from) a
+ * shared depot per size class.  New slabs are carved out of a hugepage
+ * arena when one has been set up, or come from posix_memalign otherwise.
+ *
+ * A thread only caches a class whose slabs fit its per-class budget at
+ * all, so 4M slabs normally go straight to the depot.  Each cached class
+ * reserves its budget from a process-wide total first, which bounds what
+ * all threads together can hold, and caches left untouched for a whole
+ * flush_idle() interval are handed back to the depot.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "include/assert.h"
+#include "include/buffer.h"
+#include "include/intarith.h"
+#include "include/mempool.h"
+
+namespace {
+
+const size_t SLAB_ALIGN = 4096;
+const size_t HUGEPAGE_SIZE = 2 << 20;
+const size_t slab_sizes[] = { 4096, 64 << 10, 4 << 20 };
+const int NUM_CLASSES = sizeof(slab_sizes) / sizeof(slab_sizes[0]);
+
+std::atomic<size_t> thread_cache_bytes(1 << 20);
+std::atomic<size_t> thread_cache_total_bytes(64 << 20);
+std::atomic<size_t> depot_bytes(64 << 20);
+
+/// size class for a (len, align) request, or -1 if we do not serve it
+int get_class(size_t len, size_t align)
+{
+  if (align > SLAB_ALIGN || !len)
+    return -1;
+  size_t r = ROUND_UP_TO(len, SLAB_ALIGN);
+  for (int c = 0; c < NUM_CLASSES; ++c)
+    if (slab_sizes[c] == r)
+      return c;
+  return -1;
+}
+
+/// slabs of class c a thread may cache; 0 if it should not cache them
+size_t thread_cache_max(int c)
+{
+  return thread_cache_bytes.load() / slab_sizes[c];
+}
+
+size_t depot_max(int c)
+{
+  return depot_bytes.load() / slab_sizes[c];
+}
+
+void account(mempool::pool_index_t ix, ssize_t bytes, ssize_t items)
+{
+  mempool::shard_t *shard = mempool::get_pool(ix).pick_a_shard();
+  shard->bytes += bytes;
+  shard->items += items;
+}
+
+/*
+ * bump allocator over one big mapping; slabs carved out of it are never
+ * given back to the system, only recycled.
+ */
+class HugepageArena {
+  char *base = nullptr;
+  size_t size = 0;
+  std::atomic<size_t> used = { 0 };
+
+public:
+  int init(size_t bytes) {
+    bytes = ROUND_UP_TO(bytes, HUGEPAGE_SIZE);
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    p = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (p == MAP_FAILED) {
+      // no reserved hugepages; ask for transparent ones instead
+      p = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED)
+	return -errno;
+#ifdef MADV_HUGEPAGE
+      ::madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    }
+    base = static_cast<char*>(p);
+    size = bytes;
+    return 0;
+  }
+
+  char *allocate(size_t len) {
+    size_t off = used.load();
+    do {
+      if (off + len > size)
+	return nullptr;
+    } while (!used.compare_exchange_weak(off, off + len));
+    return base + off;
+  }
+
+  bool contains(const char *p) const {
+    return p >= base && p < base + size;
+  }
+};
+
+class SlabAllocator : public ceph::buffer::raw_allocator {
+  struct Depot {
+    std::mutex lock;
+    std::vector<char*> free;
+  } depots[NUM_CLASSES];
+
+  std::mutex arena_lock;
+  std::atomic<HugepageArena*> arena = { nullptr };
+
+  struct ThreadCache {
+    // only contended while flush_idle() looks at this cache
+    std::mutex lock;
+    std::vector<char*> free[NUM_CLASSES];
+    // budget reserved from thread_cache_total_bytes, per class
+    size_t reserved[NUM_CLASSES] = {};
+    // untouched since the last flush_idle()
+    bool idle = false;
+    ThreadCache();
+    ~ThreadCache();
+  };
+  static thread_local ThreadCache tls_cache;
+  // trivially destructible, so still readable while (and after)
+  // tls_cache is destroyed at thread exit
+  static thread_local bool tls_cache_gone;
+
+  std::mutex caches_lock;
+  std::vector<ThreadCache*> caches;
+  // sum of ThreadCache::reserved over all threads
+  std::atomic<size_t> thread_cache_reserved = { 0 };
+
+  /// reserve class c's budget for t; false if it may not cache c
+  bool reserve(ThreadCache& t, int c) {
+    if (t.reserved[c])
+      return true;
+    size_t bytes = thread_cache_max(c) * slab_sizes[c];
+    if (!bytes)
+      return false;
+    if (thread_cache_reserved.fetch_add(bytes) + bytes >
+	thread_cache_total_bytes.load()) {
+      thread_cache_reserved -= bytes;
+      return false;
+    }
+    t.reserved[c] = bytes;
+    return true;
+  }
+
+  /// hand everything t caches back to the depot; t.lock is held
+  void flush(ThreadCache& t) {
+    for (int c = 0; c < NUM_CLASSES; ++c) {
+      std::vector<char*>& v = t.free[c];
+      if (!v.empty())
+	drain(c, v.data(), v.size());
+      v.clear();
+      v.shrink_to_fit();
+      thread_cache_reserved -= t.reserved[c];
+      t.reserved[c] = 0;
+    }
+  }
+
+  char *fresh_slab(int c) {
+    size_t len = slab_sizes[c];
+    HugepageArena *a = arena.load();
+    if (a) {
+      char *p = a->allocate(len);
+      if (p)
+	return p;
+    }
+    void *p;
+    if (::posix_memalign(&p, SLAB_ALIGN, len))
+      return nullptr;
+    return static_cast<char*>(p);
+  }
+
+  /// move up to n idle slabs of class c from the depot into v
+  void refill(int c, std::vector<char*>& v, size_t n) {
+    Depot& d = depots[c];
+    std::lock_guard<std::mutex> l(d.lock);
+    while (n-- && !d.free.empty()) {
+      v.push_back(d.free.back());
+      d.free.pop_back();
+    }
+  }
+
+  /// hand idle slabs of class c over to the depot; free what does not fit
+  void drain(int c, char **p, size_t n) {
+    Depot& d = depots[c];
+    size_t max = depot_max(c);
+    HugepageArena *a = arena.load();
+    size_t freed = 0;
+    {
+      std::lock_guard<std::mutex> l(d.lock);
+      for (size_t i = 0; i < n; ++i) {
+	if (d.free.size() < max || (a && a->contains(p[i]))) {
+	  d.free.push_back(p[i]);
+	} else {
+	  ::free(p[i]);
+	  ++freed;
+	}
+      }
+    }
+    if (freed)
+      account(mempool::mempool_buffer_slab, -(ssize_t)(freed * slab_sizes[c]),
+	      -(ssize_t)freed);
+  }
+
+public:
+  char *allocate(size_t len, size_t align) override {
+    int c = get_class(len, align);
+    if (c < 0)
+      return nullptr;
+    size_t size = slab_sizes[c];
+    char *p = nullptr;
+    if (!tls_cache_gone) {
+      ThreadCache& t = tls_cache;
+      std::lock_guard<std::mutex> l(t.lock);
+      t.idle = false;
+      std::vector<char*>& v = t.free[c];
+      if (v.empty())
+	refill(c, v, reserve(t, c) ? (thread_cache_max(c) + 1) / 2 : 1);
+      if (!v.empty()) {
+	p = v.back();
+	v.pop_back();
+      }
+    } else {
+      std::vector<char*> v;
+      refill(c, v, 1);
+      if (!v.empty())
+	p = v.back();
+    }
+    if (p) {
+      account(mempool::mempool_buffer_slab, -(ssize_t)size, -1);
+    } else {
+      p = fresh_slab(c);
+      if (!p)
+	return nullptr;
+    }
+    account(mempool::mempool_buffer_data, size, size);
+    return p;
+  }
+
+  void deallocate(char *p, size_t len, size_t align) override {
+    int c = get_class(len, align);
+    assert(c >= 0);
+    size_t size = slab_sizes[c];
+    account(mempool::mempool_buffer_data, -(ssize_t)size, -(ssize_t)size);
+    account(mempool::mempool_buffer_slab, size, 1);
+    if (tls_cache_gone) {
+      drain(c, &p, 1);
+      return;
+    }
+    ThreadCache& t = tls_cache;
+    std::lock_guard<std::mutex> l(t.lock);
+    t.idle = false;
+    if (!reserve(t, c)) {
+      drain(c, &p, 1);
+      return;
+    }
+    std::vector<char*>& v = t.free[c];
+    v.push_back(p);
+    size_t max = t.reserved[c] / size;
+    if (v.size() > max) {
+      // keep half, so that alternating alloc/free does not bounce
+      size_t n = v.size() - max / 2;
+      drain(c, v.data() + v.size() - n, n);
+      v.resize(v.size() - n);
+    }
+  }
+
+  /// flush the caches of threads that have not used them since last time
+  void flush_idle() {
+    std::lock_guard<std::mutex> l(caches_lock);
+    for (auto t : caches) {
+      std::lock_guard<std::mutex> tl(t->lock);
+      if (t->idle)
+	flush(*t);
+      t->idle = true;
+    }
+  }
+
+  int set_arena_bytes(size_t bytes) {
+    if (!bytes)
+      return 0;
+    std::lock_guard<std::mutex> l(arena_lock);
+    if (arena.load())
+      return -EEXIST;
+    HugepageArena *a = new HugepageArena;
+    int r = a->init(bytes);
+    if (r < 0) {
+      delete a;
+      return r;
+    }
+    arena = a;
+    return 0;
+  }
+};
+
+thread_local SlabAllocator::ThreadCache SlabAllocator::tls_cache;
+thread_local bool SlabAllocator::tls_cache_gone = false;
+
+SlabAllocator *get_slab()
+{
+  // never destroyed: buffers may outlive static destructors
+  static SlabAllocator *slab = new SlabAllocator;
+  return slab;
+}
+
+SlabAllocator::ThreadCache::ThreadCache()
+{
+  SlabAllocator *slab = get_slab();
+  std::lock_guard<std::mutex> l(slab->caches_lock);
+  slab->caches.push_back(this);
+}
+
+SlabAllocator::ThreadCache::~ThreadCache()
+{
+  tls_cache_gone = true;
+  SlabAllocator *slab = get_slab();
+  std::lock_guard<std::mutex> l(slab->caches_lock);
+  slab->caches.erase(std::find(slab->caches.begin(), slab->caches.end(), this));
+  std::lock_guard<std::mutex> tl(lock);
+  slab->flush(*this);
+}
+
+} // anonymous namespace
+
+ceph::buffer::raw_allocator *ceph::buffer::get_slab_allocator()
+{
+  return get_slab();
+}
+
+void ceph::buffer::set_slab_thread_cache_bytes(size_t bytes)
+{
+  thread_cache_bytes = bytes;
+}
+
+void ceph::buffer::set_slab_thread_cache_total_bytes(size_t bytes)
+{
+  thread_cache_total_bytes = bytes;
+}
+
+void ceph::buffer::flush_idle_slab_thread_caches()
+{
+  get_slab()->flush_idle();
+}
+
+void ceph::buffer::set_slab_depot_bytes(size_t bytes)
+{
+  depot_bytes = bytes;
+}
+
+int ceph::buffer::set_slab_hugepage_arena_bytes(size_t bytes)
+{
+  return get_slab()->set_arena_bytes(bytes);
+}
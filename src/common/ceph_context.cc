@@ -100,6 +100,12 @@ public:
   const char** get_tracked_conf_keys() const override {
     static const char *KEYS[] = {
       "mempool_debug",
+      "mempool_soft_limits",
+      "buffer_slab_allocator",
+      "buffer_slab_thread_cache_bytes",
+      "buffer_slab_thread_cache_total_bytes",
+      "buffer_slab_depot_bytes",
+      "buffer_slab_hugepage_arena_bytes",
       NULL
     };
     return KEYS;
@@ -110,6 +116,38 @@ public:
     if (changed.count("mempool_debug")) {
       mempool::set_debug_mode(cct->_conf->mempool_debug);
     }
+    if (changed.count("mempool_soft_limits")) {
+      ostringstream ss;
+      int r = mempool::set_soft_limits(cct->_conf->mempool_soft_limits, &ss);
+      if (r < 0)
+	lderr(cct) << "unable to parse mempool_soft_limits '"
+		   << cct->_conf->mempool_soft_limits << "': " << ss.str()
+		   << dendl;
+    }
+    if (changed.count("buffer_slab_thread_cache_bytes")) {
+      buffer::set_slab_thread_cache_bytes(
+	cct->_conf->buffer_slab_thread_cache_bytes);
+    }
+    if (changed.count("buffer_slab_thread_cache_total_bytes")) {
+      buffer::set_slab_thread_cache_total_bytes(
+	cct->_conf->buffer_slab_thread_cache_total_bytes);
+    }
+    if (changed.count("buffer_slab_depot_bytes")) {
+      buffer::set_slab_depot_bytes(cct->_conf->buffer_slab_depot_bytes);
+    }
+    if (changed.count("buffer_slab_hugepage_arena_bytes")) {
+      int r = buffer::set_slab_hugepage_arena_bytes(
+	cct->_conf->buffer_slab_hugepage_arena_bytes);
+      if (r < 0)
+	lderr(cct) << "unable to set up a "
+		   << cct->_conf->buffer_slab_hugepage_arena_bytes
+		   << " byte hugepage arena for buffers: " << cpp_strerror(r)
+		   << dendl;
+    }
+    if (changed.count("buffer_slab_allocator")) {
+      buffer::set_raw_allocator(cct->_conf->buffer_slab_allocator ?
+				buffer::get_slab_allocator() : nullptr);
+    }
   }
 
   // AdminSocketHook
@@ -163,6 +201,10 @@ public:
 
       // refresh the perf coutners
       _cct->refresh_perf_values();
+
+      mempool::check_soft_limits();
+      buffer::flush_idle_slab_thread_caches();
+      _cct->_conf->reclaim_snapshots();
     }
     return NULL;
   }
@@ -208,6 +250,7 @@ public:
       "log_file",
       "log_max_new",
       "log_max_recent",
+      "log_thread_queue_len",
       "log_to_syslog",
       "err_to_syslog",
       "log_to_stderr",
@@ -252,6 +295,10 @@ public:
       log->set_max_recent(conf->log_max_recent);
     }
 
+    if (changed.count("log_thread_queue_len")) {
+      log->set_thread_queue_len(conf->log_thread_queue_len);
+    }
+
     // graylog
     if (changed.count("log_to_graylog") || changed.count("err_to_graylog")) {
       int l = conf->log_to_graylog ? 99 : (conf->err_to_graylog ? -1 : -2);
@@ -184,6 +184,41 @@ md_config_t::md_config_t()
 
   validate_default_settings();
   init_subsys();
+  _publish_snapshot();
+}
+
+md_config_snapshot_t::md_config_snapshot_t(const md_config_t& conf,
+					   uint64_t version)
+  :
+#define OPTION(name, type, def_val) name(conf.name),
+#define OPTION_VALIDATOR(name)
+#define SAFE_OPTION(name, type, def_val) OPTION(name, type, def_val)
+#define SUBSYS(name, log, gather)
+#define DEFAULT_SUBSYS(log, gather)
+#include "common/config_opts.h"
+#undef OPTION
+#undef OPTION_VALIDATOR
+#undef SAFE_OPTION
+#undef SUBSYS
+#undef DEFAULT_SUBSYS
+    version(version)
+{
+}
+
+bool md_config_snapshot_t::matches(const md_config_t& conf) const
+{
+#define OPTION(name, type, def_val) if (!(name == conf.name)) return false;
+#define OPTION_VALIDATOR(name)
+#define SAFE_OPTION(name, type, def_val) OPTION(name, type, def_val)
+#define SUBSYS(name, log, gather)
+#define DEFAULT_SUBSYS(log, gather)
+#include "common/config_opts.h"
+#undef OPTION
+#undef OPTION_VALIDATOR
+#undef SAFE_OPTION
+#undef SUBSYS
+#undef DEFAULT_SUBSYS
+  return true;
 }
 
 void md_config_t::init_subsys()
@@ -205,6 +240,41 @@ void md_config_t::init_subsys()
 
 md_config_t::~md_config_t()
 {
+  for (auto& p : retired_snapshots)
+    delete p.second;
+  delete current_snapshot.load(std::memory_order_relaxed);
+}
+
+void md_config_t::_publish_snapshot()
+{
+  // set_val() marks options changed even when they are set to the value
+  // they already have, so compare before making a copy nobody needs.
+  const md_config_snapshot_t *cur =
+    current_snapshot.load(std::memory_order_relaxed);
+  if (cur && cur->matches(*this))
+    return;
+  const md_config_snapshot_t *next =
+    new md_config_snapshot_t(*this, cur ? cur->version + 1 : 1);
+  current_snapshot.store(next, std::memory_order_release);
+  // readers may still be using the old one; reclaim_snapshots() frees it
+  // once the grace period is over
+  if (cur)
+    retired_snapshots.emplace_back(ceph::coarse_mono_clock::now(), cur);
+}
+
+int md_config_t::reclaim_snapshots()
+{
+  Mutex::Locker l(lock);
+  const ceph::coarse_mono_time now = ceph::coarse_mono_clock::now();
+  const ceph::timespan grace = std::chrono::seconds(config_snapshot_grace);
+  int n = 0;
+  while (!retired_snapshots.empty() &&
+	 now - retired_snapshots.front().first >= grace) {
+    delete retired_snapshots.front().second;
+    retired_snapshots.pop_front();
+    ++n;
+  }
+  return n;
 }
 
 void md_config_t::add_observer(md_config_obs_t* observer_)
@@ -707,9 +777,12 @@ void md_config_t::_apply_changes(std::ostream *oss)
     }
   }
 
+  if (!changed.empty())
+    _publish_snapshot();
   changed.clear();
 
-  // Make any pending observer callbacks
+  // Make any pending observer callbacks, now that the new values are
+  // visible through snapshot() as well
   for (rev_obs_map_t::const_iterator r = robs.begin(); r != robs.end(); ++r) {
     md_config_obs_t *obs = r->first;
     obs->handle_conf_change(this, r->second);
@@ -724,6 +797,7 @@ void md_config_t::call_all_observers()
     Mutex::Locker l(lock);
 
     expand_all_meta();
+    _publish_snapshot();
 
     for (obs_map_t::iterator r = observers.begin(); r != observers.end(); ++r) {
       obs[r->second].insert(r->first);
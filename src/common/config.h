@@ -16,13 +16,17 @@
 #define CEPH_CONFIG_H
 
 #include <iosfwd>
+#include <atomic>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <vector>
 #include <map>
 #include <set>
 #include <boost/variant.hpp>
 
 #include "common/ConfUtils.h"
+#include "common/ceph_time.h"
 #include "common/entity_name.h"
 #include "common/Mutex.h"
 #include "log/SubsystemMap.h"
@@ -41,6 +45,7 @@ enum {
 #define OSD_POOL_ERASURE_CODE_STRIPE_WIDTH 4096
 
 class CephContext;
+struct md_config_snapshot_t;
 
 extern const char *CEPH_CONF_FILE_DEFAULT;
 
@@ -59,12 +64,19 @@ extern const char *CEPH_CONF_FILE_DEFAULT;
  *
  * ACCESS
  *
- * There are 3 ways to read the ceph context-- the old way and two new ways.
+ * There are 4 ways to read the ceph context-- the old way and three new ways.
  * In the old way, code would simply read the public variables of the
  * configuration, without taking a lock. In the new way #1, code registers a
  * configuration obserever which receives callbacks when a value changes. These
  * callbacks take place under the md_config_t lock. Alternatively one can use
  * get_val(const char *name) method to safely get a copy of the value.
+ * Hot paths should use snapshot() instead: it returns an immutable copy of
+ * all the values as of the last apply_changes() with a plain acquire load
+ * of a pointer, so that values read together are consistent with each
+ * other and nothing changes underneath the reader.  A new snapshot is
+ * published before the observers are called; the one it replaces is freed
+ * by reclaim_snapshots() once config_snapshot_grace has passed, so a
+ * reader must not hold on to a snapshot for longer than that.
  *
  * To prevent serious problems resulting from thread-safety issues, we disallow
  * changing std::string configuration values after
@@ -198,6 +210,16 @@ public:
   bool _internal_field(const string& k);
   void call_all_observers();
 
+  /// the values as of the last apply_changes(); never NULL, and valid for
+  /// at least config_snapshot_grace seconds after it is replaced
+  const md_config_snapshot_t *snapshot() const {
+    return current_snapshot.load(std::memory_order_acquire);
+  }
+
+  /// free the snapshots replaced more than config_snapshot_grace ago;
+  /// returns how many were freed
+  int reclaim_snapshots();
+
   // Called by the Ceph daemons to make configuration changes at runtime
   int injectargs(const std::string &s, std::ostream *oss);
 
@@ -287,6 +309,10 @@ private:
   /// expand all metavariables in config structure.
   void expand_all_meta();
 
+  /// copy the current values into a new snapshot and publish it, unless
+  /// they are the same as the current one's
+  void _publish_snapshot();
+
   // The configuration file we read, or NULL if we haven't read one.
   ConfFile cf;
 public:
@@ -296,6 +322,13 @@ private:
   obs_map_t observers;
   changed_set_t changed;
 
+  /// the latest snapshot; stored with release, loaded with acquire
+  std::atomic<const md_config_snapshot_t*> current_snapshot{nullptr};
+  /// replaced snapshots and when they were replaced, oldest first;
+  /// protected by lock
+  std::deque<std::pair<ceph::coarse_mono_time,
+		       const md_config_snapshot_t*>> retired_snapshots;
+
 public:
   ceph::logging::SubsystemMap subsys;
 
@@ -357,6 +390,7 @@ public:
   mutable Mutex lock;
 
   friend class test_md_config_t;
+  friend struct md_config_snapshot_t;
 protected:
   // Tests and possibly users expect options to appear in the output
   // of ceph-conf in the same order as declared in config_opts.h
@@ -364,6 +398,57 @@ protected:
   config_option const *find_config_option(const std::string& normalized_key) const;
 };
 
+/**
+ * An immutable copy of every option value of an md_config_t.
+ *
+ * Unlike the md_config_t fields, which may be rewritten while they are
+ * being read, a snapshot never changes once it has been published, and
+ * SAFE_OPTIONs may be read from it directly.
+ */
+struct md_config_snapshot_t {
+#define OPTION_OPT_INT(name) const int name;
+#define OPTION_OPT_LONGLONG(name) const long long name;
+#define OPTION_OPT_STR(name) const std::string name;
+#define OPTION_OPT_DOUBLE(name) const double name;
+#define OPTION_OPT_FLOAT(name) const float name;
+#define OPTION_OPT_BOOL(name) const bool name;
+#define OPTION_OPT_ADDR(name) const entity_addr_t name;
+#define OPTION_OPT_U32(name) const uint32_t name;
+#define OPTION_OPT_U64(name) const uint64_t name;
+#define OPTION_OPT_UUID(name) const uuid_d name;
+#define OPTION(name, ty, init) OPTION_##ty(name)
+#define OPTION_VALIDATOR(name)
+#define SAFE_OPTION(name, ty, init) OPTION_##ty(name)
+#define SUBSYS(name, log, gather)
+#define DEFAULT_SUBSYS(log, gather)
+#include "common/config_opts.h"
+#undef OPTION_OPT_INT
+#undef OPTION_OPT_LONGLONG
+#undef OPTION_OPT_STR
+#undef OPTION_OPT_DOUBLE
+#undef OPTION_OPT_FLOAT
+#undef OPTION_OPT_BOOL
+#undef OPTION_OPT_ADDR
+#undef OPTION_OPT_U32
+#undef OPTION_OPT_U64
+#undef OPTION_OPT_UUID
+#undef OPTION
+#undef OPTION_VALIDATOR
+#undef SAFE_OPTION
+#undef SUBSYS
+#undef DEFAULT_SUBSYS
+
+  /// bumped on every publication
+  const uint64_t version;
+
+  md_config_snapshot_t(const md_config_t& conf, uint64_t version);
+  md_config_snapshot_t(const md_config_snapshot_t&) = delete;
+  md_config_snapshot_t& operator=(const md_config_snapshot_t&) = delete;
+
+  /// whether every value is the same as conf's
+  bool matches(const md_config_t& conf) const;
+};
+
 template<typename T>
 struct get_typed_value_visitor : public boost::static_visitor<T> {
   template<typename U,
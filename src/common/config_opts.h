@@ -44,6 +44,7 @@ OPTION(erasure_code_dir, OPT_STR, CEPH_PKGLIBDIR"/erasure-code") // default loca
 OPTION(log_file, OPT_STR, "/var/log/ceph/$cluster-$name.log") // default changed by common_preinit()
 OPTION(log_max_new, OPT_INT, 1000) // default changed by common_preinit()
 OPTION(log_max_recent, OPT_INT, 10000) // default changed by common_preinit()
+OPTION(log_thread_queue_len, OPT_INT, 64) // per-thread lock-free queue of new entries; 0 to disable
 OPTION(log_to_stderr, OPT_BOOL, true) // default changed by common_preinit()
 OPTION(err_to_stderr, OPT_BOOL, true) // default changed by common_preinit()
 OPTION(log_to_syslog, OPT_BOOL, false)
@@ -107,6 +108,16 @@ OPTION(async_compressor_thread_timeout, OPT_INT, 5)
 OPTION(async_compressor_thread_suicide_timeout, OPT_INT, 30)
 
 OPTION(mempool_debug, OPT_BOOL, false)
+// per pool soft limits, "pool=bytes[,pool=bytes...]"; pools over their limit
+// ask their caches to trim every heartbeat_interval
+OPTION(mempool_soft_limits, OPT_STR, "")
+
+// recycle page aligned 4K/64K/4M data buffers through per-thread slab caches
+OPTION(buffer_slab_allocator, OPT_BOOL, false)
+OPTION(buffer_slab_thread_cache_bytes, OPT_U64, 1 << 20) // per thread and size class
+OPTION(buffer_slab_thread_cache_total_bytes, OPT_U64, 64 << 20) // all thread caches together
+OPTION(buffer_slab_depot_bytes, OPT_U64, 64 << 20) // shared, per size class
+OPTION(buffer_slab_hugepage_arena_bytes, OPT_U64, 0) // carve slabs from hugepages; only read once
 
 DEFAULT_SUBSYS(0, 5)
 SUBSYS(lockdep, 0, 1)
@@ -173,6 +184,9 @@ OPTION(keyring, OPT_STR, "/etc/ceph/$cluster.$name.keyring,/etc/ceph/$cluster.ke
 OPTION(heartbeat_interval, OPT_INT, 5)
 OPTION(heartbeat_file, OPT_STR, "")
 OPTION(heartbeat_inject_failure, OPT_INT, 0)    // force an unhealthy heartbeat for N seconds
+// a replaced config snapshot is freed this many seconds later, by the
+// heartbeat_interval service thread; readers must drop theirs sooner
+OPTION(config_snapshot_grace, OPT_U32, 300)
 OPTION(perf, OPT_BOOL, true)       // enable internal perf counters
 
 OPTION(ms_type, OPT_STR, "async+posix")   // messenger backend
@@ -181,6 +195,10 @@ OPTION(ms_cluster_type, OPT_STR, "")   // messenger backend
 OPTION(ms_tcp_nodelay, OPT_BOOL, true)
 OPTION(ms_tcp_rcvbuf, OPT_INT, 0)
 OPTION(ms_tcp_prefetch_max_size, OPT_INT, 4096) // max prefetch size, we limit this to avoid extra memcpy
+OPTION(ms_tcp_zerocopy, OPT_BOOL, false) // use MSG_ZEROCOPY for large sends (async posix stack, linux >= 4.14)
+OPTION(ms_tcp_zerocopy_min_size, OPT_U64, 64 << 10) // only sends at least this big use MSG_ZEROCOPY
+OPTION(ms_tcp_zerocopy_max_pinned, OPT_U64, 64 << 20) // per connection cap on bytes awaiting zerocopy completion
+OPTION(ms_tcp_zerocopy_linger, OPT_DOUBLE, 30) // seconds a closed socket waits for outstanding zerocopy completions before it is reset
 OPTION(ms_initial_backoff, OPT_DOUBLE, .2)
 OPTION(ms_max_backoff, OPT_DOUBLE, 15.0)
 OPTION(ms_crc_data, OPT_BOOL, true)
@@ -190,6 +208,8 @@ OPTION(ms_die_on_unhandled_msg, OPT_BOOL, false)
 OPTION(ms_die_on_old_message, OPT_BOOL, false)     // assert if we get a dup incoming message and shouldn't have (may be triggered by pre-541cd3c64be0dfa04e8a2df39422e0eb9541a428 code)
 OPTION(ms_die_on_skipped_message, OPT_BOOL, false)  // assert if we skip a seq (kernel client does this intentionally)
 OPTION(ms_dispatch_throttle_bytes, OPT_U64, 100 << 20)
+OPTION(ms_dispatch_control_throttle_bytes, OPT_U64, 100 << 20) // separate budget for maps, beacons, heartbeats and high priority messages
+OPTION(ms_dispatch_threads, OPT_INT, 1) // >1 requires dispatchers that tolerate concurrent ms_dispatch calls
 OPTION(ms_bind_ipv6, OPT_BOOL, false)
 OPTION(ms_bind_port_min, OPT_INT, 6800)
 OPTION(ms_bind_port_max, OPT_INT, 7300)
@@ -214,6 +234,7 @@ OPTION(ms_inject_delay_probability, OPT_DOUBLE, 0) // range [0, 1]
 OPTION(ms_inject_internal_delays, OPT_DOUBLE, 0)   // seconds
 OPTION(ms_dump_on_send, OPT_BOOL, false)           // hexdump msg to log on send
 OPTION(ms_dump_corrupt_message_level, OPT_INT, 1)  // debug level to hexdump undecodeable messages at
+OPTION(ms_msg_latency, OPT_BOOL, false)            // per type/connection stage latency histograms (dump_msg_latency)
 OPTION(ms_async_op_threads, OPT_U64, 3)            // number of worker processing threads for async messenger created on init
 OPTION(ms_async_max_op_threads, OPT_U64, 5)        // max number of worker processing threads for async messenger
 OPTION(ms_async_set_affinity, OPT_BOOL, true)
@@ -224,6 +245,8 @@ OPTION(ms_async_set_affinity, OPT_BOOL, true)
 // core
 OPTION(ms_async_affinity_cores, OPT_STR, "")
 OPTION(ms_async_send_inline, OPT_BOOL, false)
+OPTION(ms_async_cork_bytes, OPT_U64, 64 << 10) // batch already-queued outgoing messages into one send up to this many bytes; 0 sends each separately
+OPTION(ms_async_rx_buffer_pool_bytes, OPT_U64, 8 << 20) // per worker cache of page-aligned receive buffers; 0 disables
 OPTION(ms_async_rdma_device_name, OPT_STR, "")
 OPTION(ms_async_rdma_enable_hugepage, OPT_BOOL, false)
 OPTION(ms_async_rdma_buffer_size, OPT_INT, 8192)
@@ -234,12 +257,17 @@ OPTION(ms_async_rdma_polling_us, OPT_U32, 1000)
 OPTION(ms_async_rdma_local_gid, OPT_STR, "")       // GID format: "fe80:0000:0000:0000:7efe:90ff:fe72:6efe", no zero folding
 OPTION(ms_async_rdma_roce_ver, OPT_INT, 1)         // 0=RoCEv1, 1=RoCEv2, 2=RoCEv1.5
 OPTION(ms_async_rdma_sl, OPT_INT, 3)               // in RoCE, this means PCP
+OPTION(ms_async_rdma_inline_size, OPT_U32, 128)    // sends up to this size are copied into the work request; 0 disables
+OPTION(ms_async_rdma_zero_copy, OPT_BOOL, false)   // send large buffers from their own registered memory
+OPTION(ms_async_rdma_zero_copy_min_size, OPT_U32, 64 << 10)
+OPTION(ms_async_rdma_reg_cache_bytes, OPT_U64, 256 << 20) // cap on memory kept registered for zero copy sends
 
 OPTION(ms_dpdk_port_id, OPT_INT, 0)
 OPTION(ms_dpdk_coremask, OPT_STR, "1")
 OPTION(ms_dpdk_memory_channel, OPT_STR, "4")
 OPTION(ms_dpdk_hugepages, OPT_STR, "")
 OPTION(ms_dpdk_pmd, OPT_STR, "")
+OPTION(ms_dpdk_eal_args, OPT_STR, "") // extra EAL arguments, e.g. "--vdev=net_virtio_user0,path=/dev/vhost-net --no-pci"
 OPTION(ms_dpdk_host_ipv4_addr, OPT_STR, "")
 OPTION(ms_dpdk_gateway_ipv4_addr, OPT_STR, "")
 OPTION(ms_dpdk_netmask_ipv4_addr, OPT_STR, "")
@@ -363,6 +391,7 @@ OPTION(mon_mds_skip_sanity, OPT_BOOL, false)  // skip safety assertions on FSMap
 
 // monitor debug options
 OPTION(mon_debug_deprecated_as_obsolete, OPT_BOOL, false) // consider deprecated commands as obsolete
+OPTION(mon_debug_no_require_luminous, OPT_BOOL, false) // do not set require_luminous_osds on new clusters
 
 // dump transactions
 OPTION(mon_debug_dump_transactions, OPT_BOOL, false)
@@ -669,6 +698,7 @@ OPTION(osd_crush_initial_weight, OPT_DOUBLE, -1) // if >=0, the initial weight i
 OPTION(osd_pool_default_crush_rule, OPT_INT, -1) // deprecated for osd_pool_default_crush_replicated_ruleset
 OPTION(osd_pool_default_crush_replicated_ruleset, OPT_INT, CEPH_DEFAULT_CRUSH_REPLICATED_RULESET)
 OPTION(osd_pool_erasure_code_stripe_width, OPT_U32, OSD_POOL_ERASURE_CODE_STRIPE_WIDTH) // in bytes
+OPTION(osd_ec_parity_delta_writes, OPT_BOOL, false) // partial stripe overwrites read and write only the modified data chunks and the coding chunks, if the plugin supports it
 OPTION(osd_pool_default_size, OPT_INT, 3)
 OPTION(osd_pool_default_min_size, OPT_INT, 0)  // 0 means no specific default; ceph will use size-size/2
 OPTION(osd_pool_default_pg_num, OPT_INT, 8) // number of PGs for new pools. Configure in global or mon section of ceph.conf
@@ -797,6 +827,10 @@ OPTION(osd_auto_mark_unfound_lost, OPT_BOOL, false)
 OPTION(osd_recovery_delay_start, OPT_FLOAT, 0)
 OPTION(osd_recovery_max_active, OPT_U64, 3)
 OPTION(osd_recovery_max_single_start, OPT_U64, 1)
+OPTION(osd_recovery_max_bytes_per_sec, OPT_U64, 0) // per-osd recovery bandwidth budget; 0 to disable
+OPTION(osd_recovery_max_ops_per_sec, OPT_U64, 0)   // per-osd recovered objects/sec budget; 0 to disable
+OPTION(osd_recovery_target_client_latency, OPT_DOUBLE, 0) // seconds; throttle recovery budget when client ops are slower; 0 to disable
+OPTION(osd_recovery_min_rate_scale, OPT_DOUBLE, .05) // lowest fraction of the recovery budget latency feedback may throttle to
 OPTION(osd_recovery_max_chunk, OPT_U64, 8<<20)  // max size of push chunk
 OPTION(osd_recovery_max_omap_entries_per_chunk, OPT_U64, 64000) // max number of omap entries per chunk; 0 to disable limit
 OPTION(osd_copyfrom_max_chunk, OPT_U64, 8<<20)   // max size of a COPYFROM chunk
@@ -842,6 +876,8 @@ OPTION(osd_min_pg_log_entries, OPT_U32, 3000)  // number of entries to keep in t
 OPTION(osd_max_pg_log_entries, OPT_U32, 10000) // max entries, say when degraded, before we trim
 OPTION(osd_pg_log_trim_min, OPT_U32, 100)
 OPTION(osd_op_complaint_time, OPT_FLOAT, 30) // how many seconds old makes an op complaint-worthy
+OPTION(osd_op_coalesce_max_ops, OPT_U32, 0) // max writes to one object queued behind an in-flight write and submitted as one transaction; 0 to disable
+OPTION(osd_op_coalesce_max_bytes, OPT_U64, 1<<20) // submit a coalesced batch once it carries this many bytes
 OPTION(osd_command_max_records, OPT_INT, 256)
 OPTION(osd_max_pg_blocked_by, OPT_U32, 16)    // max peer osds to report that are blocking our progress
 OPTION(osd_op_log_threshold, OPT_INT, 5) // how many op log messages to show in one go
@@ -866,6 +902,7 @@ OPTION(osd_enxio_on_misdirected_op, OPT_BOOL, false)
 OPTION(osd_debug_verify_cached_snaps, OPT_BOOL, false)
 OPTION(osd_enable_op_tracker, OPT_BOOL, true) // enable/disable OSD op tracking
 OPTION(osd_num_op_tracker_shard, OPT_U32, 32) // The number of shards for holding the ops
+OPTION(osd_op_tracker_sample_rate, OPT_U32, 1) // record the events of 1 in N ops (plus slow ones)
 OPTION(osd_op_history_size, OPT_U32, 20)    // Max number of completed ops to track
 OPTION(osd_op_history_duration, OPT_U32, 600) // Oldest completed op to track
 OPTION(osd_target_transaction_size, OPT_INT, 30)     // to adjust various transactions that batch smaller items
@@ -885,6 +922,9 @@ OPTION(osd_loop_before_reset_tphandle, OPT_U32, 64) // Max number of loop before
 OPTION(threadpool_default_timeout, OPT_INT, 60)
 // default wait time for an empty queue before pinging the hb timeout
 OPTION(threadpool_empty_queue_max_wait, OPT_INT, 2)
+// items a ThreadPool worker dequeues per trip through the pool lock; idle
+// workers steal the surplus
+OPTION(threadpool_dequeue_batch, OPT_INT, 1)
 
 OPTION(leveldb_log_to_ceph_log, OPT_BOOL, true)
 OPTION(leveldb_write_buffer_size, OPT_U64, 8 *1024*1024) // leveldb write buffer size
@@ -72,6 +72,24 @@ public:
 #define lgeneric_dout(cct, v) dout_impl(cct, ceph_subsys_, v) *_dout
 #define lgeneric_derr(cct) dout_impl(cct, ceph_subsys_, -1) *_dout
 
+// the lambda is called as f(ostream&) only if and when the entry is
+// written out, from the log thread; it must capture by value.  it is the
+// last argument and may contain commas (e.g. in its capture list).
+//
+// dout_prefix is NOT applied to deferred lines: it typically reads state
+// of the caller's object, which the log thread must not touch.  a caller
+// that wants one has to capture what it needs and write it from f.
+#define dout_deferred_impl(cct, sub, v, ...)				\
+  do {									\
+    if (cct->_conf->subsys.should_gather(sub, v))			\
+      cct->_log->submit_deferred(v, sub, __VA_ARGS__);			\
+  } while (0)
+
+#define lsubdout_deferred(cct, sub, v, ...)	\
+  dout_deferred_impl(cct, ceph_subsys_##sub, v, __VA_ARGS__)
+#define ldout_deferred(cct, v, ...)		\
+  dout_deferred_impl(cct, dout_subsys, v, __VA_ARGS__)
+
 #define ldlog_p1(cct, sub, lvl)                 \
   (cct->_conf->subsys.should_gather((sub), (lvl)))
 
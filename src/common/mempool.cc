@@ -12,8 +12,13 @@
  *
  */
 
+#include <errno.h>
+
+#include <sstream>
+
 #include "include/mempool.h"
 #include "include/demangle.h"
+#include "common/strtol.h"
 
 
 // default to debug_mode off
@@ -54,6 +59,58 @@ void mempool::set_debug_mode(bool d)
   debug_mode = d;
 }
 
+size_t mempool::pick_thread_shard()
+{
+  static std::atomic<size_t> next = {0};
+  return next++ & (num_shards - 1);
+}
+
+int mempool::check_soft_limits()
+{
+  int over = 0;
+  for (size_t i = 0; i < num_pools; ++i) {
+    if (get_pool((pool_index_t)i).check_soft_limit())
+      ++over;
+  }
+  return over;
+}
+
+int mempool::set_soft_limits(const std::string& spec, std::ostream *err)
+{
+  size_t limits[num_pools] = {0};
+  std::istringstream is(spec);
+  std::string item;
+  while (std::getline(is, item, ',')) {
+    if (item.empty())
+      continue;
+    size_t eq = item.find('=');
+    if (eq == std::string::npos) {
+      *err << "expected pool=bytes, got '" << item << "'";
+      return -EINVAL;
+    }
+    std::string name = item.substr(0, eq);
+    size_t i;
+    for (i = 0; i < num_pools; ++i) {
+      if (name == get_pool_name((pool_index_t)i))
+	break;
+    }
+    if (i == num_pools) {
+      *err << "unknown mempool '" << name << "'";
+      return -EINVAL;
+    }
+    std::string strerr;
+    uint64_t bytes = strict_sistrtoll(item.c_str() + eq + 1, &strerr);
+    if (!strerr.empty()) {
+      *err << "bad limit for mempool '" << name << "': " << strerr;
+      return -EINVAL;
+    }
+    limits[i] = bytes;
+  }
+  for (size_t i = 0; i < num_pools; ++i)
+    get_pool((pool_index_t)i).set_soft_limit(limits[i]);
+  return 0;
+}
+
 // --------------------------------------------------------------
 // pool_t
 
@@ -96,12 +153,43 @@ void mempool::pool_t::get_stats(
   }
 }
 
+int mempool::pool_t::register_trimmer(trimmer_t t)
+{
+  std::lock_guard<std::mutex> l(trim_lock);
+  int id = ++last_trimmer_id;
+  trimmers[id] = t;
+  return id;
+}
+
+void mempool::pool_t::unregister_trimmer(int id)
+{
+  std::lock_guard<std::mutex> l(trim_lock);
+  trimmers.erase(id);
+}
+
+bool mempool::pool_t::check_soft_limit()
+{
+  size_t limit = soft_limit;
+  if (!limit)
+    return false;
+  size_t bytes = allocated_bytes();
+  if (bytes <= limit)
+    return false;
+  std::lock_guard<std::mutex> l(trim_lock);
+  for (auto& p : trimmers)
+    p.second(bytes, limit);
+  return true;
+}
+
 void mempool::pool_t::dump(ceph::Formatter *f) const
 {
   stats_t total;
   std::map<std::string, stats_t> by_type;
   get_stats(&total, &by_type);
   f->dump_object("total", total);
+  size_t limit = soft_limit;
+  if (limit)
+    f->dump_unsigned("soft_limit", limit);
   if (!by_type.empty()) {
     for (auto &i : by_type) {
       f->open_object_section(i.first.c_str());
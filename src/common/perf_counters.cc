@@ -27,6 +27,8 @@
 #include <stdint.h>
 #include <string.h>
 #include <string>
+#include <atomic>
+#include <thread>
 
 using std::ostringstream;
 
@@ -183,13 +185,7 @@ void PerfCounters::inc(int idx, uint64_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return;
-  if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount.inc();
-    data.u64.add(amt);
-    data.avgcount2.inc();
-  } else {
-    data.u64.add(amt);
-  }
+  data.add(amt);
 }
 
 void PerfCounters::dec(int idx, uint64_t amt)
@@ -203,7 +199,7 @@ void PerfCounters::dec(int idx, uint64_t amt)
   assert(!(data.type & PERFCOUNTER_LONGRUNAVG));
   if (!(data.type & PERFCOUNTER_U64))
     return;
-  data.u64.sub(amt);
+  data.sub(amt);
 }
 
 void PerfCounters::set(int idx, uint64_t amt)
@@ -219,13 +215,7 @@ void PerfCounters::set(int idx, uint64_t amt)
 
   ANNOTATE_BENIGN_RACE_SIZED(&data.u64, sizeof(data.u64),
                              "perf counter atomic");
-  if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount.inc();
-    data.u64.set(amt);
-    data.avgcount2.inc();
-  } else {
-    data.u64.set(amt);
-  }
+  data.set(amt);
 }
 
 uint64_t PerfCounters::get(int idx) const
@@ -238,7 +228,7 @@ uint64_t PerfCounters::get(int idx) const
   const perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_U64))
     return 0;
-  return data.u64.read();
+  return data.read_u64();
 }
 
 void PerfCounters::tinc(int idx, utime_t amt)
@@ -251,13 +241,7 @@ void PerfCounters::tinc(int idx, utime_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return;
-  if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount.inc();
-    data.u64.add(amt.to_nsec());
-    data.avgcount2.inc();
-  } else {
-    data.u64.add(amt.to_nsec());
-  }
+  data.add(amt.to_nsec());
 }
 
 void PerfCounters::tinc(int idx, ceph::timespan amt)
@@ -270,13 +254,7 @@ void PerfCounters::tinc(int idx, ceph::timespan amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return;
-  if (data.type & PERFCOUNTER_LONGRUNAVG) {
-    data.avgcount.inc();
-    data.u64.add(amt.count());
-    data.avgcount2.inc();
-  } else {
-    data.u64.add(amt.count());
-  }
+  data.add(amt.count());
 }
 
 void PerfCounters::tset(int idx, utime_t amt)
@@ -289,7 +267,7 @@ void PerfCounters::tset(int idx, utime_t amt)
   perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return;
-  data.u64.set(amt.to_nsec());
+  data.set(amt.to_nsec());
   if (data.type & PERFCOUNTER_LONGRUNAVG)
     ceph_abort();
 }
@@ -304,7 +282,7 @@ utime_t PerfCounters::tget(int idx) const
   const perf_counter_data_any_d& data(m_data[idx - m_lower_bound - 1]);
   if (!(data.type & PERFCOUNTER_TIME))
     return utime_t();
-  uint64_t v = data.u64.read();
+  uint64_t v = data.read_u64();
   return utime_t(v / 1000000000ull, v % 1000000000ull);
 }
 
@@ -407,7 +385,7 @@ void PerfCounters::dump_formatted_generic(Formatter *f, bool schema,
         d->histogram->dump_formatted(f);
         f->close_section();
       } else {
-	uint64_t v = d->u64.read();
+	uint64_t v = d->read_u64();
 	if (d->type & PERFCOUNTER_U64) {
 	  f->dump_unsigned(d->name, v);
 	} else if (d->type & PERFCOUNTER_TIME) {
@@ -428,6 +406,29 @@ const std::string &PerfCounters::get_name() const
   return m_name;
 }
 
+unsigned PerfCounters::get_num_shards()
+{
+  static const unsigned num_shards = [] {
+    unsigned cpus = std::thread::hardware_concurrency();
+    unsigned n = 1;
+    while (n < cpus && n < 64)
+      n <<= 1;
+    return n;
+  }();
+  return num_shards;
+}
+
+unsigned PerfCounters::get_shard_index()
+{
+  // threads are handed out shards round robin on first use; with at
+  // least as many shards as cpus, busy threads rarely share one.
+  static std::atomic<unsigned> next_shard(0);
+  static __thread int shard = -1;
+  if (shard < 0)
+    shard = next_shard++ & (get_num_shards() - 1);
+  return shard;
+}
+
 PerfCounters::PerfCounters(CephContext *cct, const std::string &name,
 	   int lower_bound, int upper_bound)
   : m_cct(cct),
@@ -442,7 +443,8 @@ PerfCounters::PerfCounters(CephContext *cct, const std::string &name,
 
 PerfCountersBuilder::PerfCountersBuilder(CephContext *cct, const std::string &name,
                   int first, int last)
-  : m_perf_counters(new PerfCounters(cct, name, first, last))
+  : m_perf_counters(new PerfCounters(cct, name, first, last)),
+    m_sharded(false)
 {
 }
 
@@ -507,6 +509,9 @@ void PerfCountersBuilder::add_impl(int idx, const char *name,
   data.nick = nick;
   data.type = (enum perfcounter_type_d)ty;
   data.histogram = std::move(histogram);
+  if (m_sharded && (ty & (PERFCOUNTER_COUNTER | PERFCOUNTER_LONGRUNAVG)))
+    data.shards.reset(
+      new PerfCounters::perf_counter_shard_d[PerfCounters::get_num_shards()]);
 }
 
 PerfCounters *PerfCountersBuilder::create_perf_counters()
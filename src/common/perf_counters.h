@@ -69,10 +69,30 @@ enum perfcounter_type_d : uint8_t
  * For the time average, it returns the current value and
  * the "avgcount" member when read off. avgcount is incremented when you call
  * tinc. Calling tset on an average is an error and will assert out.
+ *
+ * Counters and averages that many threads bump at high rates can be
+ * sharded (see PerfCountersBuilder::set_sharded()): each thread updates
+ * its own cache line and readers sum the shards, so inc()/tinc() no
+ * longer bounce a shared line between cores.
  */
 class PerfCounters
 {
 public:
+  /// one thread's slice of a sharded counter, padded to its own cache lines
+  struct perf_counter_shard_d {
+    atomic64_t u64;
+    atomic64_t avgcount;
+    atomic64_t avgcount2;
+    char pad[128 - (3 * sizeof(atomic64_t)) % 128];
+
+    perf_counter_shard_d() : u64(0), avgcount(0), avgcount2(0) {}
+  };
+
+  /// number of shards of a sharded counter (a power of two)
+  static unsigned get_num_shards();
+  /// the calling thread's shard
+  static unsigned get_shard_index();
+
   /** Represents a PerfCounters data element. */
   struct perf_counter_data_any_d {
     perf_counter_data_any_d()
@@ -107,6 +127,8 @@ public:
     atomic64_t avgcount;
     atomic64_t avgcount2;
     std::unique_ptr<PerfHistogram<>> histogram;
+    /// non-NULL if sharded; u64/avgcount/avgcount2 are then unused
+    std::unique_ptr<perf_counter_shard_d[]> shards;
 
     void reset()
     {
@@ -114,14 +136,92 @@ public:
 	u64.set(0);
 	avgcount.set(0);
 	avgcount2.set(0);
+	if (shards) {
+	  for (unsigned i = 0; i < get_num_shards(); ++i) {
+	    shards[i].u64.set(0);
+	    shards[i].avgcount.set(0);
+	    shards[i].avgcount2.set(0);
+	  }
+	}
       }
       if (histogram) {
         histogram->reset();
       }
     }
 
+    /// add v, counting one more sample if this is an average
+    void add(uint64_t v) {
+      atomic64_t *pu64 = &u64, *pavgcount = &avgcount, *pavgcount2 = &avgcount2;
+      if (shards) {
+	perf_counter_shard_d& s = shards[get_shard_index()];
+	pu64 = &s.u64;
+	pavgcount = &s.avgcount;
+	pavgcount2 = &s.avgcount2;
+      }
+      if (type & PERFCOUNTER_LONGRUNAVG) {
+	pavgcount->inc();
+	pu64->add(v);
+	pavgcount2->inc();
+      } else {
+	pu64->add(v);
+      }
+    }
+
+    void sub(uint64_t v) {
+      if (shards)
+	shards[get_shard_index()].u64.sub(v);
+      else
+	u64.sub(v);
+    }
+
+    /// overwrite the value (not atomic against concurrent add() if sharded)
+    void set(uint64_t v) {
+      atomic64_t *pu64 = &u64, *pavgcount = &avgcount, *pavgcount2 = &avgcount2;
+      if (shards) {
+	for (unsigned i = 1; i < get_num_shards(); ++i)
+	  shards[i].u64.set(0);
+	pu64 = &shards[0].u64;
+	pavgcount = &shards[0].avgcount;
+	pavgcount2 = &shards[0].avgcount2;
+      }
+      if (type & PERFCOUNTER_LONGRUNAVG) {
+	pavgcount->inc();
+	pu64->set(v);
+	pavgcount2->inc();
+      } else {
+	pu64->set(v);
+      }
+    }
+
+    uint64_t read_u64() const {
+      if (!shards)
+	return u64.read();
+      uint64_t sum = 0;
+      for (unsigned i = 0; i < get_num_shards(); ++i)
+	sum += shards[i].u64.read();
+      return sum;
+    }
+
     /// read <sum, count> safely
     pair<uint64_t,uint64_t> read_avg() const {
+      if (shards) {
+	// each shard is consistent on its own; that is all we need
+	uint64_t total_sum = 0, total_count = 0;
+	for (unsigned i = 0; i < get_num_shards(); ++i) {
+	  pair<uint64_t,uint64_t> a = read_avg(shards[i].u64, shards[i].avgcount,
+					       shards[i].avgcount2);
+	  total_sum += a.first;
+	  total_count += a.second;
+	}
+	return make_pair(total_sum, total_count);
+      }
+      return read_avg(u64, avgcount, avgcount2);
+    }
+
+  private:
+    static pair<uint64_t,uint64_t> read_avg(const atomic64_t& u64,
+					    const atomic64_t& avgcount,
+					    const atomic64_t& avgcount2) {
       uint64_t sum, count;
       do {
 	count = avgcount.read();
@@ -288,6 +388,11 @@ public:
       PerfHistogramCommon::axis_config_d x_axis_config,
       PerfHistogramCommon::axis_config_d y_axis_config,
       const char *description=NULL, const char* nick = NULL);
+  /// shard the counters and averages added from now on (plain values
+  /// and histograms are never sharded)
+  void set_sharded(bool s) {
+    m_sharded = s;
+  }
   PerfCounters* create_perf_counters();
 private:
   PerfCountersBuilder(const PerfCountersBuilder &rhs);
@@ -297,6 +402,7 @@ private:
                 unique_ptr<PerfHistogram<>> histogram = nullptr);
 
   PerfCounters *m_perf_counters;
+  bool m_sharded;
 };
 
 #endif
@@ -16,6 +16,7 @@
  */
 
 #include <errno.h>
+#include <string.h>
 #include <vector>
 #include <algorithm>
 #include <ostream>
@@ -273,3 +274,34 @@ int ErasureCode::decode_concat(const map<int, bufferlist> &chunks,
   }
   return r;
 }
+
+void ErasureCode::encode_delta(const bufferptr &old_data,
+                               const bufferptr &new_data,
+                               bufferptr *delta)
+{
+  assert(old_data.length() == new_data.length());
+  unsigned length = old_data.length();
+  if (delta->length() == 0)
+    *delta = buffer::create_aligned(length, SIMD_ALIGN);
+  assert(delta->length() == length);
+
+  const char *o = old_data.c_str();
+  const char *n = new_data.c_str();
+  char *d = delta->c_str();
+  unsigned i = 0;
+  for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+    uint64_t ow, nw;
+    memcpy(&ow, o + i, sizeof(ow));
+    memcpy(&nw, n + i, sizeof(nw));
+    nw ^= ow;
+    memcpy(d + i, &nw, sizeof(nw));
+  }
+  for (; i < length; i++)
+    d[i] = o[i] ^ n[i];
+}
+
+int ErasureCode::apply_delta(const map<int, bufferptr> &in,
+                             map<int, bufferptr> *out)
+{
+  return -ENOTSUP;
+}
@@ -104,6 +104,17 @@ namespace ceph {
     virtual int decode_concat(const map<int, bufferlist> &chunks,
 			      bufferlist *decoded);
 
+    virtual bool supports_parity_delta() const {
+      return false;
+    }
+
+    virtual void encode_delta(const bufferptr &old_data,
+                              const bufferptr &new_data,
+                              bufferptr *delta);
+
+    virtual int apply_delta(const map<int, bufferptr> &in,
+                            map<int, bufferptr> *out);
+
   protected:
     int parse(const ErasureCodeProfile &profile,
 	      ostream *ss);
@@ -447,6 +447,44 @@ namespace ceph {
      */
     virtual int decode_concat(const map<int, bufferlist> &chunks,
 			      bufferlist *decoded) = 0;
+
+    /**
+     * Return true if the coding chunks can be updated with
+     * **apply_delta** when only some of the data chunks change,
+     * without reading the data chunks that stay the same. This is
+     * only possible for linear codes that do not remap the chunks.
+     *
+     * @return **true** if **apply_delta** is supported
+     */
+    virtual bool supports_parity_delta() const = 0;
+
+    /**
+     * Compute the difference between **old_data** and **new_data**,
+     * the previous and the new content of the same region of a data
+     * chunk, and store it in **delta**. Both buffers must have the
+     * same length. If **delta** is empty, a buffer is allocated.
+     *
+     * @param [in] old_data current content of the data chunk region
+     * @param [in] new_data new content of the data chunk region
+     * @param [out] delta the difference, to be given to **apply_delta**
+     */
+    virtual void encode_delta(const bufferptr &old_data,
+                              const bufferptr &new_data,
+                              bufferptr *delta) = 0;
+
+    /**
+     * Update the coding chunk regions in **out**, in place, with the
+     * deltas computed by **encode_delta** for the data chunk regions
+     * in **in**. Data chunks that did not change are not listed in
+     * **in**. All buffers must have the same length and cover the
+     * same region of their respective chunks.
+     *
+     * @param [in] in map data chunk indexes to deltas
+     * @param [in,out] out map coding chunk indexes to coding data
+     * @return **0** on success or a negative errno on error.
+     */
+    virtual int apply_delta(const map<int, bufferptr> &in,
+                            map<int, bufferptr> *out) = 0;
   };
 
   typedef ceph::shared_ptr<ErasureCodeInterface> ErasureCodeInterfaceRef;
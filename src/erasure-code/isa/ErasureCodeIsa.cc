@@ -157,6 +157,44 @@ ErasureCodeIsaDefault::isa_encode(char **data,
 
 // -----------------------------------------------------------------------------
 
+int
+ErasureCodeIsaDefault::apply_delta(const map<int, bufferptr> &in,
+                                   map<int, bufferptr> *out)
+{
+  for (map<int, bufferptr>::const_iterator d = in.begin();
+       d != in.end();
+       ++d) {
+    assert(d->first < k);
+    unsigned char *delta = (unsigned char*) d->second.c_str();
+    unsigned blocksize = d->second.length();
+    if (m == 1) {
+      // single parity stripe, see isa_encode
+      assert(out->size() == 1 && out->begin()->first == k);
+      bufferptr &parity = out->begin()->second;
+      assert(parity.length() == blocksize);
+      unsigned char *src[2] = {(unsigned char*) parity.c_str(), delta};
+      region_xor(src, (unsigned char*) parity.c_str(), 2, blocksize);
+      continue;
+    }
+    // ec_encode_data_update adds the contribution of data chunk
+    // d->first to all coding chunks, it must be given all of them
+    assert((int)out->size() == m);
+    vector<unsigned char*> coding(m);
+    for (map<int, bufferptr>::iterator c = out->begin();
+         c != out->end();
+         ++c) {
+      assert(c->first >= k && c->first < k + m);
+      assert(c->second.length() == blocksize);
+      coding[c->first - k] = (unsigned char*) c->second.c_str();
+    }
+    ec_encode_data_update(blocksize, k, m, d->first, encode_tbls,
+                          delta, coding.data());
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+
 bool
 ErasureCodeIsaDefault::erasure_contains(int *erasures, int i)
 {
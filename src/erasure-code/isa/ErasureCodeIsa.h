@@ -155,6 +155,14 @@ public:
                          char **coding,
                          int blocksize);
 
+  virtual bool supports_parity_delta() const
+  {
+    return chunk_mapping.empty();
+  }
+
+  virtual int apply_delta(const map<int, bufferptr> &in,
+                          map<int, bufferptr> *out);
+
   virtual unsigned get_alignment() const;
 
   virtual void prepare();
@@ -150,6 +150,46 @@ int ErasureCodeJerasure::decode_chunks(const set<int> &want_to_read,
   return jerasure_decode(erasures, data, coding, blocksize);
 }
 
+int ErasureCodeJerasure::matrix_apply_delta(const int *matrix,
+					    const map<int, bufferptr> &in,
+					    map<int, bufferptr> *out)
+{
+  // coding chunk i is the sum of matrix[(i - k) * k + j] * data chunk j
+  // in GF(2^w), therefore a change of data chunk j by delta changes
+  // coding chunk i by matrix[(i - k) * k + j] * delta
+  for (map<int, bufferptr>::const_iterator d = in.begin();
+       d != in.end();
+       ++d) {
+    assert(d->first < k);
+    for (map<int, bufferptr>::iterator c = out->begin();
+	 c != out->end();
+	 ++c) {
+      assert(c->first >= k && c->first < k + m);
+      assert(c->second.length() == d->second.length());
+      assert(c->second.length() % (w / 8) == 0);
+      int multby = matrix[(c->first - k) * k + d->first];
+      char *region = const_cast<char*>(d->second.c_str());
+      switch (w) {
+      case 8:
+	galois_w08_region_multiply(region, multby, d->second.length(),
+				   c->second.c_str(), 1);
+	break;
+      case 16:
+	galois_w16_region_multiply(region, multby, d->second.length(),
+				   c->second.c_str(), 1);
+	break;
+      case 32:
+	galois_w32_region_multiply(region, multby, d->second.length(),
+				   c->second.c_str(), 1);
+	break;
+      default:
+	return -ENOTSUP;
+      }
+    }
+  }
+  return 0;
+}
+
 bool ErasureCodeJerasure::is_prime(int value)
 {
   int prime55[] = {
@@ -86,6 +86,9 @@ public:
   static bool is_prime(int value);
 protected:
   virtual int parse(ErasureCodeProfile &profile, ostream *ss);
+  int matrix_apply_delta(const int *matrix,
+			 const map<int, bufferptr> &in,
+			 map<int, bufferptr> *out);
 };
 
 class ErasureCodeJerasureReedSolomonVandermonde : public ErasureCodeJerasure {
@@ -112,6 +115,13 @@ public:
                                char **data,
                                char **coding,
                                int blocksize);
+  virtual bool supports_parity_delta() const {
+    return chunk_mapping.empty();
+  }
+  virtual int apply_delta(const map<int, bufferptr> &in,
+                          map<int, bufferptr> *out) {
+    return matrix_apply_delta(matrix, in, out);
+  }
   virtual unsigned get_alignment() const;
   virtual void prepare();
 private:
@@ -141,6 +151,13 @@ public:
                                char **data,
                                char **coding,
                                int blocksize);
+  virtual bool supports_parity_delta() const {
+    return chunk_mapping.empty();
+  }
+  virtual int apply_delta(const map<int, bufferptr> &in,
+                          map<int, bufferptr> *out) {
+    return matrix_apply_delta(matrix, in, out);
+  }
   virtual unsigned get_alignment() const;
   virtual void prepare();
 private:
@@ -123,6 +123,44 @@ namespace buffer CEPH_BUFFER_API {
   /// enable/disable tracking of buffer::ptr::c_str() calls
   void track_c_str(bool b);
 
+  /*
+   * where page aligned and large raw buffers get their memory.
+   */
+  class CEPH_BUFFER_API raw_allocator {
+  public:
+    virtual ~raw_allocator() {}
+    /// len bytes aligned to align, or NULL to use the default allocator
+    virtual char *allocate(size_t len, size_t align) = 0;
+    /// give back memory returned by allocate(len, align)
+    virtual void deallocate(char *p, size_t len, size_t align) = 0;
+  };
+
+  /// use a (NULL for the default); it must never be destroyed, since
+  /// buffers allocated by it return their memory to it
+  void set_raw_allocator(raw_allocator *a);
+  raw_allocator *get_raw_allocator();
+
+  /**
+   * the built-in slab allocator: 4K, 64K and 4M buffers are recycled
+   * through per-thread caches backed by a shared depot per size class,
+   * optionally carved out of a hugepage arena.  Idle memory is accounted
+   * to the buffer_slab mempool, handed out memory to buffer_data.
+   */
+  raw_allocator *get_slab_allocator();
+  /// bytes each thread caches per size class; classes whose buffers
+  /// are bigger bypass the thread caches
+  void set_slab_thread_cache_bytes(size_t bytes);
+  /// bytes all thread caches together may hold
+  void set_slab_thread_cache_total_bytes(size_t bytes);
+  /// give back the caches of threads that have not allocated or freed a
+  /// slab buffer since the previous call
+  void flush_idle_slab_thread_caches();
+  /// bytes the shared depot caches per size class
+  void set_slab_depot_bytes(size_t bytes);
+  /// carve new slabs out of a hugepage backed arena of this size; only
+  /// the first successful call has any effect
+  int set_slab_hugepage_arena_bytes(size_t bytes);
+
   /*
    * an abstract raw buffer.  with a reference count.
    */
@@ -339,8 +377,256 @@ namespace buffer CEPH_BUFFER_API {
    */
 
   class CEPH_BUFFER_API list {
+  public:
+    /**
+     * the segments of a list.
+     *
+     * A doubly linked list like std::list<ptr>, except that the first
+     * node is embedded in the container, so that the common single
+     * segment list never allocates a node.  Further nodes are allocated
+     * from the buffer_meta mempool.  Iterators stay valid across
+     * insertion and erasure of other elements; unlike std::list, splice,
+     * swap and move invalidate iterators to the source's embedded node,
+     * whose segment is moved to another node.  They stay constant time.
+     */
+    class CEPH_BUFFER_API buffers_t {
+      struct node_base {
+	node_base *prev, *next;
+      };
+    public:
+      struct ptr_node : public node_base {
+	ptr bp;
+	ptr_node() {}
+	template<typename... Args>
+	explicit ptr_node(Args&&... args) : bp(std::forward<Args>(args)...) {}
+	static void *operator new(size_t size);
+	static void operator delete(void *p);
+      };
+
+    private:
+      node_base _root;
+      ptr_node _inline;
+      bool _inline_used;
+      size_t _size;
+
+      template<typename... Args>
+      ptr_node *_create_node(Args&&... args) {
+	if (!_inline_used) {
+	  _inline_used = true;
+	  _inline.bp = ptr(std::forward<Args>(args)...);
+	  return &_inline;
+	}
+	return new ptr_node(std::forward<Args>(args)...);
+      }
+      void _destroy_node(ptr_node *n) {
+	if (n == &_inline) {
+	  _inline.bp = ptr();
+	  _inline_used = false;
+	} else {
+	  delete n;
+	}
+      }
+      static void _link_before(node_base *pos, node_base *n) {
+	n->next = pos;
+	n->prev = pos->prev;
+	pos->prev->next = n;
+	pos->prev = n;
+      }
+      static void _unlink(node_base *n) {
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+      }
+      void _reset() {
+	_root.prev = _root.next = &_root;
+	_size = 0;
+      }
+
+    public:
+      template <bool is_const>
+      class iterator_impl
+	: public std::iterator<std::bidirectional_iterator_tag,
+			       typename std::conditional<is_const,
+							 const ptr,
+							 ptr>::type> {
+	typedef typename std::conditional<is_const,
+					  const node_base,
+					  node_base>::type node_t;
+	typedef typename std::conditional<is_const,
+					  const ptr_node,
+					  ptr_node>::type ptr_node_t;
+	node_t *n;
+	friend class buffers_t;
+	friend class iterator_impl<true>;
+      public:
+	typedef typename std::conditional<is_const,
+					  const ptr,
+					  ptr>::type value_t;
+	iterator_impl() : n(nullptr) {}
+	explicit iterator_impl(node_t *n) : n(n) {}
+	iterator_impl(const iterator_impl<false>& other) : n(other.n) {}
+
+	value_t& operator*() const {
+	  return static_cast<ptr_node_t*>(n)->bp;
+	}
+	value_t* operator->() const {
+	  return &static_cast<ptr_node_t*>(n)->bp;
+	}
+	iterator_impl& operator++() {
+	  n = n->next;
+	  return *this;
+	}
+	iterator_impl operator++(int) {
+	  iterator_impl t(*this);
+	  n = n->next;
+	  return t;
+	}
+	iterator_impl& operator--() {
+	  n = n->prev;
+	  return *this;
+	}
+	iterator_impl operator--(int) {
+	  iterator_impl t(*this);
+	  n = n->prev;
+	  return t;
+	}
+	friend bool operator==(const iterator_impl& l, const iterator_impl& r) {
+	  return l.n == r.n;
+	}
+	friend bool operator!=(const iterator_impl& l, const iterator_impl& r) {
+	  return l.n != r.n;
+	}
+      };
+      typedef iterator_impl<false> iterator;
+      typedef iterator_impl<true> const_iterator;
+      typedef ptr value_type;
+      typedef ptr& reference;
+      typedef const ptr& const_reference;
+
+      buffers_t() : _inline_used(false) {
+	_reset();
+      }
+      buffers_t(const buffers_t& other) : buffers_t() {
+	for (const auto& bp : other)
+	  push_back(bp);
+      }
+      buffers_t(buffers_t&& other) : buffers_t() {
+	splice(end(), other);
+      }
+      ~buffers_t() {
+	clear();
+      }
+      buffers_t& operator=(const buffers_t& other) {
+	if (this != &other) {
+	  clear();
+	  for (const auto& bp : other)
+	    push_back(bp);
+	}
+	return *this;
+      }
+      buffers_t& operator=(buffers_t&& other) {
+	if (this != &other) {
+	  clear();
+	  splice(end(), other);
+	}
+	return *this;
+      }
+
+      iterator begin() { return iterator(_root.next); }
+      iterator end() { return iterator(&_root); }
+      const_iterator begin() const { return const_iterator(_root.next); }
+      const_iterator end() const { return const_iterator(&_root); }
+      const_iterator cbegin() const { return begin(); }
+      const_iterator cend() const { return end(); }
+
+      size_t size() const { return _size; }
+      bool empty() const { return _size == 0; }
+      ptr& front() { return *begin(); }
+      const ptr& front() const { return *begin(); }
+      ptr& back() { return *iterator(_root.prev); }
+      const ptr& back() const { return *const_iterator(_root.prev); }
+
+      template<typename... Args>
+      iterator emplace(const_iterator pos, Args&&... args) {
+	ptr_node *n = _create_node(std::forward<Args>(args)...);
+	_link_before(const_cast<node_base*>(pos.n), n);
+	++_size;
+	return iterator(n);
+      }
+      iterator insert(const_iterator pos, const ptr& bp) {
+	return emplace(pos, bp);
+      }
+      iterator insert(const_iterator pos, ptr&& bp) {
+	return emplace(pos, std::move(bp));
+      }
+      template<typename... Args>
+      void emplace_front(Args&&... args) {
+	emplace(begin(), std::forward<Args>(args)...);
+      }
+      template<typename... Args>
+      void emplace_back(Args&&... args) {
+	emplace(end(), std::forward<Args>(args)...);
+      }
+      void push_front(const ptr& bp) { emplace(begin(), bp); }
+      void push_front(ptr&& bp) { emplace(begin(), std::move(bp)); }
+      void push_back(const ptr& bp) { emplace(end(), bp); }
+      void push_back(ptr&& bp) { emplace(end(), std::move(bp)); }
+
+      iterator erase(const_iterator pos) {
+	node_base *n = const_cast<node_base*>(pos.n);
+	node_base *next = n->next;
+	_unlink(n);
+	--_size;
+	_destroy_node(static_cast<ptr_node*>(n));
+	return iterator(next);
+      }
+      void pop_front() { erase(begin()); }
+      void pop_back() { erase(const_iterator(_root.prev)); }
+
+      void clear() {
+	node_base *n = _root.next;
+	while (n != &_root) {
+	  node_base *next = n->next;
+	  _destroy_node(static_cast<ptr_node*>(n));
+	  n = next;
+	}
+	_reset();
+      }
+
+      /// move all of other's elements before pos
+      void splice(const_iterator pos, buffers_t& other) {
+	if (&other == this || other.empty())
+	  return;
+	if (other._inline_used) {
+	  // the embedded node cannot leave other; swap a node of ours in
+	  // for it where it sits, and relink the rest wholesale
+	  ptr_node *n = _create_node(std::move(other._inline.bp));
+	  n->prev = other._inline.prev;
+	  n->next = other._inline.next;
+	  n->prev->next = n;
+	  n->next->prev = n;
+	  other._inline.bp = ptr();
+	  other._inline_used = false;
+	}
+	node_base *p = const_cast<node_base*>(pos.n);
+	node_base *first = other._root.next, *last = other._root.prev;
+	first->prev = p->prev;
+	p->prev->next = first;
+	last->next = p;
+	p->prev = last;
+	_size += other._size;
+	other._reset();
+      }
+
+      void swap(buffers_t& other) {
+	buffers_t t(std::move(other));
+	other = std::move(*this);
+	*this = std::move(t);
+      }
+    };
+
+  private:
     // my private bits
-    std::list<ptr> _buffers;
+    buffers_t _buffers;
     unsigned _len;
     unsigned _memcopy_count; //the total of memcopy using rebuild().
     ptr append_buffer;  // where i put small appends.
@@ -357,11 +643,11 @@ namespace buffer CEPH_BUFFER_API {
 					const list,
 					list>::type bl_t;
       typedef typename std::conditional<is_const,
-					const std::list<ptr>,
-					std::list<ptr> >::type list_t;
+					const buffers_t,
+					buffers_t>::type list_t;
       typedef typename std::conditional<is_const,
-					typename std::list<ptr>::const_iterator,
-					typename std::list<ptr>::iterator>::type list_iter_t;
+					typename buffers_t::const_iterator,
+					typename buffers_t::iterator>::type list_iter_t;
       bl_t* bl;
       list_t* ls;  // meh.. just here to avoid an extra pointer dereference..
       unsigned off; // in bl
@@ -686,13 +972,13 @@ namespace buffer CEPH_BUFFER_API {
     const ptr& back() const { return _buffers.back(); }
 
     unsigned get_memcopy_count() const {return _memcopy_count; }
-    const std::list<ptr>& buffers() const { return _buffers; }
+    const buffers_t& buffers() const { return _buffers; }
     void swap(list& other);
     unsigned length() const {
 #if 0
       // DEBUG: verify _len
       unsigned len = 0;
-      for (std::list<ptr>::const_iterator it = _buffers.begin();
+      for (buffers_t::const_iterator it = _buffers.begin();
 	   it != _buffers.end();
 	   it++) {
 	len += (*it).length();
@@ -783,7 +1069,7 @@ namespace buffer CEPH_BUFFER_API {
 
     // clone non-shareable buffers (make shareable)
     void make_shareable() {
-      std::list<buffer::ptr>::iterator pb;
+      buffers_t::iterator pb;
       for (pb = _buffers.begin(); pb != _buffers.end(); ++pb) {
         (void) pb->make_shareable();
       }
@@ -794,7 +1080,7 @@ namespace buffer CEPH_BUFFER_API {
     {
       if (this != &bl) {
         clear();
-        std::list<buffer::ptr>::const_iterator pb;
+        buffers_t::const_iterator pb;
         for (pb = bl._buffers.begin(); pb != bl._buffers.end(); ++pb) {
           push_back(*pb);
         }
@@ -29,4 +29,27 @@ static inline uint32_t ceph_crc32c(uint32_t crc, unsigned char const *data, unsi
 	return ceph_crc32c_func(crc, data, length);
 }
 
+/**
+ * calculate crc32c of a run of zero bytes
+ *
+ * Equivalent to ceph_crc32c(crc, NULL, length), but takes O(log length)
+ * time instead of O(length).
+ */
+extern uint32_t ceph_crc32c_zeros(uint32_t crc, unsigned length);
+
+/**
+ * combine the crc32c of two adjacent buffers
+ *
+ * If crc1 = ceph_crc32c(seed, A, len(A)) and crc2 = ceph_crc32c(0, B, len2),
+ * returns ceph_crc32c(seed, A+B, len(A)+len2) without touching the data.
+ *
+ * @param crc1 crc of the first buffer, with any initial value
+ * @param crc2 crc of the second buffer, with initial value 0
+ * @param len2 length of the second buffer
+ */
+static inline uint32_t ceph_crc32c_combine(uint32_t crc1, uint32_t crc2, unsigned len2)
+{
+	return ceph_crc32c_zeros(crc1, len2) ^ crc2;
+}
+
 #endif
@@ -27,6 +27,7 @@
 #include <mutex>
 #include <atomic>
 #include <climits>
+#include <functional>
 #include <typeinfo>
 
 #include <common/Formatter.h>
@@ -132,6 +133,27 @@ Note that you cannot easily query per-type, primarily because debug
 mode is optional and you should not rely on that information being
 available.
 
+Soft limits
+-----------
+
+A pool can be given a soft limit, in bytes, with
+
+  mempool::get_pool(mempool::mempool_mds_co).set_soft_limit(bytes);
+
+or for a whole daemon with the "mempool_soft_limits" option.  Nothing
+is refused when a pool goes over its limit.  Instead, the owners of the
+caches in the pool register a trimmer,
+
+  int id = mempool::get_pool(ix).register_trimmer(
+    [this](size_t bytes, size_t limit) { ... });
+
+and the trimmers are called each time mempool::check_soft_limits() finds
+the pool over its limit (every heartbeat_interval, from the CephContext
+service thread).  A trimmer should shed roughly (bytes - limit) / bytes of
+what it holds; it must not block on a lock that may be held while calling
+unregister_trimmer(), so most take their cache lock with a try-lock and
+simply wait for the next round if it is busy.
+
 */
 
 namespace mempool {
@@ -147,8 +169,13 @@ namespace mempool {
   f(bluefs)			      \
   f(buffer_meta)		      \
   f(buffer_data)		      \
+  f(buffer_slab)		      \
   f(osd)			      \
+  f(osd_pglog)			      \
   f(osdmap_mapping)		      \
+  f(mds_co)			      \
+  f(objectcacher)		      \
+  f(rgw_cache)			      \
   f(unittest_1)			      \
   f(unittest_2)
 
@@ -203,18 +230,29 @@ struct type_t {
   std::atomic<ssize_t> items = {0};  // signed
 };
 
+/// called with the pool's current size and its soft limit
+typedef std::function<void(size_t bytes, size_t limit)> trimmer_t;
+
 struct type_info_hash {
   std::size_t operator()(const std::type_info& k) const {
     return k.hash_code();
   }
 };
 
+size_t pick_thread_shard();
+
 class pool_t {
   shard_t shard[num_shards];
 
   mutable std::mutex lock;  // only used for types list
   std::unordered_map<const char *, type_t> type_map;
 
+  std::atomic<size_t> soft_limit = {0};
+  // held while trimmers run, so that unregister_trimmer() waits for them
+  std::mutex trim_lock;
+  std::map<int, trimmer_t> trimmers;
+  int last_trimmer_id = 0;
+
 public:
   //
   // How much this pool consumes. O(<num_shards>)
@@ -223,11 +261,11 @@ public:
   size_t allocated_items() const;
 
   shard_t* pick_a_shard() {
-    // Dirt cheap, see:
-    //   http://fossies.org/dox/glibc-2.24/pthread__self_8c_source.html
-    size_t me = (size_t)pthread_self();
-    size_t i = (me >> 3) & ((1 << num_shard_bits) - 1);
-    return &shard[i];
+    // Each thread picks its shard once, round robin.  (pthread_self() is
+    // at the same offset in every thread's stack mapping, so hashing it
+    // tends to put every thread on the same shard.)
+    static thread_local size_t me = pick_thread_shard();
+    return &shard[me];
   }
 
   type_t *get_type(const std::type_info& ti, size_t size) {
@@ -247,11 +285,39 @@ public:
 		 std::map<std::string, stats_t> *by_type) const;
 
   void dump(ceph::Formatter *f) const;
+
+  /// 0 for no limit
+  void set_soft_limit(size_t bytes) {
+    soft_limit = bytes;
+  }
+  size_t get_soft_limit() const {
+    return soft_limit;
+  }
+
+  /// returns an id for unregister_trimmer()
+  int register_trimmer(trimmer_t t);
+  /// once this returns the trimmer is not running and will not be called
+  void unregister_trimmer(int id);
+
+  /// run the trimmers if we are over the soft limit; true if we were
+  bool check_soft_limit();
 };
 
 // skip unittest_[12] by default
 void dump(ceph::Formatter *f, size_t skip=2);
 
+/// check_soft_limit() on every pool; returns how many were over
+int check_soft_limits();
+
+/**
+ * Set the soft limits of all pools from a "pool=bytes[,pool=bytes...]"
+ * list.  Pools not mentioned get no limit.
+ *
+ * @return 0, or -EINVAL (with a message in *err) on a parse error, in
+ * which case no limit is changed
+ */
+int set_soft_limits(const std::string& spec, std::ostream *err);
+
 
 // STL allocator for use with containers.  All actual state
 // is stored in the static pool_allocator_base_t, which saves us from
@@ -403,6 +469,12 @@ public:
     inline size_t allocated_items() {					\
       return mempool::get_pool(id).allocated_items();			\
     }									\
+    inline int register_trimmer(mempool::trimmer_t t) {		\
+      return mempool::get_pool(id).register_trimmer(t);			\
+    }									\
+    inline void unregister_trimmer(int tid) {				\
+      mempool::get_pool(id).unregister_trimmer(tid);			\
+    }									\
   };
 
 DEFINE_MEMORY_POOLS_HELPER(P)
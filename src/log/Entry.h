@@ -7,12 +7,30 @@
 #include "include/utime.h"
 #include "common/PrebufferedStreambuf.h"
 #include <pthread.h>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <utility>
 
 
 namespace ceph {
 namespace logging {
 
+/// the arguments of a log line, captured to be formatted later
+struct DeferredFormat {
+  virtual ~DeferredFormat() {}
+  virtual void format(std::ostream& out) = 0;
+};
+
+template<typename F>
+struct DeferredFormatFn : public DeferredFormat {
+  F f;
+  explicit DeferredFormatFn(F&& f) : f(std::move(f)) {}
+  void format(std::ostream& out) override {
+    f(out);
+  }
+};
+
 struct Entry {
   utime_t m_stamp;
   pthread_t m_thread;
@@ -22,6 +40,8 @@ struct Entry {
   PrebufferedStreambuf m_streambuf;
   size_t m_buf_len;
   size_t* m_exp_len;
+  /// if set, the text has not been formatted into m_streambuf yet
+  std::unique_ptr<DeferredFormat> m_deferred;
   char m_static_buf[1];
 
   Entry()
@@ -73,6 +93,25 @@ struct Entry {
     }
   }
 
+  /**
+   * defer formatting to the log thread (or to a crash dump), and skip it
+   * entirely for gathered entries that are never written out.  f is
+   * called as f(ostream&) and must only use what it captured by value.
+   */
+  template<typename F>
+  void set_deferred(F&& f) {
+    typedef typename std::decay<F>::type fn_t;
+    m_deferred.reset(new DeferredFormatFn<fn_t>(fn_t(std::forward<F>(f))));
+  }
+
+  void finish_deferred() {
+    if (m_deferred) {
+      ostream os(&m_streambuf);
+      m_deferred->format(os);
+      m_deferred.reset();
+    }
+  }
+
   void set_str(const std::string &s) {
     ostream os(&m_streambuf);
     os << s;
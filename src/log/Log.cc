@@ -6,6 +6,9 @@
 #include <errno.h>
 #include <syslog.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "common/errno.h"
 #include "common/safe_io.h"
 #include "common/Clock.h"
@@ -21,6 +24,7 @@
 
 #define DEFAULT_MAX_NEW    100
 #define DEFAULT_MAX_RECENT 10000
+#define DEFAULT_THREAD_QUEUE_LEN 64
 
 #define PREALLOC 1000000
 
@@ -30,6 +34,25 @@ namespace logging {
 
 static OnExitManager exit_callbacks;
 
+static std::atomic<uint64_t> last_log_id(0);
+
+/// this thread's queue, for the Log it last submitted to
+struct ThreadQueueRef {
+  uint64_t log_id = 0;
+  std::shared_ptr<ThreadQueue> q;
+};
+static thread_local ThreadQueueRef thread_queue;
+
+ThreadQueue::ThreadQueue(unsigned len)
+  : m_head(0), m_tail(0)
+{
+  unsigned n = 1;
+  while (n < len)
+    n <<= 1;
+  m_slots.reset(new Entry*[n]);
+  m_mask = n - 1;
+}
+
 static void log_on_exit(void *p)
 {
   Log *l = *(Log **)p;
@@ -40,10 +63,13 @@ static void log_on_exit(void *p)
 
 Log::Log(SubsystemMap *s)
   : m_indirect_this(NULL),
+    m_id(++last_log_id),
     m_subs(s),
     m_queue_mutex_holder(0),
     m_flush_mutex_holder(0),
     m_new(), m_recent(),
+    m_thread_queue_len(DEFAULT_THREAD_QUEUE_LEN),
+    m_flusher_waiting(false),
     m_fd(-1),
     m_uid(0),
     m_gid(0),
@@ -83,6 +109,11 @@ Log::~Log()
   }
 
   assert(!is_started());
+  for (auto& q : m_thread_queues) {
+    Entry *e;
+    while ((e = q->pop()) != NULL)
+      delete e;
+  }
   if (m_fd >= 0)
     VOID_TEMP_FAILURE_RETRY(::close(m_fd));
 
@@ -112,6 +143,12 @@ void Log::set_max_new(int n)
   m_max_new = n;
 }
 
+void Log::set_thread_queue_len(int n)
+{
+  // existing queues keep their size; new ones get the new one
+  m_thread_queue_len = n;
+}
+
 void Log::set_max_recent(int n)
 {
   pthread_mutex_lock(&m_flush_mutex);
@@ -203,14 +240,48 @@ void Log::stop_graylog()
   pthread_mutex_unlock(&m_flush_mutex);
 }
 
-void Log::submit_entry(Entry *e)
+ThreadQueue *Log::_get_thread_queue()
 {
+  ThreadQueueRef& r = thread_queue;
+  if (r.log_id == m_id)
+    return r.q.get();
+  int len = m_thread_queue_len.load(std::memory_order_relaxed);
+  if (len <= 0)
+    return NULL;
+  // a thread switching between Logs leaves its old queue behind; the
+  // old Log drops it once drained
+  r.q = std::make_shared<ThreadQueue>(len);
+  r.log_id = m_id;
   pthread_mutex_lock(&m_queue_mutex);
-  m_queue_mutex_holder = pthread_self();
+  m_thread_queues.push_back(r.q);
+  pthread_mutex_unlock(&m_queue_mutex);
+  return r.q.get();
+}
 
+void Log::submit_entry(Entry *e)
+{
   if (m_inject_segv)
     *(volatile int *)(0) = 0xdead;
 
+  if (m_thread_queue_len.load(std::memory_order_relaxed) > 0) {
+    ThreadQueue *q = _get_thread_queue();
+    if (q && q->push(e)) {
+      // pairs with the fence in entry(): either it sees our entry or we
+      // see it waiting
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (m_flusher_waiting.load(std::memory_order_relaxed)) {
+	pthread_mutex_lock(&m_queue_mutex);
+	pthread_cond_signal(&m_cond_flusher);
+	pthread_mutex_unlock(&m_queue_mutex);
+      }
+      return;
+    }
+    // full; fall back to the shared queue, which also throttles us
+  }
+
+  pthread_mutex_lock(&m_queue_mutex);
+  m_queue_mutex_holder = pthread_self();
+
   // wait for flush to catch up
   while (m_new.m_len > m_max_new)
     pthread_cond_wait(&m_cond_loggers, &m_queue_mutex);
@@ -260,6 +331,45 @@ Entry *Log::create_entry(int level, int subsys, size_t* expected_size)
   }
 }
 
+bool Log::_thread_queues_empty()
+{
+  for (auto& q : m_thread_queues) {
+    if (!q->empty())
+      return false;
+  }
+  return true;
+}
+
+void Log::_take_new(EntryQueue *t)
+{
+  t->swap(m_new);
+  std::vector<Entry*> v;
+  for (auto p = m_thread_queues.begin(); p != m_thread_queues.end(); ) {
+    Entry *e;
+    while ((e = (*p)->pop()) != NULL)
+      v.push_back(e);
+    if (p->use_count() == 1 && (*p)->empty()) {
+      // its thread has exited or moved on to another Log
+      m_thread_queues.erase(p++);
+    } else {
+      ++p;
+    }
+  }
+  if (v.empty())
+    return;
+
+  // restore the submission order across threads
+  Entry *e;
+  while ((e = t->dequeue()) != NULL)
+    v.push_back(e);
+  std::stable_sort(v.begin(), v.end(),
+		   [](const Entry *a, const Entry *b) {
+		     return a->m_stamp < b->m_stamp;
+		   });
+  for (auto e : v)
+    t->enqueue(e);
+}
+
 void Log::flush()
 {
   pthread_mutex_lock(&m_flush_mutex);
@@ -267,7 +377,7 @@ void Log::flush()
   pthread_mutex_lock(&m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
   EntryQueue t;
-  t.swap(m_new);
+  _take_new(&t);
   pthread_cond_broadcast(&m_cond_loggers);
   m_queue_mutex_holder = 0;
   pthread_mutex_unlock(&m_queue_mutex);
@@ -294,7 +404,10 @@ void Log::_flush(EntryQueue *t, EntryQueue *requeue, bool crash)
     bool do_stderr = m_stderr_crash >= e->m_prio && should_log;
     bool do_graylog2 = m_graylog_crash >= e->m_prio && should_log;
 
-    e->hint_size();
+    if (should_log)
+      e->finish_deferred();
+    else if (!e->m_deferred)
+      e->hint_size();
     if (do_fd || do_syslog || do_stderr) {
       size_t buflen = 0;
 
@@ -381,7 +494,7 @@ void Log::dump_recent()
   m_queue_mutex_holder = pthread_self();
 
   EntryQueue t;
-  t.swap(m_new);
+  _take_new(&t);
 
   m_queue_mutex_holder = 0;
   pthread_mutex_unlock(&m_queue_mutex);
@@ -442,7 +555,7 @@ void *Log::entry()
   pthread_mutex_lock(&m_queue_mutex);
   m_queue_mutex_holder = pthread_self();
   while (!m_stop) {
-    if (!m_new.empty()) {
+    if (!m_new.empty() || !_thread_queues_empty()) {
       m_queue_mutex_holder = 0;
       pthread_mutex_unlock(&m_queue_mutex);
       flush();
@@ -451,7 +564,13 @@ void *Log::entry()
       continue;
     }
 
-    pthread_cond_wait(&m_cond_flusher, &m_queue_mutex);
+    // thread queue submitters only take the lock to wake us if we are
+    // (about to be) waiting
+    m_flusher_waiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_thread_queues_empty())
+      pthread_cond_wait(&m_cond_flusher, &m_queue_mutex);
+    m_flusher_waiting = false;
   }
   m_queue_mutex_holder = 0;
   pthread_mutex_unlock(&m_queue_mutex);
@@ -4,6 +4,10 @@
 #ifndef __CEPH_LOG_LOG_H
 #define __CEPH_LOG_LOG_H
 
+#include <atomic>
+#include <list>
+#include <memory>
+
 #include "common/Thread.h"
 
 #include "EntryQueue.h"
@@ -15,9 +19,45 @@ class Graylog;
 class SubsystemMap;
 class Entry;
 
+/**
+ * Single producer (the owning thread), single consumer (whoever holds
+ * the flush lock) ring of submitted entries.
+ */
+class ThreadQueue {
+  std::unique_ptr<Entry*[]> m_slots;
+  unsigned m_mask;
+  std::atomic<uint64_t> m_head;  ///< next to pop
+  std::atomic<uint64_t> m_tail;  ///< next to push
+
+public:
+  explicit ThreadQueue(unsigned len);
+
+  bool empty() const {
+    return m_head.load(std::memory_order_acquire) ==
+      m_tail.load(std::memory_order_acquire);
+  }
+  bool push(Entry *e) {
+    uint64_t t = m_tail.load(std::memory_order_relaxed);
+    if (t - m_head.load(std::memory_order_acquire) > m_mask)
+      return false;
+    m_slots[t & m_mask] = e;
+    m_tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+  Entry *pop() {
+    uint64_t h = m_head.load(std::memory_order_relaxed);
+    if (h == m_tail.load(std::memory_order_acquire))
+      return NULL;
+    Entry *e = m_slots[h & m_mask];
+    m_head.store(h + 1, std::memory_order_release);
+    return e;
+  }
+};
+
 class Log : private Thread
 {
   Log **m_indirect_this;
+  const uint64_t m_id;   ///< unique per instance, to key thread queues
 
   SubsystemMap *m_subs;
 
@@ -30,6 +70,11 @@ class Log : private Thread
   pthread_t m_flush_mutex_holder;
 
   EntryQueue m_new;    ///< new entries
+  /// per-thread queues of new entries, one ref each (the other is the
+  /// thread's); protected by m_queue_mutex
+  std::list<std::shared_ptr<ThreadQueue>> m_thread_queues;
+  std::atomic<int> m_thread_queue_len;  ///< 0 to always use m_new
+  std::atomic<bool> m_flusher_waiting;
   EntryQueue m_recent; ///< recent (less new) entries we've already written at low detail
 
   std::string m_log_file;
@@ -55,6 +100,10 @@ class Log : private Thread
 
   void _flush(EntryQueue *q, EntryQueue *requeue, bool crash);
 
+  ThreadQueue *_get_thread_queue();
+  bool _thread_queues_empty();
+  void _take_new(EntryQueue *t);
+
   void _log_message(const char *s, bool crash);
 
 public:
@@ -64,6 +113,7 @@ public:
   void set_flush_on_exit();
 
   void set_max_new(int n);
+  void set_thread_queue_len(int n);
   void set_max_recent(int n);
   void set_log_file(std::string fn);
   void reopen_log_file();
@@ -86,6 +136,15 @@ public:
   Entry *create_entry(int level, int subsys, size_t* expected_size);
   void submit_entry(Entry *e);
 
+  /// submit an entry whose text is produced by f(ostream&) when it is
+  /// actually written out (see Entry::set_deferred)
+  template<typename F>
+  void submit_deferred(int level, int subsys, F&& f) {
+    Entry *e = create_entry(level, subsys);
+    e->set_deferred(std::forward<F>(f));
+    submit_entry(e);
+  }
+
   void start();
   void stop();
 
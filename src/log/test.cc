@@ -5,6 +5,9 @@
 #include "common/PrebufferedStreambuf.h"
 #include "SubsystemMap.h"
 
+#include <atomic>
+#include <thread>
+
 using namespace ceph::logging;
 
 TEST(Log, Simple)
@@ -190,6 +193,61 @@ TEST(Log, ManyGather)
   log.stop();
 }
 
+TEST(Log, ManyThreads)
+{
+  SubsystemMap subs;
+  subs.add(1, "foo", 1, 20);
+  Log log(&subs);
+  log.set_max_new(10);
+  log.set_max_recent(1000000);
+  log.start();
+  std::atomic<int> formatted(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&log, &formatted] {
+	for (int i = 0; i < many; i++) {
+	  Entry *e = log.create_entry(10, 1);
+	  e->set_deferred([&formatted](ostream& out) {
+	      ++formatted;
+	      out << "deferred";
+	    });
+	  log.submit_entry(e);
+	}
+      });
+  }
+  for (auto& t : threads)
+    t.join();
+  log.flush();
+  // level 10 is gathered but not logged: nothing was formatted
+  ASSERT_EQ(0, formatted.load());
+  log.stop();
+}
+
+TEST(Log, Deferred)
+{
+  SubsystemMap subs;
+  subs.add(1, "foo", 1, 20);
+  Log log(&subs);
+  log.set_stderr_level(-1, -1);
+  log.start();
+  int formatted = 0;
+  log.submit_deferred(10, 1, [&formatted](ostream& out) {
+      ++formatted;
+      out << "gathered " << 10;
+    });
+  log.submit_deferred(1, 1, [&formatted](ostream& out) {
+      ++formatted;
+      out << "logged " << 1;
+    });
+  log.flush();
+  ASSERT_EQ(1, formatted);
+  log.dump_recent();
+  ASSERT_EQ(2, formatted);
+  log.dump_recent();
+  ASSERT_EQ(2, formatted);
+  log.stop();
+}
+
 void do_segv()
 {
   SubsystemMap subs;
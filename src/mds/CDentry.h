@@ -24,6 +24,7 @@
 #include "include/buffer_fwd.h"
 #include "include/lru.h"
 #include "include/elist.h"
+#include "include/mempool.h"
 #include "include/filepath.h"
 
 #include "MDSCacheObject.h"
@@ -128,16 +129,7 @@ public:
     g_num_dns++;
   }
 
-
-  static void *operator new(size_t num_bytes) {
-    void *n = pool.malloc();
-    if (!n)
-      throw std::bad_alloc();
-    return n;
-  }
-  void operator delete(void *p) {
-    pool.free(p);
-  }
+  MEMPOOL_CLASS_HELPERS();
 
   const char *pin_name(int p) const {
     switch (p) {
@@ -390,16 +382,6 @@ protected:
 
   version_t version;  // dir version when last touched.
   version_t projected_version;  // what it will be when i unlock/commit.
-
-
-private:
-  /*
-   * This class uses a boost::pool to handle allocation. This is *not*
-   * thread-safe, so don't do allocations from multiple threads!
-   *
-   * Alternatively, switch the pool to use a boost::singleton_pool.
-   */
-  static boost::pool<> pool;
 };
 
 ostream& operator<<(ostream& out, const CDentry& dn);
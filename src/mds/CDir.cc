@@ -74,7 +74,7 @@ public:
 // PINS
 //int cdir_pins[CDIR_NUM_PINS] = { 0,0,0,0,0,0,0,0,0,0,0,0,0,0 };
 
-boost::pool<> CDir::pool(sizeof(CDir));
+MEMPOOL_DEFINE_OBJECT_FACTORY(CDir, co_dir, mds_co);
 
 
 ostream& operator<<(ostream& out, const CDir& dir)
@@ -19,6 +19,7 @@
 
 #include "include/types.h"
 #include "include/buffer_fwd.h"
+#include "include/mempool.h"
 #include "common/bloom_filter.hpp"
 #include "common/config.h"
 #include "common/DecayCounter.h"
@@ -44,24 +45,8 @@ ostream& operator<<(ostream& out, const class CDir& dir);
 class CDir : public MDSCacheObject {
   friend ostream& operator<<(ostream& out, const class CDir& dir);
 
-  /*
-   * This class uses a boost::pool to handle allocation. This is *not*
-   * thread-safe, so don't do allocations from multiple threads!
-   *
-   * Alternatively, switch the pool to use a boost::singleton_pool.
-   */
-private:
-  static boost::pool<> pool;
 public:
-  static void *operator new(size_t num_bytes) { 
-    void *n = pool.malloc();
-    if (!n)
-      throw std::bad_alloc();
-    return n;
-  }
-  void operator delete(void *p) {
-    pool.free(p);
-  }
+  MEMPOOL_CLASS_HELPERS();
 
 public:
   // -- pins --
@@ -66,7 +66,7 @@ public:
 };
 
 
-boost::pool<> CInode::pool(sizeof(CInode));
+MEMPOOL_DEFINE_OBJECT_FACTORY(CInode, co_inode, mds_co);
 boost::pool<> Capability::pool(sizeof(Capability));
 
 LockType CInode::versionlock_type(CEPH_LOCK_IVERSION);
@@ -180,7 +180,6 @@ public:
 MDCache::MDCache(MDSRank *m) :
   mds(m),
   filer(m->objecter, m->finisher),
-  exceeded_size_limit(false),
   recovery_queue(m),
   stray_manager(m)
 {
@@ -222,10 +221,17 @@ MDCache::MDCache(MDSRank *m) :
   decayrate.set_halflife(g_conf->mds_decay_halflife);
 
   did_shutdown_log_cap = false;
+
+  mempool_keep_permille = 0;
+  mempool_trimmer = mempool::mds_co::register_trimmer(
+    [this](size_t bytes, size_t limit) {
+      mempool_keep_permille = std::max<size_t>(1, limit * 1000 / bytes);
+    });
 }
 
 MDCache::~MDCache() 
 {
+  mempool::mds_co::unregister_trimmer(mempool_trimmer);
   if (logger) {
     g_ceph_context->get_perfcounters_collection()->remove(logger.get());
   }
@@ -282,11 +288,6 @@ void MDCache::add_inode(CInode *in)
     if (in->is_base())
       base_inodes.insert(in);
   }
-
-  if (get_num_inodes() >
-        g_conf->mds_cache_size * g_conf->mds_health_cache_threshold) {
-    exceeded_size_limit = true;
-  }
 }
 
 void MDCache::remove_inode(CInode *o) 
@@ -6400,6 +6401,16 @@ bool MDCache::trim(int max, int count)
       max = 1;
   } else if (max < 0) {
     max = g_conf->mds_cache_size;
+    unsigned keep = mempool_keep_permille.exchange(0);
+    if (keep) {
+      // the mds_co mempool is over its soft limit
+      int want = std::max<uint64_t>(
+	1, (uint64_t)lru.lru_get_size() * keep / 1000);
+      dout(5) << "trim mds_co mempool over soft limit, keeping " << want
+	      << " of " << lru.lru_get_size() << " dentries" << dendl;
+      if (max <= 0 || want < max)
+	max = want;
+    }
     if (max <= 0)
       return false;
   }
@@ -7395,22 +7406,6 @@ void MDCache::check_memory_usage()
       mds->server->recall_client_state(ratio);
     }
   }
-
-  // If the cache size had exceeded its limit, but we're back in bounds
-  // now, free any unused pool memory so that our memory usage isn't
-  // permanently bloated.
-  if (exceeded_size_limit
-      && get_num_inodes() <=
-        g_conf->mds_cache_size * g_conf->mds_health_cache_threshold) {
-    // Only do this once we are back in bounds: otherwise the releases would
-    // slow down whatever process caused us to exceed bounds to begin with
-    dout(2) << "check_memory_usage: releasing unused space from pool allocators"
-            << dendl;
-    CInode::pool.release_memory();
-    CDir::pool.release_memory();
-    CDentry::pool.release_memory();
-    exceeded_size_limit = false;
-  }
 }
 
 
@@ -17,6 +17,8 @@
 #ifndef CEPH_MDCACHE_H
 #define CEPH_MDCACHE_H
 
+#include <atomic>
+
 #include "include/types.h"
 #include "include/filepath.h"
 #include "include/elist.h"
@@ -136,7 +138,10 @@ class MDCache {
 
   Filer filer;
 
-  bool exceeded_size_limit;
+  /// mds_co mempool trimmer; asks trim() to keep only this many
+  /// thousandths of the LRU (0 if the pool is within its soft limit)
+  int mempool_trimmer;
+  std::atomic<unsigned> mempool_keep_permille;
 
 public:
   void advance_stray() {
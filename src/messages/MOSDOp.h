@@ -31,6 +31,149 @@
 
 class OSD;
 
+/*
+ * Contiguous codecs for the types MOSDOp and MOSDOpReply carry, so that
+ * their payloads can be sized (size_t), written (contiguous_appender) and
+ * read back (ptr::iterator) in a single pass.  The wire format is that of
+ * each type's encode()/decode().
+ *
+ * These are deliberately not denc_traits of those types: that would move
+ * every container of them elsewhere in the tree over to the generic denc
+ * container decode.
+ */
+struct osd_op_denc {
+  DENC_HELPERS
+
+  template<typename T, typename U>
+  using if_is = typename std::enable_if<
+    std::is_same<typename std::remove_const<T>::type, U>::value>::type;
+
+  template<typename T, typename P>
+  static if_is<T, pg_t> op_denc(T& v, P& p) {
+    __u8 struct_v = 1;
+    denc(struct_v, p);
+    denc(v.m_pool, p);
+    denc(v.m_seed, p);
+    denc(v.m_preferred, p);
+  }
+  template<typename T, typename P>
+  static if_is<T, shard_id_t> op_denc(T& v, P& p) {
+    denc(v.id, p);
+  }
+  template<typename T, typename P>
+  static if_is<T, spg_t> op_denc(T& v, P& p) {
+    DENC_START(1, 1, p);
+    op_denc(v.pgid, p);
+    op_denc(v.shard, p);
+    DENC_FINISH(p);
+  }
+  template<typename T, typename P>
+  static if_is<T, eversion_t> op_denc(T& v, P& p) {
+    denc(v.version, p);
+    denc(v.epoch, p);
+  }
+  template<typename T, typename P>
+  static if_is<T, utime_t> op_denc(T& v, P& p) {
+    denc(v.tv.tv_sec, p);
+    denc(v.tv.tv_nsec, p);
+  }
+  template<typename T, typename P>
+  static if_is<T, object_t> op_denc(T& v, P& p) {
+    denc(v.name, p);
+  }
+
+  template<typename P>
+  static void op_denc(const errorcode32_t& v, P& p) {
+    denc(v.code, p);
+  }
+  static void op_denc(errorcode32_t& v, buffer::ptr::iterator& p) {
+    denc(v.code, p);
+    v.code = ceph_to_host_errno(v.code);
+  }
+
+  static void op_denc(const ceph_osd_op& v, size_t& p) {
+    p += sizeof(v);
+  }
+  static void op_denc(const ceph_osd_op& v,
+		      bufferlist::contiguous_appender& p) {
+    p.append((const char*)&v, sizeof(v));
+  }
+  static void op_denc(ceph_osd_op& v, buffer::ptr::iterator& p) {
+    v = *(const ceph_osd_op*)p.get_pos_add(sizeof(v));
+  }
+
+  // object_locator_t has a legacy compat decode, so no DENC_START here
+  static void op_denc(const object_locator_t& v, size_t& p) {
+    p += 2 + 4;  // struct_v, struct_compat, struct_len
+    denc(v.pool, p);
+    p += sizeof(int32_t);  // preferred
+    denc(v.key, p);
+    denc(v.nspace, p);
+    denc(v.hash, p);
+  }
+  static void op_denc(const object_locator_t& v,
+		      bufferlist::contiguous_appender& p) {
+    assert(v.hash == -1 || v.key.empty());
+    __u8 struct_v = 6;
+    __u8 struct_compat = v.hash != -1 ? 6 : 3;
+    denc(struct_v, p);
+    denc(struct_compat, p);
+    char *len_pos = p.get_pos_add(sizeof(uint32_t));
+    uint32_t start_oob_off = p.get_out_of_band_offset();
+    denc(v.pool, p);
+    int32_t preferred = -1;
+    denc(preferred, p);
+    denc(v.key, p);
+    denc(v.nspace, p);
+    denc(v.hash, p);
+    *(__le32*)len_pos = p.get_pos() - len_pos - sizeof(uint32_t) +
+      p.get_out_of_band_offset() - start_oob_off;
+  }
+  static void op_denc(object_locator_t& v, buffer::ptr::iterator& p) {
+    // mirrors DECODE_START_LEGACY_COMPAT_LEN(6, 3, 3) in
+    // object_locator_t::decode()
+    __u8 struct_v;
+    denc(struct_v, p);
+    const char *struct_end = nullptr;
+    if (struct_v >= 3) {
+      __u8 struct_compat;
+      denc(struct_compat, p);
+      if (struct_compat > 6)
+	throw buffer::malformed_input(
+	  DECODE_ERR_VERSION(__PRETTY_FUNCTION__, 6));
+      uint32_t struct_len;
+      denc(struct_len, p);
+      if (struct_len > (size_t)(p.get_end() - p.get_pos()))
+	throw buffer::malformed_input(DECODE_ERR_PAST(__PRETTY_FUNCTION__));
+      struct_end = p.get_pos() + struct_len;
+    }
+    if (struct_v < 2) {
+      int32_t op;
+      denc(op, p);
+      v.pool = op;
+      int16_t pref;
+      denc(pref, p);
+    } else {
+      denc(v.pool, p);
+      int32_t preferred;
+      denc(preferred, p);
+    }
+    denc(v.key, p);
+    if (struct_v >= 5)
+      denc(v.nspace, p);
+    if (struct_v >= 6)
+      denc(v.hash, p);
+    else
+      v.hash = -1;
+    if (struct_end) {
+      if (p.get_pos() > struct_end)
+	throw buffer::malformed_input(DECODE_ERR_PAST(__PRETTY_FUNCTION__));
+      p.advance(struct_end - p.get_pos());
+    }
+    assert(v.hash == -1 || v.key.empty());
+  }
+};
+
 class MOSDOp : public MOSDFastDispatchOp {
 
   static const int HEAD_VERSION = 8;
@@ -363,28 +506,41 @@ struct ceph_osd_request_head {
       // latest v8 encoding with hobject_t hash separate from pgid, no
       // reassert version
       header.version = HEAD_VERSION;
-      ::encode(pgid, payload);
-      ::encode(hobj.get_hash(), payload);
-      ::encode(osdmap_epoch, payload);
-      ::encode(flags, payload);
-      ::encode(reqid, payload);
-      ::encode(client_inc, payload);
-      ::encode(mtime, payload);
-      ::encode(get_object_locator(), payload);
-      ::encode(hobj.oid, payload);
+      object_locator_t oloc = get_object_locator();
+      size_t len = 0;
+      denc_head(len, features, oloc);
+      auto a = payload.get_contiguous_appender(len);
+      denc_head(a, features, oloc);
+    }
+  }
 
-      __u16 num_ops = ops.size();
-      ::encode(num_ops, payload);
-      for (unsigned i = 0; i < ops.size(); i++)
-	::encode(ops[i].op, payload);
+  // the v8 encoding, for both bound_encode (size_t) and encode
+  // (contiguous_appender), so the payload is sized once and written in
+  // a single pass
+  template<typename P>
+  void denc_head(P& p, uint64_t features,
+		 const object_locator_t& oloc) const {
+    osd_op_denc::op_denc(pgid, p);
+    denc(hobj.get_hash(), p);
+    denc(osdmap_epoch, p);
+    denc(flags, p);
+    denc(reqid, p);
+    denc(client_inc, p);
+    osd_op_denc::op_denc(mtime, p);
+    osd_op_denc::op_denc(oloc, p);
+    osd_op_denc::op_denc(hobj.oid, p);
 
-      ::encode(hobj.snap, payload);
-      ::encode(snap_seq, payload);
-      ::encode(snaps, payload);
+    __u16 num_ops = ops.size();
+    denc(num_ops, p);
+    for (unsigned i = 0; i < ops.size(); i++)
+      osd_op_denc::op_denc(ops[i].op, p);
 
-      ::encode(retry_attempt, payload);
-      ::encode(features, payload);
-    }
+    denc(hobj.snap, p);
+    denc(snap_seq, p);
+    denc(snaps, p);
+
+    denc(retry_attempt, p);
+    denc(features, p);
   }
 
   virtual void decode_payload() {
@@ -393,13 +549,16 @@ struct ceph_osd_request_head {
 
     // Always keep here the newest version of decoding order/rule
     if (header.version == HEAD_VERSION) {
-      ::decode(pgid, p);      // actual pgid
+      bufferptr bp = get_contiguous_rest(p);
+      auto cp = bp.begin();
+      osd_op_denc::op_denc(pgid, cp);      // actual pgid
       uint32_t hash;
-      ::decode(hash, p); // raw hash value
+      denc(hash, cp); // raw hash value
       hobj.set_hash(hash);
-      ::decode(osdmap_epoch, p);
-      ::decode(flags, p);
-      ::decode(reqid, p);
+      denc(osdmap_epoch, cp);
+      denc(flags, cp);
+      denc(reqid, cp);
+      p.advance(cp.get_offset());
     } else if (header.version == 7) {
       ::decode(pgid.pgid, p);      // raw pgid
       hobj.set_hash(pgid.pgid.ps());
@@ -530,25 +689,28 @@ struct ceph_osd_request_head {
       return false; // Message is already final decoded
     assert(header.version >= 7);
 
-    ::decode(client_inc, p);
-    ::decode(mtime, p);
+    bufferptr bp = get_contiguous_rest(p);
+    auto cp = bp.begin();
+    denc(client_inc, cp);
+    osd_op_denc::op_denc(mtime, cp);
     object_locator_t oloc;
-    ::decode(oloc, p);
-    ::decode(hobj.oid, p);
+    osd_op_denc::op_denc(oloc, cp);
+    osd_op_denc::op_denc(hobj.oid, cp);
 
     __u16 num_ops;
-    ::decode(num_ops, p);
+    denc(num_ops, cp);
     ops.resize(num_ops);
     for (unsigned i = 0; i < num_ops; i++)
-      ::decode(ops[i].op, p);
+      osd_op_denc::op_denc(ops[i].op, cp);
 
-    ::decode(hobj.snap, p);
-    ::decode(snap_seq, p);
-    ::decode(snaps, p);
+    denc(hobj.snap, cp);
+    denc(snap_seq, cp);
+    denc(snaps, cp);
 
-    ::decode(retry_attempt, p);
+    denc(retry_attempt, cp);
 
-    ::decode(features, p);
+    denc(features, cp);
+    p.advance(cp.get_offset());
 
     hobj.pool = pgid.pgid.pool();
     hobj.set_key(oloc.key);
@@ -174,64 +174,82 @@ public:
       ::encode_nohead(oid.name, payload);
     } else {
       header.version = HEAD_VERSION;
-      ::encode(oid, payload);
-      ::encode(pgid, payload);
-      ::encode(flags, payload);
-      ::encode(result, payload);
-      ::encode(bad_replay_version, payload);
-      ::encode(osdmap_epoch, payload);
-
-      __u32 num_ops = ops.size();
-      ::encode(num_ops, payload);
-      for (unsigned i = 0; i < num_ops; i++)
-	::encode(ops[i].op, payload);
-
-      ::encode(retry_attempt, payload);
-
-      for (unsigned i = 0; i < num_ops; i++)
-	::encode(ops[i].rval, payload);
-
-      ::encode(replay_version, payload);
-      ::encode(user_version, payload);
-      if ((features & CEPH_FEATURE_NEW_OSDOPREPLY_ENCODING) == 0) {
+      bool v6 = (features & CEPH_FEATURE_NEW_OSDOPREPLY_ENCODING) == 0;
+      if (!v6)
+	do_redirect = !redirect.empty();
+      size_t len = 0;
+      denc_head(len);
+      len += sizeof(__u8);  // do_redirect
+      {
+	auto a = payload.get_contiguous_appender(len);
+	denc_head(a);
+	if (!v6)
+	  denc(do_redirect, a);
+      }
+      if (v6) {
         header.version = 6;
         ::encode(redirect, payload);
-      } else {
-        do_redirect = !redirect.empty();
-        ::encode(do_redirect, payload);
-        if (do_redirect) {
-          ::encode(redirect, payload);
-        }
+      } else if (do_redirect) {
+	::encode(redirect, payload);
       }
     }
   }
+
+  // everything up to the redirect, for both bound_encode (size_t) and
+  // encode (contiguous_appender), so it's sized once and written in a
+  // single pass
+  template<typename P>
+  void denc_head(P& p) const {
+    osd_op_denc::op_denc(oid, p);
+    osd_op_denc::op_denc(pgid, p);
+    denc(flags, p);
+    osd_op_denc::op_denc(result, p);
+    osd_op_denc::op_denc(bad_replay_version, p);
+    denc(osdmap_epoch, p);
+
+    __u32 num_ops = ops.size();
+    denc(num_ops, p);
+    for (unsigned i = 0; i < num_ops; i++)
+      osd_op_denc::op_denc(ops[i].op, p);
+
+    denc(retry_attempt, p);
+
+    for (unsigned i = 0; i < num_ops; i++)
+      denc(ops[i].rval, p);
+
+    osd_op_denc::op_denc(replay_version, p);
+    denc(user_version, p);
+  }
   virtual void decode_payload() {
     bufferlist::iterator p = payload.begin();
 
     // Always keep here the newest version of decoding order/rule
     if (header.version == HEAD_VERSION) {
-      ::decode(oid, p);
-      ::decode(pgid, p);
-      ::decode(flags, p);
-      ::decode(result, p);
-      ::decode(bad_replay_version, p);
-      ::decode(osdmap_epoch, p);
+      bufferptr bp = get_contiguous_rest(p);
+      auto cp = bp.begin();
+      osd_op_denc::op_denc(oid, cp);
+      osd_op_denc::op_denc(pgid, cp);
+      denc(flags, cp);
+      osd_op_denc::op_denc(result, cp);
+      osd_op_denc::op_denc(bad_replay_version, cp);
+      denc(osdmap_epoch, cp);
 
       __u32 num_ops = ops.size();
-      ::decode(num_ops, p);
+      denc(num_ops, cp);
       ops.resize(num_ops);
       for (unsigned i = 0; i < num_ops; i++)
-	::decode(ops[i].op, p);
-      ::decode(retry_attempt, p);
+	osd_op_denc::op_denc(ops[i].op, cp);
+      denc(retry_attempt, cp);
 
       for (unsigned i = 0; i < num_ops; ++i)
-	::decode(ops[i].rval, p);
+	denc(ops[i].rval, cp);
 
       OSDOp::split_osd_op_vector_out_data(ops, data);
 
-      ::decode(replay_version, p);
-      ::decode(user_version, p);
-      ::decode(do_redirect, p);
+      osd_op_denc::op_denc(replay_version, cp);
+      denc(user_version, cp);
+      denc(do_redirect, cp);
+      p.advance(cp.get_offset());
       if (do_redirect)
 	::decode(redirect, p);
     } else if (header.version < 2) {
@@ -210,12 +210,13 @@ void MgrClient::send_report()
     ENCODE_START(1, 1, report->packed);
     for (const auto &path : session->declared) {
       auto data = by_path.at(path);
-      ::encode(static_cast<uint64_t>(data->u64.read()),
-          report->packed);
       if (data->type & PERFCOUNTER_LONGRUNAVG) {
-        ::encode(static_cast<uint64_t>(data->avgcount.read()),
-            report->packed);
-        ::encode(static_cast<uint64_t>(data->avgcount2.read()),
+        pair<uint64_t,uint64_t> a = data->read_avg();
+        ::encode(a.first, report->packed);
+        ::encode(a.second, report->packed);
+        ::encode(a.second, report->packed);
+      } else {
+        ::encode(static_cast<uint64_t>(data->read_u64()),
             report->packed);
       }
     }
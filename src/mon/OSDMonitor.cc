@@ -150,7 +150,8 @@ void OSDMonitor::create_initial()
   // new cluster should require latest by default
   newmap.set_flag(CEPH_OSDMAP_REQUIRE_JEWEL);
   newmap.set_flag(CEPH_OSDMAP_REQUIRE_KRAKEN);
-  newmap.set_flag(CEPH_OSDMAP_REQUIRE_LUMINOUS);
+  if (!g_conf->mon_debug_no_require_luminous)
+    newmap.set_flag(CEPH_OSDMAP_REQUIRE_LUMINOUS);
 
   // encode into pending incremental
   newmap.encode(pending_inc.fullmap,
@@ -4700,6 +4701,28 @@ int OSDMonitor::check_cluster_features(uint64_t features,
   return 0;
 }
 
+int OSDMonitor::check_count_min_hit_set(stringstream &ss)
+{
+  if (!osdmap.test_flag(CEPH_OSDMAP_REQUIRE_LUMINOUS)) {
+    ss << "the require_luminous_osds flag must be set before using"
+       << " count_min hit sets";
+    return -EPERM;
+  }
+
+  for (xlist<MonSession*>::iterator p = mon->session_map.sessions.begin();
+       !p.end(); ++p) {
+    MonSession *s = *p;
+    if (!s->inst.name.is_client() || !s->con)
+      continue;
+    if (!HAVE_FEATURE(s->con->get_features(), SERVER_LUMINOUS)) {
+      ss << "client " << s->inst << " lacks CEPH_FEATURE_SERVER_LUMINOUS"
+	 << " and cannot decode count_min hit sets";
+      return -EPERM;
+    }
+  }
+  return 0;
+}
+
 bool OSDMonitor::validate_crush_against_features(const CrushWrapper *newcrush,
                                                  stringstream& ss)
 {
@@ -5375,7 +5398,12 @@ int OSDMonitor::prepare_command_pool_set(map<string,cmd_vartype> &cmdmap,
 	p.hit_set_params = HitSet::Params(new ExplicitHashHitSet::Params);
       else if (val == "explicit_object")
 	p.hit_set_params = HitSet::Params(new ExplicitObjectHitSet::Params);
-      else {
+      else if (val == "count_min") {
+	err = check_count_min_hit_set(ss);
+	if (err)
+	  return err;
+	p.hit_set_params = HitSet::Params(new CountMinHitSet::Params);
+      } else {
 	ss << "unrecognized hit_set type '" << val << "'";
 	return -EINVAL;
       }
@@ -7862,6 +7890,11 @@ done:
     }
     else if (g_conf->osd_tier_default_cache_hit_set_type == "explicit_object") {
       hsp = HitSet::Params(new ExplicitObjectHitSet::Params);
+    } else if (g_conf->osd_tier_default_cache_hit_set_type == "count_min") {
+      err = check_count_min_hit_set(ss);
+      if (err)
+	goto reply;
+      hsp = HitSet::Params(new CountMinHitSet::Params);
     } else {
       ss << "osd tier cache default hit set type '" <<
 	g_conf->osd_tier_default_cache_hit_set_type << "' is not a known type";
@@ -182,6 +182,13 @@ private:
 
   void update_msgr_features();
   int check_cluster_features(uint64_t features, stringstream &ss);
+  /**
+   * check if count_min hit sets can be enabled: older daemons and
+   * clients fail to decode an OSDMap carrying them.
+   *
+   * @returns 0 if allowed, -EPERM otherwise
+   */
+  int check_count_min_hit_set(stringstream &ss);
   /**
    * check if the cluster supports the features required by the
    * given crush map. Outputs the daemons which don't support it
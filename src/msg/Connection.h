@@ -16,6 +16,7 @@
 #define CEPH_CONNECTION_H
 
 #include <stdlib.h>
+#include <atomic>
 #include <ostream>
 
 #include <boost/intrusive_ptr.hpp>
@@ -53,6 +54,9 @@ public:
   int rx_buffers_version;
   map<ceph_tid_t,pair<bufferlist,int> > rx_buffers;
 
+  /// per-connection MsgLatency histogram, set on first use
+  std::atomic<RefCountedObject*> msg_latency;
+
   friend class boost::intrusive_ptr<Connection>;
   friend class PipeConnection;
 
@@ -67,7 +71,8 @@ public:
       peer_type(-1),
       features(0),
       failed(false),
-      rx_buffers_version(0) {
+      rx_buffers_version(0),
+      msg_latency(nullptr) {
   }
 
   virtual ~Connection() {
@@ -76,6 +81,8 @@ public:
       //generic_dout(0) << "~Connection " << this << " dropping priv " << priv << dendl;
       priv->put();
     }
+    if (msg_latency)
+      msg_latency.load()->put();
   }
 
   void set_priv(RefCountedObject *o) {
@@ -29,14 +29,48 @@
 #define dout_prefix *_dout << "-- " << msgr->get_myaddr() << " "
 
 double DispatchQueue::get_max_age(utime_t now) const {
-  Mutex::Locker l(lock);
-  if (marrival.empty())
+  double oldest = 0;
+  bool found = false;
+  for (auto s : shards) {
+    Mutex::Locker l(s->lock);
+    if (!s->marrival.empty() &&
+	(!found || s->marrival.begin()->first < oldest)) {
+      oldest = s->marrival.begin()->first;
+      found = true;
+    }
+  }
+  if (!found)
     return 0;
   else
-    return (now - marrival.begin()->first);
+    return (now - oldest);
+}
+
+int DispatchQueue::get_dispatch_class(int type, int priority)
+{
+  if (priority >= CEPH_MSG_PRIO_HIGH)
+    return DISPATCH_CLASS_CONTROL;
+  switch (type) {
+  case CEPH_MSG_MON_MAP:
+  case CEPH_MSG_MDS_MAP:
+  case CEPH_MSG_OSD_MAP:
+  case CEPH_MSG_FS_MAP:
+  case MSG_MGR_MAP:
+  case MSG_OSD_PING:
+  case MSG_MDS_BEACON:
+  case MSG_MGR_BEACON:
+  case MSG_MON_PAXOS:
+    return DISPATCH_CLASS_CONTROL;
+  default:
+    return DISPATCH_CLASS_DEFAULT;
+  }
+}
+
+int DispatchQueue::get_dispatch_class(const Message *m)
+{
+  return get_dispatch_class(m->get_type(), m->get_priority());
 }
 
-uint64_t DispatchQueue::pre_dispatch(Message *m)
+uint64_t DispatchQueue::pre_dispatch(Message *m, int *dclass)
 {
   ldout(cct,1) << "<== " << m->get_source_inst()
 	       << " " << m->get_seq()
@@ -51,12 +85,13 @@ uint64_t DispatchQueue::pre_dispatch(Message *m)
 	       << dendl;
   uint64_t msize = m->get_dispatch_throttle_size();
   m->set_dispatch_throttle_size(0); // clear it out, in case we requeue this message.
+  *dclass = get_dispatch_class(m);
   return msize;
 }
 
-void DispatchQueue::post_dispatch(Message *m, uint64_t msize)
+void DispatchQueue::post_dispatch(Message *m, uint64_t msize, int dclass)
 {
-  dispatch_throttle_release(msize);
+  dispatch_throttle_release(msize, dclass);
   ldout(cct,20) << "done calling dispatch on " << m << dendl;
 }
 
@@ -67,9 +102,10 @@ bool DispatchQueue::can_fast_dispatch(Message *m) const
 
 void DispatchQueue::fast_dispatch(Message *m)
 {
-  uint64_t msize = pre_dispatch(m);
+  int dclass;
+  uint64_t msize = pre_dispatch(m, &dclass);
   msgr->ms_fast_dispatch(m);
-  post_dispatch(m, msize);
+  post_dispatch(m, msize, dclass);
 }
 
 void DispatchQueue::fast_preprocess(Message *m)
@@ -79,18 +115,18 @@ void DispatchQueue::fast_preprocess(Message *m)
 
 void DispatchQueue::enqueue(Message *m, int priority, uint64_t id)
 {
-
-  Mutex::Locker l(lock);
+  Shard *s = get_shard(m->get_connection().get());
+  Mutex::Locker l(s->lock);
   ldout(cct,20) << "queue " << m << " prio " << priority << dendl;
-  add_arrival(m);
+  s->add_arrival(m);
   if (priority >= CEPH_MSG_PRIO_LOW) {
-    mqueue.enqueue_strict(
+    s->mqueue.enqueue_strict(
         id, priority, QueueItem(m));
   } else {
-    mqueue.enqueue(
+    s->mqueue.enqueue(
         id, priority, m->get_cost(), QueueItem(m));
   }
-  cond.Signal();
+  s->cond.Signal();
 }
 
 void DispatchQueue::local_delivery(Message *m, int priority)
@@ -129,13 +165,14 @@ void DispatchQueue::run_local_delivery()
   local_delivery_lock.Unlock();
 }
 
-void DispatchQueue::dispatch_throttle_release(uint64_t msize)
+void DispatchQueue::dispatch_throttle_release(uint64_t msize, int dclass)
 {
   if (msize) {
+    Throttle &t = get_dispatch_throttler(dclass);
     ldout(cct,10) << __func__ << " " << msize << " to dispatch throttler "
-	    << dispatch_throttler.get_current() << "/"
-	    << dispatch_throttler.get_max() << dendl;
-    dispatch_throttler.put(msize);
+	    << t.get_current() << "/"
+	    << t.get_max() << dendl;
+    t.put(msize);
   }
 }
 
@@ -148,14 +185,16 @@ void DispatchQueue::dispatch_throttle_release(uint64_t msize)
  * end of the queue. If the queue is empty; it's removed.
  * The message is then delivered and the process starts again.
  */
-void DispatchQueue::entry()
+void DispatchQueue::entry(unsigned shard)
 {
+  Shard *s = shards[shard];
+  Mutex &lock = s->lock;
   lock.Lock();
   while (true) {
-    while (!mqueue.empty()) {
-      QueueItem qitem = mqueue.dequeue();
+    while (!s->mqueue.empty()) {
+      QueueItem qitem = s->mqueue.dequeue();
       if (!qitem.is_code())
-	remove_arrival(qitem.get_message());
+	s->remove_arrival(qitem.get_message());
       lock.Unlock();
 
       if (qitem.is_code()) {
@@ -193,9 +232,10 @@ void DispatchQueue::entry()
 	  ldout(cct,10) << " stop flag set, discarding " << m << " " << *m << dendl;
 	  m->put();
 	} else {
-	  uint64_t msize = pre_dispatch(m);
+	  int dclass;
+	  uint64_t msize = pre_dispatch(m, &dclass);
 	  msgr->ms_deliver_dispatch(m);
-	  post_dispatch(m, msize);
+	  post_dispatch(m, msize, dclass);
 	}
       }
 
@@ -205,38 +245,43 @@ void DispatchQueue::entry()
       break;
 
     // wait for something to be put on queue
-    cond.Wait(lock);
+    s->cond.Wait(lock);
   }
   lock.Unlock();
 }
 
 void DispatchQueue::discard_queue(uint64_t id) {
-  Mutex::Locker l(lock);
-  list<QueueItem> removed;
-  mqueue.remove_by_class(id, &removed);
-  for (list<QueueItem>::iterator i = removed.begin();
-       i != removed.end();
-       ++i) {
-    assert(!(i->is_code())); // We don't discard id 0, ever!
-    Message *m = i->get_message();
-    remove_arrival(m);
-    dispatch_throttle_release(m->get_dispatch_throttle_size());
-    m->put();
+  // id is not tied to a connection here, so look in every shard
+  for (auto s : shards) {
+    Mutex::Locker l(s->lock);
+    list<QueueItem> removed;
+    s->mqueue.remove_by_class(id, &removed);
+    for (list<QueueItem>::iterator i = removed.begin();
+	 i != removed.end();
+	 ++i) {
+      assert(!(i->is_code())); // We don't discard id 0, ever!
+      Message *m = i->get_message();
+      s->remove_arrival(m);
+      dispatch_throttle_release(m);
+      m->put();
+    }
   }
 }
 
 void DispatchQueue::start()
 {
   assert(!stop);
-  assert(!dispatch_thread.is_started());
-  dispatch_thread.create("ms_dispatch");
+  assert(!is_started());
+  for (auto s : shards)
+    s->dispatch_thread.start();
   local_delivery_thread.create("ms_local");
 }
 
 void DispatchQueue::wait()
 {
   local_delivery_thread.join();
-  dispatch_thread.join();
+  for (auto s : shards)
+    s->dispatch_thread.join();
 }
 
 void DispatchQueue::discard_local()
@@ -258,9 +303,12 @@ void DispatchQueue::shutdown()
   local_delivery_cond.Signal();
   local_delivery_lock.Unlock();
 
-  // stop my dispatch thread
-  lock.Lock();
+  // stop my dispatch threads
+  for (auto s : shards)
+    s->lock.Lock();
   stop = true;
-  cond.Signal();
-  lock.Unlock();
+  for (auto s : shards) {
+    s->cond.Signal();
+    s->lock.Unlock();
+  }
 }
@@ -21,6 +21,7 @@
 #include "include/assert.h"
 #include "include/xlist.h"
 #include "include/atomic.h"
+#include "include/stringify.h"
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "common/Thread.h"
@@ -64,45 +65,84 @@ class DispatchQueue {
     
   CephContext *cct;
   Messenger *msgr;
-  mutable Mutex lock;
-  Cond cond;
-
-  PrioritizedQueue<QueueItem, uint64_t> mqueue;
-
-  set<pair<double, Message*> > marrival;
-  map<Message *, set<pair<double, Message*> >::iterator> marrival_map;
-  void add_arrival(Message *m) {
-    marrival_map.insert(
-      make_pair(
-	m,
-	marrival.insert(make_pair(m->get_recv_stamp(), m)).first
-	)
-      );
-  }
-  void remove_arrival(Message *m) {
-    map<Message *, set<pair<double, Message*> >::iterator>::iterator i =
-      marrival_map.find(m);
-    assert(i != marrival_map.end());
-    marrival.erase(i->second);
-    marrival_map.erase(i);
-  }
-
-  std::atomic<uint64_t> next_id;
-    
-  enum { D_CONNECT = 1, D_ACCEPT, D_BAD_REMOTE_RESET, D_BAD_RESET, D_CONN_REFUSED, D_NUM_CODES };
 
   /**
-   * The DispatchThread runs dispatch_entry to empty out the dispatch_queue.
+   * The DispatchThread runs dispatch_entry to empty out its shard.
    */
   class DispatchThread : public Thread {
     DispatchQueue *dq;
+    unsigned shard;
+    string name;  // Thread keeps a pointer to it
   public:
-    explicit DispatchThread(DispatchQueue *dq) : dq(dq) {}
+    DispatchThread(DispatchQueue *dq, unsigned s)
+      : dq(dq), shard(s),
+	name(s ? "ms_dispatch_" + stringify(s) : "ms_dispatch") {}
     void *entry() {
-      dq->entry();
+      dq->entry(shard);
       return 0;
     }
-  } dispatch_thread;
+    void start() {
+      create(name.c_str());
+    }
+  };
+
+  /**
+   * Each shard is drained by its own DispatchThread.  Everything queued
+   * for a Connection lands in the same shard, so per-connection ordering
+   * holds however many threads there are (ms_dispatch_threads).
+   */
+  struct Shard {
+    mutable Mutex lock;
+    Cond cond;
+    PrioritizedQueue<QueueItem, uint64_t> mqueue;
+    set<pair<double, Message*> > marrival;
+    map<Message *, set<pair<double, Message*> >::iterator> marrival_map;
+    DispatchThread dispatch_thread;
+
+    Shard(DispatchQueue *dq, unsigned i, const string &name)
+      : lock((i ? "Messenger::DispatchQueue::lock" + name + "-" + stringify(i) :
+	      "Messenger::DispatchQueue::lock" + name).c_str()),
+	mqueue(dq->cct->_conf->ms_pq_max_tokens_per_priority,
+	       dq->cct->_conf->ms_pq_min_cost),
+	dispatch_thread(dq, i) {}
+
+    void add_arrival(Message *m) {
+      marrival_map.insert(
+	make_pair(
+	  m,
+	  marrival.insert(make_pair(m->get_recv_stamp(), m)).first
+	  )
+	);
+    }
+    void remove_arrival(Message *m) {
+      map<Message *, set<pair<double, Message*> >::iterator>::iterator i =
+	marrival_map.find(m);
+      assert(i != marrival_map.end());
+      marrival.erase(i->second);
+      marrival_map.erase(i);
+    }
+  };
+  vector<Shard*> shards;
+
+  Shard *get_shard(const Connection *con) const {
+    return shards[(reinterpret_cast<uintptr_t>(con) / sizeof(void*)) % shards.size()];
+  }
+
+  std::atomic<uint64_t> next_id;
+    
+  enum { D_CONNECT = 1, D_ACCEPT, D_BAD_REMOTE_RESET, D_BAD_RESET, D_CONN_REFUSED, D_NUM_CODES };
+
+  void queue_code(int code, Connection *con) {
+    Shard *s = get_shard(con);
+    Mutex::Locker l(s->lock);
+    if (stop)
+      return;
+    s->mqueue.enqueue_strict(
+      0,
+      CEPH_MSG_PRIO_HIGHEST,
+      QueueItem(code, con));
+    s->cond.Signal();
+  }
 
   Mutex local_delivery_lock;
   Cond local_delivery_cond;
@@ -118,13 +158,34 @@ class DispatchQueue {
     }
   } local_delivery_thread;
 
-  uint64_t pre_dispatch(Message *m);
-  void post_dispatch(Message *m, uint64_t msize);
+  uint64_t pre_dispatch(Message *m, int *dclass);
+  void post_dispatch(Message *m, uint64_t msize, int dclass);
 
  public:
 
+  /**
+   * Dispatch throttle classes.  Control traffic (cluster maps, beacons,
+   * heartbeats and anything sent at CEPH_MSG_PRIO_HIGH or above) has its
+   * own byte budget, so a backlog of client requests cannot keep it from
+   * being read off the wire.  Its queue priority is left alone: raising
+   * it would let it overtake earlier messages on the same connection.
+   */
+  enum {
+    DISPATCH_CLASS_DEFAULT = 0,
+    DISPATCH_CLASS_CONTROL,
+  };
+  static int get_dispatch_class(int type, int priority);
+  static int get_dispatch_class(const Message *m);
+
   /// Throttle preventing us from building up a big backlog waiting for dispatch
   Throttle dispatch_throttler;
+  /// Same for DISPATCH_CLASS_CONTROL messages
+  Throttle control_dispatch_throttler;
+
+  Throttle& get_dispatch_throttler(int dclass) {
+    return dclass == DISPATCH_CLASS_CONTROL ?
+      control_dispatch_throttler : dispatch_throttler;
+  }
 
   bool stop;
   void local_delivery(Message *m, int priority);
@@ -133,66 +194,40 @@ class DispatchQueue {
   double get_max_age(utime_t now) const;
 
   int get_queue_len() const {
-    Mutex::Locker l(lock);
-    return mqueue.length();
+    int len = 0;
+    for (auto s : shards) {
+      Mutex::Locker l(s->lock);
+      len += s->mqueue.length();
+    }
+    return len;
   }
 
   /**
    * Release memory accounting back to the dispatch throttler.
    *
    * @param msize The amount of memory to release.
+   * @param dclass The dispatch class it was taken for.
    */
-  void dispatch_throttle_release(uint64_t msize);
+  void dispatch_throttle_release(uint64_t msize, int dclass);
+  void dispatch_throttle_release(Message *m) {
+    dispatch_throttle_release(m->get_dispatch_throttle_size(),
+			      get_dispatch_class(m));
+  }
 
   void queue_connect(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_CONNECT, con));
-    cond.Signal();
+    queue_code(D_CONNECT, con);
   }
   void queue_accept(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_ACCEPT, con));
-    cond.Signal();
+    queue_code(D_ACCEPT, con);
   }
   void queue_remote_reset(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_REMOTE_RESET, con));
-    cond.Signal();
+    queue_code(D_BAD_REMOTE_RESET, con);
   }
   void queue_reset(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_BAD_RESET, con));
-    cond.Signal();
+    queue_code(D_BAD_RESET, con);
   }
   void queue_refused(Connection *con) {
-    Mutex::Locker l(lock);
-    if (stop)
-      return;
-    mqueue.enqueue_strict(
-      0,
-      CEPH_MSG_PRIO_HIGHEST,
-      QueueItem(D_CONN_REFUSED, con));
-    cond.Signal();
+    queue_code(D_CONN_REFUSED, con);
   }
 
   bool can_fast_dispatch(Message *m) const;
@@ -205,28 +240,34 @@ class DispatchQueue {
     return next_id++;
   }
   void start();
-  void entry();
+  void entry(unsigned shard);
   void wait();
   void shutdown();
-  bool is_started() const {return dispatch_thread.is_started();}
+  bool is_started() const {return shards[0]->dispatch_thread.is_started();}
 
   DispatchQueue(CephContext *cct, Messenger *msgr, string &name)
     : cct(cct), msgr(msgr),
-      lock("Messenger::DispatchQueue::lock" + name),
-      mqueue(cct->_conf->ms_pq_max_tokens_per_priority,
-	     cct->_conf->ms_pq_min_cost),
       next_id(1),
-      dispatch_thread(this),
       local_delivery_lock("Messenger::DispatchQueue::local_delivery_lock" + name),
       stop_local_delivery(false),
       local_delivery_thread(this),
       dispatch_throttler(cct, string("msgr_dispatch_throttler-") + name,
                          cct->_conf->ms_dispatch_throttle_bytes),
+      control_dispatch_throttler(
+	cct, string("msgr_dispatch_throttler-control-") + name,
+	cct->_conf->ms_dispatch_control_throttle_bytes),
       stop(false)
-    {}
+    {
+      unsigned n = std::max(1, (int)cct->_conf->ms_dispatch_threads);
+      for (unsigned i = 0; i < n; ++i)
+	shards.push_back(new Shard(this, i, name));
+    }
   ~DispatchQueue() {
-    assert(mqueue.empty());
-    assert(marrival.empty());
+    for (auto s : shards) {
+      assert(s->mqueue.empty());
+      assert(s->marrival.empty());
+      delete s;
+    }
     assert(local_messages.empty());
   }
 };
@@ -226,6 +226,9 @@ protected:
   utime_t throttle_stamp;
   /* time at which message was fully read */
   utime_t recv_complete_stamp;
+  /* send_stamp is set when the message is queued for sending, only when
+   * ms_msg_latency is on */
+  utime_t send_stamp;
 
   ConnectionRef connection;
 
@@ -393,6 +396,8 @@ public:
   const utime_t& get_throttle_stamp() const { return throttle_stamp; }
   void set_recv_complete_stamp(utime_t t) { recv_complete_stamp = t; }
   const utime_t& get_recv_complete_stamp() const { return recv_complete_stamp; }
+  void set_send_stamp(utime_t t) { send_stamp = t; }
+  const utime_t& get_send_stamp() const { return send_stamp; }
 
   void calc_header_crc() {
     header.crc = ceph_crc32c(0, (unsigned char*)&header,
@@ -451,6 +456,17 @@ public:
   virtual void decode_payload() = 0;
   virtual void encode_payload(uint64_t features) = 0;
   virtual const char *get_type_name() const = 0;
+
+  // the rest of the payload from p as one ptr for a denc decode; this is
+  // shallow unless the payload is fragmented, in which case it's copied once
+  static bufferptr get_contiguous_rest(const bufferlist::iterator& p) {
+    if (p.end())
+      throw buffer::end_of_buffer();
+    bufferptr bp;
+    bufferlist::iterator t = p;
+    t.copy_shallow(t.get_remaining(), bp);
+    return bp;
+  }
   virtual void print(ostream& out) const {
     out << get_type_name() << " magic: " << magic;
   }
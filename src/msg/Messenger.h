@@ -22,6 +22,7 @@ using namespace std;
 
 #include "Message.h"
 #include "Dispatcher.h"
+#include "MsgLatency.h"
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "include/Context.h"
@@ -66,6 +67,9 @@ public:
    */
   CephContext *cct;
   int crcflags;
+  /// stage latency histograms, shared per CephContext; NULL unless
+  /// ms_msg_latency is set
+  MsgLatency *msg_latency;
 
   /**
    * A Policy describes the rules of a Connection. Is there a limit on how
@@ -141,9 +145,13 @@ public:
       magic(0),
       socket_priority(-1),
       cct(cct_),
-      crcflags(get_default_crc_flags(cct->_conf))
+      crcflags(get_default_crc_flags(cct->_conf)),
+      msg_latency(NULL)
   {
     my_inst.name = w;
+    if (cct->_conf->ms_msg_latency)
+      cct->lookup_or_create_singleton_object<MsgLatency>(msg_latency,
+							 "MsgLatency");
   }
   virtual ~Messenger() {}
 
@@ -566,6 +574,8 @@ public:
    */
   void ms_fast_dispatch(Message *m) {
     m->set_dispatch_stamp(ceph_clock_now());
+    if (msg_latency)
+      msg_latency->record_recv(m);
     for (list<Dispatcher*>::iterator p = fast_dispatchers.begin();
 	 p != fast_dispatchers.end();
 	 ++p) {
@@ -596,6 +606,8 @@ public:
    */
   void ms_deliver_dispatch(Message *m) {
     m->set_dispatch_stamp(ceph_clock_now());
+    if (msg_latency)
+      msg_latency->record_recv(m);
     for (list<Dispatcher*>::iterator p = dispatchers.begin();
 	 p != dispatchers.end();
 	 ++p) {
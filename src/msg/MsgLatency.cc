@@ -0,0 +1,232 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include "MsgLatency.h"
+#include "Message.h"
+#include "Messenger.h"
+#include "common/admin_socket.h"
+#include "common/ceph_context.h"
+#include "common/Formatter.h"
+
+class MsgLatencyHook : public AdminSocketHook {
+  MsgLatency *ml;
+public:
+  explicit MsgLatencyHook(MsgLatency *ml) : ml(ml) {}
+  bool call(std::string command, cmdmap_t& cmdmap, std::string format,
+	    bufferlist& out) override {
+    Formatter *f = Formatter::create(format, "json-pretty", "json-pretty");
+    if (command == "reset_msg_latency") {
+      ml->reset();
+      f->open_object_section("result");
+      f->dump_bool("success", true);
+      f->close_section();
+    } else {
+      ml->dump(f);
+    }
+    f->flush(out);
+    delete f;
+    return true;
+  }
+};
+
+const char *MsgLatency::get_stage_name(int s)
+{
+  switch (s) {
+  case STAGE_THROTTLE: return "throttle";
+  case STAGE_READ: return "read";
+  case STAGE_DISPATCH: return "dispatch";
+  case STAGE_SEND: return "send";
+  default: return "???";
+  }
+}
+
+MsgLatency::Hist::Hist()
+  : RefCountedObject(NULL, 1),
+    h({{"stage", PerfHistogramCommon::SCALE_LINEAR, 0, 1, STAGE_MAX + 1},
+       {"latency_usec", PerfHistogramCommon::SCALE_LOG2, 0, 1, 32}})
+{
+}
+
+MsgLatency::MsgLatency(CephContext *cct)
+  : cct(cct), hook(new MsgLatencyHook(this))
+{
+  for (int i = 0; i < MAX_TYPES; ++i)
+    by_type[i] = nullptr;
+  AdminSocket *admin_socket = cct->get_admin_socket();
+  int r = admin_socket->register_command(
+    "dump_msg_latency", "dump_msg_latency", hook,
+    "dump per message type and per connection messenger stage latencies");
+  assert(r == 0);
+  r = admin_socket->register_command(
+    "reset_msg_latency", "reset_msg_latency", hook,
+    "reset the messenger stage latency histograms");
+  assert(r == 0);
+}
+
+MsgLatency::~MsgLatency()
+{
+  AdminSocket *admin_socket = cct->get_admin_socket();
+  admin_socket->unregister_command("dump_msg_latency");
+  admin_socket->unregister_command("reset_msg_latency");
+  delete hook;
+
+  for (int i = 0; i < MAX_TYPES; ++i) {
+    Hist *h = by_type[i].load();
+    if (h)
+      h->put();
+  }
+  for (auto h : conns)
+    h->put();
+}
+
+MsgLatency::Hist *MsgLatency::get_type_hist(Message *m)
+{
+  int type = m->get_type();
+  if (type < 0 || type >= MAX_TYPES)
+    type = 0;
+  Hist *h = by_type[type].load(std::memory_order_acquire);
+  if (h)
+    return h;
+  h = new Hist;
+  h->label = type ? m->get_type_name() : "other";
+  Hist *expected = nullptr;
+  if (!by_type[type].compare_exchange_strong(expected, h)) {
+    h->put();
+    return expected;
+  }
+  return h;
+}
+
+MsgLatency::Hist *MsgLatency::get_conn_hist(Connection *con)
+{
+  RefCountedObject *o = con->msg_latency.load(std::memory_order_acquire);
+  if (o)
+    return static_cast<Hist*>(o);
+  Hist *h = new Hist;  // the connection's ref
+  RefCountedObject *expected = nullptr;
+  if (!con->msg_latency.compare_exchange_strong(expected, h)) {
+    h->put();
+    return static_cast<Hist*>(expected);
+  }
+  {
+    std::lock_guard<std::mutex> l(h->lock);
+    std::ostringstream ss;
+    ss << con->get_messenger()->get_myname() << " <-> "
+       << ceph_entity_type_name(con->get_peer_type()) << " "
+       << con->get_peer_addr();
+    h->label = ss.str();
+  }
+  h->get();  // ours
+  std::lock_guard<std::mutex> l(conns_lock);
+  conns.push_back(h);
+  return h;
+}
+
+void MsgLatency::inc(Hist *th, Hist *ch, int stage, utime_t start,
+		     utime_t end)
+{
+  if (start == utime_t() || end < start)
+    return;
+  int64_t usec = (end - start).to_nsec() / 1000;
+  th->h.inc(stage, usec);
+  if (ch)
+    ch->h.inc(stage, usec);
+}
+
+void MsgLatency::record_recv(Message *m)
+{
+  Hist *th = get_type_hist(m);
+  Connection *con = m->get_connection().get();
+  Hist *ch = con ? get_conn_hist(con) : nullptr;
+  inc(th, ch, STAGE_THROTTLE, m->get_recv_stamp(), m->get_throttle_stamp());
+  inc(th, ch, STAGE_READ, m->get_throttle_stamp(),
+      m->get_recv_complete_stamp());
+  inc(th, ch, STAGE_DISPATCH, m->get_recv_complete_stamp(),
+      m->get_dispatch_stamp());
+}
+
+void MsgLatency::record_sent(Connection *con, Message *m)
+{
+  utime_t queued = m->get_send_stamp();
+  if (queued == utime_t())
+    return;
+  inc(get_type_hist(m), get_conn_hist(con), STAGE_SEND, queued,
+      ceph_clock_now());
+}
+
+void MsgLatency::dump(Formatter *f)
+{
+  f->open_object_section("msg_latency");
+  f->open_array_section("stages");
+  for (int s = 0; s < STAGE_MAX; ++s)
+    f->dump_string("stage", get_stage_name(s));
+  f->close_section();
+
+  f->open_array_section("by_type");
+  for (int i = 0; i < MAX_TYPES; ++i) {
+    Hist *h = by_type[i].load(std::memory_order_acquire);
+    if (!h)
+      continue;
+    f->open_object_section("type");
+    f->dump_int("type", i);
+    f->dump_string("name", h->label);
+    f->open_object_section("histogram");
+    h->h.dump_formatted(f);
+    f->close_section();
+    f->close_section();
+  }
+  f->close_section();
+
+  std::list<Hist*> gone;
+  f->open_array_section("by_connection");
+  {
+    std::lock_guard<std::mutex> l(conns_lock);
+    for (auto p = conns.begin(); p != conns.end(); ) {
+      Hist *h = *p;
+      bool closed = h->get_nref() == 1;
+      f->open_object_section("connection");
+      {
+	std::lock_guard<std::mutex> hl(h->lock);
+	f->dump_string("name", h->label);
+      }
+      f->dump_bool("closed", closed);
+      f->open_object_section("histogram");
+      h->h.dump_formatted(f);
+      f->close_section();
+      f->close_section();
+      if (closed) {
+	// the connection is gone; this was its last report
+	gone.push_back(h);
+	conns.erase(p++);
+      } else {
+	++p;
+      }
+    }
+  }
+  f->close_section();
+  f->close_section();
+
+  for (auto h : gone)
+    h->put();
+}
+
+void MsgLatency::reset()
+{
+  for (int i = 0; i < MAX_TYPES; ++i) {
+    Hist *h = by_type[i].load(std::memory_order_acquire);
+    if (h)
+      h->h.reset();
+  }
+  std::lock_guard<std::mutex> l(conns_lock);
+  for (auto h : conns)
+    h->h.reset();
+}
@@ -0,0 +1,88 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#ifndef CEPH_MSG_LATENCY_H
+#define CEPH_MSG_LATENCY_H
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include "include/utime.h"
+#include "common/RefCountedObj.h"
+#include "common/perf_histogram.h"
+
+class AdminSocketHook;
+class CephContext;
+class Message;
+struct Connection;
+
+/**
+ * Per-message stage latencies, aggregated per message type and per
+ * connection.
+ *
+ * There is one instance per CephContext, shared by all of its messengers
+ * (enabled with ms_msg_latency).  Each histogram has the stage on its
+ * first axis and the time spent in that stage, in usec with log2 buckets,
+ * on the second.  Everything on the recording path is a handful of
+ * atomic increments; locks are only taken the first time a type or a
+ * connection is seen.  Dump with the "dump_msg_latency" admin socket
+ * command.
+ */
+class MsgLatency {
+public:
+  enum stage_t {
+    STAGE_THROTTLE,  ///< recv started -> throttle acquired
+    STAGE_READ,      ///< throttle acquired -> recv complete
+    STAGE_DISPATCH,  ///< recv complete -> handed to a dispatcher
+    STAGE_SEND,      ///< send_message() -> written to the socket
+    STAGE_MAX
+  };
+  static const char *get_stage_name(int s);
+
+  struct Hist : public RefCountedObject {
+    PerfHistogram<2> h;
+    std::mutex lock;     ///< protects label
+    std::string label;
+    Hist();
+  };
+
+  explicit MsgLatency(CephContext *cct);
+  ~MsgLatency();
+
+  /// record the receive stages of m; called when it is dispatched
+  void record_recv(Message *m);
+  /// record the send stage of m on con; called once it has been written
+  void record_sent(Connection *con, Message *m);
+
+  void dump(Formatter *f);
+  void reset();
+
+private:
+  static const int MAX_TYPES = 0x800;  ///< larger types are lumped into 0
+
+  CephContext *cct;
+  AdminSocketHook *hook;
+
+  std::atomic<Hist*> by_type[MAX_TYPES];
+
+  std::mutex conns_lock;
+  /// one ref each; dropped on dump once the connection is gone
+  std::list<Hist*> conns;
+
+  Hist *get_type_hist(Message *m);
+  Hist *get_conn_hist(Connection *con);
+  static void inc(Hist *th, Hist *ch, int stage, utime_t start, utime_t end);
+};
+
+#endif
@@ -97,33 +97,12 @@ class C_tick_wakeup : public EventCallback {
   }
 };
 
-static void alloc_aligned_buffer(bufferlist& data, unsigned len, unsigned off)
-{
-  // create a buffer to read into that matches the data alignment
-  unsigned left = len;
-  if (off & ~CEPH_PAGE_MASK) {
-    // head
-    unsigned head = 0;
-    head = MIN(CEPH_PAGE_SIZE - (off & ~CEPH_PAGE_MASK), left);
-    data.push_back(buffer::create(head));
-    left -= head;
-  }
-  unsigned middle = left & CEPH_PAGE_MASK;
-  if (middle > 0) {
-    data.push_back(buffer::create_page_aligned(middle));
-    left -= middle;
-  }
-  if (left) {
-    data.push_back(buffer::create(left));
-  }
-}
-
 AsyncConnection::AsyncConnection(CephContext *cct, AsyncMessenger *m, DispatchQueue *q,
                                  Worker *w)
   : Connection(cct, m), delay_state(NULL), async_msgr(m), conn_id(q->get_id()),
     logger(w->get_perf_counter()), global_seq(0), connect_seq(0), peer_global_seq(0),
     out_seq(0), ack_left(0), in_seq(0), state(STATE_NONE), state_after_send(STATE_NONE), port(-1),
-    dispatch_queue(q), can_write(WriteStatus::NOWRITE),
+    dispatch_queue(q), can_write(WriteStatus::NOWRITE), out_pending(nullptr),
     open_write(false), keepalive(false), recv_buf(NULL),
     recv_max_prefetch(MAX(msgr->cct->_conf->ms_tcp_prefetch_max_size, TCP_PREFETCH_MIN_SIZE)),
     recv_start(0), recv_end(0),
@@ -147,6 +126,7 @@ AsyncConnection::AsyncConnection(CephContext *cct, AsyncMessenger *m, DispatchQu
 AsyncConnection::~AsyncConnection()
 {
   assert(out_q.empty());
+  assert(!out_pending.load());
   assert(sent.empty());
   delete authorizer;
   if (recv_buf)
@@ -201,6 +181,12 @@ ssize_t AsyncConnection::_try_send(bool more)
     }
   }
 
+  if (corked_msgs) {
+    logger->inc(l_msgr_send_msgs_per_syscall, corked_msgs);
+    logger->tinc(l_msgr_send_cork_lat, ceph_clock_now() - cork_stamp);
+    corked_msgs = 0;
+  }
+
   ssize_t r = cs.send(outcoming_bl, more);
   if (r < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " send error: " << cpp_strerror(r) << dendl;
@@ -242,6 +228,14 @@ ssize_t AsyncConnection::_try_send(bool more)
 //
 // return the remaining bytes, 0 means this buffer is finished
 // else return < 0 means error
+bufferptr AsyncConnection::alloc_rx_buffer(unsigned len, unsigned off)
+{
+  bool reused;
+  bufferptr bp = worker->rx_buffer_pool->get(len, off, &reused);
+  logger->inc(reused ? l_msgr_recv_buffer_reuse : l_msgr_recv_buffer_alloc);
+  return bp;
+}
+
 ssize_t AsyncConnection::read_until(unsigned len, char *p)
 {
   ldout(async_msgr->cct, 25) << __func__ << " len is " << len << " state_offset is "
@@ -334,6 +328,9 @@ void AsyncConnection::process()
   bool need_dispatch_writer = false;
   std::lock_guard<std::mutex> l(lock);
   last_active = ceph::coarse_mono_clock::now();
+  // an error-queue wakeup reads as readable even in states that don't read
+  if (cs)
+    cs.reap_completions();
   do {
     ldout(async_msgr->cct, 20) << __func__ << " prev state is " << get_state_name(prev_state) << dendl;
     prev_state = state;
@@ -546,10 +543,12 @@ void AsyncConnection::process()
       case STATE_OPEN_MESSAGE_THROTTLE_DISPATCH_QUEUE:
         {
           if (cur_msg_size) {
-            if (!dispatch_queue->dispatch_throttler.get_or_fail(cur_msg_size)) {
+            Throttle &t = dispatch_queue->get_dispatch_throttler(
+              DispatchQueue::get_dispatch_class(current_header.type, current_header.priority));
+            if (!t.get_or_fail(cur_msg_size)) {
               ldout(async_msgr->cct, 10) << __func__ << " wants " << cur_msg_size << " bytes from dispatch throttle "
-                                         << dispatch_queue->dispatch_throttler.get_current() << "/"
-                                         << dispatch_queue->dispatch_throttler.get_max() << " failed, just wait." << dendl;
+                                         << t.get_current() << "/"
+                                         << t.get_max() << " failed, just wait." << dendl;
               // following thread pool deal with th full message queue isn't a
               // short time, so we can wait a ms.
               if (register_time_events.empty())
@@ -569,7 +568,7 @@ void AsyncConnection::process()
           unsigned front_len = current_header.front_len;
           if (front_len) {
             if (!front.length())
-              front.push_back(buffer::create(front_len));
+              front.push_back(alloc_rx_buffer(front_len, 0));
 
             r = read_until(front_len, front.c_str());
             if (r < 0) {
@@ -590,7 +589,7 @@ void AsyncConnection::process()
           unsigned middle_len = current_header.middle_len;
           if (middle_len) {
             if (!middle.length())
-              middle.push_back(buffer::create(middle_len));
+              middle.push_back(alloc_rx_buffer(middle_len, 0));
 
             r = read_until(middle_len, middle.c_str());
             if (r < 0) {
@@ -624,17 +623,22 @@ void AsyncConnection::process()
               data_blp = data_buf.begin();
             } else {
               ldout(async_msgr->cct,20) << __func__ << " allocating new rx buffer at offset " << data_off << dendl;
-              alloc_aligned_buffer(data_buf, data_len, data_off);
+              // one buffer placed at the payload's in-page offset, so its
+              // page boundaries line up with the object's
+              data_buf.push_back(alloc_rx_buffer(data_len, data_off & ~CEPH_PAGE_MASK));
               data_blp = data_buf.begin();
             }
           }
 
           msg_left = data_len;
+          data_crc = 0;
+          data_crc_off = 0;
           state = STATE_OPEN_MESSAGE_READ_DATA;
         }
 
       case STATE_OPEN_MESSAGE_READ_DATA:
         {
+          bool crc_data = async_msgr->crcflags & MSG_CRC_DATA;
           while (msg_left > 0) {
             bufferptr bp = data_blp.get_current_ptr();
             unsigned read = MIN(bp.length(), msg_left);
@@ -642,9 +646,17 @@ void AsyncConnection::process()
             if (r < 0) {
               ldout(async_msgr->cct, 1) << __func__ << " read data error " << dendl;
               goto fail;
-            } else if (r > 0) {
-              break;
             }
+            // checksum whatever arrived while it is still in cache rather
+            // than in a second pass over the whole payload at decode time
+            if (crc_data) {
+              unsigned filled = read - r;
+              data_crc = ceph_crc32c(data_crc, (unsigned char*)bp.c_str() + data_crc_off,
+                                     filled - data_crc_off);
+              data_crc_off = r > 0 ? filled : 0;
+            }
+            if (r > 0)
+              break;
 
             data_blp.advance(read);
             data.append(bp, 0, read);
@@ -696,7 +708,17 @@ void AsyncConnection::process()
 
           ldout(async_msgr->cct, 20) << __func__ << " got " << front.length() << " + " << middle.length()
                               << " + " << data.length() << " byte message" << dendl;
-          Message *message = decode_message(async_msgr->cct, async_msgr->crcflags, current_header, footer, front, middle, data);
+          int crcflags = async_msgr->crcflags;
+          if ((crcflags & MSG_CRC_DATA) && (footer.flags & CEPH_MSG_FOOTER_NOCRC) == 0) {
+            if (data_crc != footer.data_crc) {
+              ldout(async_msgr->cct, 0) << __func__ << " bad crc in data " << data_crc
+                                        << " != exp " << footer.data_crc << dendl;
+              goto fail;
+            }
+            // already verified while reading
+            crcflags &= ~MSG_CRC_DATA;
+          }
+          Message *message = decode_message(async_msgr->cct, crcflags, current_header, footer, front, middle, data);
           if (!message) {
             ldout(async_msgr->cct, 1) << __func__ << " decode message failed " << dendl;
             goto fail;
@@ -1669,6 +1691,7 @@ ssize_t AsyncConnection::handle_connect_msg(ceph_msg_connect &connect, bufferlis
 
     // Clean up output buffer
     existing->outcoming_bl.clear();
+    existing->corked_msgs = 0;
     if (existing->delay_state) {
       existing->delay_state->flush();
       assert(!delay_state);
@@ -1884,6 +1907,8 @@ int AsyncConnection::send_message(Message *m)
 
   m->get_header().src = async_msgr->get_myname();
   m->set_connection(this);
+  if (async_msgr->msg_latency)
+    m->set_send_stamp(ceph_clock_now());
 
   if (m->get_type() == CEPH_MSG_OSD_OP)
     OID_EVENT_TRACE_WITH_MSG(m, "SEND_MSG_OSD_OP_BEGIN", true);
@@ -1916,6 +1941,43 @@ int AsyncConnection::send_message(Message *m)
   if (can_fast_prepare)
     prepare_send_message(f, m, bl);
 
+  if (!async_msgr->cct->_conf->ms_async_send_inline) {
+    if (can_write == WriteStatus::CLOSED) {
+      ldout(async_msgr->cct, 10) << __func__ << " connection closed."
+                                 << " Drop message " << m << dendl;
+      m->put();
+      return 0;
+    }
+
+    pending_msg_t *p = new pending_msg_t{nullptr, m, std::move(bl), f};
+    pending_msg_t *head = out_pending.load(std::memory_order_relaxed);
+    do {
+      p->next = head;
+    } while (!out_pending.compare_exchange_weak(head, p));
+
+    // _stop() marks us CLOSED before it discards the queue, so if our
+    // push missed the discard we see CLOSED here and clean up ourselves.
+    // The first message of a batch wakes the worker, and does so under
+    // write_lock: cleanup() frees write_handler once CLOSED is visible
+    // there.  Whoever flips REPLACING to CANWRITE checks is_queued()
+    // after the store, so one side always sees the other.
+    WriteStatus ws = can_write;
+    if (!head || ws == WriteStatus::CLOSED) {
+      std::lock_guard<std::mutex> l(write_lock);
+      ws = can_write;
+      if (ws == WriteStatus::CLOSED) {
+        if (out_pending.load()) {
+          ldout(async_msgr->cct, 10) << __func__ << " connection closed, discarding pending" << dendl;
+          discard_out_queue();
+        }
+      } else if (!head && ws != WriteStatus::REPLACING) {
+        // later senders of the batch ride this wakeup
+        center->dispatch_event_external(write_handler);
+      }
+    }
+    return 0;
+  }
+
   std::lock_guard<std::mutex> l(write_lock);
   // "features" changes will change the payload encoding
   if (can_fast_prepare && (can_write == WriteStatus::NOWRITE || get_features() != f)) {
@@ -1925,7 +1987,7 @@ int AsyncConnection::send_message(Message *m)
     ldout(async_msgr->cct, 5) << __func__ << " clear encoded buffer previous "
                               << f << " != " << get_features() << dendl;
   }
-  if (!is_queued() && can_write == WriteStatus::CANWRITE && async_msgr->cct->_conf->ms_async_send_inline) {
+  if (!is_queued() && can_write == WriteStatus::CANWRITE) {
     if (!bl.length())
       prepare_send_message(get_features(), m, bl);
     logger->inc(l_msgr_send_messages_inline);
@@ -1947,6 +2009,37 @@ int AsyncConnection::send_message(Message *m)
   return 0;
 }
 
+void AsyncConnection::_drain_out_pending()
+{
+  pending_msg_t *p = out_pending.exchange(nullptr);
+  if (!p)
+    return;
+
+  // the stack is LIFO; restore submission order
+  pending_msg_t *fifo = nullptr;
+  while (p) {
+    pending_msg_t *next = p->next;
+    p->next = fifo;
+    fifo = p;
+    p = next;
+  }
+
+  while (fifo) {
+    pending_msg_t *next = fifo->next;
+    // "features" changes will change the payload encoding
+    if (fifo->bl.length() &&
+        (can_write == WriteStatus::NOWRITE || get_features() != fifo->features)) {
+      fifo->bl.clear();
+      fifo->m->get_payload().clear();
+      ldout(async_msgr->cct, 5) << __func__ << " clear encoded buffer previous "
+                                << fifo->features << " != " << get_features() << dendl;
+    }
+    out_q[fifo->m->get_priority()].emplace_back(std::move(fifo->bl), fifo->m);
+    delete fifo;
+    fifo = next;
+  }
+}
+
 void AsyncConnection::requeue_sent()
 {
   if (sent.empty())
@@ -1992,6 +2085,7 @@ void AsyncConnection::discard_out_queue()
 {
   ldout(async_msgr->cct, 10) << __func__ << " started" << dendl;
 
+  _drain_out_pending();
   for (list<Message*>::iterator p = sent.begin(); p != sent.end(); ++p) {
     ldout(async_msgr->cct, 20) << __func__ << " discard " << *p << dendl;
     (*p)->put();
@@ -2004,6 +2098,7 @@ void AsyncConnection::discard_out_queue()
     }
   out_q.clear();
   outcoming_bl.clear();
+  corked_msgs = 0;
 }
 
 int AsyncConnection::randomize_out_seq()
@@ -2053,6 +2148,7 @@ void AsyncConnection::fault()
   replacing = false;
   is_reset_from_peer = false;
   outcoming_bl.clear();
+  corked_msgs = 0;
   if (!once_ready && !is_queued() &&
       state >=STATE_ACCEPTING && state <= STATE_ACCEPTING_WAIT_CONNECT_MSG_AUTH) {
     ldout(async_msgr->cct, 0) << __func__ << " with nothing to send and in the half "
@@ -2137,6 +2233,8 @@ void AsyncConnection::_stop()
   ldout(async_msgr->cct, 2) << __func__ << dendl;
   std::lock_guard<std::mutex> l(write_lock);
 
+  // senders that push after this store see it and discard for themselves
+  can_write = WriteStatus::CLOSED;
   reset_recv_state();
   dispatch_queue->discard_queue(conn_id);
   discard_out_queue();
@@ -2145,7 +2243,6 @@ void AsyncConnection::_stop()
 
   state = STATE_CLOSED;
   open_write = false;
-  can_write = WriteStatus::CLOSED;
   state_offset = 0;
   // Make sure in-queue events will been processed
   center->dispatch_event_external(EventCallbackRef(new C_clean_handler(this)));
@@ -2232,7 +2329,7 @@ ssize_t AsyncConnection::write_message(Message *m, bufferlist& bl, bool more)
                              << " off " << header.data_off << dendl;
 
   if ((bl.length() <= ASYNC_COALESCE_THRESHOLD) && (bl.buffers().size() > 1)) {
-    std::list<buffer::ptr>::const_iterator pb;
+    buffer::list::buffers_t::const_iterator pb;
     for (pb = bl.buffers().begin(); pb != bl.buffers().end(); ++pb) {
       outcoming_bl.append((char*)pb->c_str(), pb->length());
     }
@@ -2260,7 +2357,20 @@ ssize_t AsyncConnection::write_message(Message *m, bufferlist& bl, bool more)
   logger->inc(l_msgr_send_bytes, outcoming_bl.length() - original_bl_len);
   ldout(async_msgr->cct, 20) << __func__ << " sending " << m->get_seq()
                              << " " << m << dendl;
-  ssize_t rc = _try_send(more);
+  if (!corked_msgs)
+    cork_stamp = ceph_clock_now();
+  ++corked_msgs;
+
+  ssize_t rc = 0;
+  if (more && outcoming_bl.length() < async_msgr->cct->_conf->ms_async_cork_bytes) {
+    // more messages are already queued; let the caller append them and
+    // send the whole batch with one syscall.  Nothing waits on a timer,
+    // so the only added latency is encoding the rest of the batch.
+    ldout(async_msgr->cct, 20) << __func__ << " corked " << corked_msgs
+                               << " messages " << outcoming_bl.length() << " bytes" << dendl;
+  } else {
+    rc = _try_send(more);
+  }
   if (rc < 0) {
     ldout(async_msgr->cct, 1) << __func__ << " error sending " << m << ", "
                               << cpp_strerror(rc) << dendl;
@@ -2269,6 +2379,8 @@ ssize_t AsyncConnection::write_message(Message *m, bufferlist& bl, bool more)
   } else {
     ldout(async_msgr->cct, 10) << __func__ << " sending " << m << " continuely." << dendl;
   }
+  if (rc >= 0 && async_msgr->msg_latency)
+    async_msgr->msg_latency->record_sent(this, m);
   if (m->get_type() == CEPH_MSG_OSD_OP)
     OID_EVENT_TRACE_WITH_MSG(m, "SEND_MSG_OSD_OP_END", false);
   else if (m->get_type() == CEPH_MSG_OSD_OPREPLY)
@@ -2309,11 +2421,12 @@ void AsyncConnection::reset_recv_state()
   }
   if (state > STATE_OPEN_MESSAGE_THROTTLE_DISPATCH_QUEUE &&
       state <= STATE_OPEN_MESSAGE_READ_FOOTER_AND_DISPATCH) {
+    int dclass = DispatchQueue::get_dispatch_class(current_header.type, current_header.priority);
     ldout(async_msgr->cct, 10) << __func__ << " releasing " << cur_msg_size
                                << " bytes to dispatch_queue throttler "
-                               << dispatch_queue->dispatch_throttler.get_current() << "/"
-                               << dispatch_queue->dispatch_throttler.get_max() << dendl;
-    dispatch_queue->dispatch_throttle_release(cur_msg_size);
+                               << dispatch_queue->get_dispatch_throttler(dclass).get_current() << "/"
+                               << dispatch_queue->get_dispatch_throttler(dclass).get_max() << dendl;
+    dispatch_queue->dispatch_throttle_release(cur_msg_size, dclass);
   }
 }
 
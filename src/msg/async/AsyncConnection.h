@@ -61,6 +61,7 @@ class AsyncConnection : public Connection {
   ssize_t _send(Message *m);
   void prepare_send_message(uint64_t features, Message *m, bufferlist &bl);
   ssize_t read_until(unsigned needed, char *p);
+  bufferptr alloc_rx_buffer(unsigned len, unsigned off);
   ssize_t _process_connection();
   void _connect();
   void _stop();
@@ -96,7 +97,7 @@ class AsyncConnection : public Connection {
     return 0;
   }
   bool is_queued() const {
-    return !out_q.empty() || outcoming_bl.length();
+    return !out_q.empty() || out_pending.load() || outcoming_bl.length();
   }
   void shutdown_socket() {
     for (auto &&t : register_time_events)
@@ -112,7 +113,9 @@ class AsyncConnection : public Connection {
       cs.close();
     }
   }
+  void _drain_out_pending();
   Message *_get_next_outgoing(bufferlist *bl) {
+    _drain_out_pending();
     Message *m = 0;
     while (!m && !out_q.empty()) {
       map<int, list<pair<bufferlist, Message*> > >::reverse_iterator it = out_q.rbegin();
@@ -129,7 +132,7 @@ class AsyncConnection : public Connection {
     return m;
   }
   bool _has_next_outgoing() const {
-    return !out_q.empty();
+    return !out_q.empty() || out_pending.load();
   }
   void reset_recv_state();
 
@@ -171,7 +174,7 @@ class AsyncConnection : public Connection {
         std::lock_guard<std::mutex> l(delay_lock);
         while (!delay_queue.empty()) {
           Message *m = delay_queue.front().second;
-          dispatch_queue->dispatch_throttle_release(m->get_dispatch_throttle_size());
+          dispatch_queue->dispatch_throttle_release(m);
           m->put();
           delay_queue.pop_front();
         }
@@ -314,8 +317,27 @@ class AsyncConnection : public Connection {
   std::atomic<WriteStatus> can_write;
   bool open_write;
   map<int, list<pair<bufferlist, Message*> > > out_q;  // priority queue for outbound msgs
+
+  /*
+   * Messages from send_message() are pushed onto this lock-free stack
+   * instead of out_q, so sending threads only take write_lock to wake the
+   * worker for the first message of a batch, or once closed.  The
+   * worker moves them into out_q in submission order, under write_lock,
+   * in _drain_out_pending().
+   */
+  struct pending_msg_t {
+    pending_msg_t *next;
+    Message *m;
+    bufferlist bl;        // payload if it was encoded by the sender
+    uint64_t features;    // features bl was encoded with
+  };
+  std::atomic<pending_msg_t*> out_pending;
   list<Message*> sent; // the first bufferlist need to inject seq
   bufferlist outcoming_bl;
+  // messages encoded into outcoming_bl since the last send syscall, and
+  // when the first of them was appended
+  unsigned corked_msgs = 0;
+  utime_t cork_stamp;
   bool keepalive;
 
   std::mutex lock;
@@ -344,6 +366,8 @@ class AsyncConnection : public Connection {
   ceph_msg_header current_header;
   bufferlist data_buf;
   bufferlist::iterator data_blp;
+  uint32_t data_crc;       // running crc32c of the data received so far
+  unsigned data_crc_off;   // bytes of the current data_blp ptr covered by data_crc
   bufferlist front, middle, data;
   ceph_msg_connect connect_msg;
   // Connecting state
@@ -387,6 +411,11 @@ class AsyncConnection : public Connection {
       dispatch_queue->queue_reset(this);
   }
   void cleanup() {
+    {
+      // a sender racing _stop() may have pushed after its discard
+      std::lock_guard<std::mutex> l(write_lock);
+      discard_out_queue();
+    }
     shutdown_socket();
     delete read_handler;
     delete write_handler;
@@ -19,8 +19,12 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
 
 #include <algorithm>
+#include <deque>
 
 #include "PosixStack.h"
 
@@ -37,11 +41,168 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "PosixStack "
 
+// MSG_ZEROCOPY appeared in linux 4.14; older libc headers may lack the
+// constants even when the running kernel supports them.
+#ifdef __linux__
+# define HAVE_MSG_ZEROCOPY 1
+# ifndef SO_ZEROCOPY
+#  define SO_ZEROCOPY 60
+# endif
+# ifndef MSG_ZEROCOPY
+#  define MSG_ZEROCOPY 0x4000000
+# endif
+# ifndef SO_EE_ORIGIN_ZEROCOPY
+#  define SO_EE_ORIGIN_ZEROCOPY 5
+# endif
+# ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#  define SO_EE_CODE_ZEROCOPY_COPIED 1
+# endif
+#endif
+
+/*
+ * MSG_ZEROCOPY transmit state.  The kernel numbers every successful
+ * zerocopy sendmsg() call on the socket starting from 0 and reports
+ * completed ranges of those numbers on the socket error queue.  Until
+ * a call's number is reported the pages it referenced must not be
+ * reused, so the sent bufferptrs stay pinned here.
+ */
+struct PosixZeroCopyState {
+  struct pending_t {
+    uint32_t first, last;   // inclusive range of sendmsg() numbers
+    uint32_t completed;
+    bufferlist bl;
+  };
+  uint32_t next_seq = 0;
+  uint64_t pinned_bytes = 0;
+  std::deque<pending_t> pending;
+
+  void complete(uint32_t lo, uint32_t hi) {
+    for (auto &p : pending) {
+      // sequence numbers wrap, compare as distances
+      uint32_t a = (int32_t)(lo - p.first) > 0 ? lo : p.first;
+      uint32_t b = (int32_t)(hi - p.last) < 0 ? hi : p.last;
+      if ((int32_t)(b - a) >= 0)
+        p.completed += b - a + 1;
+    }
+    while (!pending.empty() &&
+           pending.front().completed >= pending.front().last - pending.front().first + 1) {
+      pinned_bytes -= pending.front().bl.length();
+      pending.pop_front();
+    }
+  }
+
+  // drain completion notifications from fd's error queue; returns true
+  // if the kernel reported it had to copy a send anyway
+  bool reap(int fd) {
+    bool copied = false;
+#ifdef HAVE_MSG_ZEROCOPY
+    while (!pending.empty()) {
+      char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_in6))];
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (::recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        break;
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+            !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))
+          continue;
+        struct sock_extended_err *ee = (struct sock_extended_err*)CMSG_DATA(cm);
+        if (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY || ee->ee_errno != 0)
+          continue;
+        if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+          copied = true;
+        complete(ee->ee_info, ee->ee_data);
+      }
+    }
+#endif
+    return copied;
+  }
+};
+
+/*
+ * Owns the fd of a closed socket that still has zerocopy sends in
+ * flight.  The kernel only reports completions on the socket's own
+ * error queue, so the fd stays open (already shut down) and the pinned
+ * buffers stay referenced until every send is reported or
+ * ms_tcp_zerocopy_linger expires; then the socket is reset so nothing
+ * can still be reading the pages, and everything is released.
+ */
+class PosixZeroCopyLinger : public EventCallback {
+  class C_expire : public EventCallback {
+    PosixZeroCopyLinger *linger;
+   public:
+    explicit C_expire(PosixZeroCopyLinger *l) : linger(l) {}
+    void do_request(int id) override {
+      linger->timer_id = 0;
+      linger->finish(true);
+    }
+  };
+
+  CephContext *cct;
+  EventCenter *center;
+  int fd;
+  PosixZeroCopyState zc;
+  C_expire expire_cb;
+  uint64_t timer_id = 0;
+  bool armed = false;
+
+  void finish(bool reset) {
+    ldout(cct, 10) << __func__ << " fd " << fd << " " << zc.pending.size()
+                   << " zerocopy sends (" << zc.pinned_bytes << " bytes) still pending"
+                   << (reset ? ", resetting" : "") << dendl;
+    if (timer_id)
+      center->delete_time_event(timer_id);
+    center->delete_file_event(fd, EVENT_READABLE);
+    if (reset) {
+      struct linger l = {1, 0};
+      ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &l, sizeof(l));
+    }
+    ::close(fd);
+    delete this;
+  }
+
+ public:
+  PosixZeroCopyLinger(CephContext *c, EventCenter *ce, int f, PosixZeroCopyState &&z)
+    : cct(c), center(ce), fd(f), zc(std::move(z)), expire_cb(this) {}
+
+  void start() {
+    if (center->in_thread())
+      do_request(fd);
+    else
+      center->dispatch_event_external(this);
+  }
+
+  // EPOLLERR for new completions is reported as readable
+  void do_request(int id) override {
+    if (!armed) {
+      armed = true;
+      if (center->create_file_event(fd, EVENT_READABLE, this) < 0) {
+        finish(true);
+        return;
+      }
+      timer_id = center->create_time_event(
+        cct->_conf->ms_tcp_zerocopy_linger * 1000000, &expire_cb);
+    }
+    zc.reap(fd);
+    if (zc.pending.empty())
+      finish(false);
+  }
+};
+
 class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
+  CephContext *cct;
   NetHandler &handler;
   int _fd;
   entity_addr_t sa;
   bool connected;
+
+  EventCenter *center;
+  bool zerocopy = false;
+  uint64_t zerocopy_min_size = 0;
+  uint64_t zerocopy_max_pinned = 0;
+  PosixZeroCopyState zc;
 #if !defined(MSG_NOSIGNAL) && !defined(SO_NOSIGPIPE)
   sigset_t sigpipe_mask;
   bool sigpipe_pending;
@@ -49,8 +210,24 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 #endif
 
  public:
-  explicit PosixConnectedSocketImpl(NetHandler &h, const entity_addr_t &sa, int f, bool connected)
-      : handler(h), _fd(f), sa(sa), connected(connected) {}
+  explicit PosixConnectedSocketImpl(CephContext *c, NetHandler &h, EventCenter *ce,
+                                    const entity_addr_t &sa, int f, bool connected)
+      : cct(c), handler(h), _fd(f), sa(sa), connected(connected), center(ce) {
+#ifdef HAVE_MSG_ZEROCOPY
+    if (cct->_conf->ms_tcp_zerocopy) {
+      int on = 1;
+      if (::setsockopt(_fd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0) {
+        zerocopy = true;
+        zerocopy_min_size = cct->_conf->ms_tcp_zerocopy_min_size;
+        zerocopy_max_pinned = cct->_conf->ms_tcp_zerocopy_max_pinned;
+      } else {
+        int r = -errno;
+        ldout(cct, 1) << __func__ << " SO_ZEROCOPY not supported, using copying sends: "
+                      << cpp_strerror(r) << dendl;
+      }
+    }
+#endif
+  }
 
   int is_connected() override {
     if (connected)
@@ -72,6 +249,7 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
   }
 
   ssize_t read(char *buf, size_t len) override {
+    reap_completions();
     ssize_t r = ::read(_fd, buf, len);
     if (r < 0)
       r = -errno;
@@ -142,7 +320,10 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
 
   // return the sent length
   // < 0 means error occured
-  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more)
+  // *zc_calls is bumped for every successful sendmsg() made with
+  // MSG_ZEROCOPY in flags.
+  static ssize_t do_sendmsg(int fd, struct msghdr &msg, unsigned len, bool more,
+                            int flags, unsigned *zc_calls)
   {
     suppress_sigpipe();
 
@@ -150,9 +331,9 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     while (1) {
       ssize_t r;
   #if defined(MSG_NOSIGNAL)
-      r = ::sendmsg(fd, &msg, MSG_NOSIGNAL | (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, flags | MSG_NOSIGNAL | (more ? MSG_MORE : 0));
   #else
-      r = ::sendmsg(fd, &msg, (more ? MSG_MORE : 0));
+      r = ::sendmsg(fd, &msg, flags | (more ? MSG_MORE : 0));
   #endif /* defined(MSG_NOSIGNAL) */
 
       if (r < 0) {
@@ -160,10 +341,20 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
           continue;
         } else if (errno == EAGAIN) {
           break;
+  #ifdef HAVE_MSG_ZEROCOPY
+        } else if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+          // out of optmem for notifications; copy this one instead
+          flags &= ~MSG_ZEROCOPY;
+          continue;
+  #endif
         }
         return -errno;
       }
 
+  #ifdef HAVE_MSG_ZEROCOPY
+      if (flags & MSG_ZEROCOPY)
+        ++*zc_calls;
+  #endif
       sent += r;
       if (len == sent) break;
 
@@ -184,9 +375,30 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     return (ssize_t)sent;
   }
 
+  // EPOLLERR for zerocopy completions is reported as readable
+  void reap_completions() override {
+    if (zc.pending.empty())
+      return;
+    if (zc.reap(_fd) && zerocopy) {
+      // the kernel had to copy anyway (e.g. loopback, or a device
+      // without scatter-gather); pinning only costs us here.
+      ldout(cct, 10) << __func__ << " kernel copied zerocopy send, disabling on fd "
+                     << _fd << dendl;
+      zerocopy = false;
+    }
+  }
+
   ssize_t send(bufferlist &bl, bool more) override {
     size_t sent_bytes = 0;
-    std::list<bufferptr>::const_iterator pb = bl.buffers().begin();
+    int flags = 0;
+    unsigned zc_calls = 0;
+#ifdef HAVE_MSG_ZEROCOPY
+    reap_completions();
+    if (zerocopy && bl.length() >= zerocopy_min_size &&
+        zc.pinned_bytes < zerocopy_max_pinned)
+      flags = MSG_ZEROCOPY;
+#endif
+    bufferlist::buffers_t::const_iterator pb = bl.buffers().begin();
     uint64_t left_pbrs = bl.buffers().size();
     while (left_pbrs) {
       struct msghdr msg;
@@ -206,7 +418,7 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
         size--;
       }
 
-      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more);
+      ssize_t r = do_sendmsg(_fd, msg, msglen, left_pbrs || more, flags, &zc_calls);
       if (r < 0)
         return r;
 
@@ -217,7 +429,20 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
       // only "r" == 0 continue
     }
 
-    if (sent_bytes) {
+    if (sent_bytes && zc_calls) {
+      // keep the sent pages referenced until the kernel is done with them
+      PosixZeroCopyState::pending_t p;
+      p.first = zc.next_seq;
+      p.last = zc.next_seq + zc_calls - 1;
+      p.completed = 0;
+      if (sent_bytes < bl.length())
+        bl.splice(0, sent_bytes, &p.bl);
+      else
+        p.bl.swap(bl);
+      zc.next_seq += zc_calls;
+      zc.pinned_bytes += p.bl.length();
+      zc.pending.push_back(std::move(p));
+    } else if (sent_bytes) {
       bufferlist swapped;
       if (sent_bytes < bl.length()) {
         bl.splice(sent_bytes, bl.length()-sent_bytes, &swapped);
@@ -233,7 +458,16 @@ class PosixConnectedSocketImpl final : public ConnectedSocketImpl {
     ::shutdown(_fd, SHUT_RDWR);
   }
   void close() override {
-    ::close(_fd);
+    reap_completions();
+    if (zc.pending.empty()) {
+      ::close(_fd);
+      return;
+    }
+    // the device may still be reading pages we sent; completions only
+    // arrive on this socket, so keep it (and them) until they do
+    ::shutdown(_fd, SHUT_RDWR);
+    PosixZeroCopyLinger *linger = new PosixZeroCopyLinger(cct, center, _fd, std::move(zc));
+    linger->start();
   }
   int fd() const override {
     return _fd;
@@ -280,7 +514,7 @@ int PosixServerSocketImpl::accept(ConnectedSocket *sock, const SocketOptions &op
   }
   handler.set_priority(sd, opt.priority);
 
-  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(handler, *out, sd, true));
+  std::unique_ptr<PosixConnectedSocketImpl> csi(new PosixConnectedSocketImpl(w->cct, handler, &w->center, *out, sd, true));
   *sock = ConnectedSocket(std::move(csi));
   if (out)
     out->set_sockaddr((sockaddr*)&ss);
@@ -350,7 +584,7 @@ int PosixWorker::connect(const entity_addr_t &addr, const SocketOptions &opts, C
 
   net.set_priority(sd, opts.priority);
   *socket = ConnectedSocket(
-      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(net, addr, sd, !opts.nonblock)));
+      std::unique_ptr<PosixConnectedSocketImpl>(new PosixConnectedSocketImpl(cct, net, &center, addr, sd, !opts.nonblock)));
   return 0;
 }
 
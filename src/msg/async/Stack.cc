@@ -14,7 +14,10 @@
  *
  */
 
+#include <stdlib.h>
+
 #include "common/Cond.h"
+#include "common/deleter.h"
 #include "common/errno.h"
 #include "PosixStack.h"
 #ifdef HAVE_RDMA
@@ -31,6 +34,76 @@
 #undef dout_prefix
 #define dout_prefix *_dout << "stack "
 
+RxBufferPool::~RxBufferPool()
+{
+  for (auto &fl : free_list) {
+    free_buf_t *f = fl.load();
+    while (f) {
+      free_buf_t *next = f->next;
+      ::free(f);
+      f = next;
+    }
+  }
+}
+
+void RxBufferPool::put(unsigned c, char *p)
+{
+  uint64_t size = (uint64_t)CEPH_PAGE_SIZE * class_pages(c);
+  if (cached_bytes.fetch_add(size) + size > max_cached_bytes) {
+    cached_bytes -= size;
+    ::free(p);
+    return;
+  }
+  auto &fl = free_list[c];
+  free_buf_t *f = reinterpret_cast<free_buf_t*>(p);
+  f->next = fl.load(std::memory_order_relaxed);
+  while (!fl.compare_exchange_weak(f->next, f,
+                                   std::memory_order_release,
+                                   std::memory_order_relaxed))
+    ;
+}
+
+bufferptr RxBufferPool::get(unsigned len, unsigned off, bool *reused)
+{
+  *reused = false;
+  unsigned total = off + len;
+  unsigned pages = (total + CEPH_PAGE_SIZE - 1) / CEPH_PAGE_SIZE;
+
+  // small segments (message fronts, mostly) are not worth a page, and
+  // huge ones are rare enough not to cache
+  if (!max_cached_bytes || total < CEPH_PAGE_SIZE ||
+      pages > class_pages(NUM_CLASSES - 1)) {
+    if (!off)
+      return buffer::create(len);
+    return bufferptr(bufferptr(buffer::create_page_aligned(total)), off, len);
+  }
+
+  unsigned c = size_class(pages);
+  size_t size = (size_t)CEPH_PAGE_SIZE * class_pages(c);
+  auto &fl = free_list[c];
+  free_buf_t *f = fl.load(std::memory_order_acquire);
+  // only this thread pops, so f stays on the list until we take it
+  while (f && !fl.compare_exchange_weak(f, f->next,
+                                        std::memory_order_acquire,
+                                        std::memory_order_acquire))
+    ;
+  char *p;
+  if (f) {
+    cached_bytes -= size;
+    p = reinterpret_cast<char*>(f);
+    *reused = true;
+  } else {
+    void *m;
+    if (::posix_memalign(&m, CEPH_PAGE_SIZE, size))
+      throw std::bad_alloc();
+    p = (char*)m;
+  }
+  auto pool = shared_from_this();
+  bufferptr bp(buffer::claim_buffer(
+      total, p, make_deleter([pool, c, p]() { pool->put(c, p); })));
+  return bufferptr(bp, off, len);
+}
+
 std::function<void ()> NetworkStack::add_thread(unsigned i)
 {
   Worker *w = workers[i];
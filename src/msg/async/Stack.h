@@ -17,7 +17,12 @@
 #ifndef CEPH_MSG_ASYNC_STACK_H
 #define CEPH_MSG_ASYNC_STACK_H
 
+#include <memory>
+#include <mutex>
+
 #include "include/Spinlock.h"
+#include "include/buffer.h"
+#include "include/intarith.h"
 #include "common/perf_counters.h"
 #include "common/simple_spin.h"
 #include "msg/msg_types.h"
@@ -34,6 +39,9 @@ class ConnectedSocketImpl {
   virtual void shutdown() = 0;
   virtual void close() = 0;
   virtual int fd() const = 0;
+  // handle transmit completions reported out of band (e.g. on the
+  // socket error queue) without waiting for the next read or send
+  virtual void reap_completions() {}
 };
 
 class ConnectedSocket;
@@ -127,6 +135,11 @@ class ConnectedSocket {
     return _csi->fd();
   }
 
+  /// Processes transmit completions the stack reported out of band.
+  void reap_completions() {
+    _csi->reap_completions();
+  }
+
   explicit operator bool() const {
     return _csi.get();
   }
@@ -183,6 +196,67 @@ class ServerSocket {
 };
 /// @}
 
+/*
+ * Page-aligned receive buffers recycled per worker.
+ *
+ * Buffers are handed out as claim_buffer()s whose deleter puts the
+ * memory back on the free list of its size class, so a payload released
+ * by whichever thread drops the message still comes back here.  The
+ * deleters keep the pool alive until the last buffer is returned.
+ *
+ * Size classes step by a quarter of a power of two (1-4 pages, then 5,
+ * 6, 7, 8, 10, 12, 14, 16, 20, ... pages), so a segment wastes less
+ * than a quarter of its buffer.  Each class is an intrusive lock-free
+ * stack: any thread may put(), but only the owning worker's thread
+ * calls get(), and with a single popper the stack has no ABA hazard.
+ */
+class RxBufferPool : public std::enable_shared_from_this<RxBufferPool> {
+  // up to 1024 pages, 4MB with 4K pages
+  static const unsigned NUM_CLASSES = 36;
+
+  struct free_buf_t {
+    free_buf_t *next;
+  };
+
+  std::atomic<free_buf_t*> free_list[NUM_CLASSES];
+  std::atomic<uint64_t> cached_bytes = {0};
+  const uint64_t max_cached_bytes;
+
+  static unsigned size_class(unsigned pages) {
+    if (pages <= 4)
+      return pages - 1;
+    // pages - 1 is in [4 << s, 8 << s), rounded up to steps of 1 << s
+    unsigned s = cbits(pages - 1) - 3;
+    return 4 * s + ((pages - 1) >> s);
+  }
+  static unsigned class_pages(unsigned c) {
+    if (c < 4)
+      return c + 1;
+    unsigned s = c / 4 - 1;
+    return (c % 4 + 5) << s;
+  }
+
+  void put(unsigned c, char *p);
+
+ public:
+  explicit RxBufferPool(uint64_t max_bytes) : max_cached_bytes(max_bytes) {
+    for (auto &fl : free_list)
+      fl = nullptr;
+  }
+  ~RxBufferPool();
+
+  /**
+   * get a buffer for a len byte segment
+   *
+   * Must only be called from the owning worker's thread.
+   *
+   * @param off   in-page offset the segment should start at, so that
+   *              payloads land page aligned relative to their object offset
+   * @param reused set to whether the memory came from the pool
+   */
+  bufferptr get(unsigned len, unsigned off, bool *reused);
+};
+
 class NetworkStack;
 
 enum {
@@ -194,6 +268,10 @@ enum {
   l_msgr_send_bytes,
   l_msgr_created_connections,
   l_msgr_active_connections,
+  l_msgr_recv_buffer_alloc,
+  l_msgr_recv_buffer_reuse,
+  l_msgr_send_msgs_per_syscall,
+  l_msgr_send_cork_lat,
   l_msgr_last,
 };
 
@@ -211,24 +289,33 @@ class Worker {
 
   std::atomic_uint references;
   EventCenter center;
+  std::shared_ptr<RxBufferPool> rx_buffer_pool;
 
   Worker(const Worker&) = delete;
   Worker& operator=(const Worker&) = delete;
 
   Worker(CephContext *c, unsigned i)
-    : cct(c), perf_logger(NULL), id(i), references(0), center(c) {
+    : cct(c), perf_logger(NULL), id(i), references(0), center(c),
+      rx_buffer_pool(std::make_shared<RxBufferPool>(c->_conf->ms_async_rx_buffer_pool_bytes)) {
     char name[128];
     sprintf(name, "AsyncMessenger::Worker-%u", id);
     // initialize perf_logger
     PerfCountersBuilder plb(cct, name, l_msgr_first, l_msgr_last);
 
+    // send_message() callers bump these from any thread
+    plb.set_sharded(true);
     plb.add_u64_counter(l_msgr_recv_messages, "msgr_recv_messages", "Network received messages");
     plb.add_u64_counter(l_msgr_send_messages, "msgr_send_messages", "Network sent messages");
     plb.add_u64_counter(l_msgr_send_messages_inline, "msgr_send_messages_inline", "Network sent inline messages");
     plb.add_u64_counter(l_msgr_recv_bytes, "msgr_recv_bytes", "Network received bytes");
     plb.add_u64_counter(l_msgr_send_bytes, "msgr_send_bytes", "Network received bytes");
+    plb.set_sharded(false);
     plb.add_u64_counter(l_msgr_active_connections, "msgr_active_connections", "Active connection number");
     plb.add_u64_counter(l_msgr_created_connections, "msgr_created_connections", "Created connection number");
+    plb.add_u64_counter(l_msgr_recv_buffer_alloc, "msgr_recv_buffer_alloc", "Receive buffers freshly allocated");
+    plb.add_u64_counter(l_msgr_recv_buffer_reuse, "msgr_recv_buffer_reuse", "Receive buffers reused from the pool");
+    plb.add_u64_avg(l_msgr_send_msgs_per_syscall, "msgr_send_msgs_per_syscall", "Messages sent per send syscall");
+    plb.add_time_avg(l_msgr_send_cork_lat, "msgr_send_cork_lat", "Time messages wait to be batched into one send");
 
     perf_logger = plb.create_perf_counters();
     cct->get_perfcounters_collection()->add(perf_logger);
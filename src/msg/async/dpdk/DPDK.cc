@@ -646,6 +646,8 @@ DPDKQueuePair::DPDKQueuePair(CephContext *c, EventCenter *cen, DPDKDevice* dev,
   plb.add_u64_counter(l_dpdk_qp_rx_linearize_ops, "dpdk_receive_linearize_ops", "DPDK received linearize operations");
   plb.add_u64_counter(l_dpdk_qp_tx_linearize_ops, "dpdk_send_linearize_ops", "DPDK send linearize operations");
   plb.add_u64_counter(l_dpdk_qp_tx_queue_length, "dpdk_send_queue_length", "DPDK send queue length");
+  plb.add_u64_counter(l_dpdk_qp_rx_forwarded, "dpdk_receive_forwarded", "DPDK received packets handed to another core");
+  plb.add_u64_counter(l_dpdk_qp_rx_forward_dropped, "dpdk_receive_forward_dropped", "DPDK received packets dropped because the target core was backlogged");
 
   perf_logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perf_logger);
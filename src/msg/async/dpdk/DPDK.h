@@ -93,6 +93,8 @@ enum {
   l_dpdk_qp_rx_linearize_ops,
   l_dpdk_qp_tx_linearize_ops,
   l_dpdk_qp_tx_queue_length,
+  l_dpdk_qp_rx_forwarded,
+  l_dpdk_qp_rx_forward_dropped,
   l_dpdk_qp_last
 };
 
@@ -556,6 +558,7 @@ class DPDKQueuePair {
 
   DPDKDevice& port() const { return *_dev; }
   tx_buf* get_tx_buf() { return _tx_buf_factory.get(); }
+  PerfCounters *get_perf_counter() { return perf_logger; }
 
   void handle_stats();
 
@@ -894,7 +897,6 @@ class DPDKDevice {
     if (!qp._sw_reta)
       return src_cpuid;
 
-    assert(!qp._sw_reta);
     auto hash = hashfn() >> _rss_table_bits;
     auto& reta = *qp._sw_reta;
     return reta[hash % reta.size()];
@@ -810,6 +810,11 @@ typename tcp<InetTraits>::connection tcp<InetTraits>::connect(const entity_addr_
   auto dst_ip = ipv4_address(addr);
   auto dst_port = addr.get_port();
 
+  // Pick a source port whose RSS hash steers the replies back to this
+  // core, so every packet of the connection is handled where its tcb
+  // lives and nothing needs forwarding.  Give up on affinity rather than
+  // spin forever if the redirection table never points at us.
+  unsigned tries = 0;
   do {
     src_port = _port_dist(_e);
     id = connid{src_ip, dst_ip, src_port, (uint16_t)dst_port};
@@ -818,6 +823,8 @@ typename tcp<InetTraits>::connection tcp<InetTraits>::connect(const entity_addr_
           _inet._inet.netif()->hash2cpu(
               id.hash(_inet._inet.netif()->rss_key())) == center->get_id())
         break;
+      if (++tries >= 65536)
+        break;
     }
   } while (true);
 
@@ -23,6 +23,7 @@
 
 #include "DPDK.h"
 #include "dpdk_rte.h"
+#include "include/str_list.h"
 
 namespace dpdk {
 
@@ -97,6 +98,12 @@ namespace dpdk {
       args.push_back(string2vector("--file-prefix"));
       args.push_back(string2vector(rte_file_prefix));
 
+      // e.g. a virtio-user or tap vdev, to run without a dedicated NIC
+      std::vector<std::string> extra;
+      get_str_vec(c->_conf->ms_dpdk_eal_args, " \t", extra);
+      for (auto &a : extra)
+        args.push_back(string2vector(a));
+
       std::vector<char*> cargs;
 
       for (auto&& a: args) {
@@ -122,11 +122,15 @@ class C_handle_l2forward : public EventCallback {
 void interface::forward(EventCenter *source, unsigned target, Packet p) {
   static __thread unsigned queue_depth;
 
+  PerfCounters *logger = _dev->queue_for_cpu(source->get_id()).get_perf_counter();
   if (queue_depth < 1000) {
     queue_depth++;
+    logger->inc(l_dpdk_qp_rx_forwarded);
     // FIXME: need ensure this event not be called after EventCenter destruct
     _dev->workers[target]->center.dispatch_event_external(
         new C_handle_l2forward(_dev, queue_depth, std::move(p.free_on_cpu(source)), target));
+  } else {
+    logger->inc(l_dpdk_qp_rx_forward_dropped);
   }
 }
 
@@ -23,7 +23,6 @@
 #define dout_prefix *_dout << "Infiniband "
 
 static const uint32_t MAX_SHARED_RX_SGE_COUNT = 1;
-static const uint32_t MAX_INLINE_DATA = 0;
 static const uint32_t TCP_MSG_LEN = sizeof("0000:00000000:00000000:00000000:00000000000000000000000000000000");
 static const uint32_t CQ_DEPTH = 30000;
 
@@ -162,6 +161,7 @@ Infiniband::QueuePair::QueuePair(
   initial_psn(0),
   max_send_wr(max_send_wr),
   max_recv_wr(max_recv_wr),
+  max_inline_data(0),
   q_key(q_key),
   dead(false)
 {
@@ -183,11 +183,17 @@ int Infiniband::QueuePair::init()
   qpia.srq = srq;                      // use the same shared receive queue
   qpia.cap.max_send_wr  = max_send_wr; // max outstanding send requests
   qpia.cap.max_send_sge = 1;           // max send scatter-gather elements
-  qpia.cap.max_inline_data = MAX_INLINE_DATA;          // max bytes of immediate data on send q
+  qpia.cap.max_inline_data = cct->_conf->ms_async_rdma_inline_size; // max bytes of immediate data on send q
   qpia.qp_type = type;                 // RC, UC, UD, or XRC
   qpia.sq_sig_all = 0;                 // only generate CQEs on requested WQEs
 
   qp = ibv_create_qp(pd, &qpia);
+  if (qp == NULL && qpia.cap.max_inline_data) {
+    ldout(cct, 1) << __func__ << " device refused " << qpia.cap.max_inline_data
+                  << " bytes of inline data, disabling inline sends" << dendl;
+    qpia.cap.max_inline_data = 0;
+    qp = ibv_create_qp(pd, &qpia);
+  }
   if (qp == NULL) {
     lderr(cct) << __func__ << " failed to create queue pair" << cpp_strerror(errno) << dendl;
     if (errno == ENOMEM) {
@@ -198,8 +204,10 @@ int Infiniband::QueuePair::init()
     return -1;
   }
 
+  // the device may round the inline size up
+  max_inline_data = qpia.cap.max_inline_data;
   ldout(cct, 20) << __func__ << " successfully create queue pair: "
-                 << "qp=" << qp << dendl;
+                 << "qp=" << qp << " max_inline_data=" << max_inline_data << dendl;
 
   // move from RESET to INIT state
   ibv_qp_attr qpa;
@@ -647,6 +655,92 @@ int Infiniband::MemoryManager::Cluster::get_buffers(std::vector<Chunk*> &chunks,
 }
 
 
+Infiniband::MemoryManager::RegCache::RegCache(ProtectionDomain *p, uint64_t max)
+  : pd(p), max_bytes(max), lock("RegCache::lock")
+{
+}
+
+Infiniband::MemoryManager::RegCache::~RegCache()
+{
+  for (auto t : txs)
+    delete t;
+  for (auto &e : entries)
+    ibv_dereg_mr(e.second.mr);
+}
+
+/**
+ * Look up (or create) the registration covering bp and take a reference on
+ * it for one send work request.
+ *
+ * \param[out] miss
+ *      set to true if bp's buffer had to be registered.
+ * \return
+ *      a Tx to be used as the wr_id, or NULL if the buffer could not be
+ *      registered and must be copied instead.
+ */
+Infiniband::MemoryManager::RegCache::Tx* Infiniband::MemoryManager::RegCache::get(
+    const bufferptr &bp, bool *miss)
+{
+  const char *base = bp.raw_c_str();
+  Mutex::Locker l(lock);
+  auto it = entries.find(base);
+  *miss = it == entries.end();
+  if (*miss) {
+    // senders only need local read access, which also works for read-only
+    // pages such as static buffers
+    ibv_mr *mr = ibv_reg_mr(pd->pd, const_cast<char*>(base), bp.raw_length(), 0);
+    if (!mr)
+      return NULL;
+    lru.push_front(base);
+    it = entries.emplace(base, Entry{bp, mr, 0, lru.begin()}).first;
+    bytes += bp.raw_length();
+  } else {
+    lru.splice(lru.begin(), lru, it->second.lru_pos);
+  }
+  ++it->second.inflight;
+  if (*miss)
+    trim();
+  Tx *t = new Tx{bp, &it->second};
+  txs.insert(t);
+  return t;
+}
+
+/**
+ * Release the reference taken by get() once the work request completed.
+ *
+ * \return
+ *      false if wr_id is not a zero copy send of this cache.
+ */
+bool Infiniband::MemoryManager::RegCache::put(uint64_t wr_id)
+{
+  Tx *t = reinterpret_cast<Tx*>(wr_id);
+  Mutex::Locker l(lock);
+  if (!txs.erase(t))
+    return false;
+  assert(t->entry->inflight > 0);
+  --t->entry->inflight;
+  delete t;
+  trim();
+  return true;
+}
+
+void Infiniband::MemoryManager::RegCache::trim()
+{
+  assert(lock.is_locked());
+  auto p = lru.end();
+  while (bytes > max_bytes && p != lru.begin()) {
+    --p;
+    auto e = entries.find(*p);
+    assert(e != entries.end());
+    if (e->second.inflight)
+      continue;
+    ibv_dereg_mr(e->second.mr);
+    bytes -= e->second.pin.raw_length();
+    entries.erase(e);
+    p = lru.erase(p);
+  }
+}
+
 Infiniband::MemoryManager::MemoryManager(Device *d, ProtectionDomain *p, bool hugepage)
   : device(d), pd(p)
 {
@@ -655,6 +749,7 @@ Infiniband::MemoryManager::MemoryManager(Device *d, ProtectionDomain *p, bool hu
 
 Infiniband::MemoryManager::~MemoryManager()
 {
+  delete reg_cache;
   if (channel)
     delete channel;
   if (send)
@@ -705,6 +800,12 @@ void Infiniband::MemoryManager::return_tx(std::vector<Chunk*> &chunks)
   }
 }
 
+void Infiniband::MemoryManager::create_reg_cache(uint64_t max_bytes)
+{
+  assert(!reg_cache);
+  reg_cache = new RegCache(pd, max_bytes);
+}
+
 int Infiniband::MemoryManager::get_send_buffers(std::vector<Chunk*> &c, size_t bytes)
 {
   return send->get_buffers(c, bytes);
@@ -748,6 +849,8 @@ Infiniband::Infiniband(CephContext *cct, const std::string &device_name, uint8_t
                                      cct->_conf->ms_async_rdma_enable_hugepage);
   memory_manager->register_rx_tx(
       cct->_conf->ms_async_rdma_buffer_size, max_recv_wr, max_send_wr);
+  if (cct->_conf->ms_async_rdma_zero_copy)
+    memory_manager->create_reg_cache(cct->_conf->ms_async_rdma_reg_cache_bytes);
 
   srq = create_shared_receive_queue(max_recv_wr, MAX_SHARED_RX_SGE_COUNT);
   post_channel_cluster();
@@ -795,6 +898,9 @@ int Infiniband::recall_chunk(Chunk* c)
     v.push_back(c);
     memory_manager->return_tx(v);  
     return 2;
+  } else if (memory_manager->get_reg_cache() &&
+             memory_manager->get_reg_cache()->put(reinterpret_cast<uint64_t>(c))) {
+    return 3;
   }
   return -1;
 }
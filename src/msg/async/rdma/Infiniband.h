@@ -19,9 +19,13 @@
 
 #include <infiniband/verbs.h>
 
+#include <list>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
+#include "include/buffer.h"
 #include "include/int_types.h"
 #include "include/page.h"
 #include "common/debug.h"
@@ -182,6 +186,43 @@ class Infiniband {
       char* base;
     };
 
+    // Registrations of caller-owned send buffers, so that large bufferptrs
+    // can be posted from their own memory instead of being copied into tx
+    // chunks.  The whole raw buffer behind a bufferptr is registered once and
+    // pinned by holding a reference to it; entries are kept in LRU order and
+    // idle ones are deregistered once more than max_bytes are registered.
+    class RegCache {
+     public:
+      struct Entry {
+        bufferptr pin;
+        ibv_mr* mr;
+        uint32_t inflight;     // posted work requests using mr
+        std::list<const char*>::iterator lru_pos;
+      };
+      // wr_id of a zero copy send, alive until its completion
+      struct Tx {
+        bufferptr bp;
+        Entry* entry;
+      };
+
+      RegCache(ProtectionDomain *p, uint64_t max);
+      ~RegCache();
+
+      Tx* get(const bufferptr &bp, bool *miss);
+      bool put(uint64_t wr_id);
+
+     private:
+      void trim();
+
+      ProtectionDomain *pd;
+      uint64_t max_bytes;
+      uint64_t bytes = 0;
+      Mutex lock;
+      std::map<const char*, Entry> entries;
+      std::list<const char*> lru;    // most recently used first
+      std::set<Tx*> txs;
+    };
+
     MemoryManager(Device *d, ProtectionDomain *p, bool hugepage);
     ~MemoryManager();
 
@@ -193,12 +234,15 @@ class Infiniband {
     int get_channel_buffers(std::vector<Chunk*> &chunks, size_t bytes);
     int is_tx_chunk(Chunk* c) { return send->all_chunks.count(c);}
     int is_rx_chunk(Chunk* c) { return channel->all_chunks.count(c);}
+    void create_reg_cache(uint64_t max_bytes);
+    RegCache* get_reg_cache() { return reg_cache; }
 
     bool enabled_huge_page;
 
    private:
     Cluster* channel;//RECV
     Cluster* send;// SEND
+    RegCache* reg_cache = nullptr;
     Device *device;
     ProtectionDomain *pd;
   };
@@ -311,6 +355,11 @@ class Infiniband {
      */
     bool is_error() const;
     ibv_qp* get_qp() const { return qp; }
+    /**
+     * Largest send that may be posted with IBV_SEND_INLINE, as granted by
+     * the device when the QueuePair was created.
+     */
+    uint32_t get_max_inline_data() const { return max_inline_data; }
     Infiniband::CompletionQueue* get_tx_cq() const { return txcq; }
     Infiniband::CompletionQueue* get_rx_cq() const { return rxcq; }
     int to_dead();
@@ -330,6 +379,7 @@ class Infiniband {
     uint32_t     initial_psn;    // initial packet sequence number
     uint32_t     max_send_wr;
     uint32_t     max_recv_wr;
+    uint32_t     max_inline_data;
     uint32_t     q_key;
     bool dead;
   };
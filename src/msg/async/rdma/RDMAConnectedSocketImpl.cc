@@ -411,32 +411,107 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
   if (!bytes)
     return 0;
 
-  int ret = worker->reserve_message_buffer(this, tx_buffers, bytes);
-  if (ret == 0) {
-    ldout(cct, 1) << __func__ << " no enough buffers in worker " << worker << dendl;
-    worker->perf_logger->inc(l_msgr_rdma_tx_no_mem);
-    return -EAGAIN; // that is ok , cause send will return bytes. == 0 enough buffers, < 0 no buffer, >0 not enough
+  // Buffers of at least ms_async_rdma_zero_copy_min_size are posted from
+  // their own memory, in pieces no larger than the peer's receive chunks;
+  // everything else is copied into tx chunks.  Work requests keep the order
+  // of pending_bl, so a partly filled chunk is closed before each zero copy
+  // piece and every run of copied buffers starts in a fresh chunk.
+  RegCache *reg_cache = infiniband->get_memory_manager()->get_reg_cache();
+  const uint32_t chunk_size = cct->_conf->ms_async_rdma_buffer_size;
+  const bufferlist::buffers_t &bufs = pending_bl.buffers();
+  std::vector<std::vector<ZeroCopyTx*> > zc;
+  if (reg_cache)
+    zc.resize(bufs.size());
+  size_t copy_bytes = 0, run = 0;
+  unsigned idx = 0;
+  for (auto it = bufs.begin(); it != bufs.end(); ++it, ++idx) {
+    if (reg_cache && it->length() >= cct->_conf->ms_async_rdma_zero_copy_min_size) {
+      for (unsigned off = 0; off < it->length(); off += chunk_size) {
+        bool miss;
+        ZeroCopyTx *t = reg_cache->get(
+            bufferptr(*it, off, MIN(chunk_size, it->length() - off)), &miss);
+        if (!t)
+          break;  // cannot be registered, copy it
+        if (miss)
+          worker->perf_logger->inc(l_msgr_rdma_reg_cache_miss);
+        zc[idx].push_back(t);
+      }
+      if (!zc[idx].empty()) {
+        copy_bytes += ROUND_UP_TO(run, chunk_size);
+        run = 0;
+        continue;
+      }
+    }
+    run += it->length();
+  }
+  copy_bytes += ROUND_UP_TO(run, chunk_size);
+
+  if (copy_bytes) {
+    int ret = worker->reserve_message_buffer(this, tx_buffers, copy_bytes);
+    if (ret == 0) {
+      ldout(cct, 1) << __func__ << " no enough buffers in worker " << worker << dendl;
+      worker->perf_logger->inc(l_msgr_rdma_tx_no_mem);
+      for (auto &v : zc)
+        for (auto t : v)
+          reg_cache->put(reinterpret_cast<uint64_t>(t));
+      return -EAGAIN; // that is ok , cause send will return bytes. == 0 enough buffers, < 0 no buffer, >0 not enough
+    }
   }
+
+  std::vector<ibv_sge> sges;
+  std::vector<uint64_t> wr_ids;
+  unsigned num_chunks = 0, num_zc = 0;
+  uint64_t zc_bytes = 0;
+  auto close_chunk = [&](Chunk *c) {
+    sges.push_back(ibv_sge{reinterpret_cast<uint64_t>(c->buffer), c->get_offset(), c->mr->lkey});
+    wr_ids.push_back(reinterpret_cast<uint64_t>(c));
+    ++num_chunks;
+  };
   vector<Chunk*>::iterator current_buffer = tx_buffers.begin();
-  list<bufferptr>::const_iterator it = pending_bl.buffers().begin();
   unsigned total = 0;
-  while (it != pending_bl.buffers().end()) {
+  idx = 0;
+  for (auto it = bufs.begin(); it != bufs.end(); ++it, ++idx) {
+    if (!zc.empty() && !zc[idx].empty()) {
+      if (current_buffer != tx_buffers.end() && (*current_buffer)->get_offset())
+        close_chunk(*current_buffer++);
+      for (auto t : zc[idx]) {
+        sges.push_back(ibv_sge{reinterpret_cast<uint64_t>(t->bp.c_str()), t->bp.length(),
+                               t->entry->mr->lkey});
+        wr_ids.push_back(reinterpret_cast<uint64_t>(t));
+        total += t->bp.length();
+        zc_bytes += t->bp.length();
+        ++num_zc;
+      }
+      zc[idx].clear();
+      continue;
+    }
     const uintptr_t addr = reinterpret_cast<const uintptr_t>(it->c_str());
     unsigned copied = 0;
     while (copied < it->length()) {
+      if (current_buffer == tx_buffers.end())
+        goto sending;
       uint32_t r = (*current_buffer)->write((char*)addr+copied, it->length() - copied);
       copied += r;
       total += r;
-      if ((*current_buffer)->full()){
-        ++current_buffer;
-        if (current_buffer == tx_buffers.end())
-          goto sending;
-      }
+      if ((*current_buffer)->full())
+        close_chunk(*current_buffer++);
     }
-    ++it;
   }
 
  sending:
+  if (current_buffer != tx_buffers.end() && (*current_buffer)->get_offset())
+    close_chunk(*current_buffer++);
+  if (current_buffer != tx_buffers.end()) {
+    std::vector<Chunk*> unused(current_buffer, tx_buffers.end());
+    dispatcher->inflight -= unused.size();
+    infiniband->get_memory_manager()->return_tx(unused);
+  }
+  // pieces behind a partial copy are posted by a later submit
+  for (auto &v : zc)
+    for (auto t : v)
+      reg_cache->put(reinterpret_cast<uint64_t>(t));
+  dispatcher->inflight += num_zc;
+
   assert(total <= pending_bl.length());
   bufferlist swapped;
   if (total < pending_bl.length()) {
@@ -450,62 +525,66 @@ ssize_t RDMAConnectedSocketImpl::submit(bool more)
   ldout(cct, 20) << __func__ << " left bytes: " << pending_bl.length() << " in buffers "
                  << pending_bl.buffers().size() << dendl;
 
-  int r = post_work_request(tx_buffers);
+  int r = post_work_request(sges, wr_ids);
   if (r < 0)
     return r;
 
+  worker->perf_logger->inc(l_msgr_rdma_tx_chunks, num_chunks);
+  worker->perf_logger->inc(l_msgr_rdma_tx_zero_copy_bytes, zc_bytes);
   ldout(cct, 20) << __func__ << " finished sending " << bytes << " bytes." << dendl;
   return bytes;
 }
 
-int RDMAConnectedSocketImpl::post_work_request(std::vector<Chunk*> &tx_buffers)
+int RDMAConnectedSocketImpl::post_work_request(std::vector<ibv_sge> &sges,
+                                               std::vector<uint64_t> &wr_ids)
 {
-  ldout(cct, 20) << __func__ << " QP: " << my_msg.qpn << " " << tx_buffers[0] << dendl;
-  vector<Chunk*>::iterator current_buffer = tx_buffers.begin();
-  ibv_sge isge[tx_buffers.size()];
-  uint32_t current_sge = 0;
-  ibv_send_wr iswr[tx_buffers.size()];
-  uint32_t current_swr = 0;
+  ldout(cct, 20) << __func__ << " QP: " << my_msg.qpn << " " << wr_ids[0] << dendl;
+  ibv_send_wr iswr[sges.size()];
   ibv_send_wr* pre_wr = NULL;
+  const uint32_t max_inline = qp->get_max_inline_data();
 
   memset(iswr, 0, sizeof(iswr));
-  memset(isge, 0, sizeof(isge));
-  current_buffer = tx_buffers.begin();
-  while (current_buffer != tx_buffers.end()) {
-    isge[current_sge].addr = reinterpret_cast<uint64_t>((*current_buffer)->buffer);
-    isge[current_sge].length = (*current_buffer)->get_offset();
-    isge[current_sge].lkey = (*current_buffer)->mr->lkey;
-    ldout(cct, 25) << __func__ << " sending buffer: " << *current_buffer << " length: " << isge[current_sge].length  << dendl;
-
-    iswr[current_swr].wr_id = reinterpret_cast<uint64_t>(*current_buffer);
-    iswr[current_swr].next = NULL;
-    iswr[current_swr].sg_list = &isge[current_sge];
-    iswr[current_swr].num_sge = 1;
-    iswr[current_swr].opcode = IBV_WR_SEND;
-    iswr[current_swr].send_flags = IBV_SEND_SIGNALED;
-    /*if (isge[current_sge].length < infiniband->max_inline_data) {
-      iswr[current_swr].send_flags = IBV_SEND_INLINE;
-      ldout(cct, 20) << __func__ << " send_inline." << dendl;
-      }*/
-
-    worker->perf_logger->inc(l_msgr_rdma_tx_bytes, isge[current_sge].length);
+  for (size_t i = 0; i < sges.size(); ++i) {
+    ldout(cct, 25) << __func__ << " sending buffer: " << wr_ids[i] << " length: " << sges[i].length  << dendl;
+
+    iswr[i].wr_id = wr_ids[i];
+    iswr[i].next = NULL;
+    iswr[i].sg_list = &sges[i];
+    iswr[i].num_sge = 1;
+    iswr[i].opcode = IBV_WR_SEND;
+    iswr[i].send_flags = IBV_SEND_SIGNALED;
+    // small sends are copied into the work request, so the device need not
+    // read the chunk back over the bus; the chunk is still returned on
+    // completion
+    if (sges[i].length <= max_inline) {
+      iswr[i].send_flags |= IBV_SEND_INLINE;
+      worker->perf_logger->inc(l_msgr_rdma_tx_inline_chunks);
+    }
+
+    worker->perf_logger->inc(l_msgr_rdma_tx_bytes, sges[i].length);
     if (pre_wr)
-      pre_wr->next = &iswr[current_swr];
-    pre_wr = &iswr[current_swr];
-    ++current_sge;
-    ++current_swr;
-    ++current_buffer;
+      pre_wr->next = &iswr[i];
+    pre_wr = &iswr[i];
   }
 
   ibv_send_wr *bad_tx_work_request;
   if (ibv_post_send(qp->get_qp(), iswr, &bad_tx_work_request)) {
+    int r = -errno;
     ldout(cct, 1) << __func__ << " failed to send data"
                   << " (most probably should be peer not ready): "
-                  << cpp_strerror(errno) << dendl;
+                  << cpp_strerror(r) << dendl;
     worker->perf_logger->inc(l_msgr_rdma_tx_failed);
-    return -errno;
+    // work requests from the bad one on were not posted
+    RegCache *reg_cache = infiniband->get_memory_manager()->get_reg_cache();
+    std::vector<Chunk*> unposted;
+    for (ibv_send_wr *w = bad_tx_work_request; w; w = w->next) {
+      if (!reg_cache || !reg_cache->put(w->wr_id))
+        unposted.push_back(reinterpret_cast<Chunk*>(w->wr_id));
+      --dispatcher->inflight;
+    }
+    infiniband->get_memory_manager()->return_tx(unposted);
+    return r;
   }
-  worker->perf_logger->inc(l_msgr_rdma_tx_chunks, tx_buffers.size());
   ldout(cct, 20) << __func__ << " qp state is : " << Infiniband::qp_state_string(qp->get_state()) << dendl;
   return 0;
 }
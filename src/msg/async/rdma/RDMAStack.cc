@@ -343,6 +343,10 @@ RDMAWorker::RDMAWorker(CephContext *c, unsigned i)
   plb.add_u64_counter(l_msgr_rdma_rx_chunks, "rx_chunks", "The number of rx chunks transmitted");
   plb.add_u64_counter(l_msgr_rdma_rx_bytes, "rx_bytes", "The bytes of rx chunks transmitted");
 
+  plb.add_u64_counter(l_msgr_rdma_tx_inline_chunks, "tx_inline_chunks", "The number of tx chunks sent inline");
+  plb.add_u64_counter(l_msgr_rdma_tx_zero_copy_bytes, "tx_zero_copy_bytes", "The bytes sent without copying into tx chunks");
+  plb.add_u64_counter(l_msgr_rdma_reg_cache_miss, "reg_cache_miss", "The number of buffers registered for zero copy send");
+
   perf_logger = plb.create_perf_counters();
   cct->get_perfcounters_collection()->add(perf_logger);
 }
@@ -485,6 +489,7 @@ void RDMAWorker::handle_tx_event()
   std::vector<Chunk*> tx_chunks;
   std::vector<ibv_wc> cqe;
   get_wc(cqe);
+  MemoryManager::RegCache *reg_cache = memory_manager->get_reg_cache();
 
   for (size_t i = 0; i < cqe.size(); ++i) {
     ibv_wc* response = &cqe[i];
@@ -518,6 +523,8 @@ void RDMAWorker::handle_tx_event()
     //assert(memory_manager->is_tx_chunk(chunk));
     if (memory_manager->is_tx_chunk(chunk)) {
       tx_chunks.push_back(chunk);
+    } else if (reg_cache && reg_cache->put(response->wr_id)) {
+      --stack->get_dispatcher()->inflight;
     } else {
       ldout(cct, 1) << __func__ << " a outter chunk: " << chunk << dendl;//fin
     }
@@ -146,6 +146,10 @@ enum {
   l_msgr_rdma_rx_chunks,
   l_msgr_rdma_rx_bytes,
 
+  l_msgr_rdma_tx_inline_chunks,
+  l_msgr_rdma_tx_zero_copy_bytes,
+  l_msgr_rdma_reg_cache_miss,
+
   l_msgr_rdma_last,
 };
 
@@ -198,6 +202,8 @@ class RDMAWorker : public Worker {
 class RDMAConnectedSocketImpl : public ConnectedSocketImpl {
  public:
   typedef Infiniband::MemoryManager::Chunk Chunk;
+  typedef Infiniband::MemoryManager::RegCache RegCache;
+  typedef RegCache::Tx ZeroCopyTx;
   typedef Infiniband::CompletionChannel CompletionChannel;
   typedef Infiniband::CompletionQueue CompletionQueue;
 
@@ -226,7 +232,7 @@ class RDMAConnectedSocketImpl : public ConnectedSocketImpl {
 
   void notify();
   ssize_t read_buffers(char* buf, size_t len);
-  int post_work_request(std::vector<Chunk*>&);
+  int post_work_request(std::vector<ibv_sge> &sges, std::vector<uint64_t> &wr_ids);
 
  public:
   RDMAConnectedSocketImpl(CephContext *cct, Infiniband* ib, RDMADispatcher* s,
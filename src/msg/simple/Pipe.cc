@@ -242,7 +242,7 @@ void Pipe::DelayedDelivery::discard()
   Mutex::Locker l(delay_lock);
   while (!delay_queue.empty()) {
     Message *m = delay_queue.front().second;
-    pipe->in_q->dispatch_throttle_release(m->get_dispatch_throttle_size());
+    pipe->in_q->dispatch_throttle_release(m);
     m->put();
     delay_queue.pop_front();
   }
@@ -1715,7 +1715,7 @@ void Pipe::reader()
 
       if (state == STATE_CLOSED ||
 	  state == STATE_CONNECTING) {
-	in_q->dispatch_throttle_release(m->get_dispatch_throttle_size());
+	in_q->dispatch_throttle_release(m);
 	m->put();
 	continue;
       }
@@ -1729,7 +1729,7 @@ void Pipe::reader()
 	ldout(msgr->cct,0) << "reader got old message "
 		<< m->get_seq() << " <= " << in_seq << " " << m << " " << *m
 		<< ", discarding" << dendl;
-	in_q->dispatch_throttle_release(m->get_dispatch_throttle_size());
+	in_q->dispatch_throttle_release(m);
 	m->put();
 	if (connection_state->has_feature(CEPH_FEATURE_RECONNECT_SEQ) &&
 	    msgr->cct->_conf->ms_die_on_old_message)
@@ -1955,7 +1955,9 @@ void Pipe::writer()
           ldout(msgr->cct,1) << "writer error sending " << m << ", "
 		  << cpp_strerror(errno) << dendl;
 	  fault();
-        }
+        } else if (msgr->msg_latency) {
+	  msgr->msg_latency->record_sent(connection_state.get(), m);
+	}
 	m->put();
       }
       continue;
@@ -2079,10 +2081,12 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
     // policy throttle, as this one does not deadlock (unless dispatch
     // blocks indefinitely, which it shouldn't).  in contrast, the
     // policy throttle carries for the lifetime of the message.
+    Throttle &t = in_q->get_dispatch_throttler(
+      DispatchQueue::get_dispatch_class(header.type, header.priority));
     ldout(msgr->cct,10) << "reader wants " << message_size << " from dispatch throttler "
-	     << in_q->dispatch_throttler.get_current() << "/"
-	     << in_q->dispatch_throttler.get_max() << dendl;
-    in_q->dispatch_throttler.get(message_size);
+	     << t.get_current() << "/"
+	     << t.get_max() << dendl;
+    t.get(message_size);
   }
 
   utime_t throttle_stamp = ceph_clock_now();
@@ -2242,7 +2246,8 @@ int Pipe::read_message(Message **pm, AuthSessionHandler* auth_handler)
       policy.throttler_bytes->put(message_size);
     }
 
-    in_q->dispatch_throttle_release(message_size);
+    in_q->dispatch_throttle_release(
+      message_size, DispatchQueue::get_dispatch_class(header.type, header.priority));
   }
   return ret;
 }
@@ -2467,7 +2472,7 @@ int Pipe::write_message(const ceph_msg_header& header, const ceph_msg_footer& fo
   }
 
   // payload (front+data)
-  list<bufferptr>::const_iterator pb = blist.buffers().begin();
+  bufferlist::buffers_t::const_iterator pb = blist.buffers().begin();
   unsigned b_off = 0;  // carry-over buffer offset, if any
   unsigned bl_pos = 0; // blist pos
   unsigned left = blist.length();
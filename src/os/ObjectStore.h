@@ -716,8 +716,8 @@ public:
       vector<__le32> &cm,
       vector<__le32> &om) {
 
-      list<bufferptr> list = bl.buffers();
-      std::list<bufferptr>::iterator p;
+      bufferlist::buffers_t list = bl.buffers();
+      bufferlist::buffers_t::iterator p;
 
       for(p = list.begin(); p != list.end(); ++p) {
         assert(p->length() % sizeof(Op) == 0);
@@ -3146,7 +3146,9 @@ BlueStore::BlueStore(CephContext *cct, const string& path)
 	     cct->_conf->bluestore_wal_thread_timeout,
 	     cct->_conf->bluestore_wal_thread_suicide_timeout,
 	     &wal_tp),
-    m_finisher_num(1),
+    finishers(cct, "finisher", "finisher",
+	      cct->_conf->bluestore_shard_finishers ?
+	      cct->_conf->osd_op_num_shards : 1),
     kv_sync_thread(this),
     kv_stop(false),
     logger(NULL),
@@ -3158,17 +3160,6 @@ BlueStore::BlueStore(CephContext *cct, const string& path)
   _init_logger();
   cct->_conf->add_observer(this);
   set_cache_shards(1);
-
-  if (cct->_conf->bluestore_shard_finishers) {
-    m_finisher_num = cct->_conf->osd_op_num_shards;
-  }
-
-  for (int i = 0; i < m_finisher_num; ++i) {
-    ostringstream oss;
-    oss << "finisher-" << i;
-    Finisher *f = new Finisher(cct, oss.str(), "finisher");
-    finishers.push_back(f);
-  }
 }
 
 BlueStore::BlueStore(CephContext *cct,
@@ -3202,7 +3193,9 @@ BlueStore::BlueStore(CephContext *cct,
 	     cct->_conf->bluestore_wal_thread_timeout,
 	     cct->_conf->bluestore_wal_thread_suicide_timeout,
 	     &wal_tp),
-    m_finisher_num(1),
+    finishers(cct, "finisher", "finisher",
+	      cct->_conf->bluestore_shard_finishers ?
+	      cct->_conf->osd_op_num_shards : 1),
     kv_sync_thread(this),
     kv_stop(false),
     logger(NULL),
@@ -3216,26 +3209,10 @@ BlueStore::BlueStore(CephContext *cct,
   _init_logger();
   cct->_conf->add_observer(this);
   set_cache_shards(1);
-
-  if (cct->_conf->bluestore_shard_finishers) {
-    m_finisher_num = cct->_conf->osd_op_num_shards;
-  }
-
-  for (int i = 0; i < m_finisher_num; ++i) {
-    ostringstream oss;
-    oss << "finisher-" << i;
-    Finisher *f = new Finisher(cct, oss.str(), "finisher");
-    finishers.push_back(f);
-  }
 }
 
 BlueStore::~BlueStore()
 {
-  for (auto f : finishers) {
-    delete f;
-  }
-  finishers.clear();
-
   cct->_conf->remove_observer(this);
   _shutdown_logger();
   assert(!mounted);
@@ -3324,6 +3301,8 @@ void BlueStore::_init_logger()
 {
   PerfCountersBuilder b(cct, "BlueStore",
                         l_bluestore_first, l_bluestore_last);
+  // updated by every op, kv and finisher thread
+  b.set_sharded(true);
   b.add_time_avg(l_bluestore_state_prepare_lat, "state_prepare_lat",
     "Average prepare state latency");
   b.add_time_avg(l_bluestore_state_aio_wait_lat, "state_aio_wait_lat",
@@ -3366,6 +3345,7 @@ void BlueStore::_init_logger()
     "Average decompress latency");
   b.add_time_avg(l_bluestore_csum_lat, "csum_lat",
     "Average checksum latency");
+  b.set_sharded(false);
   b.add_u64(l_bluestore_compress_success_count, "compress_success_count",
     "Sum for beneficial compress ops");
   b.add_u64(l_bluestore_compress_rejected_count, "compress_rejected_count",
@@ -4758,9 +4738,7 @@ int BlueStore::mount()
       goto out_coll;
   }
 
-  for (auto f : finishers) {
-    f->start();
-  }
+  finishers.start();
   wal_tp.start();
   kv_sync_thread.create("bstore_kv_sync");
 
@@ -4780,10 +4758,8 @@ int BlueStore::mount()
   _kv_stop();
   wal_wq.drain();
   wal_tp.stop();
-  for (auto f : finishers) {
-    f->wait_for_empty();
-    f->stop();
-  }
+  finishers.wait_for_empty();
+  finishers.stop();
  out_coll:
   coll_map.clear();
  out_alloc:
@@ -4816,12 +4792,10 @@ int BlueStore::umount()
   wal_wq.drain();
   dout(20) << __func__ << " stopping wal_tp" << dendl;
   wal_tp.stop();
-  for (auto f : finishers) {
-    dout(20) << __func__ << " draining finisher" << dendl;
-    f->wait_for_empty();
-    dout(20) << __func__ << " stopping finisher" << dendl;
-    f->stop();
-  }
+  dout(20) << __func__ << " draining finishers" << dendl;
+  finishers.wait_for_empty();
+  dout(20) << __func__ << " stopping finishers" << dendl;
+  finishers.stop();
   _reap_collections();
   coll_map.clear();
   dout(20) << __func__ << " closing" << dendl;
@@ -7332,19 +7306,20 @@ void BlueStore::_txc_finish_kv(TransContext *txc)
     txc->onreadable_sync->complete(0);
     txc->onreadable_sync = NULL;
   }
-  unsigned n = txc->osr->parent->shard_hint.hash_to_shard(m_finisher_num);
+  unsigned n = txc->osr->parent->shard_hint.hash_to_shard(
+    finishers.get_num_lanes());
   if (txc->oncommit) {
     logger->tinc(l_bluestore_commit_lat, ceph_clock_now() - txc->start);
-    finishers[n]->queue(txc->oncommit);
+    finishers.queue(n, txc->oncommit);
     txc->oncommit = NULL;
   }
   if (txc->onreadable) {
-    finishers[n]->queue(txc->onreadable);
+    finishers.queue(n, txc->onreadable);
     txc->onreadable = NULL;
   }
 
   if (!txc->oncommits.empty()) {
-    finishers[n]->queue(txc->oncommits);
+    finishers.queue(n, txc->oncommits);
   }
   _op_queue_release_throttle(txc);
 }
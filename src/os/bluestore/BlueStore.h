@@ -1741,8 +1741,7 @@ private:
   ThreadPool wal_tp;
   WALWQ wal_wq;
 
-  int m_finisher_num;
-  vector<Finisher*> finishers;
+  ShardedFinisher finishers;
 
   KVSyncThread kv_sync_thread;
   std::mutex kv_lock;
@@ -541,8 +541,10 @@ FileStore::FileStore(CephContext* cct, const std::string &base,
                       !cct->_conf->filestore_wbthrottle_enable),
   throttle_ops(cct, "filestore_ops", cct->_conf->filestore_caller_concurrency),
   throttle_bytes(cct, "filestore_bytes", cct->_conf->filestore_caller_concurrency),
-  m_ondisk_finisher_num(cct->_conf->filestore_ondisk_finisher_threads),
-  m_apply_finisher_num(cct->_conf->filestore_apply_finisher_threads),
+  ondisk_finishers(cct, "filestore-ondisk", "fn_odsk_fstore",
+		   cct->_conf->filestore_ondisk_finisher_threads),
+  apply_finishers(cct, "filestore-apply", "fn_appl_fstore",
+		  cct->_conf->filestore_apply_finisher_threads),
   op_tp(cct, "FileStore::op_tp", "tp_fstore_op", cct->_conf->filestore_op_threads, "filestore_op_threads"),
   op_wq(this, cct->_conf->filestore_op_thread_timeout,
 	cct->_conf->filestore_op_thread_suicide_timeout, &op_tp),
@@ -574,18 +576,6 @@ FileStore::FileStore(CephContext* cct, const std::string &base,
   m_filestore_max_xattr_value_size(0)
 {
   m_filestore_kill_at.set(cct->_conf->filestore_kill_at);
-  for (int i = 0; i < m_ondisk_finisher_num; ++i) {
-    ostringstream oss;
-    oss << "filestore-ondisk-" << i;
-    Finisher *f = new Finisher(cct, oss.str(), "fn_odsk_fstore");
-    ondisk_finishers.push_back(f);
-  }
-  for (int i = 0; i < m_apply_finisher_num; ++i) {
-    ostringstream oss;
-    oss << "filestore-apply-" << i;
-    Finisher *f = new Finisher(cct, oss.str(), "fn_appl_fstore");
-    apply_finishers.push_back(f);
-  }
 
   ostringstream oss;
   oss << basedir << "/current";
@@ -638,14 +628,6 @@ FileStore::FileStore(CephContext* cct, const std::string &base,
 
 FileStore::~FileStore()
 {
-  for (vector<Finisher*>::iterator it = ondisk_finishers.begin(); it != ondisk_finishers.end(); ++it) {
-    delete *it;
-    *it = NULL;
-  }
-  for (vector<Finisher*>::iterator it = apply_finishers.begin(); it != apply_finishers.end(); ++it) {
-    delete *it;
-    *it = NULL;
-  }
   cct->_conf->remove_observer(this);
   cct->get_perfcounters_collection()->remove(logger);
 
@@ -1767,12 +1749,8 @@ int FileStore::mount()
   journal_start();
 
   op_tp.start();
-  for (vector<Finisher*>::iterator it = ondisk_finishers.begin(); it != ondisk_finishers.end(); ++it) {
-    (*it)->start();
-  }
-  for (vector<Finisher*>::iterator it = apply_finishers.begin(); it != apply_finishers.end(); ++it) {
-    (*it)->start();
-  }
+  ondisk_finishers.start();
+  apply_finishers.start();
 
   timer.init();
 
@@ -1877,12 +1855,8 @@ int FileStore::umount()
   if (!(generic_flags & SKIP_JOURNAL_REPLAY))
     journal_write_close();
 
-  for (vector<Finisher*>::iterator it = ondisk_finishers.begin(); it != ondisk_finishers.end(); ++it) {
-    (*it)->stop();
-  }
-  for (vector<Finisher*>::iterator it = apply_finishers.begin(); it != apply_finishers.end(); ++it) {
-    (*it)->stop();
-  }
+  ondisk_finishers.stop();
+  apply_finishers.stop();
 
   if (fsid_fd >= 0) {
     VOID_TEMP_FAILURE_RETRY(::close(fsid_fd));
@@ -2032,10 +2006,10 @@ void FileStore::_finish_op(OpSequencer *osr)
     o->onreadable_sync->complete(0);
   }
   if (o->onreadable) {
-    apply_finishers[osr->id % m_apply_finisher_num]->queue(o->onreadable);
+    apply_finishers.queue(osr->id, o->onreadable);
   }
   if (!to_queue.empty()) {
-    apply_finishers[osr->id % m_apply_finisher_num]->queue(to_queue);
+    apply_finishers.queue(osr->id, to_queue);
   }
   delete o;
 }
@@ -2194,7 +2168,7 @@ int FileStore::queue_transactions(Sequencer *posr, vector<Transaction>& tls,
   if (onreadable_sync) {
     onreadable_sync->complete(r);
   }
-  apply_finishers[osr->id % m_apply_finisher_num]->queue(onreadable, r);
+  apply_finishers.queue(osr->id, onreadable, r);
 
   submit_manager.op_submit_finish(op);
   apply_manager.op_apply_finish(op);
@@ -2218,10 +2192,10 @@ void FileStore::_journaled_ahead(OpSequencer *osr, Op *o, Context *ondisk)
   // getting blocked behind an ondisk completion.
   if (ondisk) {
     dout(10) << " queueing ondisk " << ondisk << dendl;
-    ondisk_finishers[osr->id % m_ondisk_finisher_num]->queue(ondisk);
+    ondisk_finishers.queue(osr->id, ondisk);
   }
   if (!to_queue.empty()) {
-    ondisk_finishers[osr->id % m_ondisk_finisher_num]->queue(to_queue);
+    ondisk_finishers.queue(osr->id, to_queue);
   }
 }
 
@@ -4047,9 +4021,7 @@ void FileStore::_flush_op_queue()
   dout(10) << "_flush_op_queue draining op tp" << dendl;
   op_wq.drain();
   dout(10) << "_flush_op_queue waiting for apply finisher" << dendl;
-  for (vector<Finisher*>::iterator it = apply_finishers.begin(); it != apply_finishers.end(); ++it) {
-    (*it)->wait_for_empty();
-  }
+  apply_finishers.wait_for_empty();
 }
 
 /*
@@ -4073,9 +4045,7 @@ void FileStore::flush()
     if (journal)
       journal->flush();
     dout(10) << "flush draining ondisk finisher" << dendl;
-    for (vector<Finisher*>::iterator it = ondisk_finishers.begin(); it != ondisk_finishers.end(); ++it) {
-      (*it)->wait_for_empty();
-    }
+    ondisk_finishers.wait_for_empty();
   }
 
   _flush_op_queue();
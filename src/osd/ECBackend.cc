@@ -152,6 +152,8 @@ ostream &operator<<(ostream &lhs, const ECBackend::Op &rhs)
       << " pending_read=" << rhs.pending_read
       << " remote_read=" << rhs.remote_read
       << " remote_read_result=" << rhs.remote_read_result
+      << " using_delta=" << rhs.using_delta
+      << " delta_reads_pending=" << rhs.delta_reads_pending
       << " pending_apply=" << rhs.pending_apply
       << " pending_commit=" << rhs.pending_commit
       << " plan.to_read=" << rhs.plan.to_read
@@ -611,6 +613,7 @@ void ECBackend::continue_recovery_op(
 	pop.recovery_info = op.recovery_info;
 	pop.before_progress = op.recovery_progress;
 	pop.after_progress = after_progress;
+	get_parent()->note_recovery_bytes(pop.data.length());
 	if (*mi != get_parent()->primary_shard())
 	  get_parent()->begin_peer_recover(
 	    *mi,
@@ -1135,6 +1138,29 @@ void ECBackend::handle_sub_read_reply(
   assert(rop.in_progress.count(from));
   rop.in_progress.erase(from);
   unsigned is_complete = 0;
+  if (rop.for_delta) {
+    // only the shards we asked for will do; don't decode or read more
+    if (!rop.in_progress.empty()) {
+      dout(10) << __func__ << " readop not complete: " << rop << dendl;
+      return;
+    }
+    for (auto &&i: rop.complete) {
+      if (!i.second.errors.empty()) {
+	i.second.r = i.second.errors.begin()->second;
+	continue;
+      }
+      const set<pg_shard_t> &need = rop.to_read.find(i.first)->second.need;
+      for (auto &&extent: i.second.returned) {
+	if (extent.get<2>().size() != need.size()) {
+	  i.second.r = -EIO;
+	  break;
+	}
+      }
+    }
+    dout(20) << __func__ << " Complete: " << rop << dendl;
+    complete_read_op(rop, m);
+    return;
+  }
   // For redundant reads check for completion as each shard comes in,
   // or in a non-recovery read check for completion once all the shards read.
   // TODO: It would be nice if recovery could send more reads too
@@ -1559,8 +1585,10 @@ void ECBackend::start_read_op(
   map<hobject_t, read_request_t> &to_read,
   OpRequestRef _op,
   bool do_redundant_reads,
-  bool for_recovery)
+  bool for_recovery,
+  bool for_delta)
 {
+  assert(!for_delta || (!do_redundant_reads && !for_recovery));
   ceph_tid_t tid = get_parent()->get_tid();
   assert(!tid_to_read_map.count(tid));
   auto &op = tid_to_read_map.emplace(
@@ -1572,6 +1600,7 @@ void ECBackend::start_read_op(
       for_recovery,
       _op,
       std::move(to_read))).first->second;
+  op.for_delta = for_delta;
   dout(10) << __func__ << ": starting " << op << dendl;
   do_read_op(
     op);
@@ -1713,12 +1742,144 @@ void ECBackend::start_rmw(Op *op, PGTransactionUPtr &&t)
     },
     get_parent()->get_dpp());
 
+  if (cct->_conf->osd_ec_parity_delta_writes) {
+    ECTransaction::plan_parity_delta(sinfo, ec_impl, op->plan);
+  }
+
   dout(10) << __func__ << ": " << *op << dendl;
 
   waiting_state.push_back(*op);
   check_ops();
 }
 
+bool ECBackend::get_delta_read_shards(
+  const Op *op,
+  map<hobject_t,set<pg_shard_t>> *shards)
+{
+  if (op->plan.delta_chunks.empty())
+    return false;
+
+  for (auto &&i: op->plan.delta_chunks) {
+    set<int> want = i.second;
+    for (unsigned c = ec_impl->get_data_chunk_count();
+	 c < ec_impl->get_chunk_count();
+	 ++c) {
+      want.insert(c);
+    }
+    set<pg_shard_t> &to_read = (*shards)[i.first];
+    int r = get_min_avail_to_read_shards(
+      i.first,
+      want,
+      false,
+      false,
+      &to_read);
+    if (r < 0 || to_read.size() != want.size())
+      return false;
+    for (auto &&j: to_read) {
+      if (!want.count(j.shard))
+	return false;
+    }
+  }
+  return true;
+}
+
+struct OnDeltaReadComplete :
+  public GenContext<pair<RecoveryMessages*, ECBackend::read_result_t& > &> {
+  ECBackend *ec;
+  ECBackend::Op *op;
+  hobject_t hoid;
+  OnDeltaReadComplete(ECBackend *ec, ECBackend::Op *op, const hobject_t &hoid)
+    : ec(ec), op(op), hoid(hoid) {}
+  void finish(pair<RecoveryMessages *, ECBackend::read_result_t &> &in) override {
+    ec->handle_delta_read_complete(op, hoid, in.second);
+  }
+};
+
+void ECBackend::start_delta_reads(
+  Op *op,
+  const map<hobject_t,set<pg_shard_t>> &shards)
+{
+  map<hobject_t, read_request_t> for_read_op;
+  for (auto &&i: shards) {
+    list<boost::tuple<uint64_t, uint64_t, uint32_t> > offsets;
+    const extent_set &stripes = op->plan.to_read[i.first];
+    for (auto j = stripes.begin(); j != stripes.end(); ++j) {
+      offsets.push_back(boost::make_tuple(j.get_start(), j.get_len(), 0));
+    }
+    for_read_op.insert(
+      make_pair(
+	i.first,
+	read_request_t(
+	  offsets,
+	  i.second,
+	  false,
+	  new OnDeltaReadComplete(this, op, i.first))));
+  }
+  op->delta_reads_pending = for_read_op.size();
+  start_read_op(
+    CEPH_MSG_PRIO_DEFAULT,
+    for_read_op,
+    OpRequestRef(),
+    false, false, true);
+}
+
+void ECBackend::handle_delta_read_complete(
+  Op *op,
+  const hobject_t &hoid,
+  read_result_t &res)
+{
+  assert(op->using_delta);
+  assert(op->delta_reads_pending > 0);
+  --op->delta_reads_pending;
+
+  int r = res.r;
+  if (r == 0) {
+    auto &chunks = op->delta_read_result[hoid];
+    for (auto &&extent: res.returned) {
+      pair<uint64_t, uint64_t> range = sinfo.aligned_offset_len_to_chunk(
+	make_pair(extent.get<0>(), extent.get<1>()));
+      for (auto &&j: extent.get<2>()) {
+	if (j.second.length() != range.second) {
+	  r = -EIO;
+	  break;
+	}
+	chunks[j.first.shard].insert(range.first, range.second, j.second);
+      }
+    }
+    for (auto &&i: op->plan.delta_chunks[hoid]) {
+      if (!chunks.count(i))
+	r = -EIO;
+    }
+  }
+  if (r < 0) {
+    dout(10) << __func__ << ": " << hoid << " read failed with " << r
+	     << dendl;
+    op->delta_read_failed = true;
+  }
+  if (op->delta_reads_pending > 0)
+    return;
+
+  if (op->delta_read_failed) {
+    // read and re-encode the full stripes instead
+    dout(10) << __func__ << ": falling back to full stripe reads for "
+	     << *op << dendl;
+    op->using_delta = false;
+    op->delta_read_failed = false;
+    op->delta_read_result.clear();
+    op->remote_read = op->plan.to_read;
+    objects_read_async_no_cache(
+      op->remote_read,
+      [this, op](map<hobject_t,pair<int, extent_map> > &&results) {
+	for (auto &&i: results) {
+	  op->remote_read_result.emplace(i.first, i.second.second);
+	}
+	check_ops();
+      });
+    return;
+  }
+  check_ops();
+}
+
 bool ECBackend::try_state_to_reads()
 {
   if (waiting_state.empty())
@@ -1734,11 +1895,23 @@ bool ECBackend::try_state_to_reads()
     return false;
   }
 
+  map<hobject_t,set<pg_shard_t>> delta_shards;
   if (op->invalidates_cache()) {
     dout(20) << __func__ << ": invalidating cache after this op"
 	     << dendl;
     pipeline_state.invalidate();
     op->using_cache = false;
+  } else if (waiting_reads.empty() &&
+	     waiting_commit.empty() &&
+	     get_delta_read_shards(op, &delta_shards)) {
+    /* Nothing is in flight, so the shards hold the current content of
+     * the stripes.  A parity delta write does not fill the cache with
+     * the full stripes, so later rmw writes wait for it to complete. */
+    dout(20) << __func__ << ": using parity deltas, invalidating cache"
+	     << " after this op" << dendl;
+    pipeline_state.invalidate();
+    op->using_cache = false;
+    op->using_delta = true;
   } else {
     op->using_cache = pipeline_state.caching_enabled();
   }
@@ -1773,13 +1946,16 @@ bool ECBackend::try_state_to_reads()
 	op->pending_read[hpair.first] = std::move(pending_read);
       }
     }
-  } else {
+  } else if (!op->using_delta) {
     op->remote_read = op->plan.to_read;
   }
 
   dout(10) << __func__ << ": " << *op << dendl;
 
-  if (!op->remote_read.empty()) {
+  if (op->using_delta) {
+    assert(get_parent()->get_pool().is_hacky_ecoverwrites());
+    start_delta_reads(op, delta_shards);
+  } else if (!op->remote_read.empty()) {
     assert(get_parent()->get_pool().is_hacky_ecoverwrites());
     objects_read_async_no_cache(
       op->remote_read,
@@ -1841,6 +2017,7 @@ bool ECBackend::try_reads_to_commit()
       !get_osdmap()->test_flag(CEPH_OSDMAP_REQUIRE_KRAKEN),
       sinfo,
       op->remote_read_result,
+      op->delta_read_result,
       op->log_entries,
       &written,
       &trans,
@@ -1868,7 +2045,8 @@ bool ECBackend::try_reads_to_commit()
     written_set[i.first] = i.second.get_interval_set();
   }
   dout(20) << __func__ << ": written_set: " << written_set << dendl;
-  assert(written_set == op->plan.will_write);
+  // parity delta writes only update some chunks of the stripes
+  assert(op->using_delta || written_set == op->plan.will_write);
 
   if (op->using_cache) {
     for (auto &&hpair: written) {
@@ -1878,6 +2056,7 @@ bool ECBackend::try_reads_to_commit()
   }
   op->remote_read.clear();
   op->remote_read_result.clear();
+  op->delta_read_result.clear();
 
   dout(10) << "onreadable_sync: " << op->on_local_applied_sync << dendl;
   ObjectStore::Transaction empty;
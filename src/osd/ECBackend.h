@@ -369,6 +369,11 @@ public:
     // True if reading for recovery which could possibly reading only a subset
     // of the available shards.
     bool for_recovery;
+    // True if reading exactly the shards a parity delta write needs.
+    // These are fewer than needed to decode, and on a shard error the
+    // write falls back to reading full stripes itself, so the reply is
+    // never checked for decodability nor extended to more shards.
+    bool for_delta = false;
 
     map<hobject_t, read_request_t> to_read;
     map<hobject_t, read_result_t> complete;
@@ -416,7 +421,7 @@ public:
     int priority,
     map<hobject_t, read_request_t> &to_read,
     OpRequestRef op,
-    bool do_redundant_reads, bool for_recovery);
+    bool do_redundant_reads, bool for_recovery, bool for_delta = false);
 
   void do_read_op(ReadOp &rop);
   int send_all_remaining_reads(
@@ -464,15 +469,24 @@ public:
     bool requires_rmw() const { return !plan.to_read.empty(); }
     bool invalidates_cache() const { return plan.invalidates_cache; }
 
-    // must be true if requires_rmw(), must be false if invalidates_cache()
+    // must be true if requires_rmw() unless using_delta, must be false
+    // if invalidates_cache()
     bool using_cache = false;
 
+    // true if the overwrite is applied as parity deltas, @see
+    // ECTransaction::plan_parity_delta
+    bool using_delta = false;
+
     /// In progress read state;
     map<hobject_t,extent_set> pending_read; // subset already being read
     map<hobject_t,extent_set> remote_read;  // subset we must read
     map<hobject_t,extent_map> remote_read_result;
+    unsigned delta_reads_pending = 0;
+    bool delta_read_failed = false;
+    map<hobject_t,map<int,extent_map>> delta_read_result; // by chunk offset
     bool read_in_progress() const {
-      return !remote_read.empty() && remote_read_result.empty();
+      return (!remote_read.empty() && remote_read_result.empty()) ||
+	delta_reads_pending > 0;
     }
 
     /// In progress write state
@@ -552,6 +566,17 @@ public:
   eversion_t completed_to;
   eversion_t committed_to;
   void start_rmw(Op *op, PGTransactionUPtr &&t);
+  bool get_delta_read_shards(
+    const Op *op,
+    map<hobject_t,set<pg_shard_t>> *shards);
+  void start_delta_reads(
+    Op *op,
+    const map<hobject_t,set<pg_shard_t>> &shards);
+  friend struct OnDeltaReadComplete;
+  void handle_delta_read_complete(
+    Op *op,
+    const hobject_t &hoid,
+    read_result_t &res);
   bool try_state_to_reads();
   bool try_reads_to_commit();
   bool try_finish_rmw();
@@ -82,6 +82,157 @@ void encode_and_write(
   }
 }
 
+static bufferptr get_chunk_range(
+  const extent_map &chunk,
+  uint64_t offset,
+  uint64_t length)
+{
+  bufferptr ptr = buffer::create_page_aligned(length);
+  uint64_t copied = 0;
+  for (auto &&extent: chunk.intersect(offset, length)) {
+    assert(extent.get_off() == offset + copied);
+    extent.get_val().copy(0, extent.get_len(), ptr.c_str() + copied);
+    copied += extent.get_len();
+  }
+  assert(copied == length);
+  return ptr;
+}
+
+void encode_delta_and_write(
+  pg_t pgid,
+  const hobject_t &oid,
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  const extent_set &stripes,
+  const map<int, extent_map> &old_chunks,
+  const PGTransaction::ObjectOperation &op,
+  pg_log_entry_t *entry,
+  vector<pair<uint64_t, uint64_t> > *rollback_extents,
+  map<shard_id_t, ObjectStore::Transaction> *transactions,
+  DoutPrefixProvider *dpp) {
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const int k = ecimpl->get_data_chunk_count();
+  const int n = ecimpl->get_chunk_count();
+
+  // new content of the modified data chunks, by chunk offset
+  map<int, extent_map> new_chunks;
+  uint32_t fadvise_flags = 0;
+  for (auto &&extent: op.buffer_updates) {
+    using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+    bufferlist bl;
+    match(
+      extent.get_val(),
+      [&](const BufferUpdate::Write &op) {
+	bl = op.buffer;
+	fadvise_flags |= op.fadvise_flags;
+      },
+      [&](const BufferUpdate::Zero &) {
+	bl.append_zero(extent.get_len());
+      },
+      [&](const BufferUpdate::CloneRange &) {
+	assert(
+	  0 ==
+	  "CloneRange is not allowed, do_op should have returned ENOTSUPP");
+      });
+
+    uint64_t off = extent.get_off();
+    const uint64_t end = off + extent.get_len();
+    while (off < end) {
+      uint64_t in_chunk = off % chunk_size;
+      int chunk = (off % stripe_width) / chunk_size;
+      uint64_t len = MIN(chunk_size - in_chunk, end - off);
+      bufferlist piece;
+      piece.substr_of(bl, off - extent.get_off(), len);
+      new_chunks[chunk].insert(
+	sinfo.logical_to_prev_chunk_offset(off) + in_chunk, len, piece);
+      off += len;
+    }
+  }
+
+  for (auto stripe = stripes.begin(); stripe != stripes.end(); ++stripe) {
+    pair<uint64_t, uint64_t> range = sinfo.aligned_offset_len_to_chunk(
+      make_pair(stripe.get_start(), stripe.get_len()));
+
+    map<int, bufferptr> deltas;
+    map<int, bufferptr> to_write;
+    for (auto &&i: new_chunks) {
+      extent_map modified = i.second.intersect(range.first, range.second);
+      if (modified.empty())
+	continue;
+      assert(i.first < k);
+      auto old_chunk = old_chunks.find(i.first);
+      assert(old_chunk != old_chunks.end());
+      bufferptr old_data = get_chunk_range(
+	old_chunk->second, range.first, range.second);
+      bufferptr new_data(old_data.c_str(), old_data.length());
+      for (auto &&extent: modified) {
+	extent.get_val().copy(
+	  0, extent.get_len(),
+	  new_data.c_str() + extent.get_off() - range.first);
+      }
+      ecimpl->encode_delta(old_data, new_data, &deltas[i.first]);
+      to_write[i.first] = new_data;
+    }
+    if (deltas.empty())
+      continue;
+
+    map<int, bufferptr> parity;
+    for (int i = k; i < n; ++i) {
+      auto old_chunk = old_chunks.find(i);
+      assert(old_chunk != old_chunks.end());
+      parity[i] = get_chunk_range(
+	old_chunk->second, range.first, range.second);
+    }
+    int r = ecimpl->apply_delta(deltas, &parity);
+    assert(r == 0);
+    to_write.insert(parity.begin(), parity.end());
+
+    ldpp_dout(dpp, 20) << __func__ << ": " << oid
+		       << " updating " << deltas.size() << " data chunks"
+		       << " and the coding chunks at "
+		       << range.first << "~" << range.second
+		       << dendl;
+
+    if (entry) {
+      /* rollback extents are applied to every shard, so all of them
+       * save the range even if only some are written */
+      if (rollback_extents->empty()) {
+	for (auto &&st : *transactions) {
+	  st.second.touch(
+	    coll_t(spg_t(pgid, st.first)),
+	    ghobject_t(oid, entry->version.version, st.first));
+	}
+      }
+      rollback_extents->emplace_back(range);
+      for (auto &&st : *transactions) {
+	st.second.clone_range(
+	  coll_t(spg_t(pgid, st.first)),
+	  ghobject_t(oid, ghobject_t::NO_GEN, st.first),
+	  ghobject_t(oid, entry->version.version, st.first),
+	  range.first,
+	  range.second,
+	  range.first);
+      }
+    }
+
+    for (auto &&i: to_write) {
+      auto st = transactions->find(shard_id_t(i.first));
+      if (st == transactions->end())
+	continue;
+      bufferlist bl;
+      bl.append(i.second);
+      st->second.write(
+	coll_t(spg_t(pgid, st->first)),
+	ghobject_t(oid, ghobject_t::NO_GEN, st->first),
+	range.first,
+	range.second,
+	bl,
+	fadvise_flags);
+    }
+  }
+}
+
 bool ECTransaction::requires_overwrite(
   uint64_t prev_size,
   const PGTransaction::ObjectOperation &op) {
@@ -95,6 +246,51 @@ bool ECTransaction::requires_overwrite(
       (op.truncate->first < prev_size)));
 }
 
+void ECTransaction::plan_parity_delta(
+  const ECUtil::stripe_info_t &sinfo,
+  ErasureCodeInterfaceRef &ecimpl,
+  WritePlan &plan)
+{
+  plan.delta_chunks.clear();
+  if (plan.to_read.empty() || !ecimpl->supports_parity_delta())
+    return;
+
+  const uint64_t stripe_width = sinfo.get_stripe_width();
+  const uint64_t chunk_size = sinfo.get_chunk_size();
+  const unsigned k = ecimpl->get_data_chunk_count();
+  const unsigned m = ecimpl->get_coding_chunk_count();
+
+  map<hobject_t,set<int>> delta_chunks;
+  for (auto &&i: plan.to_read) {
+    auto opiter = plan.t->op_map.find(i.first);
+    if (opiter == plan.t->op_map.end())
+      return;
+    const PGTransaction::ObjectOperation &op = opiter->second;
+    // only in place overwrites of existing stripes
+    if (!op.is_none() || op.deletes_first() || op.has_source() ||
+	op.truncate || op.buffer_updates.empty())
+      return;
+    auto wwiter = plan.will_write.find(i.first);
+    if (wwiter == plan.will_write.end() || !(wwiter->second == i.second))
+      return;
+
+    set<int> &chunks = delta_chunks[i.first];
+    for (auto &&extent: op.buffer_updates) {
+      uint64_t off = extent.get_off();
+      const uint64_t end = off + extent.get_len();
+      while (off < end && chunks.size() < k) {
+	chunks.insert((off % stripe_width) / chunk_size);
+	off += chunk_size - (off % chunk_size);
+      }
+    }
+    // reading the modified and the coding chunks must not cost more
+    // than reading all the data chunks
+    if (chunks.size() + m > k)
+      return;
+  }
+  plan.delta_chunks.swap(delta_chunks);
+}
+
 void ECTransaction::generate_transactions(
   WritePlan &plan,
   ErasureCodeInterfaceRef &ecimpl,
@@ -102,6 +298,7 @@ void ECTransaction::generate_transactions(
   bool legacy_log_entries,
   const ECUtil::stripe_info_t &sinfo,
   const map<hobject_t,extent_map> &partial_extents,
+  const map<hobject_t,map<int,extent_map>> &delta_extents,
   vector<pg_log_entry_t> &entries,
   map<hobject_t,extent_map> *written_map,
   map<shard_id_t, ObjectStore::Transaction> *transactions,
@@ -466,56 +663,76 @@ void ECTransaction::generate_transactions(
       }
 
       uint32_t fadvise_flags = 0;
-      for (auto &&extent: op.buffer_updates) {
-	using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
-	bufferlist bl;
-	match(
-	  extent.get_val(),
-	  [&](const BufferUpdate::Write &op) {
-	    bl = op.buffer;
-	    fadvise_flags |= op.fadvise_flags;
-	  },
-	  [&](const BufferUpdate::Zero &) {
-	    bl.append_zero(extent.get_len());
-	  },
-	  [&](const BufferUpdate::CloneRange &) {
-	    assert(
-	      0 ==
-	      "CloneRange is not allowed, do_op should have returned ENOTSUPP");
-	  });
-
-	uint64_t off = extent.get_off();
-	uint64_t len = extent.get_len();
-	uint64_t end = off + len;
-	ldpp_dout(dpp, 20) << __func__ << ": adding buffer_update "
-			   << make_pair(off, len)
-			   << dendl;
-	assert(len > 0);
-	if (off > new_size) {
-	  assert(off > append_after);
-	  bl.prepend_zero(off - new_size);
-	  len += off - new_size;
-	  ldpp_dout(dpp, 20) << __func__ << ": prepending zeroes to align "
-			     << off << "->" << new_size
-			     << dendl;
-	  off = new_size;
-	}
-	if (!sinfo.logical_offset_is_stripe_aligned(end) && (end > append_after)) {
-	  uint64_t aligned_end = sinfo.logical_to_next_stripe_offset(
-	    end);
-	  uint64_t tail = aligned_end - end;
-	  bl.append_zero(tail);
-	  ldpp_dout(dpp, 20) << __func__ << ": appending zeroes to align end "
-			     << end << "->" << end+tail
-			     << ", len: " << len << "->" << len+tail
+      auto diter = delta_extents.find(oid);
+      if (diter != delta_extents.end()) {
+	assert(!op.truncate);
+	assert(to_write.empty());
+	auto riter = plan.to_read.find(oid);
+	assert(riter != plan.to_read.end());
+	encode_delta_and_write(
+	  pgid,
+	  oid,
+	  sinfo,
+	  ecimpl,
+	  riter->second,
+	  diter->second,
+	  op,
+	  entry,
+	  &rollback_extents,
+	  transactions,
+	  dpp);
+      } else {
+	for (auto &&extent: op.buffer_updates) {
+	  using BufferUpdate = PGTransaction::ObjectOperation::BufferUpdate;
+	  bufferlist bl;
+	  match(
+	    extent.get_val(),
+	    [&](const BufferUpdate::Write &op) {
+	      bl = op.buffer;
+	      fadvise_flags |= op.fadvise_flags;
+	    },
+	    [&](const BufferUpdate::Zero &) {
+	      bl.append_zero(extent.get_len());
+	    },
+	    [&](const BufferUpdate::CloneRange &) {
+	      assert(
+		0 ==
+		"CloneRange is not allowed, do_op should have returned ENOTSUPP");
+	    });
+
+	  uint64_t off = extent.get_off();
+	  uint64_t len = extent.get_len();
+	  uint64_t end = off + len;
+	  ldpp_dout(dpp, 20) << __func__ << ": adding buffer_update "
+			     << make_pair(off, len)
 			     << dendl;
-	  end += tail;
-	  len += tail;
-	}
+	  assert(len > 0);
+	  if (off > new_size) {
+	    assert(off > append_after);
+	    bl.prepend_zero(off - new_size);
+	    len += off - new_size;
+	    ldpp_dout(dpp, 20) << __func__ << ": prepending zeroes to align "
+			       << off << "->" << new_size
+			       << dendl;
+	    off = new_size;
+	  }
+	  if (!sinfo.logical_offset_is_stripe_aligned(end) && (end > append_after)) {
+	    uint64_t aligned_end = sinfo.logical_to_next_stripe_offset(
+	      end);
+	    uint64_t tail = aligned_end - end;
+	    bl.append_zero(tail);
+	    ldpp_dout(dpp, 20) << __func__ << ": appending zeroes to align end "
+			       << end << "->" << end+tail
+			       << ", len: " << len << "->" << len+tail
+			       << dendl;
+	    end += tail;
+	    len += tail;
+	  }
 
-	to_write.insert(off, len, bl);
-	if (end > new_size)
-	  new_size = end;
+	  to_write.insert(off, len, bl);
+	  if (end > new_size)
+	    new_size = end;
+	}
       }
 
       if (op.truncate &&
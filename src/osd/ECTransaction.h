@@ -30,6 +30,11 @@ namespace ECTransaction {
     map<hobject_t,extent_set> will_write; // superset of to_read
 
     map<hobject_t,ECUtil::HashInfoRef> hash_infos;
+
+    /* data chunks modified by each object overwrite, filled in by
+     * plan_parity_delta only if all of them can be applied as parity
+     * deltas (it is empty otherwise) */
+    map<hobject_t,set<int>> delta_chunks;
   };
 
   bool requires_overwrite(
@@ -176,6 +181,18 @@ namespace ECTransaction {
     return plan;
   }
 
+  /* A partial stripe overwrite normally reads all the data chunks of
+   * the stripes it touches and re-encodes them.  If the plugin
+   * supports it and the overwrite modifies few enough data chunks,
+   * the coding chunks can instead be updated from the difference
+   * between the old and the new content of the modified data chunks:
+   * only those and the coding chunks need to be read and written.
+   */
+  void plan_parity_delta(
+    const ECUtil::stripe_info_t &sinfo,
+    ErasureCodeInterfaceRef &ecimpl,
+    WritePlan &plan);
+
   void generate_transactions(
     WritePlan &plan,
     ErasureCodeInterfaceRef &ecimpl,
@@ -183,6 +200,7 @@ namespace ECTransaction {
     bool legacy_log_entries,
     const ECUtil::stripe_info_t &sinfo,
     const map<hobject_t,extent_map> &partial_extents,
+    const map<hobject_t,map<int,extent_map>> &delta_extents,
     vector<pg_log_entry_t> &entries,
     map<hobject_t,extent_map> *written,
     map<shard_id_t, ObjectStore::Transaction> *transactions,
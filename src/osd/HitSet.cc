@@ -15,6 +15,8 @@
 #include "HitSet.h"
 #include "common/Formatter.h"
 
+#include <math.h>
+
 // -- HitSet --
 
 HitSet::HitSet(const HitSet::Params& params)
@@ -37,6 +39,10 @@ HitSet::HitSet(const HitSet::Params& params)
     impl.reset(new ExplicitObjectHitSet(static_cast<ExplicitObjectHitSet::Params*>(params.impl.get())));
     break;
 
+  case TYPE_COUNT_MIN:
+    impl.reset(new CountMinHitSet(static_cast<CountMinHitSet::Params*>(params.impl.get())));
+    break;
+
   default:
     assert (0 == "unknown HitSet type");
   }
@@ -71,6 +77,9 @@ void HitSet::decode(bufferlist::iterator &bl)
   case TYPE_BLOOM:
     impl.reset(new BloomHitSet);
     break;
+  case TYPE_COUNT_MIN:
+    impl.reset(new CountMinHitSet);
+    break;
   case TYPE_NONE:
     impl.reset(NULL);
     break;
@@ -105,6 +114,10 @@ void HitSet::generate_test_instances(list<HitSet*>& o)
   o.back()->insert(hobject_t());
   o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
   o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
+  o.push_back(new HitSet(new CountMinHitSet(2, 16, 1)));
+  o.back()->insert(hobject_t());
+  o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
+  o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
 }
 
 HitSet::Params::Params(const Params& o)
@@ -158,6 +171,9 @@ bool HitSet::Params::create_impl(impl_type_t type)
   case TYPE_BLOOM:
     impl.reset(new BloomHitSet::Params);
     break;
+  case TYPE_COUNT_MIN:
+    impl.reset(new CountMinHitSet::Params);
+    break;
   case TYPE_NONE:
     impl.reset(NULL);
     break;
@@ -203,6 +219,8 @@ void HitSet::Params::generate_test_instances(list<HitSet::Params*>& o)
   loop_hitset_params(ExplicitHashHitSet);
   o.push_back(new Params(new ExplicitObjectHitSet::Params));
   loop_hitset_params(ExplicitObjectHitSet);
+  o.push_back(new Params(new CountMinHitSet::Params));
+  loop_hitset_params(CountMinHitSet);
 }
 
 ostream& operator<<(ostream& out, const HitSet::Params& p) {
@@ -250,3 +268,198 @@ void BloomHitSet::dump(Formatter *f) const {
   bloom.dump(f);
   f->close_section();
 }
+
+// -- CountMinHitSet --
+
+void CountMinHitSet::init(uint32_t d, uint32_t w, uint64_t s)
+{
+  assert(valid_size(d, w));
+  depth = d;
+  width = w;
+  seed = s;
+  counters.reset(depth * width ? new std::atomic<uint16_t>[depth * width]
+		 : nullptr);
+  for (uint32_t i = 0; i < depth * width; ++i)
+    counters[i].store(0, std::memory_order_relaxed);
+}
+
+CountMinHitSet::CountMinHitSet(const CountMinHitSet &o)
+  : count(o.count.load())
+{
+  init(o.depth, o.width, o.seed);
+  for (uint32_t i = 0; i < depth * width; ++i)
+    counters[i].store(o.counters[i].load(std::memory_order_relaxed),
+		      std::memory_order_relaxed);
+}
+
+uint32_t CountMinHitSet::slot(uint32_t row, uint32_t hash) const
+{
+  // murmur3 finalizer over the object hash mixed with a per-row seed
+  uint64_t h = hash ^ (seed + 0x9e3779b97f4a7c15ull * (row + 1));
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return row * width + (uint32_t)(h % width);
+}
+
+void CountMinHitSet::insert(const hobject_t& o)
+{
+  ++count;
+  if (!width)
+    return;
+  uint32_t hash = o.get_hash();
+  for (uint32_t r = 0; r < depth; ++r) {
+    std::atomic<uint16_t> &c = counters[slot(r, hash)];
+    uint16_t v = c.load(std::memory_order_relaxed);
+    // saturate rather than wrap
+    while (v != UINT16_MAX &&
+	   !c.compare_exchange_weak(v, v + 1, std::memory_order_relaxed))
+      ;
+  }
+}
+
+unsigned CountMinHitSet::estimate_count(const hobject_t& o) const
+{
+  if (!width)
+    return 0;
+  uint32_t hash = o.get_hash();
+  unsigned ret = UINT16_MAX;
+  for (uint32_t r = 0; r < depth; ++r) {
+    unsigned v = counters[slot(r, hash)].load(std::memory_order_relaxed);
+    if (v < ret)
+      ret = v;
+  }
+  return ret;
+}
+
+void CountMinHitSet::inherit(const HitSet::Impl& prev, double factor)
+{
+  const CountMinHitSet &p = static_cast<const CountMinHitSet&>(prev);
+  if (p.depth != depth || p.width != width || p.seed != seed)
+    return;
+  for (uint32_t i = 0; i < depth * width; ++i) {
+    uint16_t add = p.counters[i].load(std::memory_order_relaxed) * factor;
+    if (!add)
+      continue;
+    std::atomic<uint16_t> &c = counters[i];
+    uint16_t v = c.load(std::memory_order_relaxed);
+    uint16_t nv;
+    // saturate rather than wrap, as insert() does
+    do {
+      nv = UINT16_MAX - v < add ? UINT16_MAX : v + add;
+    } while (!c.compare_exchange_weak(v, nv, std::memory_order_relaxed));
+  }
+}
+
+unsigned CountMinHitSet::approx_unique_insert_count() const
+{
+  if (!width)
+    return 0;
+  // linear counting over the first row
+  uint32_t zeros = 0;
+  for (uint32_t i = 0; i < width; ++i)
+    if (counters[i].load(std::memory_order_relaxed) == 0)
+      ++zeros;
+  if (!zeros)
+    return width;
+  return (unsigned)(-(double)width * log((double)zeros / (double)width));
+}
+
+void CountMinHitSet::encode(bufferlist &bl) const
+{
+  ENCODE_START(1, 1, bl);
+  ::encode(depth, bl);
+  ::encode(width, bl);
+  ::encode(seed, bl);
+  ::encode(count.load(), bl);
+  // pick the smallest of a sparse (index, count) list or a dense array
+  // of 8- or 16-bit counters
+  uint32_t n = depth * width;
+  uint32_t nonzero = 0;
+  uint16_t max = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    uint16_t v = counters[i].load(std::memory_order_relaxed);
+    if (v) {
+      ++nonzero;
+      if (v > max)
+	max = v;
+    }
+  }
+  __u8 bytes = max > UINT8_MAX ? 2 : 1;
+  bool sparse = nonzero * (4 + bytes) < n * bytes;
+  ::encode(bytes, bl);
+  ::encode(sparse, bl);
+  if (sparse)
+    ::encode(nonzero, bl);
+  for (uint32_t i = 0; i < n; ++i) {
+    uint16_t v = counters[i].load(std::memory_order_relaxed);
+    if (sparse) {
+      if (!v)
+	continue;
+      ::encode(i, bl);
+    }
+    if (bytes == 1)
+      ::encode((__u8)v, bl);
+    else
+      ::encode(v, bl);
+  }
+  ENCODE_FINISH(bl);
+}
+
+void CountMinHitSet::decode(bufferlist::iterator &bl)
+{
+  DECODE_START(1, bl);
+  uint32_t d, w;
+  uint64_t s, c;
+  ::decode(d, bl);
+  ::decode(w, bl);
+  ::decode(s, bl);
+  ::decode(c, bl);
+  if (!valid_size(d, w))
+    throw buffer::malformed_input("count-min sketch too large");
+  init(d, w, s);
+  count = c;
+  __u8 bytes;
+  bool sparse;
+  ::decode(bytes, bl);
+  ::decode(sparse, bl);
+  uint32_t n = depth * width;
+  uint32_t entries = n;
+  if (sparse)
+    ::decode(entries, bl);
+  for (uint32_t e = 0; e < entries; ++e) {
+    uint32_t i = e;
+    if (sparse) {
+      ::decode(i, bl);
+      if (i >= n)
+	throw buffer::malformed_input("count-min index out of range");
+    }
+    uint16_t v;
+    if (bytes == 1) {
+      __u8 v8;
+      ::decode(v8, bl);
+      v = v8;
+    } else {
+      ::decode(v, bl);
+    }
+    counters[i].store(v, std::memory_order_relaxed);
+  }
+  DECODE_FINISH(bl);
+}
+
+void CountMinHitSet::Params::dump(Formatter *f) const {
+  f->dump_unsigned("depth", depth);
+  f->dump_unsigned("width", width);
+  f->dump_unsigned("seed", seed);
+}
+
+void CountMinHitSet::dump(Formatter *f) const {
+  f->dump_unsigned("insert_count", count);
+  f->dump_unsigned("depth", depth);
+  f->dump_unsigned("width", width);
+  f->dump_unsigned("seed", seed);
+  f->dump_unsigned("approx_unique_insert_count",
+		   approx_unique_insert_count());
+}
@@ -15,6 +15,8 @@
 #ifndef CEPH_OSD_HITSET_H
 #define CEPH_OSD_HITSET_H
 
+#include <atomic>
+#include <memory>
 #include <boost/scoped_ptr.hpp>
 
 #include "include/encoding.h"
@@ -36,7 +38,8 @@ public:
     TYPE_NONE = 0,
     TYPE_EXPLICIT_HASH = 1,
     TYPE_EXPLICIT_OBJECT = 2,
-    TYPE_BLOOM = 3
+    TYPE_BLOOM = 3,
+    TYPE_COUNT_MIN = 4
   } impl_type_t;
 
   static const char *get_type_name(impl_type_t t) {
@@ -45,6 +48,7 @@ public:
     case TYPE_EXPLICIT_HASH: return "explicit_hash";
     case TYPE_EXPLICIT_OBJECT: return "explicit_object";
     case TYPE_BLOOM: return "bloom";
+    case TYPE_COUNT_MIN: return "count_min";
     default: return "???";
     }
   }
@@ -68,6 +72,17 @@ public:
     virtual void dump(Formatter *f) const = 0;
     virtual Impl* clone() const = 0;
     virtual void seal() {}
+    /// approximate number of hits on o; sets without counts report 0 or 1
+    virtual unsigned estimate_count(const hobject_t& o) const {
+      return contains(o) ? 1 : 0;
+    }
+    /// true if counts carry over between sets, so the current set alone
+    /// reflects the object's temperature
+    virtual bool is_cumulative() const {
+      return false;
+    }
+    /// seed a fresh set from its predecessor, scaling counts by factor
+    virtual void inherit(const Impl& prev, double factor) {}
     virtual ~Impl() {}
   };
 
@@ -152,6 +167,17 @@ public:
   unsigned approx_unique_insert_count() const {
     return impl->approx_unique_insert_count();
   }
+  unsigned estimate_count(const hobject_t& o) const {
+    return impl->estimate_count(o);
+  }
+  bool is_cumulative() const {
+    return impl->is_cumulative();
+  }
+  /// carry decayed counts over from prev, if both sets support it
+  void inherit(const HitSet& prev, double factor) {
+    if (prev.impl && prev.impl->get_type() == impl->get_type())
+      impl->inherit(*prev.impl, factor);
+  }
   void seal() {
     assert(!sealed);
     sealed = true;
@@ -450,4 +476,127 @@ public:
 };
 WRITE_CLASS_ENCODER(BloomHitSet)
 
+/**
+ * count-min sketch of per-object access frequency
+ *
+ * depth rows of width saturating 16-bit counters, each row indexed by an
+ * independent hash of the object.  The estimate for an object is the
+ * minimum over its counters, which never undercounts.  Counters are
+ * atomics so insert() and estimate_count() may run concurrently without
+ * any external lock.
+ *
+ * A new set inherits the decayed counters of its predecessor, so the
+ * current set alone carries the object's recent history and a tiering
+ * agent does not need to walk the archived sets.
+ */
+class CountMinHitSet : public HitSet::Impl {
+public:
+  /// bound on depth * width: 32 MB of counters
+  static const uint64_t MAX_COUNTERS = 1ull << 24;
+
+  static bool valid_size(uint32_t d, uint32_t w) {
+    return (uint64_t)d * w <= MAX_COUNTERS;
+  }
+
+  class Params : public HitSet::Params::Impl {
+  public:
+    HitSet::impl_type_t get_type() const override {
+      return HitSet::TYPE_COUNT_MIN;
+    }
+    HitSet::Impl *get_new_impl() const override {
+      return new CountMinHitSet(this);
+    }
+
+    uint32_t depth;  ///< number of hash rows
+    uint32_t width;  ///< counters per row
+    uint64_t seed;   ///< seed for the row hashes
+
+    Params() : depth(4), width(8192), seed(0) {}
+    Params(uint32_t d, uint32_t w, uint64_t s)
+      : depth(d), width(w), seed(s) {}
+    Params(const Params &o)
+      : depth(o.depth), width(o.width), seed(o.seed) {}
+    ~Params() {}
+
+    void encode(bufferlist& bl) const override {
+      ENCODE_START(1, 1, bl);
+      ::encode(depth, bl);
+      ::encode(width, bl);
+      ::encode(seed, bl);
+      ENCODE_FINISH(bl);
+    }
+    void decode(bufferlist::iterator& bl) override {
+      DECODE_START(1, bl);
+      ::decode(depth, bl);
+      ::decode(width, bl);
+      ::decode(seed, bl);
+      if (!valid_size(depth, width))
+	throw buffer::malformed_input("count-min sketch too large");
+      DECODE_FINISH(bl);
+    }
+    void dump(Formatter *f) const override;
+    void dump_stream(ostream& o) const override {
+      o << "depth: " << depth << ", width: " << width << ", seed: " << seed;
+    }
+    static void generate_test_instances(list<Params*>& o) {
+      o.push_back(new Params);
+      o.push_back(new Params(2, 16, 7));
+    }
+  };
+
+private:
+  uint32_t depth, width;
+  uint64_t seed;
+  std::unique_ptr<std::atomic<uint16_t>[]> counters;
+  std::atomic<uint64_t> count;
+
+  void init(uint32_t d, uint32_t w, uint64_t s);
+  uint32_t slot(uint32_t row, uint32_t hash) const;
+
+public:
+  CountMinHitSet() : depth(0), width(0), seed(0), count(0) {}
+  CountMinHitSet(uint32_t d, uint32_t w, uint64_t s) : count(0) {
+    init(d, w, s);
+  }
+  explicit CountMinHitSet(const CountMinHitSet::Params *p) : count(0) {
+    init(p->depth, p->width, p->seed);
+  }
+  CountMinHitSet(const CountMinHitSet &o);
+
+  HitSet::Impl *clone() const override {
+    return new CountMinHitSet(*this);
+  }
+  HitSet::impl_type_t get_type() const override {
+    return HitSet::TYPE_COUNT_MIN;
+  }
+  bool is_full() const override {
+    return false;
+  }
+  void insert(const hobject_t& o) override;
+  bool contains(const hobject_t& o) const override {
+    return estimate_count(o) > 0;
+  }
+  unsigned estimate_count(const hobject_t& o) const override;
+  bool is_cumulative() const override {
+    return true;
+  }
+  void inherit(const HitSet::Impl& prev, double factor) override;
+  unsigned insert_count() const override {
+    return count;
+  }
+  unsigned approx_unique_insert_count() const override;
+
+  void encode(bufferlist &bl) const override;
+  void decode(bufferlist::iterator &bl) override;
+  void dump(Formatter *f) const override;
+  static void generate_test_instances(list<CountMinHitSet*>& o) {
+    o.push_back(new CountMinHitSet);
+    o.push_back(new CountMinHitSet(2, 16, 1));
+    o.back()->insert(hobject_t());
+    o.back()->insert(hobject_t("asdf", "", CEPH_NOSNAP, 123, 1, ""));
+    o.back()->insert(hobject_t("qwer", "", CEPH_NOSNAP, 456, 1, ""));
+  }
+};
+WRITE_CLASS_ENCODER(CountMinHitSet)
+
 #endif
@@ -20,6 +20,7 @@
 #include <sys/stat.h>
 #include <signal.h>
 #include <ctype.h>
+#include <math.h>
 #include <boost/scoped_ptr.hpp>
 
 #ifdef HAVE_SYS_PARAM_H
@@ -265,6 +266,15 @@ OSDService::OSDService(OSD *osd) :
   recovery_ops_active(0),
   recovery_ops_reserved(0),
   recovery_paused(false),
+  recovery_bytes_avail(0),
+  recovery_objs_avail(0),
+  recovery_bytes_limited(false),
+  recovery_objs_limited(false),
+  recovery_scale(1.0),
+  recovery_bytes_total(0),
+  recovery_objs_total(0),
+  recovery_budget_stalls(0),
+  client_lat_avg_ns(0),
   map_cache_lock("OSDService::map_cache_lock"),
   map_cache(cct, cct->_conf->osd_map_cache_size),
   map_bl_cache(cct->_conf->osd_map_cache_size),
@@ -1739,6 +1749,7 @@ OSD::OSD(CephContext *cct_, ObjectStore *store_,
                                          cct->_conf->osd_op_log_threshold);
   op_tracker.set_history_size_and_duration(cct->_conf->osd_op_history_size,
                                            cct->_conf->osd_op_history_duration);
+  op_tracker.set_sample_rate(cct->_conf->osd_op_tracker_sample_rate);
 }
 
 OSD::~OSD()
@@ -1818,6 +1829,8 @@ bool OSD::asok_command(string command, cmdmap_t& cmdmap, string format,
       ss << "op_tracker tracking is not enabled now, so no ops are tracked currently, even those get stuck. \
 	Please enable \"osd_enable_op_tracker\", and the tracker will start to track new ops received afterwards.";
     }
+  } else if (command == "dump_recovery_scheduler") {
+    service.dump_recovery_scheduler(f);
   } else if (command == "dump_blocked_ops") {
     if (!op_tracker.dump_ops_in_flight(f, true)) {
       ss << "op_tracker tracking is not enabled now, so no ops are tracked currently, even those get stuck. \
@@ -2370,6 +2383,10 @@ void OSD::final_init()
 				     "dump_blocked_ops", asok_hook,
 				     "show the blocked ops currently in flight");
   assert(r == 0);
+  r = admin_socket->register_command("dump_recovery_scheduler",
+				     "dump_recovery_scheduler", asok_hook,
+				     "show recovery budget and queued pgs");
+  assert(r == 0);
   r = admin_socket->register_command("dump_historic_ops", "dump_historic_ops",
 				     asok_hook,
 				     "show slowest recent ops");
@@ -2549,6 +2566,8 @@ void OSD::create_logger()
 
   osd_plb.add_u64(l_osd_op_wip, "op_wip",
       "Replication operations currently being processed (primary)");   // rep ops currently being processed (primary)
+  // every op thread bumps these for every client op
+  osd_plb.set_sharded(true);
   osd_plb.add_u64_counter(l_osd_op,       "op",
       "Client operations", "ops");           // client ops
   osd_plb.add_u64_counter(l_osd_op_inb,   "op_in_bytes",
@@ -2606,6 +2625,9 @@ void OSD::create_logger()
       "Latency of read-modify-write operation (excluding queue time)");   // client rmw process latency
   osd_plb.add_time_avg(l_osd_op_rw_prepare_lat, "op_rw_prepare_latency",
       "Latency of read-modify-write operations (excluding queue time and wait for finished)"); // client rmw prepare latency
+  osd_plb.set_sharded(false);
+  osd_plb.add_u64_counter(l_osd_op_coalesced, "op_coalesced",
+      "Client writes submitted as part of a coalesced transaction");
 
   osd_plb.add_u64_counter(l_osd_sop,       "subop", "Suboperations");         // subops
   osd_plb.add_u64_counter(l_osd_sop_inb,   "subop_in_bytes", "Suboperations total size");     // subop in bytes
@@ -2783,6 +2805,7 @@ int OSD::shutdown()
   cct->get_admin_socket()->unregister_command("dump_ops_in_flight");
   cct->get_admin_socket()->unregister_command("ops");
   cct->get_admin_socket()->unregister_command("dump_blocked_ops");
+  cct->get_admin_socket()->unregister_command("dump_recovery_scheduler");
   cct->get_admin_socket()->unregister_command("dump_historic_ops");
   cct->get_admin_socket()->unregister_command("dump_op_pq_state");
   cct->get_admin_socket()->unregister_command("dump_blacklist");
@@ -8550,6 +8573,24 @@ void OSD::_remove_pg(PG *pg)
 // =========================================================
 // RECOVERY
 
+void OSDService::queue_for_recovery(PG *pg, bool front)
+{
+  // computed outside recovery_lock; the caller holds the pg lock
+  unsigned priority = pg->get_backfill_priority();
+  epoch_t e = pg->get_osdmap()->get_epoch();
+  Mutex::Locker l(recovery_lock);
+  // keep awaiting_throttle sorted by descending priority, fifo within a
+  // priority (or lifo if front), so the least redundant pgs go first
+  list<recovery_queue_item_t>::iterator i = awaiting_throttle.begin();
+  while (i != awaiting_throttle.end() &&
+	 (i->priority > priority ||
+	  (!front && i->priority == priority)))
+    ++i;
+  awaiting_throttle.insert(
+    i, recovery_queue_item_t(e, pg, priority, ceph_clock_now()));
+  _maybe_queue_recovery();
+}
+
 void OSDService::_maybe_queue_recovery() {
   assert(recovery_lock.is_locked_by_me());
   uint64_t available_pushes;
@@ -8558,12 +8599,80 @@ void OSDService::_maybe_queue_recovery() {
     uint64_t to_start = MIN(
       available_pushes,
       cct->_conf->osd_recovery_max_single_start);
+    if (cct->_conf->osd_recovery_max_ops_per_sec)
+      to_start = MIN(to_start, (uint64_t)recovery_objs_avail);
     _queue_for_recovery(awaiting_throttle.front(), to_start);
     awaiting_throttle.pop_front();
     recovery_ops_reserved += to_start;
   }
 }
 
+void OSDService::_refill_recovery_budget(utime_t now)
+{
+  assert(recovery_lock.is_locked_by_me());
+  if (recovery_budget_stamp == utime_t()) {
+    recovery_budget_stamp = now;
+    return;
+  }
+  double elapsed = (double)(now - recovery_budget_stamp);
+  if (elapsed < .01)
+    return;
+  recovery_budget_stamp = now;
+  if (elapsed > 1.0)
+    elapsed = 1.0;
+
+  double target = cct->_conf->osd_recovery_target_client_latency;
+  if (target > 0) {
+    double lat = (double)client_lat_avg_ns.load(std::memory_order_relaxed) /
+      1000000000.0;
+    if (lat > target) {
+      // halve per second spent above target
+      recovery_scale *= pow(0.5, elapsed);
+    } else {
+      recovery_scale += 0.1 * elapsed;
+    }
+    double min_scale = cct->_conf->osd_recovery_min_rate_scale;
+    if (recovery_scale < min_scale)
+      recovery_scale = min_scale;
+    if (recovery_scale > 1.0)
+      recovery_scale = 1.0;
+  } else {
+    recovery_scale = 1.0;
+  }
+
+  uint64_t max_bytes = cct->_conf->osd_recovery_max_bytes_per_sec;
+  if (max_bytes) {
+    // allow up to one second of burst, but always at least one chunk
+    int64_t rate = MAX(1, (int64_t)(max_bytes * recovery_scale));
+    int64_t cap = MAX(rate, (int64_t)cct->_conf->osd_recovery_max_chunk);
+    if (!recovery_bytes_limited) {
+      // the limit was just set: start with a full bucket
+      recovery_bytes_avail = cap;
+      recovery_bytes_limited = true;
+    } else {
+      recovery_bytes_avail = MIN(cap,
+				 recovery_bytes_avail + (int64_t)(rate * elapsed));
+    }
+  } else {
+    recovery_bytes_limited = false;
+  }
+  uint64_t max_ops = cct->_conf->osd_recovery_max_ops_per_sec;
+  if (max_ops) {
+    double rate = max_ops * recovery_scale;
+    int64_t cap = MAX(1, (int64_t)rate);
+    if (!recovery_objs_limited) {
+      recovery_objs_avail = cap;
+      recovery_objs_limited = true;
+    } else {
+      // round fractional tokens up so low rates still make progress
+      recovery_objs_avail = MIN(cap,
+				recovery_objs_avail + (int64_t)ceil(rate * elapsed));
+    }
+  } else {
+    recovery_objs_limited = false;
+  }
+}
+
 bool OSDService::_recover_now(uint64_t *available_pushes)
 {
   uint64_t max = cct->_conf->osd_recovery_max_active;
@@ -8579,7 +8688,8 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
   if (available_pushes)
     *available_pushes = max - recovery_ops_active - recovery_ops_reserved;
 
-  if (ceph_clock_now() < defer_recovery_until) {
+  utime_t now = ceph_clock_now();
+  if (now < defer_recovery_until) {
     dout(15) << "_recover_now defer until " << defer_recovery_until << dendl;
     return false;
   }
@@ -8588,9 +8698,62 @@ bool OSDService::_recover_now(uint64_t *available_pushes)
     dout(15) << "_recover_now paused" << dendl;
     return false;
   }
+
+  _refill_recovery_budget(now);
+  if ((cct->_conf->osd_recovery_max_bytes_per_sec &&
+       recovery_bytes_avail <= 0) ||
+      (cct->_conf->osd_recovery_max_ops_per_sec &&
+       recovery_objs_avail <= 0)) {
+    dout(15) << "_recover_now over budget, bytes " << recovery_bytes_avail
+	     << " objs " << recovery_objs_avail
+	     << " scale " << recovery_scale << dendl;
+    ++recovery_budget_stalls;
+    return false;
+  }
   return true;
 }
 
+void OSDService::dump_recovery_scheduler(Formatter *f)
+{
+  Mutex::Locker l(recovery_lock);
+  utime_t now = ceph_clock_now();
+  f->open_object_section("recovery_scheduler");
+  f->dump_unsigned("ops_active", recovery_ops_active);
+  f->dump_unsigned("ops_reserved", recovery_ops_reserved);
+  f->dump_unsigned("max_active", cct->_conf->osd_recovery_max_active);
+  f->dump_bool("paused", recovery_paused);
+  f->dump_stream("defer_until") << defer_recovery_until;
+  f->open_object_section("budget");
+  f->dump_unsigned("max_bytes_per_sec",
+		   cct->_conf->osd_recovery_max_bytes_per_sec);
+  f->dump_unsigned("max_ops_per_sec",
+		   cct->_conf->osd_recovery_max_ops_per_sec);
+  f->dump_int("bytes_avail", recovery_bytes_avail);
+  f->dump_int("ops_avail", recovery_objs_avail);
+  f->dump_float("rate_scale", recovery_scale);
+  f->dump_float("target_client_latency",
+		cct->_conf->osd_recovery_target_client_latency);
+  f->dump_float("client_latency",
+		(double)client_lat_avg_ns.load() / 1000000000.0);
+  f->dump_unsigned("bytes_total", recovery_bytes_total);
+  f->dump_unsigned("ops_total", recovery_objs_total);
+  f->dump_unsigned("stalls", recovery_budget_stalls);
+  f->close_section();
+  f->open_array_section("awaiting_throttle");
+  for (list<recovery_queue_item_t>::iterator i = awaiting_throttle.begin();
+       i != awaiting_throttle.end();
+       ++i) {
+    f->open_object_section("pg");
+    f->dump_stream("pgid") << i->pg->info.pgid;
+    f->dump_unsigned("priority", i->priority);
+    f->dump_unsigned("epoch", i->epoch);
+    f->dump_float("waiting", (double)(now - i->queued));
+    f->close_section();
+  }
+  f->close_section();
+  f->close_section();
+}
+
 void OSD::do_recovery(
   PG *pg, epoch_t queued, uint64_t reserved_pushes,
   ThreadPool::TPHandle &handle)
@@ -8669,6 +8832,9 @@ void OSDService::start_recovery_op(PG *pg, const hobject_t& soid)
 	   << cct->_conf->osd_recovery_max_active << " rops)"
 	   << dendl;
   recovery_ops_active++;
+  if (cct->_conf->osd_recovery_max_ops_per_sec)
+    recovery_objs_avail--;
+  recovery_objs_total++;
 
 #ifdef DEBUG_RECOVERY_OIDS
   dout(20) << "  active was " << recovery_oids[pg->info.pgid] << dendl;
@@ -9240,6 +9406,7 @@ const char** OSD::get_tracked_conf_keys() const
     "osd_op_complaint_time", "osd_op_log_threshold",
     "osd_op_history_size", "osd_op_history_duration",
     "osd_enable_op_tracker",
+    "osd_op_tracker_sample_rate",
     "osd_map_cache_size",
     "osd_map_max_advance",
     "osd_pg_epoch_persisted_max_stale",
@@ -9288,6 +9455,9 @@ void OSD::handle_conf_change(const struct md_config_t *conf,
   if (changed.count("osd_enable_op_tracker")) {
       op_tracker.set_tracking(cct->_conf->osd_enable_op_tracker);
   }
+  if (changed.count("osd_op_tracker_sample_rate")) {
+    op_tracker.set_sample_rate(cct->_conf->osd_op_tracker_sample_rate);
+  }
   if (changed.count("osd_disk_thread_ioprio_class") ||
       changed.count("osd_disk_thread_ioprio_priority")) {
     set_disk_tp_priority();
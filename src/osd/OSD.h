@@ -88,6 +88,7 @@ enum {
   l_osd_op_rw_lat_outb_hist,
   l_osd_op_rw_process_lat,
   l_osd_op_rw_prepare_lat,
+  l_osd_op_coalesced,
 
   l_osd_sop,
   l_osd_sop_inb,
@@ -925,25 +926,58 @@ public:
 
 private:
   // -- pg recovery and associated throttling --
+  struct recovery_queue_item_t {
+    epoch_t epoch;
+    PGRef pg;
+    unsigned priority;  ///< higher -> fewer surviving copies
+    utime_t queued;
+    recovery_queue_item_t(epoch_t e, PGRef p, unsigned prio, utime_t q)
+      : epoch(e), pg(p), priority(prio), queued(q) {}
+  };
   Mutex recovery_lock;
-  list<pair<epoch_t, PGRef> > awaiting_throttle;
+  list<recovery_queue_item_t> awaiting_throttle;  ///< sorted by priority
 
   utime_t defer_recovery_until;
   uint64_t recovery_ops_active;
   uint64_t recovery_ops_reserved;
   bool recovery_paused;
+
+  /**
+   * recovery budget
+   *
+   * Token buckets for recovery bytes and objects, refilled at
+   * osd_recovery_max_{bytes,ops}_per_sec scaled by recovery_scale.
+   * recovery_scale follows an AIMD policy against the measured client
+   * op latency (osd_recovery_target_client_latency): halved whenever
+   * clients are slower than the target, grown additively otherwise.
+   * A bucket may go negative since bytes are charged once a push is
+   * built; new recovery simply waits until it is paid back.  Buckets
+   * are only charged while their limit is set, and start out full when
+   * it is set at runtime.
+   */
+  int64_t recovery_bytes_avail;
+  int64_t recovery_objs_avail;
+  bool recovery_bytes_limited;  ///< max_bytes_per_sec set at last refill
+  bool recovery_objs_limited;   ///< max_ops_per_sec set at last refill
+  utime_t recovery_budget_stamp;
+  double recovery_scale;
+  uint64_t recovery_bytes_total;
+  uint64_t recovery_objs_total;
+  uint64_t recovery_budget_stalls;
+  std::atomic<uint64_t> client_lat_avg_ns;  ///< ewma of client op latency
 #ifdef DEBUG_RECOVERY_OIDS
   map<spg_t, set<hobject_t> > recovery_oids;
 #endif
+  void _refill_recovery_budget(utime_t now);
   bool _recover_now(uint64_t *available_pushes);
   void _maybe_queue_recovery();
   void _queue_for_recovery(
-    pair<epoch_t, PGRef> p, uint64_t reserved_pushes) {
+    const recovery_queue_item_t &p, uint64_t reserved_pushes) {
     assert(recovery_lock.is_locked_by_me());
     pair<PGRef, PGQueueable> to_queue = make_pair(
-      p.second,
+      p.pg,
       PGQueueable(
-	PGRecovery(p.first, reserved_pushes),
+	PGRecovery(p.epoch, reserved_pushes),
 	cct->_conf->osd_recovery_cost,
 	cct->_conf->osd_recovery_priority,
 	ceph_clock_now(),
@@ -983,10 +1017,10 @@ public:
   }
   void clear_queued_recovery(PG *pg, bool front = false) {
     Mutex::Locker l(recovery_lock);
-    for (list<pair<epoch_t, PGRef> >::iterator i = awaiting_throttle.begin();
+    for (list<recovery_queue_item_t>::iterator i = awaiting_throttle.begin();
 	 i != awaiting_throttle.end();
       ) {
-      if (i->second.get() == pg) {
+      if (i->pg.get() == pg) {
 	awaiting_throttle.erase(i);
 	return;
       } else {
@@ -995,15 +1029,23 @@ public:
     }
   }
   // delayed pg activation
-  void queue_for_recovery(PG *pg, bool front = false) {
+  void queue_for_recovery(PG *pg, bool front = false);
+  /// charge bytes pushed or pulled by recovery against the budget
+  void note_recovery_bytes(uint64_t bytes) {
     Mutex::Locker l(recovery_lock);
-    if (front) {
-      awaiting_throttle.push_front(make_pair(pg->get_osdmap()->get_epoch(), pg));
-    } else {
-      awaiting_throttle.push_back(make_pair(pg->get_osdmap()->get_epoch(), pg));
-    }
-    _maybe_queue_recovery();
-  }
+    if (cct->_conf->osd_recovery_max_bytes_per_sec)
+      recovery_bytes_avail -= bytes;
+    recovery_bytes_total += bytes;
+  }
+  /// feed a completed client op latency into the recovery rate control
+  void note_client_op_latency(const utime_t& lat) {
+    uint64_t ns = lat.to_nsec();
+    uint64_t avg = client_lat_avg_ns.load(std::memory_order_relaxed);
+    // ewma with alpha 1/16; racing updates only lose a sample
+    client_lat_avg_ns.store(avg ? avg - avg / 16 + ns / 16 : ns,
+			    std::memory_order_relaxed);
+  }
+  void dump_recovery_scheduler(Formatter *f);
 
 
   // osd map cache (past osd maps)
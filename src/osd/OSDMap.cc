@@ -1054,6 +1054,10 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
 	p->second.is_tier()) {
       features |= CEPH_FEATURE_OSD_CACHEPOOL;
     }
+    if (p->second.hit_set_params.get_type() == HitSet::TYPE_COUNT_MIN) {
+      // pre-luminous peers cannot decode count_min hit set params
+      features |= CEPH_FEATUREMASK_SERVER_LUMINOUS;
+    }
     int ruleid = crush->find_rule(p->second.get_crush_ruleset(),
 				  p->second.get_type(),
 				  p->second.get_size());
@@ -1080,7 +1084,8 @@ uint64_t OSDMap::get_features(int entity_type, uint64_t *pmask) const
       }
     }
   }
-  mask |= CEPH_FEATURE_OSDHASHPSPOOL | CEPH_FEATURE_OSD_CACHEPOOL;
+  mask |= CEPH_FEATURE_OSDHASHPSPOOL | CEPH_FEATURE_OSD_CACHEPOOL |
+    CEPH_FEATUREMASK_SERVER_LUMINOUS;
   if (entity_type != CEPH_ENTITY_TYPE_CLIENT)
     mask |= CEPH_FEATURE_OSD_ERASURE_CODES;
 
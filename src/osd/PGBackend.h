@@ -257,6 +257,9 @@ typedef ceph::shared_ptr<const OSDMap> OSDMapRef;
 
      virtual PerfCounters *get_logger() = 0;
 
+     /// charge recovery traffic against the osd recovery budget
+     virtual void note_recovery_bytes(uint64_t bytes) = 0;
+
      virtual ceph_tid_t get_tid() = 0;
 
      virtual LogClientTemp clog_error() = 0;
@@ -369,7 +369,7 @@ void PGLog::merge_log(ObjectStore::Transaction& t,
     }
     log.roll_forward_to(log.head, rollbacker);
 
-    mempool::osd::list<pg_log_entry_t> new_entries;
+    mempool::osd_pglog::list<pg_log_entry_t> new_entries;
     new_entries.splice(new_entries.end(), olog.log, from, to);
     append_log_entries_update_missing(
       info.last_backfill,
@@ -483,6 +483,40 @@ public:
     op.omap_header = header;
   }
 
+  /**
+   * Appends the updates in other as if they had been made to this
+   * transaction after its own.  other may only modify objects in
+   * place: no create/clone/rename/remove, truncate, omap clear or
+   * snap updates.
+   */
+  void append(PGTransaction &&other) {
+    for (auto &&i: other.obc_map) {
+      obc_map.insert(i);
+    }
+    for (auto &&i: other.op_map) {
+      auto &theirs = i.second;
+      assert(theirs.is_none());
+      assert(!theirs.truncate);
+      assert(!theirs.clear_omap);
+      assert(!theirs.updated_snaps);
+      auto &op = get_object_op_for_modify(i.first);
+      assert(!op.updated_snaps);
+      for (auto &&j: theirs.attr_updates) {
+	op.attr_updates[j.first] = std::move(j.second);
+      }
+      for (auto &&j: theirs.omap_updates) {
+	op.omap_updates.emplace_back(std::move(j));
+      }
+      if (theirs.omap_header)
+	op.omap_header = std::move(theirs.omap_header);
+      if (theirs.alloc_hint)
+	op.alloc_hint = theirs.alloc_hint;
+      op.buffer_updates.insert(std::move(theirs.buffer_updates));
+    }
+    other.op_map.clear();
+    other.obc_map.clear();
+  }
+
   bool empty() const {
     return op_map.empty();
   }
@@ -1770,24 +1770,27 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
     return;
   }
 
+  // one consistent view of the options for the rest of the op
+  const md_config_snapshot_t *conf = cct->_conf->snapshot();
+
   // object name too long?
-  if (m->get_oid().name.size() > cct->_conf->osd_max_object_name_len) {
+  if (m->get_oid().name.size() > conf->osd_max_object_name_len) {
     dout(4) << "do_op name is longer than "
-	    << cct->_conf->osd_max_object_name_len
+	    << conf->osd_max_object_name_len
 	    << " bytes" << dendl;
     osd->reply_op_error(op, -ENAMETOOLONG);
     return;
   }
-  if (m->get_hobj().get_key().size() > cct->_conf->osd_max_object_name_len) {
+  if (m->get_hobj().get_key().size() > conf->osd_max_object_name_len) {
     dout(4) << "do_op locator is longer than "
-	    << cct->_conf->osd_max_object_name_len
+	    << conf->osd_max_object_name_len
 	    << " bytes" << dendl;
     osd->reply_op_error(op, -ENAMETOOLONG);
     return;
   }
-  if (m->get_hobj().nspace.size() > cct->_conf->osd_max_object_namespace_len) {
+  if (m->get_hobj().nspace.size() > conf->osd_max_object_namespace_len) {
     dout(4) << "do_op namespace is longer than "
-	    << cct->_conf->osd_max_object_namespace_len
+	    << conf->osd_max_object_namespace_len
 	    << " bytes" << dendl;
     osd->reply_op_error(op, -ENAMETOOLONG);
     return;
@@ -1845,11 +1848,11 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
     }
 
     // too big?
-    if (cct->_conf->osd_max_write_size &&
-        m->get_data_len() > cct->_conf->osd_max_write_size << 20) {
+    if (conf->osd_max_write_size &&
+        m->get_data_len() > conf->osd_max_write_size << 20) {
       // journal can't hold commit!
       derr << "do_op msg data len " << m->get_data_len()
-           << " > osd_max_write_size " << (cct->_conf->osd_max_write_size << 20)
+           << " > osd_max_write_size " << (conf->osd_max_write_size << 20)
            << " on " << *m << dendl;
       osd->reply_op_error(op, -OSD_WRITETOOBIG);
       return;
@@ -1867,8 +1870,8 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
   // missing object?
   if (is_unreadable_object(head)) {
     if (can_backoff &&
-	(g_conf->osd_backoff_on_degraded ||
-	 (g_conf->osd_backoff_on_unfound && missing_loc.is_unfound(head)))) {
+	(conf->osd_backoff_on_degraded ||
+	 (conf->osd_backoff_on_unfound && missing_loc.is_unfound(head)))) {
       add_backoff(session, head, head);
       maybe_kick_recovery(head);
     } else {
@@ -1879,7 +1882,7 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
 
   // degraded object?
   if (write_ordered && is_degraded_or_backfilling_object(head)) {
-    if (can_backoff && g_conf->osd_backoff_on_degraded) {
+    if (can_backoff && conf->osd_backoff_on_degraded) {
       add_backoff(session, head, head);
     } else {
       wait_for_degraded_object(head, op);
@@ -1954,6 +1957,8 @@ void PrimaryLogPG::do_op(OpRequestRef& op)
     if (got) {
       dout(3) << __func__ << " dup " << m->get_reqid()
 	      << " version " << version << dendl;
+      // the original may still be parked; make sure it is in flight
+      flush_coalesced_writes();
       if (already_complete(version)) {
 	osd->reply_op_error(op, return_code, version, user_version);
       } else {
@@ -2195,7 +2200,7 @@ void PrimaryLogPG::record_write_error(OpRequestRef op, const hobject_t &soid,
   assert(op->may_write());
   const osd_reqid_t &reqid = static_cast<MOSDOp*>(op->get_req())->get_reqid();
   ObjectContextRef obc;
-  mempool::osd::list<pg_log_entry_t> entries;
+  mempool::osd_pglog::list<pg_log_entry_t> entries;
   entries.push_back(pg_log_entry_t(pg_log_entry_t::ERROR, soid,
 				   get_next_version(), eversion_t(), 0,
 				   reqid, utime_t(), r));
@@ -2472,7 +2477,17 @@ bool PrimaryLogPG::maybe_promote(ObjectContextRef obc,
     }
     break;
   default:
-    {
+    if (hit_set && hit_set->is_cumulative()) {
+      // decayed hit count, not counting the access being handled
+      const hobject_t& oid = obc.get() ? obc->obs.oi.soid : missing_oid;
+      unsigned count = hit_set->estimate_count(oid);
+      if (count)
+	--count;
+      if (count >= recency) {
+	break;
+      }
+      return false;	// not promoting
+    } else {
       unsigned count = (int)in_hit_set;
       if (count) {
 	// Check if in other hit sets
@@ -2986,6 +3001,9 @@ void PrimaryLogPG::execute_ctx(OpContext *ctx)
   dout(30) << __func__ << " user_at_version " << ctx->user_at_version << dendl;
 
   if (op->may_read()) {
+    // parked writes must reach the store before we read it
+    if (!coalesced_writes.ctxs.empty() && coalesced_writes.hoid == soid)
+      flush_coalesced_writes();
     dout(10) << " taking ondisk_read_lock" << dendl;
     obc->ondisk_read_lock();
   }
@@ -3144,6 +3162,11 @@ void PrimaryLogPG::execute_ctx(OpContext *ctx)
       delete ctx;
     });
 
+  if (can_coalesce_write(ctx)) {
+    coalesce_write(ctx);
+    return;
+  }
+
   // issue replica writes
   ceph_tid_t rep_tid = osd->get_tid();
 
@@ -3154,6 +3177,135 @@ void PrimaryLogPG::execute_ctx(OpContext *ctx)
   repop->put();
 }
 
+bool PrimaryLogPG::can_coalesce_write(OpContext *ctx)
+{
+  if (!cct->_conf->osd_op_coalesce_max_ops ||
+      pool.info.require_rollback() ||
+      pool.info.is_tier())
+    return false;
+  if (!ctx->op || ctx->op->may_read() || ctx->op->may_cache())
+    return false;
+  if (ctx->clone_obc || ctx->snapset_obc || ctx->updated_hset_history ||
+      ctx->log.size() != 1 || !ctx->obs->exists || !ctx->new_obs.exists)
+    return false;
+  if (!ctx->watch_connects.empty() || !ctx->watch_disconnects.empty() ||
+      !ctx->notifies.empty() || !ctx->notify_acks.empty())
+    return false;
+  const hobject_t &soid = ctx->obc->obs.oi.soid;
+  if (ctx->op_t->op_map.size() != 1 ||
+      ctx->op_t->op_map.begin()->first != soid)
+    return false;
+  const PGTransaction::ObjectOperation &oop =
+    ctx->op_t->op_map.begin()->second;
+  if (!oop.is_none() || oop.truncate || oop.clear_omap || oop.updated_snaps)
+    return false;
+
+  if (!coalesced_writes.ctxs.empty())
+    return coalesced_writes.hoid == soid;
+  // only worth holding back if the previous write to this object is
+  // still in flight; its completion will release the batch
+  return !repop_queue.empty() &&
+    repop_queue.back()->hoid == soid &&
+    !repop_queue.back()->all_applied &&
+    !repop_queue.back()->rep_aborted;
+}
+
+void PrimaryLogPG::coalesce_write(OpContext *ctx)
+{
+  const hobject_t &soid = ctx->obc->obs.oi.soid;
+  dout(10) << __func__ << " " << soid << " " << ctx->at_version
+	   << " " << ctx->reqid << dendl;
+
+  // stage the log entry as issue_repop would, so the next op gets a new
+  // version and a resend of this one is recognized as a dup
+  assert(ctx->at_version > projected_last_update);
+  projected_last_update = ctx->at_version;
+  for (auto &&entry: ctx->log) {
+    projected_log.add(entry);
+  }
+  ctx->log_staged = true;
+
+  if (coalesced_writes.ctxs.empty())
+    coalesced_writes.hoid = soid;
+  coalesced_writes.ctxs.push_back(ctx);
+  coalesced_writes.bytes += ctx->bytes_written;
+  if (ctx->op)
+    ctx->op->mark_event("coalesced");
+
+  if (coalesced_writes.ctxs.size() >= cct->_conf->osd_op_coalesce_max_ops ||
+      coalesced_writes.bytes >= cct->_conf->osd_op_coalesce_max_bytes)
+    flush_coalesced_writes();
+}
+
+void PrimaryLogPG::flush_coalesced_writes()
+{
+  if (coalesced_writes.ctxs.empty())
+    return;
+
+  list<OpContext*> ctxs;
+  ctxs.swap(coalesced_writes.ctxs);
+  coalesced_writes.bytes = 0;
+
+  OpContext *ctx = ctxs.front();
+  ctxs.pop_front();
+  eversion_t first_v = ctx->at_version;
+  dout(10) << __func__ << " " << coalesced_writes.hoid << " "
+	   << (ctxs.size() + 1) << " ops from " << first_v << dendl;
+
+  // fold the rest into the first ctx; each keeps its own log entry,
+  // reply and completion callbacks
+  list<OpRequestRef> coalesced_ops;
+  for (auto other : ctxs) {
+    ctx->op_t->append(std::move(*other->op_t));
+    other->op_t.reset();
+    ctx->delta_stats.add(other->delta_stats);
+    ctx->log.insert(ctx->log.end(), other->log.begin(), other->log.end());
+    assert(other->at_version > ctx->at_version);
+    ctx->at_version = other->at_version;
+    ctx->on_applied.splice(ctx->on_applied.end(), other->on_applied);
+    ctx->on_committed.splice(ctx->on_committed.end(), other->on_committed);
+    ctx->on_success.splice(ctx->on_success.end(), other->on_success);
+    ctx->register_on_finish(
+      [other, this]() {
+	release_object_locks(other->lock_manager);
+      });
+    ctx->on_finish.splice(ctx->on_finish.end(), other->on_finish);
+    if (other->op)
+      coalesced_ops.push_back(other->op);
+  }
+  osd->logger->inc(l_osd_op_coalesced, ctxs.size() + 1);
+
+  ceph_tid_t rep_tid = osd->get_tid();
+  RepGather *repop = new_repop(ctx, ctx->obc, rep_tid);
+  repop->coalesced_ops.swap(coalesced_ops);
+  issue_repop(repop, ctx);
+  repop->first_v = first_v;
+  eval_repop(repop);
+  repop->put();
+}
+
+void PrimaryLogPG::cancel_coalesced_writes(list<OpRequestRef> *requeue)
+{
+  for (auto ctx : coalesced_writes.ctxs) {
+    dout(10) << __func__ << " " << ctx->reqid << dendl;
+    if (requeue && ctx->op)
+      requeue->push_back(ctx->op);
+    ctx->on_applied.clear();
+    ctx->on_committed.clear();
+    ctx->on_success.clear();
+    release_object_locks(ctx->lock_manager);
+    ctx->op_t.reset();
+    // on_finish deletes ctx
+    for (auto p = ctx->on_finish.begin();
+	 p != ctx->on_finish.end();
+	 ctx->on_finish.erase(p++)) {
+      (*p)();
+    }
+  }
+  coalesced_writes.ctxs.clear();
+  coalesced_writes.bytes = 0;
+}
+
 void PrimaryLogPG::reply_ctx(OpContext *ctx, int r)
 {
   if (ctx->op)
@@ -3188,6 +3340,7 @@ void PrimaryLogPG::log_op_stats(OpContext *ctx)
   osd->logger->inc(l_osd_op_inb, inb);
   osd->logger->tinc(l_osd_op_lat, latency);
   osd->logger->tinc(l_osd_op_process_lat, process_latency);
+  osd->note_client_op_latency(latency);
 
   if (op->may_read() && op->may_write()) {
     osd->logger->inc(l_osd_op_rw);
@@ -8327,16 +8480,17 @@ void PrimaryLogPG::eval_repop(RepGather *repop)
       (*p)();
     }
     // send dup commits, in order
-    if (waiting_for_ondisk.count(repop->v)) {
-      assert(waiting_for_ondisk.begin()->first == repop->v);
+    while (!waiting_for_ondisk.empty() &&
+	   waiting_for_ondisk.begin()->first <= repop->v) {
+      assert(waiting_for_ondisk.begin()->first >= repop->first_v);
       for (list<pair<OpRequestRef, version_t> >::iterator i =
-	     waiting_for_ondisk[repop->v].begin();
-	   i != waiting_for_ondisk[repop->v].end();
+	     waiting_for_ondisk.begin()->second.begin();
+	   i != waiting_for_ondisk.begin()->second.end();
 	   ++i) {
-	osd->reply_op_error(i->first, repop->r, repop->v,
-			    i->second);
+	osd->reply_op_error(i->first, repop->r,
+			    waiting_for_ondisk.begin()->first, i->second);
       }
-      waiting_for_ondisk.erase(repop->v);
+      waiting_for_ondisk.erase(waiting_for_ondisk.begin());
     }
   }
 
@@ -8383,6 +8537,10 @@ void PrimaryLogPG::eval_repop(RepGather *repop)
       }
     }
   }
+
+  // a write has landed; release whatever queued up behind it
+  if (repop->all_applied && !coalesced_writes.ctxs.empty())
+    flush_coalesced_writes();
 }
 
 void PrimaryLogPG::issue_repop(RepGather *repop, OpContext *ctx)
@@ -8393,7 +8551,7 @@ void PrimaryLogPG::issue_repop(RepGather *repop, OpContext *ctx)
           << " o " << soid
           << dendl;
 
-  repop->v = ctx->at_version;
+  repop->v = repop->first_v = ctx->at_version;
   if (ctx->at_version > eversion_t()) {
     for (set<pg_shard_t>::iterator i = actingbackfill.begin();
 	 i != actingbackfill.end();
@@ -8428,12 +8586,17 @@ void PrimaryLogPG::issue_repop(RepGather *repop, OpContext *ctx)
     ctx->obc,
     ctx->clone_obc,
     unlock_snapset_obc ? ctx->snapset_obc : ObjectContextRef());
-  if (!(ctx->log.empty())) {
-    assert(ctx->at_version >= projected_last_update);
-    projected_last_update = ctx->at_version;
-  }
-  for (auto &&entry: ctx->log) {
-    projected_log.add(entry);
+  if (ctx->log_staged) {
+    // coalesced writes were staged as they were parked
+    assert(ctx->at_version == projected_last_update);
+  } else {
+    if (!(ctx->log.empty())) {
+      assert(ctx->at_version >= projected_last_update);
+      projected_last_update = ctx->at_version;
+    }
+    for (auto &&entry: ctx->log) {
+      projected_log.add(entry);
+    }
   }
   pgbackend->submit_transaction(
     soid,
@@ -8456,6 +8619,9 @@ PrimaryLogPG::RepGather *PrimaryLogPG::new_repop(
   OpContext *ctx, ObjectContextRef obc,
   ceph_tid_t rep_tid)
 {
+  // anything parked has older versions and must be issued first
+  flush_coalesced_writes();
+
   if (ctx->op)
     dout(10) << "new_repop rep_tid " << rep_tid << " on " << *ctx->op->get_req() << dendl;
   else
@@ -8490,7 +8656,7 @@ boost::intrusive_ptr<PrimaryLogPG::RepGather> PrimaryLogPG::new_repop(
     info.last_complete,
     true,
     r);
-  repop->v = version;
+  repop->v = repop->first_v = version;
 
   repop->start = ceph_clock_now();
 
@@ -8542,7 +8708,7 @@ void PrimaryLogPG::simple_opc_submit(OpContextUPtr ctx)
 
 
 void PrimaryLogPG::submit_log_entries(
-  const mempool::osd::list<pg_log_entry_t> &entries,
+  const mempool::osd_pglog::list<pg_log_entry_t> &entries,
   ObcLockManager &&manager,
   boost::optional<std::function<void(void)> > &&_on_complete,
   OpRequestRef op,
@@ -8551,6 +8717,8 @@ void PrimaryLogPG::submit_log_entries(
   dout(10) << __func__ << " " << entries << dendl;
   assert(is_primary());
 
+  flush_coalesced_writes();
+
   eversion_t version;
   if (!entries.empty()) {
     assert(entries.rbegin()->version >= projected_last_update);
@@ -9701,7 +9869,7 @@ void PrimaryLogPG::mark_all_unfound_lost(
   pg_log.get_log().print(*_dout);
   *_dout << dendl;
 
-  mempool::osd::list<pg_log_entry_t> log_entries;
+  mempool::osd_pglog::list<pg_log_entry_t> log_entries;
 
   utime_t mtime = ceph_clock_now();
   map<hobject_t, pg_missing_item>::const_iterator m =
@@ -9830,11 +9998,16 @@ void PrimaryLogPG::apply_and_flush_repops(bool requeue)
 	rq.push_back(repop->op);
 	repop->op = OpRequestRef();
       }
+      for (auto &&op : repop->coalesced_ops) {
+	dout(10) << " requeuing " << *op->get_req() << dendl;
+	rq.push_back(op);
+      }
+      repop->coalesced_ops.clear();
 
       // also requeue any dups, interleaved into position
       map<eversion_t, list<pair<OpRequestRef, version_t> > >::iterator p =
-	waiting_for_ondisk.find(repop->v);
-      if (p != waiting_for_ondisk.end()) {
+	waiting_for_ondisk.lower_bound(repop->first_v);
+      while (p != waiting_for_ondisk.end() && p->first <= repop->v) {
 	dout(10) << " also requeuing ondisk waiters " << p->second << dendl;
 	for (list<pair<OpRequestRef, version_t> >::iterator i =
 	       p->second.begin();
@@ -9842,7 +10015,7 @@ void PrimaryLogPG::apply_and_flush_repops(bool requeue)
 	     ++i) {
 	  rq.push_back(i->first);
 	}
-	waiting_for_ondisk.erase(p);
+	waiting_for_ondisk.erase(p++);
       }
     }
 
@@ -9851,6 +10024,9 @@ void PrimaryLogPG::apply_and_flush_repops(bool requeue)
 
   assert(repop_queue.empty());
 
+  // parked writes are newer than anything that was in flight
+  cancel_coalesced_writes(requeue ? &rq : nullptr);
+
   if (requeue) {
     requeue_ops(rq);
     if (!waiting_for_ondisk.empty()) {
@@ -11386,6 +11562,7 @@ void PrimaryLogPG::hit_set_clear()
   dout(20) << __func__ << dendl;
   hit_set.reset();
   hit_set_start_stamp = utime_t();
+  hit_set_seed_pending = false;
 }
 
 void PrimaryLogPG::hit_set_setup()
@@ -11492,10 +11669,82 @@ void PrimaryLogPG::hit_set_create()
     dout(10) << __func__ << " target_size " << p->target_size
 	     << " fpp " << p->get_fpp() << dendl;
   }
+  HitSetRef prev = hit_set;
   hit_set.reset(new HitSet(params));
+  hit_set_seed_pending = false;
+  if (hit_set->is_cumulative()) {
+    // carry the previous period's counts forward, decayed at the
+    // pool's grade decay rate (halved if none is set)
+    double factor = pool.info.hit_set_grade_decay_rate ?
+      1.0 - pool.info.hit_set_grade_decay_rate / 100.0 : .5;
+    if (prev) {
+      dout(20) << __func__ << " inheriting counts decayed by " << factor
+	       << dendl;
+      hit_set->inherit(*prev, factor);
+    } else if (!info.hit_set.history.empty()) {
+      // nothing in memory after a restart or a primary change
+      hit_set_seed_pending = true;
+      hit_set_seed();
+    }
+  }
   hit_set_start_stamp = now;
 }
 
+void PrimaryLogPG::hit_set_seed()
+{
+  assert(hit_set_seed_pending);
+  if (info.hit_set.history.empty()) {
+    hit_set_seed_pending = false;
+    return;
+  }
+  HitSetRef hs;
+  int r = hit_set_load_archive(info.hit_set.history.back(), &hs);
+  if (r == -EAGAIN)
+    return;  // retried by agent_load_hit_sets
+  hit_set_seed_pending = false;
+  if (r < 0)
+    return;
+  double factor = pool.info.hit_set_grade_decay_rate ?
+    1.0 - pool.info.hit_set_grade_decay_rate / 100.0 : .5;
+  dout(10) << __func__ << " inheriting counts of the newest archived set"
+	   << " decayed by " << factor << dendl;
+  hit_set->inherit(*hs, factor);
+}
+
+int PrimaryLogPG::hit_set_load_archive(const pg_hit_set_info_t &p,
+				       HitSetRef *hs)
+{
+  if (!pool.info.is_replicated()) {
+    // FIXME: EC not supported here yet
+    derr << __func__ << " on non-replicated pool" << dendl;
+    return -EOPNOTSUPP;
+  }
+
+  hobject_t oid = get_hit_set_archive_object(p.begin, p.end, p.using_gmt);
+  if (is_unreadable_object(oid)) {
+    dout(10) << __func__ << " unreadable " << oid << ", waiting" << dendl;
+    return -EAGAIN;
+  }
+
+  ObjectContextRef obc = get_object_context(oid, false);
+  if (!obc) {
+    derr << __func__ << ": could not load hitset " << oid << dendl;
+    return -ENOENT;
+  }
+
+  bufferlist bl;
+  {
+    obc->ondisk_read_lock();
+    int r = osd->store->read(ch, ghobject_t(oid), 0, 0, bl);
+    assert(r >= 0);
+    obc->ondisk_read_unlock();
+  }
+  hs->reset(new HitSet);
+  bufferlist::iterator pbl = bl.begin();
+  ::decode(**hs, pbl);
+  return 0;
+}
+
 /**
  * apply log entries to set
  *
@@ -11529,6 +11778,8 @@ bool PrimaryLogPG::hit_set_apply_log()
 void PrimaryLogPG::hit_set_persist()
 {
   dout(10) << __func__  << dendl;
+  if (hit_set_seed_pending)
+    hit_set_seed();  // last chance before the set is archived
   bufferlist bl;
   unsigned max = pool.info.hit_set_count;
 
@@ -11913,6 +12164,14 @@ bool PrimaryLogPG::agent_work(int start_max, int agent_flush_quota)
 
 void PrimaryLogPG::agent_load_hit_sets()
 {
+  if (hit_set && hit_set->is_cumulative()) {
+    // the current set already carries the decayed history, once it
+    // has picked up the archived one
+    if (hit_set_seed_pending)
+      hit_set_seed();
+    return;
+  }
+
   if (agent_state->evict_mode == TierAgentState::EVICT_MODE_IDLE) {
     return;
   }
@@ -11924,34 +12183,9 @@ void PrimaryLogPG::agent_load_hit_sets()
       if (agent_state->hit_set_map.count(p->begin.sec()) == 0) {
 	dout(10) << __func__ << " loading " << p->begin << "-"
 		 << p->end << dendl;
-	if (!pool.info.is_replicated()) {
-	  // FIXME: EC not supported here yet
-	  derr << __func__ << " on non-replicated pool" << dendl;
+	HitSetRef hs;
+	if (hit_set_load_archive(*p, &hs) < 0)
 	  break;
-	}
-
-	hobject_t oid = get_hit_set_archive_object(p->begin, p->end, p->using_gmt);
-	if (is_unreadable_object(oid)) {
-	  dout(10) << __func__ << " unreadable " << oid << ", waiting" << dendl;
-	  break;
-	}
-
-	ObjectContextRef obc = get_object_context(oid, false);
-	if (!obc) {
-	  derr << __func__ << ": could not load hitset " << oid << dendl;
-	  break;
-	}
-
-	bufferlist bl;
-	{
-	  obc->ondisk_read_lock();
-	  int r = osd->store->read(ch, ghobject_t(oid), 0, 0, bl);
-	  assert(r >= 0);
-	  obc->ondisk_read_unlock();
-	}
-	HitSetRef hs(new HitSet);
-	bufferlist::iterator pbl = bl.begin();
-	::decode(*hs, pbl);
 	agent_state->add_hit_set(p->begin.sec(), hs);
       }
     }
@@ -12388,6 +12622,10 @@ void PrimaryLogPG::agent_estimate_temp(const hobject_t& oid, int *temp)
   assert(hit_set);
   assert(temp);
   *temp = 0;
+  if (hit_set->is_cumulative()) {
+    *temp = MIN(hit_set->estimate_count(oid), 1000u) * 1000000;
+    return;
+  }
   if (hit_set->contains(oid))
     *temp = 1000000;
   unsigned i = 0;
@@ -12417,7 +12655,7 @@ bool PrimaryLogPG::already_complete(eversion_t v)
 	       << " version is empty" << dendl;
       continue;
     }
-    if ((*i)->v > v) {
+    if ((*i)->first_v > v) {
       dout(20) << __func__ << ": " << **i
 	       << " (*i)->v past v" << dendl;
       break;
@@ -12445,7 +12683,7 @@ bool PrimaryLogPG::already_ack(eversion_t v)
 	       << " version is empty" << dendl;
       continue;
     }
-    if ((*i)->v > v) {
+    if ((*i)->first_v > v) {
       dout(20) << __func__ << ": " << **i
 	       << " (*i)->v past v" << dendl;
       break;
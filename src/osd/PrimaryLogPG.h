@@ -445,6 +445,9 @@ public:
   }
 
   PerfCounters *get_logger() override;
+  void note_recovery_bytes(uint64_t bytes) override {
+    osd->note_recovery_bytes(bytes);
+  }
 
   ceph_tid_t get_tid() override { return osd->get_tid(); }
 
@@ -557,6 +560,9 @@ public:
 
     bool sent_reply;
 
+    /// log entries already added to the projected log (coalesced write)
+    bool log_staged = false;
+
     // pending async reads <off, len, op_flags> -> <outbl, outr>
     list<pair<boost::tuple<uint64_t, uint64_t, unsigned>,
 	      pair<bufferlist*, Context*> > > pending_async_reads;
@@ -654,6 +660,7 @@ public:
     int nref;
 
     eversion_t v;
+    eversion_t first_v;  ///< first version covered; < v if writes were coalesced
     int r = 0;
 
     ceph_tid_t rep_tid;
@@ -674,6 +681,8 @@ public:
     list<std::function<void()>> on_committed;
     list<std::function<void()>> on_success;
     list<std::function<void()>> on_finish;
+
+    list<OpRequestRef> coalesced_ops;  ///< client ops folded in behind op
     
     RepGather(
       OpContext *c, ceph_tid_t rt,
@@ -852,6 +861,29 @@ protected:
     boost::optional<std::function<void(void)> > &&on_complete);
   void remove_repop(RepGather *repop);
 
+  /**
+   * write coalescing
+   *
+   * With osd_op_coalesce_max_ops set, a simple write to an object whose
+   * previous write is still in flight is parked here rather than issued.
+   * Its log entry is staged in the projected log right away, so versions
+   * and dup detection behave as if it had been issued.  The parked ops
+   * are submitted together as one transaction and one replication round
+   * once any repop applies, or as soon as anything else needs to issue a
+   * repop or read the object.  Each op keeps its own log entry (and
+   * reqid) and its own reply.  Only one object is coalesced at a time so
+   * that log entries are always submitted in version order.
+   */
+  struct CoalescedWrites {
+    hobject_t hoid;
+    list<OpContext*> ctxs;
+    uint64_t bytes = 0;
+  } coalesced_writes;
+  bool can_coalesce_write(OpContext *ctx);
+  void coalesce_write(OpContext *ctx);
+  void flush_coalesced_writes();
+  void cancel_coalesced_writes(list<OpRequestRef> *requeue);
+
   OpContextUPtr simple_opc_create(ObjectContextRef obc);
   void simple_opc_submit(OpContextUPtr ctx);
 
@@ -862,7 +894,7 @@ protected:
    * Also used to store error log entries for dup detection.
    */
   void submit_log_entries(
-    const mempool::osd::list<pg_log_entry_t> &entries,
+    const mempool::osd_pglog::list<pg_log_entry_t> &entries,
     ObcLockManager &&manager,
     boost::optional<std::function<void(void)> > &&on_complete,
     OpRequestRef op = OpRequestRef(),
@@ -878,11 +910,16 @@ protected:
   // hot/cold tracking
   HitSetRef hit_set;        ///< currently accumulating HitSet
   utime_t hit_set_start_stamp;    ///< time the current HitSet started recording
+  /// cumulative hit_set still has to inherit the newest archived set
+  bool hit_set_seed_pending = false;
 
 
   void hit_set_clear();     ///< discard any HitSet state
   void hit_set_setup();     ///< initialize HitSet state
   void hit_set_create();    ///< create a new HitSet
+  void hit_set_seed();      ///< inherit the newest archived HitSet, if readable
+  int hit_set_load_archive(const pg_hit_set_info_t &p,
+			   HitSetRef *hs); ///< read an archived HitSet
   void hit_set_persist();   ///< persist hit info
   bool hit_set_apply_log(); ///< apply log entries to update in-memory HitSet
   void hit_set_trim(OpContextUPtr &ctx, unsigned max); ///< discard old HitSets
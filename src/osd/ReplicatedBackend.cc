@@ -984,9 +984,10 @@ Message * ReplicatedBackend::generate_subop(
   eversion_t pg_roll_forward_to,
   hobject_t new_temp_oid,
   hobject_t discard_temp_oid,
-  const vector<pg_log_entry_t> &log_entries,
+  const bufferlist &log_bl,
   boost::optional<pg_hit_set_history_t> &hset_hist,
-  ObjectStore::Transaction &op_t,
+  const bufferlist &txn_bl,
+  uint64_t txn_data_off,
   pg_shard_t peer,
   const pg_info_t &pinfo)
 {
@@ -1009,11 +1010,12 @@ Message * ReplicatedBackend::generate_subop(
     ObjectStore::Transaction t;
     ::encode(t, wr->get_data());
   } else {
-    ::encode(op_t, wr->get_data());
-    wr->get_header().data_off = op_t.get_data_alignment();
+    // shares the buffers of the transaction encoded once in issue_op
+    wr->set_data(txn_bl);
+    wr->get_header().data_off = txn_data_off;
   }
 
-  ::encode(log_entries, wr->logbl);
+  wr->logbl = log_bl;
 
   if (pinfo.is_incomplete())
     wr->pg_stats = pinfo.stats;  // reflects backfill progress
@@ -1052,6 +1054,17 @@ void ReplicatedBackend::issue_op(
     if (op->op)
       op->op->mark_sub_op_sent(ss.str());
   }
+
+  // Encode the transaction and log entries once; each replica message
+  // only gets its own header and references the same buffers.
+  bufferlist txn_bl, log_bl;
+  uint64_t txn_data_off = 0;
+  if (parent->get_actingbackfill_shards().size() > 1) {
+    ::encode(op_t, txn_bl);
+    txn_data_off = op_t.get_data_alignment();
+    ::encode(log_entries, log_bl);
+  }
+
   for (set<pg_shard_t>::const_iterator i =
 	 parent->get_actingbackfill_shards().begin();
        i != parent->get_actingbackfill_shards().end();
@@ -1070,9 +1083,10 @@ void ReplicatedBackend::issue_op(
       pg_roll_forward_to,
       new_temp_oid,
       discard_temp_oid,
-      log_entries,
+      log_bl,
       hset_hist,
-      op_t,
+      txn_bl,
+      txn_data_off,
       peer,
       pinfo);
 
@@ -2121,6 +2135,7 @@ int ReplicatedBackend::build_push_op(const ObjectRecoveryInfo &recovery_info,
 
   get_parent()->get_logger()->inc(l_osd_push);
   get_parent()->get_logger()->inc(l_osd_push_outb, out_op->data.length());
+  get_parent()->note_recovery_bytes(out_op->data.length());
 
   // send
   out_op->version = recovery_info.version;
@@ -393,9 +393,10 @@ private:
     eversion_t pg_roll_forward_to,
     hobject_t new_temp_oid,
     hobject_t discard_temp_oid,
-    const vector<pg_log_entry_t> &log_entries,
+    const bufferlist &log_bl,
     boost::optional<pg_hit_set_history_t> &hset_history,
-    ObjectStore::Transaction &op_t,
+    const bufferlist &txn_bl,
+    uint64_t txn_data_off,
     pg_shard_t peer,
     const pg_info_t &pinfo);
   void issue_op(
@@ -18,9 +18,14 @@ using std::chrono::seconds;
 
 /*** ObjectCacher::BufferHead ***/
 
+MEMPOOL_DEFINE_OBJECT_FACTORY(ObjectCacher::BufferHead, objectcacher_bh,
+			      objectcacher);
 
 /*** ObjectCacher::Object ***/
 
+MEMPOOL_DEFINE_OBJECT_FACTORY(ObjectCacher::Object, objectcacher_object,
+			      objectcacher);
+
 #define dout_subsys ceph_subsys_objectcacher
 #undef dout_prefix
 #define dout_prefix *_dout << "objectcacher.object(" << oid << ") "
@@ -621,10 +626,21 @@ ObjectCacher::ObjectCacher(CephContext *cct_, string name,
   perf_start();
   finisher.start();
   scattered_write = writeback_handler.can_scattered_write();
+
+  mempool_trimmer = mempool::objectcacher::register_trimmer(
+    [this](size_t bytes, size_t limit) {
+      // never wait for the lock: it may be held while we are unregistered
+      if (!lock.TryLock())
+	return;
+      trim((uint64_t)get_stat_clean() * limit / bytes,
+	   (uint64_t)ob_lru.lru_get_size() * limit / bytes);
+      lock.Unlock();
+    });
 }
 
 ObjectCacher::~ObjectCacher()
 {
+  mempool::objectcacher::unregister_trimmer(mempool_trimmer);
   finisher.stop();
   perf_stop();
   // we should be empty.
@@ -1221,14 +1237,14 @@ void ObjectCacher::flush(loff_t amount)
 }
 
 
-void ObjectCacher::trim()
+void ObjectCacher::trim(uint64_t max_bytes, uint64_t max_ob)
 {
   assert(lock.is_locked());
-  ldout(cct, 10) << "trim  start: bytes: max " << max_size << "  clean "
-		 << get_stat_clean() << ", objects: max " << max_objects
+  ldout(cct, 10) << "trim  start: bytes: max " << max_bytes << "  clean "
+		 << get_stat_clean() << ", objects: max " << max_ob
 		 << " current " << ob_lru.lru_get_size() << dendl;
 
-  while (get_stat_clean() > 0 && (uint64_t) get_stat_clean() > max_size) {
+  while (get_stat_clean() > 0 && (uint64_t) get_stat_clean() > max_bytes) {
     BufferHead *bh = static_cast<BufferHead*>(bh_lru_rest.lru_expire());
     if (!bh)
       break;
@@ -1246,7 +1262,7 @@ void ObjectCacher::trim()
     }
   }
 
-  while (ob_lru.lru_get_size() > max_objects) {
+  while (ob_lru.lru_get_size() > max_ob) {
     Object *ob = static_cast<Object*>(ob_lru.lru_expire());
     if (!ob)
       break;
@@ -1255,8 +1271,8 @@ void ObjectCacher::trim()
     close_object(ob);
   }
 
-  ldout(cct, 10) << "trim finish:  max " << max_size << "  clean "
-		 << get_stat_clean() << ", objects: max " << max_objects
+  ldout(cct, 10) << "trim finish:  max " << max_bytes << "  clean "
+		 << get_stat_clean() << ", objects: max " << max_ob
 		 << " current " << ob_lru.lru_get_size() << dendl;
 }
 
@@ -7,6 +7,7 @@
 #include "include/lru.h"
 #include "include/Context.h"
 #include "include/xlist.h"
+#include "include/mempool.h"
 
 #include "common/Cond.h"
 #include "common/Finisher.h"
@@ -100,6 +101,8 @@ class ObjectCacher {
   // ******* BufferHead *********
   class BufferHead : public LRUObject {
   public:
+    MEMPOOL_CLASS_HELPERS();
+
     // states
     static const int STATE_MISSING = 0;
     static const int STATE_CLEAN = 1;
@@ -226,6 +229,9 @@ class ObjectCacher {
 
   // ******* Object *********
   class Object : public LRUObject {
+  public:
+    MEMPOOL_CLASS_HELPERS();
+
   private:
     // ObjectCacher::Object fields
     int ref;
@@ -417,6 +423,9 @@ class ObjectCacher {
   LRU   bh_lru_dirty, bh_lru_rest;
   LRU   ob_lru;
 
+  /// objectcacher mempool trimmer id
+  int mempool_trimmer;
+
   Cond flusher_cond;
   bool flusher_stop;
   void flusher_entry();
@@ -525,7 +534,11 @@ class ObjectCacher {
   void bh_write_adjacencies(BufferHead *bh, ceph::real_time cutoff,
 			    int64_t *amount, int *max_count);
 
-  void trim();
+  void trim() {
+    trim(max_size, max_objects);
+  }
+  /// drop clean buffers and objects beyond max_bytes and max_ob
+  void trim(uint64_t max_bytes, uint64_t max_ob);
   void flush(loff_t amount=0);
 
   /**
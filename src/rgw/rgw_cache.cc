@@ -9,6 +9,25 @@
 
 using namespace std;
 
+ObjectCache::ObjectCache()
+  : lru_size(0), lru_counter(0), lru_window(0), lock("ObjectCache"),
+    cct(NULL), enabled(false)
+{
+  mempool_trimmer = mempool::rgw_cache::register_trimmer(
+    [this](size_t bytes, size_t limit) {
+      // never wait for the lock: it may be held while we are unregistered
+      if (!lock.try_get_write())
+	return;
+      trim_lru(lru_size * limit / bytes);
+      lock.put_write();
+    });
+}
+
+ObjectCache::~ObjectCache()
+{
+  mempool::rgw_cache::unregister_trimmer(mempool_trimmer);
+}
+
 int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cache_entry_info *cache_info)
 {
   RWLock::RLocker l(lock);
@@ -17,7 +36,7 @@ int ObjectCache::get(string& name, ObjectCacheInfo& info, uint32_t mask, rgw_cac
     return -ENOENT;
   }
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
+  auto iter = cache_map.find(name);
   if (iter == cache_map.end()) {
     ldout(cct, 10) << "cache get: name=" << name << " : miss" << dendl;
     if(perfcounter) perfcounter->inc(l_rgw_cache_miss);
@@ -86,7 +105,7 @@ bool ObjectCache::chain_cache_entry(list<rgw_cache_entry_info *>& cache_info_ent
     rgw_cache_entry_info *cache_info = *citer;
 
     ldout(cct, 10) << "chain_cache_entry: cache_locator=" << cache_info->cache_locator << dendl;
-    map<string, ObjectCacheEntry>::iterator iter = cache_map.find(cache_info->cache_locator);
+    auto iter = cache_map.find(cache_info->cache_locator);
     if (iter == cache_map.end()) {
       ldout(cct, 20) << "chain_cache_entry: couldn't find cache locator" << dendl;
       return false;
@@ -126,7 +145,7 @@ void ObjectCache::put(string& name, ObjectCacheInfo& info, rgw_cache_entry_info
 
   ldout(cct, 10) << "cache put: name=" << name << " info.flags=0x"
                  << std::hex << info.flags << std::dec << dendl;
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
+  auto iter = cache_map.find(name);
   if (iter == cache_map.end()) {
     ObjectCacheEntry entry;
     entry.lru_iter = lru.end();
@@ -201,7 +220,7 @@ void ObjectCache::remove(string& name)
     return;
   }
 
-  map<string, ObjectCacheEntry>::iterator iter = cache_map.find(name);
+  auto iter = cache_map.find(name);
   if (iter == cache_map.end())
     return;
 
@@ -229,7 +248,7 @@ void ObjectCache::touch_lru(string& name, ObjectCacheEntry& entry, std::list<str
        */
       break;
     }
-    map<string, ObjectCacheEntry>::iterator map_iter = cache_map.find(*iter);
+    auto map_iter = cache_map.find(*iter);
     ldout(cct, 10) << "removing entry: name=" << *iter << " from cache LRU" << dendl;
     if (map_iter != cache_map.end())
       cache_map.erase(map_iter);
@@ -254,6 +273,20 @@ void ObjectCache::touch_lru(string& name, ObjectCacheEntry& entry, std::list<str
   entry.lru_promotion_ts = lru_counter;
 }
 
+void ObjectCache::trim_lru(unsigned long keep)
+{
+  if (cct)
+    ldout(cct, 10) << "trimming cache LRU from " << lru_size << " to " << keep
+		   << " entries" << dendl;
+  while (lru_size > keep && !lru.empty()) {
+    auto map_iter = cache_map.find(lru.front());
+    if (map_iter != cache_map.end())
+      cache_map.erase(map_iter);
+    lru.pop_front();
+    lru_size--;
+  }
+}
+
 void ObjectCache::remove_lru(string& name, std::list<string>::iterator& lru_iter)
 {
   if (lru_iter == lru.end())
@@ -10,6 +10,7 @@
 #include "include/types.h"
 #include "include/utime.h"
 #include "include/assert.h"
+#include "include/mempool.h"
 #include "common/RWLock.h"
 
 enum {
@@ -135,7 +136,7 @@ struct ObjectCacheEntry {
 };
 
 class ObjectCache {
-  std::map<string, ObjectCacheEntry> cache_map;
+  mempool::rgw_cache::map<string, ObjectCacheEntry> cache_map;
   std::list<string> lru;
   unsigned long lru_size;
   unsigned long lru_counter;
@@ -147,12 +148,18 @@ class ObjectCache {
 
   bool enabled;
 
+  /// rgw_cache mempool trimmer id
+  int mempool_trimmer;
+
   void touch_lru(string& name, ObjectCacheEntry& entry, std::list<string>::iterator& lru_iter);
   void remove_lru(string& name, std::list<string>::iterator& lru_iter);
+  /// drop the least recently used entries until at most keep are left
+  void trim_lru(unsigned long keep);
 
   void do_invalidate_all();
 public:
-  ObjectCache() : lru_size(0), lru_counter(0), lru_window(0), lock("ObjectCache"), cct(NULL), enabled(false) { }
+  ObjectCache();
+  ~ObjectCache();
   int get(std::string& name, ObjectCacheInfo& bl, uint32_t mask, rgw_cache_entry_info *cache_info);
   void put(std::string& name, ObjectCacheInfo& bl, rgw_cache_entry_info *cache_info);
   void remove(std::string& name);
@@ -12,6 +12,8 @@
 #include <sstream>
 #include <stdlib.h>
 #include <fstream>
+#include <atomic>
+#include <thread>
 
 #include "common/Formatter.h"
 
@@ -23,6 +25,7 @@
 #include "common/WorkQueue.h"
 #include "common/Semaphore.h"
 #include "common/Finisher.h"
+#include "common/Clock.h"
 
 namespace po = boost::program_options;
 using namespace std;
@@ -103,6 +106,85 @@ public:
     ThreadPool::WorkQueue<unsigned>("TestQueue", 100, 100, tp), next(_next) {}
 };
 
+/*
+ * --scaling: queue ops/sec through a ThreadPool versus its thread count,
+ * with no-op items, for a PointerWQ (lock-free queue()) and a WorkQueue
+ * (queue() under the pool lock).
+ */
+class NopPointerWQ : public ThreadPool::PointerWQ<unsigned> {
+public:
+  std::atomic<uint64_t> done = { 0 };
+  explicit NopPointerWQ(ThreadPool *tp)
+    : ThreadPool::PointerWQ<unsigned>("NopPointerWQ", 100, 100, tp) {
+    tp->add_work_queue(this);
+  }
+protected:
+  void process(unsigned *item) override {
+    done++;
+  }
+};
+class NopWQ : public ThreadPool::WorkQueue<unsigned> {
+  list<unsigned*> q;
+  bool _enqueue(unsigned *item) override {
+    q.push_back(item);
+    return true;
+  }
+  void _dequeue(unsigned *item) override { ceph_abort(); }
+  unsigned *_dequeue() override {
+    if (q.empty())
+      return 0;
+    unsigned *val = q.front();
+    q.pop_front();
+    return val;
+  }
+  void _process(unsigned *item, ThreadPool::TPHandle &) override {
+    done++;
+  }
+  void _clear() override { q.clear(); }
+  bool _empty() override { return q.empty(); }
+public:
+  std::atomic<uint64_t> done = { 0 };
+  explicit NopWQ(ThreadPool *tp)
+    : ThreadPool::WorkQueue<unsigned>("NopWQ", 100, 100, tp) {}
+};
+
+template <typename WQ>
+static double ops_per_sec(unsigned threads, unsigned submitters,
+			  unsigned items)
+{
+  ThreadPool tp(g_ceph_context, "scaling", "tp_scaling", threads);
+  WQ wq(&tp);
+  tp.start();
+  unsigned item = 0;
+  utime_t start = ceph_clock_now();
+  vector<std::thread> ts;
+  for (unsigned i = 0; i < submitters; ++i)
+    ts.push_back(std::thread([&] {
+	  for (unsigned j = 0; j < items / submitters; ++j)
+	    wq.queue(&item);
+	}));
+  for (auto& t : ts)
+    t.join();
+  wq.drain();
+  utime_t elapsed = ceph_clock_now() - start;
+  tp.stop();
+  return (double)wq.done.load() / (double)elapsed;
+}
+
+static void scaling(unsigned max_threads, unsigned submitters,
+		    unsigned items)
+{
+  cout << "# " << items << " items from " << submitters << " submitters, "
+       << "threadpool_dequeue_batch " << g_conf->threadpool_dequeue_batch
+       << std::endl;
+  cout << "threads\tPointerWQ ops/s\tWorkQueue ops/s" << std::endl;
+  for (unsigned t = 1; t <= max_threads; t *= 2) {
+    cout << t << "\t" << (uint64_t)ops_per_sec<NopPointerWQ>(t, submitters, items)
+	 << "\t" << (uint64_t)ops_per_sec<NopWQ>(t, submitters, items)
+	 << std::endl;
+  }
+}
+
 int main(int argc, char **argv)
 {
   po::options_description desc("Allowed options");
@@ -116,6 +198,9 @@ int main(int argc, char **argv)
      "num items")
     ("layers", po::value<string>()->default_value(""),
      "layer desc")
+    ("scaling", "print ops/sec versus thread count (1, 2, 4, ... num-threads) and exit")
+    ("submitters", po::value<unsigned>()->default_value(4),
+     "number of threads queueing items, with --scaling")
     ;
 
   vector<string> ceph_option_strings;
@@ -154,6 +239,13 @@ int main(int argc, char **argv)
     return 1;
   }
 
+  if (vm.count("scaling")) {
+    scaling(vm["num-threads"].as<unsigned>(),
+	    vm["submitters"].as<unsigned>(),
+	    vm["num-items"].as<unsigned>());
+    return 0;
+  }
+
   DetailedStatCollector col(1, new JSONFormatter, 0, &cout);
   Semaphore sem;
   for (unsigned i = 0; i < vm["queue-size"].as<unsigned>(); ++i)
@@ -1,6 +1,17 @@
 // -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
 // vim: ts=8 sw=2 smarttab
 
+/*
+ * Log submission throughput versus thread count.
+ *
+ * usage: ceph_bench_log <max threads> <lines per thread> [deferred]
+ *
+ * Runs with 1, 2, 4, ... max threads.  With "deferred" the lines are
+ * submitted with ldout_deferred() and only formatted if they are written
+ * out.  Compare with --log_thread_queue_len 0 for the shared, locked
+ * queue, and with e.g. --debug_none 0/5 for gather-only logging.
+ */
+
 #include "include/types.h"
 #include "common/Thread.h"
 #include "common/debug.h"
@@ -10,12 +21,14 @@
 #include "global/global_init.h"
 
 #define dout_context g_ceph_context
+#define dout_subsys ceph_subsys_
 
 struct T : public Thread {
   int num;
+  bool deferred;
   set<int> myset;
   map<int,string> mymap;
-  explicit T(int n) : num(n) {
+  T(int n, bool d) : num(n), deferred(d) {
     myset.insert(123);
     myset.insert(456);
     mymap[1] = "foo";
@@ -23,32 +36,29 @@ struct T : public Thread {
   }
 
   void *entry() override {
-    while (num-- > 0)
-      generic_dout(0) << "this is a typical log line.  set "
-		      << myset << " and map " << mymap << dendl;
+    if (deferred) {
+      while (num-- > 0) {
+	int n = num;
+	ldout_deferred(g_ceph_context, 0, [n](ostream& out) {
+	    out << "this is a typical log line.  line " << n;
+	  });
+      }
+    } else {
+      while (num-- > 0)
+	generic_dout(0) << "this is a typical log line.  set "
+			<< myset << " and map " << mymap << dendl;
+    }
     return 0;
   }
 };
 
-int main(int argc, const char **argv)
+static void run(int threads, int num, bool deferred)
 {
-  int threads = atoi(argv[1]);
-  int num = atoi(argv[2]);
-
-  cout << threads << " threads, " << num << " lines per thread" << std::endl;
-
-  vector<const char*> args;
-  argv_to_vec(argc, argv, args);
-  env_to_vec(args);
-
-  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
-			 CODE_ENVIRONMENT_UTILITY, 0);
-
   utime_t start = ceph_clock_now();
 
   list<T*> ls;
   for (int i=0; i<threads; i++) {
-    T *t = new T(num);
+    T *t = new T(num, deferred);
     t->create("t");
     ls.push_back(t);
   }
@@ -60,15 +70,38 @@ int main(int argc, const char **argv)
     delete t;
   }
 
-  utime_t t = ceph_clock_now();
-  t -= start;
-  cout << " flushing.. " << t << " so far ..." << std::endl;
-
+  utime_t submitted = ceph_clock_now() - start;
   g_ceph_context->_log->flush();
+  utime_t dur = ceph_clock_now() - start;
 
-  utime_t end = ceph_clock_now();
-  utime_t dur = end - start;
+  cout << threads << " threads: submitted in " << submitted << " ("
+       << (uint64_t)(threads * num / (double)submitted) << " lines/sec), "
+       << "flushed in " << dur << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+  if (argc < 3) {
+    cerr << "usage: " << argv[0]
+	 << " <max threads> <lines per thread> [deferred]" << std::endl;
+    return 1;
+  }
+  int threads = atoi(argv[1]);
+  int num = atoi(argv[2]);
+  bool deferred = argc > 3 && strcmp(argv[3], "deferred") == 0;
+
+  cout << "up to " << threads << " threads, " << num << " lines per thread"
+       << (deferred ? ", deferred formatting" : "") << std::endl;
+
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_OSD,
+			 CODE_ENVIRONMENT_UTILITY, 0);
 
-  cout << dur << std::endl;
+  for (int t = 1; t < threads; t *= 2)
+    run(t, num, deferred);
+  run(threads, num, deferred);
   return 0;
 }
@@ -0,0 +1,131 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+
+/*
+ * ns per encode_payload/decode_payload of the hot OSD messages.
+ *
+ * MOSDOp is measured with the v8 (contiguous, denc) encoding and with the
+ * v7 encoding, which still goes through the per-field bufferlist
+ * encoders, so the two numbers can be compared directly.
+ *
+ * usage: ceph_bench_msg_encode [iterations] [ops per message]
+ */
+
+#include "include/types.h"
+#include "common/Clock.h"
+#include "common/ceph_argparse.h"
+#include "global/global_init.h"
+#include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
+
+static MOSDOp *make_op(unsigned num_ops)
+{
+  spg_t pgid(pg_t(0x1234, 3), shard_id_t::NO_SHARD);
+  hobject_t hobj(object_t("rbd_data.1234567890ab.0000000000000123"),
+		 "", CEPH_NOSNAP, 0x1234, 3, "");
+  MOSDOp *m = new MOSDOp(7, 1000, hobj, pgid, 42,
+			 CEPH_OSD_FLAG_WRITE | CEPH_OSD_FLAG_ONDISK,
+			 CEPH_FEATURES_ALL);
+  m->set_reqid(osd_reqid_t(entity_name_t::CLIENT(4567), 7, 1000));
+  m->set_mtime(ceph_clock_now());
+  m->set_snap_seq(12);
+  vector<snapid_t> snaps = {12, 9, 4};
+  m->set_snaps(snaps);
+  for (unsigned i = 0; i < num_ops; ++i) {
+    bufferlist bl;
+    bl.append_zero(4096);
+    m->write(i * 4096, 4096, bl);
+  }
+  return m;
+}
+
+static void report(const char *what, utime_t dur, unsigned iters,
+		   unsigned len)
+{
+  cout << what << ": " << (double)dur.to_nsec() / iters << " ns/msg, "
+       << len << " byte payload" << std::endl;
+}
+
+static void bench_op(const char *what, uint64_t features, unsigned iters,
+		     unsigned num_ops)
+{
+  MOSDOp *m = make_op(num_ops);
+
+  utime_t start = ceph_clock_now();
+  for (unsigned i = 0; i < iters; ++i) {
+    m->clear_payload();
+    m->encode_payload(features);
+  }
+  utime_t end = ceph_clock_now();
+  string name = string(what) + " encode";
+  report(name.c_str(), end - start, iters, m->get_payload().length());
+
+  ceph_msg_header header = m->get_header();
+  start = ceph_clock_now();
+  for (unsigned i = 0; i < iters; ++i) {
+    MOSDOp *d = new MOSDOp();
+    d->set_header(header);
+    bufferlist bl(m->get_payload());
+    d->set_payload(bl);
+    d->decode_payload();
+    d->finish_decode();
+    d->put();
+  }
+  end = ceph_clock_now();
+  name = string(what) + " decode";
+  report(name.c_str(), end - start, iters, m->get_payload().length());
+  m->put();
+}
+
+static void bench_reply(unsigned iters, unsigned num_ops)
+{
+  MOSDOp *req = make_op(num_ops);
+  MOSDOpReply *m = new MOSDOpReply(req, 0, 42, CEPH_OSD_FLAG_ONDISK, true);
+  m->set_reply_versions(eversion_t(42, 1001), 1001);
+
+  utime_t start = ceph_clock_now();
+  for (unsigned i = 0; i < iters; ++i) {
+    m->clear_payload();
+    m->encode_payload(CEPH_FEATURES_ALL);
+  }
+  utime_t end = ceph_clock_now();
+  report("MOSDOpReply encode", end - start, iters,
+	 m->get_payload().length());
+
+  ceph_msg_header header = m->get_header();
+  start = ceph_clock_now();
+  for (unsigned i = 0; i < iters; ++i) {
+    MOSDOpReply *d = new MOSDOpReply();
+    d->set_header(header);
+    bufferlist bl(m->get_payload());
+    d->set_payload(bl);
+    d->decode_payload();
+    d->put();
+  }
+  end = ceph_clock_now();
+  report("MOSDOpReply decode", end - start, iters,
+	 m->get_payload().length());
+  m->put();
+  req->put();
+}
+
+int main(int argc, const char **argv)
+{
+  vector<const char*> args;
+  argv_to_vec(argc, argv, args);
+  env_to_vec(args);
+
+  auto cct = global_init(NULL, args, CEPH_ENTITY_TYPE_CLIENT,
+			 CODE_ENVIRONMENT_UTILITY, 0);
+
+  unsigned iters = args.size() > 0 ? atoi(args[0]) : 1000000;
+  unsigned num_ops = args.size() > 1 ? atoi(args[1]) : 1;
+  cout << iters << " iterations, " << num_ops << " ops per message"
+       << std::endl;
+
+  bench_op("MOSDOp v8", CEPH_FEATURES_ALL, iters, num_ops);
+  bench_op("MOSDOp v7", CEPH_FEATURES_ALL & ~CEPH_FEATUREMASK_RESEND_ON_SPLIT,
+	   iters, num_ops);
+  bench_reply(iters, num_ops);
+  return 0;
+}
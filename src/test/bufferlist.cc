@@ -23,10 +23,14 @@
 #include <limits.h>
 #include <errno.h>
 #include <sys/uio.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include "include/buffer.h"
 #include "include/utime.h"
 #include "include/encoding.h"
+#include "include/mempool.h"
 #include "common/environment.h"
 #include "common/Clock.h"
 #include "common/safe_io.h"
@@ -238,6 +242,117 @@ TEST(Buffer, BenchAlloc) {
   bench_buffer_alloc(4, 1000000);
 }
 
+TEST(Buffer, SlabAllocator) {
+  buffer::set_raw_allocator(buffer::get_slab_allocator());
+
+  size_t data_bytes = mempool::buffer_data::allocated_bytes();
+  size_t slab_bytes = mempool::buffer_slab::allocated_bytes();
+  const char *first;
+  {
+    bufferptr p = buffer::create_page_aligned(4096);
+    first = p.c_str();
+    EXPECT_EQ(0u, (unsigned long)first & ~CEPH_PAGE_MASK);
+    EXPECT_EQ(data_bytes + 4096, mempool::buffer_data::allocated_bytes());
+  }
+  // idle, but kept around in this thread's cache
+  EXPECT_EQ(data_bytes, mempool::buffer_data::allocated_bytes());
+  EXPECT_LE(slab_bytes + 4096, mempool::buffer_slab::allocated_bytes());
+  {
+    bufferptr p = buffer::create_page_aligned(4096);
+    EXPECT_EQ(first, p.c_str());
+    EXPECT_EQ(slab_bytes, mempool::buffer_slab::allocated_bytes());
+  }
+  {
+    // page multiples are routed to the allocator, too
+    bufferptr p = buffer::create(65536);
+    EXPECT_EQ(0u, (unsigned long)p.c_str() & ~CEPH_PAGE_MASK);
+    EXPECT_EQ(data_bytes + 65536, mempool::buffer_data::allocated_bytes());
+  }
+  {
+    // not a size class: falls back to the default allocator
+    bufferptr p = buffer::create_page_aligned(3 * 4096);
+    EXPECT_EQ(data_bytes + 3 * 4096, mempool::buffer_data::allocated_bytes());
+  }
+  {
+    // freed on another thread: ends up in the depot, and reused here
+    bufferptr p = buffer::create_page_aligned(4 << 20);
+    const char *big = p.c_str();
+    std::thread t([&p] { p = bufferptr(); });
+    t.join();
+    bufferptr q = buffer::create_page_aligned(4 << 20);
+    EXPECT_EQ(big, q.c_str());
+  }
+  {
+    // bigger than a thread's budget: bypasses this thread's cache
+    const char *big = bufferptr(buffer::create_page_aligned(4 << 20)).c_str();
+    const char *other = nullptr;
+    std::thread t([&other] {
+	bufferptr p = buffer::create_page_aligned(4 << 20);
+	other = p.c_str();
+      });
+    t.join();
+    EXPECT_EQ(big, other);
+  }
+  {
+    // an idle thread's cache is handed back to the depot
+    buffer::set_slab_thread_cache_bytes(4096);
+    std::mutex lock;
+    std::condition_variable cond;
+    const char *cached = nullptr;
+    bool done = false;
+    std::thread t([&] {
+	const char *p = bufferptr(buffer::create_page_aligned(4096)).c_str();
+	std::unique_lock<std::mutex> l(lock);
+	cached = p;
+	cond.notify_all();
+	cond.wait(l, [&] { return done; });
+      });
+    {
+      std::unique_lock<std::mutex> l(lock);
+      cond.wait(l, [&] { return cached != nullptr; });
+    }
+    buffer::flush_idle_slab_thread_caches();
+    buffer::flush_idle_slab_thread_caches();
+    const char *reused = nullptr;
+    std::thread u([&reused] {
+	bufferptr p = buffer::create_page_aligned(4096);
+	reused = p.c_str();
+      });
+    u.join();
+    EXPECT_EQ(cached, reused);
+    {
+      std::lock_guard<std::mutex> l(lock);
+      done = true;
+      cond.notify_all();
+    }
+    t.join();
+    buffer::set_slab_thread_cache_bytes(1 << 20);
+  }
+
+  buffer::set_raw_allocator(nullptr);
+  bufferptr p = buffer::create_page_aligned(4096);
+  EXPECT_NE(first, p.c_str());
+}
+
+TEST(Buffer, BenchSlabAlloc) {
+  for (auto a : { (buffer::raw_allocator*)nullptr,
+	          buffer::get_slab_allocator() }) {
+    buffer::set_raw_allocator(a);
+    for (unsigned size : { 4096, 65536 }) {
+      unsigned num = 1000000;
+      utime_t start = ceph_clock_now();
+      for (unsigned i = 0; i < num; ++i) {
+	bufferptr p = buffer::create_page_aligned(size);
+	p.c_str()[0] = 1;
+      }
+      utime_t end = ceph_clock_now();
+      cout << num << " " << (a ? "slab" : "default") << " alloc of size "
+	   << size << " in " << (end - start) << std::endl;
+    }
+  }
+  buffer::set_raw_allocator(nullptr);
+}
+
 TEST(BufferRaw, ostream) {
   bufferptr ptr(1);
   std::ostringstream stream;
@@ -1422,6 +1537,149 @@ TEST(BufferList, BenchAlloc) {
   bench_bufferlist_alloc(4, 100000, 16);
 }
 
+TEST(BufferList, buffers_t) {
+  bufferlist::buffers_t b;
+  ASSERT_TRUE(b.empty());
+  b.push_back(buffer::copy("B", 1));
+  b.push_front(buffer::copy("A", 1));
+  b.push_back(buffer::copy("C", 1));
+  ASSERT_EQ(3u, b.size());
+  ASSERT_EQ('A', b.front()[0]);
+  ASSERT_EQ('C', b.back()[0]);
+  auto p = b.erase(b.begin());
+  ASSERT_EQ('B', (*p)[0]);
+  // the embedded node is free again and gets reused
+  p = b.insert(p, buffer::copy("a", 1));
+  ASSERT_EQ('a', (*p)[0]);
+  std::string s;
+  for (auto& bp : b)
+    s.append(bp.c_str(), bp.length());
+  ASSERT_EQ("aBC", s);
+
+  bufferlist::buffers_t c;
+  c.push_back(buffer::copy("D", 1));
+  c.push_back(buffer::copy("E", 1));
+  c.splice(c.begin(), b);
+  ASSERT_TRUE(b.empty());
+  b.push_back(buffer::copy("F", 1));
+  s.clear();
+  for (auto& bp : c)
+    s.append(bp.c_str(), bp.length());
+  ASSERT_EQ("aBCDE", s);
+
+  b.swap(c);
+  ASSERT_EQ(1u, c.size());
+  ASSERT_EQ('F', c.front()[0]);
+  ASSERT_EQ(5u, b.size());
+  bufferlist::buffers_t d(b);
+  bufferlist::buffers_t e(std::move(b));
+  ASSERT_TRUE(b.empty());
+  ASSERT_EQ(5u, d.size());
+  ASSERT_EQ(5u, e.size());
+  ASSERT_EQ('E', (*--e.end())[0]);
+  e.clear();
+  ASSERT_TRUE(e.empty());
+}
+
+static size_t list_nodes()
+{
+  // everything else we allocate below comes from buffer_data
+  return mempool::buffer_meta::allocated_items();
+}
+
+TEST(BufferList, SingleSegmentNoNodes) {
+  size_t before = list_nodes();
+  {
+    bufferlist bl;
+    bl.append("foo", 3);
+    bufferlist other;
+    other.claim_append(bl);
+    bufferlist moved(std::move(other));
+    bufferlist copy(moved);
+    bufferlist swapped;
+    swapped.swap(copy);
+    ASSERT_EQ(1u, swapped.get_num_buffers());
+    ASSERT_EQ(before, list_nodes());
+    moved.append(buffer::create(4096));
+    ASSERT_EQ(before + 1, list_nodes());
+  }
+  ASSERT_EQ(before, list_nodes());
+}
+
+TEST(BufferList, SpliceRelinks) {
+  bufferlist::buffers_t b;
+  for (int i = 0; i < 1000; ++i)
+    b.push_back(buffer::copy("x", 1));
+  auto second = ++b.begin();
+  bufferlist::buffers_t c;
+  c.push_back(buffer::copy("y", 1));
+  size_t before = list_nodes();
+  // only b's embedded segment needs a node of c's; the rest are relinked
+  c.splice(c.end(), b);
+  ASSERT_EQ(before + 1, list_nodes());
+  ASSERT_TRUE(b.empty());
+  ASSERT_EQ(1001u, c.size());
+  ASSERT_EQ(second, ++(++c.begin()));
+  ASSERT_EQ('x', (*--c.end())[0]);
+  bufferlist::buffers_t d(std::move(c));
+  ASSERT_EQ(before + 1, list_nodes());
+  ASSERT_EQ(1001u, d.size());
+  d.swap(b);
+  ASSERT_EQ(before + 1, list_nodes());
+  ASSERT_EQ(1001u, b.size());
+  ASSERT_EQ('y', b.front()[0]);
+  size_t n = 0;
+  for (auto p = b.end(); p != b.begin(); --p)
+    ++n;
+  ASSERT_EQ(1001u, n);
+}
+
+template<typename F>
+void bench_bufferlist_pattern(const char *name, int num, F&& f)
+{
+  std::vector<bufferlist> kept(num);
+  size_t before = list_nodes();
+  utime_t start = ceph_clock_now();
+  for (int i=0; i<num; ++i)
+    f(kept[i]);
+  utime_t end = ceph_clock_now();
+  cout << name << ": " << (end - start) << " for " << num << ", "
+       << (double)(list_nodes() - before) / num
+       << " list nodes allocated per bufferlist" << std::endl;
+}
+
+TEST(BufferList, BenchPatterns) {
+  const int num = 200000;
+  bufferptr bp = buffer::create(4096);
+  bp.zero();
+  bench_bufferlist_pattern("append small", num, [](bufferlist& bl) {
+      bl.append("0123456789abcdef", 16);
+    });
+  bench_bufferlist_pattern("append 4 ptrs", num, [&bp](bufferlist& bl) {
+      for (int j=0; j<4; ++j)
+	bl.append(bp);
+    });
+  bench_bufferlist_pattern("claim_append", num, [&bp](bufferlist& bl) {
+      bufferlist t;
+      t.append(bp);
+      bl.claim_append(t);
+    });
+  bench_bufferlist_pattern("encode", num, [](bufferlist& bl) {
+      uint64_t v = 42;
+      std::string s("some string");
+      ::encode(v, bl);
+      ::encode(s, bl);
+    });
+  bench_bufferlist_pattern("iterate", num, [&bp](bufferlist& bl) {
+      bl.append(bp);
+      bl.append(bp);
+      unsigned sum = 0;
+      for (auto& p : bl.buffers())
+	sum += p.length();
+      ASSERT_EQ(8192u, sum);
+    });
+}
+
 TEST(BufferList, operator_equal) {
   //
   // list& operator= (const list& other)
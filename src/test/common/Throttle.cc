@@ -254,6 +254,49 @@ TEST_F(ThrottleTest, destructor) {
   }
 }
 
+/// get/put 1 slot in a loop from several threads; returns ops/sec and
+/// the largest count seen while holding a slot
+static std::pair<double, int64_t> test_contention(
+  int64_t max, unsigned threads, unsigned ops)
+{
+  Throttle throttle(g_ceph_context, "throttle_contention", max, false);
+  std::atomic<int64_t> peak = { 0 };
+  auto start = std::chrono::steady_clock::now();
+  vector<std::thread> ts;
+  for (unsigned i = 0; i < threads; ++i) {
+    ts.push_back(std::thread([&]() {
+	  for (unsigned j = 0; j < ops; ++j) {
+	    throttle.get(1);
+	    int64_t cur = throttle.get_current();
+	    int64_t p = peak.load();
+	    while (cur > p && !peak.compare_exchange_weak(p, cur))
+	      ;
+	    throttle.put(1);
+	  }
+	}));
+  }
+  for (auto &&t : ts)
+    t.join();
+  std::chrono::duration<double> elapsed =
+    std::chrono::steady_clock::now() - start;
+  EXPECT_EQ(0, throttle.get_current());
+  return make_pair((double)threads * ops / elapsed.count(), peak.load());
+}
+
+TEST_F(ThrottleTest, contention) {
+  for (unsigned threads : { 1, 2, 4, 8 }) {
+    // never reaches max: lock-free fast path only
+    auto below = test_contention(1000, threads, 100000);
+    ASSERT_LE(below.second, 1000);
+    // most gets have to wait in line
+    auto at = test_contention(2, threads, 20000);
+    ASSERT_LE(at.second, 2);
+    cout << threads << " threads: " << (uint64_t)below.first
+	 << " get+put/s below max, " << (uint64_t)at.first
+	 << " get+put/s at max" << std::endl;
+  }
+}
+
 std::pair<double, std::chrono::duration<double> > test_backoff(
   double low_threshhold,
   double high_threshhold,
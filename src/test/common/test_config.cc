@@ -168,6 +168,69 @@ TEST(md_config_t, set_val)
   }
 }
 
+class snapshot_observer_t : public md_config_obs_t {
+public:
+  uint64_t seen_version = 0;
+  int seen_value = 0;
+
+  const char** get_tracked_conf_keys() const override {
+    static const char *keys[] = { "osd_max_object_name_len", NULL };
+    return keys;
+  }
+  void handle_conf_change(const md_config_t *conf,
+			  const std::set<std::string> &changed) override {
+    // the new values must already be published when we are called
+    seen_version = conf->snapshot()->version;
+    seen_value = conf->snapshot()->osd_max_object_name_len;
+  }
+};
+
+TEST(md_config_t, snapshot)
+{
+  md_config_t conf;
+  conf.cluster = "ceph";
+  const md_config_snapshot_t *first = conf.snapshot();
+  ASSERT_TRUE(first);
+  EXPECT_EQ(conf.osd_max_object_name_len, first->osd_max_object_name_len);
+
+  snapshot_observer_t obs;
+  conf.add_observer(&obs);
+
+  // nothing is published until the change is applied
+  EXPECT_EQ(0, conf.set_val("osd_max_object_name_len", "1234"));
+  EXPECT_EQ(first, conf.snapshot());
+  conf.apply_changes(nullptr);
+
+  const md_config_snapshot_t *second = conf.snapshot();
+  EXPECT_NE(first, second);
+  EXPECT_EQ(first->version + 1, second->version);
+  EXPECT_EQ(1234, (int)second->osd_max_object_name_len);
+  EXPECT_EQ(second->version, obs.seen_version);
+  EXPECT_EQ(1234, obs.seen_value);
+
+  // older snapshots stay valid and unchanged for the grace period...
+  EXPECT_EQ(0, conf.reclaim_snapshots());
+  EXPECT_NE(1234, (int)first->osd_max_object_name_len);
+  // ...and are freed after it
+  EXPECT_EQ(0, conf.set_val("config_snapshot_grace", "0"));
+  conf.apply_changes(nullptr);
+  const md_config_snapshot_t *third = conf.snapshot();
+  EXPECT_EQ(0u, third->config_snapshot_grace);
+  EXPECT_EQ(2, conf.reclaim_snapshots());
+  EXPECT_EQ(0, conf.reclaim_snapshots());
+
+  // applying with nothing changed does not publish again
+  conf.apply_changes(nullptr);
+  EXPECT_EQ(third, conf.snapshot());
+  // nor does setting a value to what it already is
+  EXPECT_EQ(0, conf.set_val("osd_max_object_name_len", "1234"));
+  conf.apply_changes(nullptr);
+  EXPECT_EQ(third, conf.snapshot());
+  EXPECT_EQ(0, conf.reclaim_snapshots());
+
+  conf.remove_observer(&obs);
+}
+
 /*
  * Local Variables:
  * compile-command: "cd ../.. ;
@@ -265,3 +265,31 @@ TEST(Crc32c, RangeNull) {
     ASSERT_EQ(crc, *check);
   }
 }
+
+TEST(Crc32c, Zeros) {
+  int len = sizeof(crc_zero_check_table) / sizeof(crc_zero_check_table[0]);
+  uint32_t crc = 1;
+  uint32_t *check = crc_zero_check_table;
+
+  for (int i = 0 ; i < len; i++, check++) {
+    crc = ceph_crc32c_zeros(crc, len-i);
+    ASSERT_EQ(crc, *check);
+  }
+  ASSERT_EQ(0u, ceph_crc32c_zeros(0, 12345));
+  ASSERT_EQ(1234u, ceph_crc32c_zeros(1234, 0));
+}
+
+TEST(Crc32c, Combine) {
+  unsigned len = 1 << 20;
+  unsigned char *b = (unsigned char *)malloc(len);
+  for (unsigned i = 0; i < len; i++)
+    b[i] = rand();
+  uint32_t whole = ceph_crc32c(5678, b, len);
+  unsigned splits[] = { 0, 1, 7, 4096, 65537, len - 1, len };
+  for (unsigned s : splits) {
+    uint32_t a = ceph_crc32c(5678, b, s);
+    uint32_t c = ceph_crc32c(0, b + s, len - s);
+    ASSERT_EQ(whole, ceph_crc32c_combine(a, c, len - s));
+  }
+  free(b);
+}
@@ -0,0 +1,180 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <pthread.h>
+
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/Finisher.h"
+#include "global/global_context.h"
+
+namespace {
+
+/// what each lane has completed so far, per ordering token
+struct Recorder {
+  std::mutex lock;
+  std::map<uint64_t, std::vector<int>> done;
+  std::map<uint64_t, pthread_t> thread;
+  std::map<uint64_t, std::vector<int>> rvals;
+};
+
+class C_Record : public Context {
+  Recorder *rec;
+  uint64_t token;
+  int seq;
+public:
+  C_Record(Recorder *rec, uint64_t token, int seq)
+    : rec(rec), token(token), seq(seq) {}
+  void finish(int r) override {
+    std::lock_guard<std::mutex> l(rec->lock);
+    auto p = rec->thread.find(token);
+    if (p == rec->thread.end())
+      rec->thread[token] = pthread_self();
+    else
+      EXPECT_TRUE(pthread_equal(p->second, pthread_self()));
+    rec->done[token].push_back(seq);
+    rec->rvals[token].push_back(r);
+  }
+};
+
+} // anonymous namespace
+
+TEST(ShardedFinisher, lane_selection)
+{
+  ShardedFinisher f(g_ceph_context, "test_lanes", "fn_test", 4);
+  ASSERT_EQ(4u, f.get_num_lanes());
+  std::set<Finisher*> lanes;
+  for (uint64_t t = 0; t < 4; ++t) {
+    lanes.insert(f.get_lane(t));
+    // the same token always maps to the same lane
+    ASSERT_EQ(f.get_lane(t), f.get_lane(t));
+    ASSERT_EQ(f.get_lane(t), f.get_lane(t + 4));
+    ASSERT_EQ(f.get_lane(t), f.get_lane(t + 4000));
+  }
+  // and consecutive tokens spread over all of them
+  ASSERT_EQ(4u, lanes.size());
+
+  ShardedFinisher one(g_ceph_context, "test_one_lane", "fn_test", 1);
+  ASSERT_EQ(one.get_lane(0), one.get_lane(12345));
+}
+
+TEST(ShardedFinisher, per_lane_ordering)
+{
+  const uint64_t num_tokens = 16;
+  const int per_token = 1000;
+  ShardedFinisher f(g_ceph_context, "test_order", "fn_test", 4);
+  f.start();
+  Recorder rec;
+  for (int i = 0; i < per_token; ++i) {
+    for (uint64_t t = 0; t < num_tokens; ++t) {
+      switch (i % 3) {
+      case 0:
+	f.queue(t, new C_Record(&rec, t, i));
+	break;
+      case 1:
+	f.queue(t, new C_Record(&rec, t, i), -i);
+	break;
+      case 2:
+	{
+	  list<Context*> ls;
+	  ls.push_back(new C_Record(&rec, t, i));
+	  f.queue(t, ls);
+	}
+	break;
+      }
+    }
+  }
+  f.wait_for_empty();
+  {
+    std::lock_guard<std::mutex> l(rec.lock);
+    ASSERT_EQ(num_tokens, rec.done.size());
+    for (uint64_t t = 0; t < num_tokens; ++t) {
+      const std::vector<int>& d = rec.done[t];
+      ASSERT_EQ((size_t)per_token, d.size());
+      for (int i = 0; i < per_token; ++i) {
+	ASSERT_EQ(i, d[i]);
+	ASSERT_EQ(i % 3 == 1 ? -i : 0, rec.rvals[t][i]);
+      }
+    }
+    // tokens on different lanes ran on different threads
+    for (uint64_t t = 1; t < 4; ++t)
+      ASSERT_FALSE(pthread_equal(rec.thread[0], rec.thread[t]));
+    // and tokens sharing a lane on the same one
+    ASSERT_TRUE(pthread_equal(rec.thread[0], rec.thread[4]));
+  }
+  f.stop();
+}
+
+TEST(ShardedFinisher, wait_for_empty)
+{
+  ShardedFinisher f(g_ceph_context, "test_wait", "fn_test", 3);
+  f.start();
+  // nothing queued: returns right away
+  f.wait_for_empty();
+
+  std::mutex gate;
+  gate.lock();
+  Recorder rec;
+  // hold lane 0 up until after the other lanes are done
+  f.queue(0, new FunctionContext([&gate](int r) {
+	gate.lock();
+	gate.unlock();
+      }));
+  for (uint64_t t = 0; t < 3; ++t)
+    f.queue(t, new C_Record(&rec, t, 0));
+  f.get_lane(1)->wait_for_empty();
+  f.get_lane(2)->wait_for_empty();
+  {
+    std::lock_guard<std::mutex> l(rec.lock);
+    ASSERT_EQ(0u, rec.done.count(0));
+    ASSERT_EQ(1u, rec.done[1].size());
+    ASSERT_EQ(1u, rec.done[2].size());
+  }
+  gate.unlock();
+  f.wait_for_empty();
+  {
+    std::lock_guard<std::mutex> l(rec.lock);
+    ASSERT_EQ(1u, rec.done[0].size());
+  }
+  f.stop();
+}
+
+TEST(ShardedFinisher, stop)
+{
+  ShardedFinisher f(g_ceph_context, "test_stop", "fn_test", 2);
+  Recorder rec;
+  f.start();
+  for (uint64_t t = 0; t < 2; ++t)
+    f.queue(t, new C_Record(&rec, t, 0));
+  f.wait_for_empty();
+  // stop joins every lane's thread, so nothing queued now runs...
+  f.stop();
+  for (uint64_t t = 0; t < 2; ++t)
+    f.queue(t, new C_Record(&rec, t, 1));
+  {
+    std::lock_guard<std::mutex> l(rec.lock);
+    for (uint64_t t = 0; t < 2; ++t)
+      ASSERT_EQ(1u, rec.done[t].size());
+  }
+
+  // ...until the lanes are started again
+  f.start();
+  f.wait_for_empty();
+  f.stop();
+  std::lock_guard<std::mutex> l(rec.lock);
+  for (uint64_t t = 0; t < 2; ++t)
+    ASSERT_EQ(std::vector<int>({0, 1}), rec.done[t]);
+}
@@ -0,0 +1,185 @@
+// -*- mode:C++; tab-width:8; c-basic-offset:2; indent-tabs-mode:t -*-
+// vim: ts=8 sw=2 smarttab
+/*
+ * Ceph - scalable distributed file system
+ *
+ * This is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License version 2.1, as published by the Free Software
+ * Foundation.  See file COPYING.
+ *
+ */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "common/Formatter.h"
+#include "common/TrackedOp.h"
+#include "global/global_context.h"
+
+class TestOp : public TrackedOp {
+public:
+  typedef boost::intrusive_ptr<TestOp> Ref;
+
+  TestOp(int n, OpTracker *tracker)
+    : TrackedOp(tracker, ceph_clock_now()), n(n) {}
+
+  int n;
+  size_t num_events() const {
+    Mutex::Locker l(lock);
+    return events.size();
+  }
+  bool is_sampled() const {
+    return sampled;
+  }
+
+protected:
+  void _dump_op_descriptor_unlocked(ostream& stream) const override {
+    stream << "test_op(" << n << ")";
+  }
+};
+
+static int count_ops(OpTracker& tracker, bool historic)
+{
+  JSONFormatter f;
+  if (historic)
+    EXPECT_TRUE(tracker.dump_historic_ops(&f));
+  else
+    EXPECT_TRUE(tracker.dump_ops_in_flight(&f));
+  stringstream ss;
+  f.flush(ss);
+  string s = ss.str();
+  int n = 0;
+  for (size_t p = s.find("test_op("); p != string::npos;
+       p = s.find("test_op(", p + 1))
+    ++n;
+  return n;
+}
+
+TEST(OpTracker, track_all)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_history_size_and_duration(100, 600);
+  tracker.set_complaint_and_threshold(30, 5);
+  {
+    vector<TestOp::Ref> ops;
+    for (int i = 0; i < 10; ++i) {
+      ops.push_back(tracker.create_request<TestOp, int>(i));
+      ops.back()->mark_event("started");
+    }
+    EXPECT_EQ(10, count_ops(tracker, false));
+    for (auto& op : ops) {
+      EXPECT_TRUE(op->is_sampled());
+      EXPECT_EQ(2u, op->num_events());
+    }
+  }
+  EXPECT_EQ(0, count_ops(tracker, false));
+  EXPECT_EQ(10, count_ops(tracker, true));
+  tracker.on_shutdown();
+}
+
+TEST(OpTracker, sampled)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_history_size_and_duration(100, 600);
+  tracker.set_complaint_and_threshold(30, 5);
+  tracker.set_sample_rate(4);
+  {
+    vector<TestOp::Ref> ops;
+    for (int i = 0; i < 16; ++i) {
+      ops.push_back(tracker.create_request<TestOp, int>(i));
+      ops.back()->mark_event("started");
+    }
+    // every op is in flight, one in four records its events
+    EXPECT_EQ(16, count_ops(tracker, false));
+    int sampled = 0;
+    for (auto& op : ops) {
+      if (op->is_sampled()) {
+	++sampled;
+	EXPECT_EQ(2u, op->num_events());
+      } else {
+	EXPECT_EQ(0u, op->num_events());
+	EXPECT_STREQ("started", op->state_string());
+      }
+    }
+    EXPECT_EQ(4, sampled);
+  }
+  // fast unsampled ops are not kept
+  EXPECT_EQ(4, count_ops(tracker, true));
+  tracker.on_shutdown();
+}
+
+TEST(OpTracker, slow_ops_are_kept)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_history_size_and_duration(100, 600);
+  tracker.set_complaint_and_threshold(0.01, 5);
+  tracker.set_sample_rate(1000000);
+  {
+    vector<TestOp::Ref> ops;
+    for (int i = 0; i < 8; ++i)
+      ops.push_back(tracker.create_request<TestOp, int>(i));
+    int sampled = 0;
+    for (auto& op : ops)
+      sampled += op->is_sampled();
+    EXPECT_GE(1, sampled);
+
+    usleep(20000);
+    vector<string> warnings;
+    int slow = 0;
+    EXPECT_TRUE(tracker.check_ops_in_flight(warnings, &slow));
+    EXPECT_EQ(8, slow);
+    EXPECT_EQ(6u, warnings.size());  // summary + log threshold
+
+    // slow ops record events from now on
+    for (auto& op : ops) {
+      EXPECT_TRUE(op->is_sampled());
+      op->mark_event("finishing");
+      EXPECT_LE(2u, op->num_events());
+    }
+  }
+  EXPECT_EQ(8, count_ops(tracker, true));
+  tracker.on_shutdown();
+}
+
+TEST(OpTracker, concurrent)
+{
+  OpTracker tracker(g_ceph_context, true, 4);
+  tracker.set_history_size_and_duration(20, 600);
+  tracker.set_complaint_and_threshold(30, 5);
+  tracker.set_sample_rate(3);
+
+  const int num_threads = 4;
+  const int num_ops = 20000;
+  std::atomic<bool> done = {false};
+  std::thread dumper([&] {
+      while (!done) {
+	count_ops(tracker, false);
+	count_ops(tracker, true);
+	pow2_hist_t h;
+	tracker.get_age_ms_histogram(&h);
+	vector<string> warnings;
+	tracker.check_ops_in_flight(warnings);
+      }
+    });
+  vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.push_back(std::thread([&, t] {
+	  vector<TestOp::Ref> ops;
+	  for (int i = 0; i < num_ops; ++i) {
+	    ops.push_back(tracker.create_request<TestOp, int>(t * num_ops + i));
+	    ops.back()->mark_event("started");
+	    if (ops.size() > 100)
+	      ops.erase(ops.begin(), ops.begin() + 50);
+	  }
+	}));
+  }
+  for (auto& t : threads)
+    t.join();
+  done = true;
+  dumper.join();
+  EXPECT_EQ(0, count_ops(tracker, false));
+  tracker.on_shutdown();
+}
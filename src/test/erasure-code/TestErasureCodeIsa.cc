@@ -874,6 +874,64 @@ TEST_F(IsaErasureCodeTest, isa_xor_codec)
   EXPECT_EQ(5, cnt_cf);
 }
 
+TEST_F(IsaErasureCodeTest, parity_delta)
+{
+  const char *ms[] = { "1", "3" };
+  const int matrices[] = { ErasureCodeIsaDefault::kVandermonde,
+			   ErasureCodeIsaDefault::kCauchy };
+  for (int matrix = 0; matrix < 2; matrix++) {
+    for (int j = 0; j < 2; j++) {
+      ErasureCodeIsaDefault Isa(tcache, matrices[matrix]);
+      ErasureCodeProfile profile;
+      profile["k"] = "4";
+      profile["m"] = ms[j];
+      EXPECT_EQ(0, Isa.init(profile, &cerr));
+      EXPECT_TRUE(Isa.supports_parity_delta());
+      unsigned k = Isa.get_data_chunk_count();
+      unsigned n = Isa.get_chunk_count();
+
+      const unsigned object_size = 4 * 4096;
+      bufferlist before;
+      for (unsigned i = 0; i < object_size; i++)
+	before.append((char)(i * 7));
+      bufferlist after = before;
+      after.rebuild();
+      // overwrite part of the first and the last data chunks
+      unsigned chunk_size = Isa.get_chunk_size(object_size);
+      for (unsigned i = 10; i < 1000; i++) {
+	after.c_str()[i] = (char)(i * 13 + 1);
+	after.c_str()[(k - 1) * chunk_size + i] = (char)(i * 3 + 5);
+      }
+
+      set<int> want_to_encode;
+      for (unsigned i = 0; i < n; i++)
+	want_to_encode.insert(i);
+      map<int, bufferlist> old_encoded;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, before, &old_encoded));
+      map<int, bufferlist> new_encoded;
+      EXPECT_EQ(0, Isa.encode(want_to_encode, after, &new_encoded));
+
+      map<int, bufferptr> deltas;
+      int modified[] = { 0, (int)k - 1 };
+      for (int i : modified) {
+	Isa.encode_delta(old_encoded[i].begin().get_current_ptr(),
+			 new_encoded[i].begin().get_current_ptr(),
+			 &deltas[i]);
+      }
+      map<int, bufferptr> parity;
+      for (unsigned i = k; i < n; i++) {
+	old_encoded[i].rebuild();
+	parity[i] = old_encoded[i].begin().get_current_ptr();
+      }
+      EXPECT_EQ(0, Isa.apply_delta(deltas, &parity));
+      for (unsigned i = k; i < n; i++) {
+	EXPECT_EQ(0, memcmp(parity[i].c_str(), new_encoded[i].c_str(),
+			    new_encoded[i].length()));
+      }
+    }
+  }
+}
+
 TEST_F(IsaErasureCodeTest, create_ruleset)
 {
   CrushWrapper *c = new CrushWrapper;
@@ -227,6 +227,66 @@ TYPED_TEST(ErasureCodeTest, minimum_to_decode)
   }
 }
 
+template <typename T>
+void check_parity_delta(const char *w, const char *m)
+{
+  T jerasure;
+  ErasureCodeProfile profile;
+  profile["k"] = "3";
+  profile["m"] = m;
+  profile["w"] = w;
+  EXPECT_EQ(0, jerasure.init(profile, &cerr));
+  EXPECT_TRUE(jerasure.supports_parity_delta());
+  unsigned k = jerasure.get_data_chunk_count();
+  unsigned n = jerasure.get_chunk_count();
+
+  const unsigned object_size = 3 * 4096;
+  bufferlist before;
+  for (unsigned i = 0; i < object_size; i++)
+    before.append((char)(i * 7));
+  bufferlist after = before;
+  after.rebuild();
+  // overwrite part of the second data chunk
+  unsigned chunk_size = jerasure.get_chunk_size(object_size);
+  for (unsigned i = 100; i < 300; i++)
+    after.c_str()[chunk_size + i] = (char)(i * 13 + 1);
+
+  set<int> want_to_encode;
+  for (unsigned i = 0; i < n; i++)
+    want_to_encode.insert(i);
+  map<int, bufferlist> old_encoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, before, &old_encoded));
+  map<int, bufferlist> new_encoded;
+  EXPECT_EQ(0, jerasure.encode(want_to_encode, after, &new_encoded));
+
+  map<int, bufferptr> deltas;
+  jerasure.encode_delta(old_encoded[1].begin().get_current_ptr(),
+			new_encoded[1].begin().get_current_ptr(),
+			&deltas[1]);
+  map<int, bufferptr> parity;
+  for (unsigned i = k; i < n; i++) {
+    old_encoded[i].rebuild();
+    parity[i] = old_encoded[i].begin().get_current_ptr();
+  }
+  EXPECT_EQ(0, jerasure.apply_delta(deltas, &parity));
+  for (unsigned i = k; i < n; i++) {
+    EXPECT_EQ(0, memcmp(parity[i].c_str(), new_encoded[i].c_str(),
+			new_encoded[i].length()));
+  }
+}
+
+TEST(ErasureCodeTest, parity_delta)
+{
+  check_parity_delta<ErasureCodeJerasureReedSolomonVandermonde>("8", "2");
+  check_parity_delta<ErasureCodeJerasureReedSolomonVandermonde>("16", "2");
+  check_parity_delta<ErasureCodeJerasureReedSolomonVandermonde>("32", "3");
+  check_parity_delta<ErasureCodeJerasureReedSolomonRAID6>("8", "2");
+  check_parity_delta<ErasureCodeJerasureReedSolomonRAID6>("16", "2");
+
+  ErasureCodeJerasureCauchyGood cauchy;
+  EXPECT_FALSE(cauchy.supports_parity_delta());
+}
+
 TEST(ErasureCodeTest, encode)
 {
   ErasureCodeJerasureReedSolomonVandermonde jerasure;
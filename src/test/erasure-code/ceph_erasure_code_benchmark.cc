@@ -49,7 +49,9 @@ int ErasureCodeBench::setup(int argc, char** argv) {
     ("plugin,p", po::value<string>()->default_value("jerasure"),
      "erasure code plugin name")
     ("workload,w", po::value<string>()->default_value("encode"),
-     "run either encode or decode")
+     "run either encode, decode or overwrite")
+    ("stripe-unit,u", po::value<int>()->default_value(4096),
+     "size of a chunk in a stripe when overwriting")
     ("erasures,e", po::value<int>()->default_value(1),
      "number of erasures when decoding")
     ("erased", po::value<vector<int> >(),
@@ -109,6 +111,7 @@ int ErasureCodeBench::setup(int argc, char** argv) {
   }
 
   in_size = vm["size"].as<int>();
+  stripe_unit = vm["stripe-unit"].as<int>();
   max_iterations = vm["iterations"].as<int>();
   plugin = vm["plugin"].as<string>();
   workload = vm["workload"].as<string>();
@@ -143,6 +146,8 @@ int ErasureCodeBench::run() {
 
   if (workload == "encode")
     return encode();
+  else if (workload == "overwrite")
+    return overwrite();
   else
     return decode();
 }
@@ -188,6 +193,132 @@ int ErasureCodeBench::encode()
   return 0;
 }
 
+/*
+ * Overwrite the first --size bytes of an object made of stripes of
+ * k chunks of --stripe-unit bytes, as an erasure coded pool with
+ * overwrites would: either by re-encoding the full stripes, or by
+ * updating the coding chunks from the difference between the old and
+ * the new content of the modified data chunks.  For each method,
+ * display the time spent encoding and the number of shard reads and
+ * writes required by one overwrite.
+ */
+int ErasureCodeBench::overwrite()
+{
+  ErasureCodePluginRegistry &instance = ErasureCodePluginRegistry::instance();
+  ErasureCodeInterfaceRef erasure_code;
+  stringstream messages;
+  int code = instance.factory(plugin,
+			      g_conf->erasure_code_dir,
+			      profile, &erasure_code, &messages);
+  if (code) {
+    cerr << messages.str() << endl;
+    return code;
+  }
+  k = erasure_code->get_data_chunk_count();
+  m = erasure_code->get_chunk_count() - k;
+
+  const unsigned stripe_width = k * stripe_unit;
+  const unsigned stripes = (in_size + stripe_width - 1) / stripe_width;
+  const unsigned chunk_length = stripes * stripe_unit;
+
+  // the same content laid out as stripes and as chunks
+  bufferlist new_stripes;
+  new_stripes.append(string(in_size, 'Y'));
+  new_stripes.append(string(stripes * stripe_width - in_size, 'X'));
+  new_stripes.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  bufferlist old_chunks;
+  old_chunks.append(string(k * chunk_length, 'X'));
+  old_chunks.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  bufferlist new_chunks = old_chunks;
+  new_chunks.rebuild_aligned(ErasureCode::SIMD_ALIGN);
+  set<int> modified;
+  for (unsigned off = 0; off < (unsigned)in_size; off++) {
+    unsigned chunk = (off % stripe_width) / stripe_unit;
+    modified.insert(chunk);
+    new_chunks.c_str()[chunk * chunk_length +
+		       (off / stripe_width) * stripe_unit +
+		       off % stripe_unit] = 'Y';
+  }
+
+  set<int> want_to_encode;
+  for (int i = 0; i < k + m; i++) {
+    want_to_encode.insert(i);
+  }
+  map<int,bufferlist> old_encoded;
+  code = erasure_code->encode(want_to_encode, old_chunks, &old_encoded);
+  if (code)
+    return code;
+  if (old_encoded[0].length() != chunk_length) {
+    cerr << "--stripe-unit " << stripe_unit << " is not aligned for "
+	 << plugin << endl;
+    return -EINVAL;
+  }
+
+  utime_t begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    for (unsigned stripe = 0; stripe < stripes; stripe++) {
+      bufferlist in;
+      in.substr_of(new_stripes, stripe * stripe_width, stripe_width);
+      map<int,bufferlist> encoded;
+      code = erasure_code->encode(want_to_encode, in, &encoded);
+      if (code)
+	return code;
+    }
+  }
+  utime_t end_time = ceph_clock_now();
+  bool partial = in_size % stripe_width;
+  cout << "full\t" << (end_time - begin_time)
+       << "\t" << (partial ? k : 0)
+       << "\t" << (k + m) << endl;
+
+  if (!erasure_code->supports_parity_delta()) {
+    cout << "delta\tnot supported by " << plugin << endl;
+    return 0;
+  }
+
+  map<int,bufferptr> old_data;
+  map<int,bufferptr> new_data;
+  for (set<int>::iterator i = modified.begin(); i != modified.end(); ++i) {
+    old_data[*i] = bufferptr(old_chunks.c_str() + *i * chunk_length,
+			     chunk_length);
+    new_data[*i] = bufferptr(new_chunks.c_str() + *i * chunk_length,
+			     chunk_length);
+  }
+  map<int,bufferptr> parity;
+  begin_time = ceph_clock_now();
+  for (int i = 0; i < max_iterations; i++) {
+    map<int,bufferptr> deltas;
+    for (set<int>::iterator j = modified.begin(); j != modified.end(); ++j)
+      erasure_code->encode_delta(old_data[*j], new_data[*j], &deltas[*j]);
+    parity.clear();
+    for (int j = k; j < k + m; j++) {
+      parity[j] = buffer::create_aligned(chunk_length,
+					 ErasureCode::SIMD_ALIGN);
+      old_encoded[j].copy(0, chunk_length, parity[j].c_str());
+    }
+    code = erasure_code->apply_delta(deltas, &parity);
+    if (code)
+      return code;
+  }
+  end_time = ceph_clock_now();
+
+  map<int,bufferlist> new_encoded;
+  code = erasure_code->encode(want_to_encode, new_chunks, &new_encoded);
+  if (code)
+    return code;
+  for (int j = k; j < k + m; j++) {
+    if (memcmp(parity[j].c_str(), new_encoded[j].c_str(), chunk_length)) {
+      cerr << "coding chunk " << j << " updated with deltas differs from"
+	   << " the encoded coding chunk" << endl;
+      return -1;
+    }
+  }
+  cout << "delta\t" << (end_time - begin_time)
+       << "\t" << (modified.size() + m)
+       << "\t" << (modified.size() + m) << endl;
+  return 0;
+}
+
 static void display_chunks(const map<int,bufferlist> &chunks,
 			   unsigned int chunk_count) {
   cout << "chunks ";
@@ -96,6 +96,28 @@ function TEST_osd_pool_get_set() {
     teardown $dir || return 1
 }
 
+function TEST_count_min_hit_set_requires_luminous() {
+    local dir=$1
+
+    setup $dir || return 1
+    run_mon $dir a --mon-debug-no-require-luminous || return 1
+    ! ceph osd dump | grep '^flags.*require_luminous_osds' || return 1
+    ceph osd pool create cache 2 || return 1
+    ceph osd tier add $TEST_POOL cache || return 1
+    ! ceph osd pool set cache hit_set_type count_min 2> $dir/out || return 1
+    grep 'Error EPERM' $dir/out || return 1
+    ! ceph osd pool get cache hit_set_type | grep 'hit_set_type: count_min' || return 1
+    teardown $dir || return 1
+
+    setup $dir || return 1
+    run_mon $dir a || return 1
+    ceph osd pool create cache 2 || return 1
+    ceph osd tier add $TEST_POOL cache || return 1
+    ceph osd pool set cache hit_set_type count_min || return 1
+    ceph osd pool get cache hit_set_type | grep 'hit_set_type: count_min' || return 1
+    teardown $dir || return 1
+}
+
 function TEST_mon_add_to_single_mon() {
     local dir=$1
 
@@ -18,7 +18,9 @@
 #include <stdint.h>
 #include <string>
 #include <unistd.h>
+#include <sys/resource.h>
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 
@@ -29,6 +31,7 @@ using namespace std;
 #include "global/global_init.h"
 #include "msg/Messenger.h"
 #include "messages/MOSDOp.h"
+#include "messages/MOSDOpReply.h"
 
 class MessengerClient {
   class ClientThread;
@@ -80,11 +83,15 @@ class MessengerClient {
     Mutex lock;
     Cond cond;
     uint64_t inflight;
+    vector<uint64_t> send_stamp;   // rdtsc at send, indexed by tid
+    vector<uint64_t> latency_us;
 
     ClientThread(Messenger *m, int c, ConnectionRef con, int len, int ops, int think_time_us):
         msgr(m), concurrent(c), conn(con), client_inc(0), oid("object-name"), oloc(1, 1), msg_len(len), ops(ops),
         dispatcher(think_time_us, this), lock("MessengerBenchmark::ClientThread::lock") {
       m->add_dispatcher_head(&dispatcher);
+      send_stamp.resize(ops);
+      latency_us.reserve(ops);
       bufferptr ptr(msg_len);
       memset(ptr.c_str(), 0, msg_len);
       data.append(ptr);
@@ -98,9 +105,10 @@ class MessengerClient {
 	hobject_t hobj(oid, oloc.key, CEPH_NOSNAP, pgid.ps(), pgid.pool(),
 		       oloc.nspace);
 	spg_t spgid(pgid);
-        MOSDOp *m = new MOSDOp(client_inc.read(), 0, hobj, spgid, 0, 0, 0);
+        MOSDOp *m = new MOSDOp(client_inc.read(), i, hobj, spgid, 0, 0, 0);
         m->write(0, msg_len, data);
         inflight++;
+        send_stamp[i] = Cycles::rdtsc();
         conn->send_message(m);
         //cerr << __func__ << " send m=" << m << std::endl;
       }
@@ -150,25 +158,80 @@ class MessengerClient {
     for (uint64_t i = 0; i < msgrs.size(); ++i)
       msgrs[i]->wait();
   }
+  // per client (one connection, one server worker) throughput and latency
+  void report(int msg_len, double seconds) {
+    for (uint64_t i = 0; i < clients.size(); ++i) {
+      vector<uint64_t> &lat = clients[i]->latency_us;
+      if (lat.empty())
+        continue;
+      sort(lat.begin(), lat.end());
+      uint64_t sum = 0;
+      for (auto l : lat)
+        sum += l;
+      cerr << " job " << i << " ops " << lat.size()
+           << " MB/s " << (double)lat.size() * msg_len / seconds / (1 << 20)
+           << " lat avg " << sum / lat.size() << "us"
+           << " p99 " << lat[lat.size() * 99 / 100] << "us"
+           << " max " << lat.back() << "us" << std::endl;
+    }
+  }
 };
 
 void MessengerClient::ClientDispatcher::ms_fast_dispatch(Message *m) {
   usleep(think_time);
+  uint64_t now = Cycles::rdtsc();
+  ceph_tid_t tid = static_cast<MOSDOpReply*>(m)->get_tid();
   m->put();
   Mutex::Locker l(thread->lock);
+  if (tid < thread->send_stamp.size())
+    thread->latency_us.push_back(Cycles::to_microseconds(now - thread->send_stamp[tid]));
   thread->inflight--;
   thread->cond.Signal();
 }
 
 
 void usage(const string &name) {
-  cerr << "Usage: " << name << " [server ip:port] [numjobs] [concurrency] [ios] [thinktime us] [msg length]" << std::endl;
+  cerr << "Usage: " << name << " [server ip:port] [numjobs] [concurrency] [ios] [thinktime us] [msg length] [zerocopy]" << std::endl;
   cerr << "       [server ip:port]: connect to the ip:port pair" << std::endl;
   cerr << "       [numjobs]: how much client threads spawned and do benchmark" << std::endl;
   cerr << "       [concurrency]: the max inflight messages(like iodepth in fio)" << std::endl;
   cerr << "       [ios]: how much messages sent for each client" << std::endl;
   cerr << "       [thinktime]: sleep time when do fast dispatching(match client logic)" << std::endl;
   cerr << "       [msg length]: message data bytes" << std::endl;
+  cerr << "       [zerocopy]: optional, off|on|compare; report cpu per GB sent" << std::endl;
+  cerr << "                   with ms_tcp_zerocopy off, on, or both in turn" << std::endl;
+}
+
+static double cpu_seconds()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0 +
+         ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0;
+}
+
+static void run(const string &type, const string &addr, int numjobs, int concurrent,
+                int ios, int think_time, int len, const char *zerocopy)
+{
+  if (zerocopy) {
+    g_ceph_context->_conf->set_val("ms_tcp_zerocopy", zerocopy);
+    g_ceph_context->_conf->apply_changes(NULL);
+  }
+  MessengerClient client(type, addr, think_time);
+
+  client.ready(concurrent, numjobs, ios, len);
+  double cpu_start = cpu_seconds();
+  uint64_t start = Cycles::rdtsc();
+  client.start();
+  uint64_t stop = Cycles::rdtsc();
+  double cpu = cpu_seconds() - cpu_start;
+  cerr << " Total op " << ios << " run time " << Cycles::to_microseconds(stop - start) << "us." << std::endl;
+  client.report(len, Cycles::to_seconds(stop - start));
+  if (zerocopy) {
+    double gb = (double)numjobs * ios * len / (1ull << 30);
+    cerr << " zerocopy " << zerocopy << " cpu " << cpu << "s for " << gb << "GB, "
+         << (gb > 0 ? cpu / gb : 0) << " cpu s/GB" << std::endl;
+  }
 }
 
 int main(int argc, char **argv)
@@ -202,14 +265,17 @@ int main(int argc, char **argv)
   cerr << "       thinktime(us) " << think_time << std::endl;
   cerr << "       message data bytes " << len << std::endl;
 
-  MessengerClient client(public_msgr_type, args[0], think_time);
-
-  client.ready(concurrent, numjobs, ios, len);
+  string zerocopy = args.size() > 6 ? args[6] : "";
   Cycles::init();
-  uint64_t start = Cycles::rdtsc();
-  client.start();
-  uint64_t stop = Cycles::rdtsc();
-  cerr << " Total op " << ios << " run time " << Cycles::to_microseconds(stop - start) << "us." << std::endl;
+  if (zerocopy == "compare") {
+    run(public_msgr_type, args[0], numjobs, concurrent, ios, think_time, len, "false");
+    run(public_msgr_type, args[0], numjobs, concurrent, ios, think_time, len, "true");
+  } else if (zerocopy == "on" || zerocopy == "off") {
+    run(public_msgr_type, args[0], numjobs, concurrent, ios, think_time, len,
+        zerocopy == "on" ? "true" : "false");
+  } else {
+    run(public_msgr_type, args[0], numjobs, concurrent, ios, think_time, len, NULL);
+  }
 
   return 0;
 }
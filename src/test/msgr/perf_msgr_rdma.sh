@@ -0,0 +1,74 @@
+#!/bin/bash
+#
+# Exercise the async messenger's RDMA stack on a single machine with
+# soft-RoCE (rxe), no RDMA capable NIC needed.
+#
+# An rxe device is layered over NETDEV (a dummy device is created when
+# NETDEV is not set); rxe loops traffic between local addresses back
+# internally, so ceph_perf_msgr_server and ceph_perf_msgr_client can both
+# use it.  Each configuration below runs the same load and prints the
+# client's MB/s and latency per job, followed by the client's RDMA counters
+# (tx_inline_chunks, tx_zero_copy_bytes, reg_cache_miss, ...).
+#
+# Needs root, the rdma_rxe kernel module and iproute2's rdma tool, and a
+# build with -DWITH_RDMA=ON.
+#
+# usage: perf_msgr_rdma.sh [msg_len...]     (default: 4096 1048576)
+#
+
+set -e
+
+BIN=${CEPH_BIN:-./bin}
+RXE=${RXE:-rxe_ceph0}
+NETDEV=${NETDEV:-}
+IP=${IP:-10.98.0.1}
+PORT=${PORT:-6790}
+JOBS=${JOBS:-2}
+IOS=${IOS:-20000}
+DEPTH=${DEPTH:-32}
+MSG_LENS=${@:-4096 1048576}
+ASOK=/tmp/perf_msgr_rdma.client.asok
+
+created_netdev=
+cleanup() {
+    rdma link delete $RXE 2>/dev/null || true
+    [ -n "$created_netdev" ] && ip link delete $created_netdev 2>/dev/null || true
+}
+trap cleanup EXIT
+
+modprobe rdma_rxe
+if [ -z "$NETDEV" ]; then
+    NETDEV=cephrxe0
+    ip link add $NETDEV type dummy
+    created_netdev=$NETDEV
+    ip addr add $IP/24 dev $NETDEV
+    ip link set $NETDEV up
+else
+    IP=${IP_OVERRIDE:-$(ip -4 -o addr show dev $NETDEV | awk '{print $4}' | cut -d/ -f1 | head -1)}
+fi
+rdma link add $RXE type rxe netdev $NETDEV
+
+RDMA_OPTS="--ms_type async+rdma --ms_async_rdma_device_name $RXE"
+
+run() {
+    local name=$1 len=$2; shift 2
+    echo "=== $name, $len byte messages"
+    $BIN/ceph_perf_msgr_server $RDMA_OPTS "$@" $IP:$PORT $JOBS 0 > /dev/null 2>&1 &
+    local server=$!
+    sleep 1
+    $BIN/ceph_perf_msgr_client $RDMA_OPTS "$@" --admin_socket $ASOK \
+        $IP:$PORT $JOBS $DEPTH $IOS 0 $len 2>&1 | grep -E "Total op|job" &
+    local client=$!
+    # sample the counters while the client is still connected
+    sleep 2
+    $BIN/ceph --admin-daemon $ASOK perf dump 2>/dev/null | \
+        grep -E '"tx_(chunks|inline_chunks|zero_copy_bytes)"|"reg_cache_miss"' || true
+    wait $client || true
+    kill $server; wait $server 2>/dev/null || true
+}
+
+for len in $MSG_LENS; do
+    run "copy" $len --ms_async_rdma_inline_size 0
+    run "inline" $len
+    run "inline + zero copy" $len --ms_async_rdma_zero_copy true
+done
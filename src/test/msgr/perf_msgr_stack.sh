@@ -0,0 +1,77 @@
+#!/bin/bash
+#
+# Compare the async messenger's posix and DPDK stacks per core, without a
+# dedicated NIC.
+#
+# The DPDK server runs on a virtio-user port backed by vhost-net, which
+# shows up in the kernel as a tap device; the client always uses the posix
+# stack and reaches the server through that tap.  For each worker count
+# the same client load is run against a posix server on loopback and
+# against the DPDK server, and ceph_perf_msgr_client prints MB/s and
+# latency (avg/p99/max) per job.  Each job is one connection, and with
+# RSS affinity each connection is served by exactly one server core.
+#
+# Needs root (vhost-net, hugepages) and a build with -DWITH_DPDK=ON.
+#
+# usage: perf_msgr_stack.sh [workers...]     (default: 1 2 4)
+#
+
+set -e
+
+BIN=${CEPH_BIN:-./bin}
+TAP=${TAP:-tap_ceph0}
+HOST_IP=${HOST_IP:-10.99.0.1}
+DPDK_IP=${DPDK_IP:-10.99.0.2}
+PORT=${PORT:-6789}
+HUGEPAGES=${HUGEPAGES:-/dev/hugepages}
+IOS=${IOS:-100000}
+DEPTH=${DEPTH:-32}
+MSG_LEN=${MSG_LEN:-4096}
+WORKERS=${@:-1 2 4}
+
+coremask() {
+    printf "0x%x" $(( (1 << $1) - 1 ))
+}
+
+wait_tap() {
+    for i in $(seq 50); do
+        ip link show $TAP > /dev/null 2>&1 && return 0
+        sleep 0.1
+    done
+    echo "tap $TAP did not appear" >&2
+    return 1
+}
+
+run_client() {
+    local addr=$1 jobs=$2
+    $BIN/ceph_perf_msgr_client --ms_type async+posix \
+        $addr:$PORT $jobs $DEPTH $IOS 0 $MSG_LEN 2>&1 | grep -E "Total op|job"
+}
+
+for w in $WORKERS; do
+    echo "=== $w worker(s), posix server"
+    # the tap exists only while a DPDK process owns it; use loopback for posix
+    $BIN/ceph_perf_msgr_server --ms_type async+posix --ms_async_op_threads $w \
+        127.0.0.1:$PORT $w 0 > /dev/null 2>&1 &
+    server=$!
+    sleep 1
+    run_client 127.0.0.1 $w
+    kill $server; wait $server 2>/dev/null || true
+
+    echo "=== $w worker(s), dpdk server"
+    $BIN/ceph_perf_msgr_server --ms_type async+dpdk --ms_async_op_threads $w \
+        --ms_dpdk_coremask $(coremask $w) \
+        --ms_dpdk_hugepages $HUGEPAGES \
+        --ms_dpdk_host_ipv4_addr $DPDK_IP \
+        --ms_dpdk_gateway_ipv4_addr $HOST_IP \
+        --ms_dpdk_netmask_ipv4_addr 255.255.255.0 \
+        --ms_dpdk_eal_args "--vdev=net_virtio_user0,path=/dev/vhost-net,queues=$w,iface=$TAP --no-pci" \
+        $DPDK_IP:$PORT $w 0 > /dev/null 2>&1 &
+    server=$!
+    wait_tap
+    ip addr add $HOST_IP/24 dev $TAP 2>/dev/null || true
+    ip link set $TAP up
+    sleep 1
+    run_client $DPDK_IP $w
+    kill $server; wait $server 2>/dev/null || true
+done
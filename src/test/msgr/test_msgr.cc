@@ -22,6 +22,7 @@
 #include "common/Mutex.h"
 #include "common/Cond.h"
 #include "common/ceph_argparse.h"
+#include "common/Formatter.h"
 #include "global/global_init.h"
 #include "msg/Dispatcher.h"
 #include "msg/msg_types.h"
@@ -767,6 +768,141 @@ TEST_P(MessengerTest, MessageTest) {
 }
 
 
+class OrderDispatcher : public Dispatcher {
+ public:
+  Mutex lock;
+  Cond cond;
+  map<Connection*, uint64_t> next_seq;
+  uint64_t received = 0;
+  bool out_of_order = false;
+
+  OrderDispatcher(): Dispatcher(g_ceph_context), lock("OrderDispatcher::lock") {}
+  bool ms_can_fast_dispatch_any() const override { return false; }
+  bool ms_dispatch(Message *m) override {
+    MCommand *c = static_cast<MCommand*>(m);
+    uint64_t seq = std::stoull(c->cmd[0]);
+    // give other dispatch threads a chance to overtake us
+    usleep(rand() % 100);
+    Mutex::Locker l(lock);
+    uint64_t &next = next_seq[m->get_connection().get()];
+    if (seq != next)
+      out_of_order = true;
+    next = seq + 1;
+    ++received;
+    cond.Signal();
+    m->put();
+    return true;
+  }
+  bool ms_handle_reset(Connection *con) override { return true; }
+  void ms_handle_remote_reset(Connection *con) override {}
+  bool ms_handle_refused(Connection *con) override { return false; }
+  bool ms_verify_authorizer(Connection *con, int peer_type, int protocol,
+                            bufferlist& authorizer, bufferlist& authorizer_reply,
+                            bool& isvalid, CryptoKey& session_key) override {
+    isvalid = true;
+    return true;
+  }
+};
+
+TEST_P(MessengerTest, MultiDispatchThreadsTest) {
+  const int num_clients = 8, num_msgs = 200;
+  g_ceph_context->_conf->set_val("ms_dispatch_threads", "4");
+  Messenger *server = Messenger::create(g_ceph_context, string(GetParam()),
+                                        entity_name_t::OSD(1), "mserver", getpid(), 0);
+  g_ceph_context->_conf->set_val("ms_dispatch_threads", "1");
+  OrderDispatcher srv_dispatcher;
+  FakeDispatcher cli_dispatcher(false);
+  entity_addr_t bind_addr;
+  bind_addr.parse("127.0.0.1");
+  server->set_default_policy(Messenger::Policy::stateless_server(0, 0));
+  server->bind(bind_addr);
+  server->add_dispatcher_head(&srv_dispatcher);
+  server->start();
+
+  vector<Messenger*> clients;
+  for (int i = 0; i < num_clients; ++i) {
+    Messenger *c = Messenger::create(g_ceph_context, string(GetParam()),
+                                     entity_name_t::CLIENT(-1), "mclient",
+                                     getpid() + i + 1, 0);
+    c->set_default_policy(Messenger::Policy::lossless_client(0, 0));
+    c->add_dispatcher_head(&cli_dispatcher);
+    c->start();
+    clients.push_back(c);
+  }
+
+  uuid_d uuid;
+  uuid.generate_random();
+  for (int n = 0; n < num_msgs; ++n) {
+    for (auto c : clients) {
+      MCommand *m = new MCommand(uuid);
+      m->cmd.push_back(stringify(n));
+      c->get_connection(server->get_myinst())->send_message(m);
+    }
+  }
+  {
+    Mutex::Locker l(srv_dispatcher.lock);
+    while (srv_dispatcher.received < (uint64_t)num_clients * num_msgs)
+      srv_dispatcher.cond.Wait(srv_dispatcher.lock);
+    ASSERT_FALSE(srv_dispatcher.out_of_order);
+    ASSERT_EQ((size_t)num_clients, srv_dispatcher.next_seq.size());
+  }
+
+  for (auto c : clients) {
+    c->shutdown();
+    c->wait();
+    delete c;
+  }
+  server->shutdown();
+  server->wait();
+  delete server;
+}
+
+TEST_P(MessengerTest, MsgLatencyTest) {
+  g_ceph_context->_conf->set_val("ms_msg_latency", "true");
+  Messenger *server = Messenger::create(g_ceph_context, string(GetParam()),
+                                        entity_name_t::OSD(1), "lserver", getpid(), 0);
+  Messenger *client = Messenger::create(g_ceph_context, string(GetParam()),
+                                        entity_name_t::CLIENT(-1), "lclient", getpid() + 1, 0);
+  g_ceph_context->_conf->set_val("ms_msg_latency", "false");
+  ASSERT_TRUE(server->msg_latency != NULL);
+  ASSERT_EQ(server->msg_latency, client->msg_latency);
+
+  FakeDispatcher cli_dispatcher(false), srv_dispatcher(true);
+  entity_addr_t bind_addr;
+  bind_addr.parse("127.0.0.1");
+  server->set_default_policy(Messenger::Policy::stateless_server(0, 0));
+  server->bind(bind_addr);
+  server->add_dispatcher_head(&srv_dispatcher);
+  server->start();
+  client->set_default_policy(Messenger::Policy::lossy_client(0, 0));
+  client->add_dispatcher_head(&cli_dispatcher);
+  client->start();
+
+  ConnectionRef conn = client->get_connection(server->get_myinst());
+  {
+    ASSERT_EQ(conn->send_message(new MPing()), 0);
+    Mutex::Locker l(cli_dispatcher.lock);
+    while (!cli_dispatcher.got_new)
+      cli_dispatcher.cond.Wait(cli_dispatcher.lock);
+    cli_dispatcher.got_new = false;
+  }
+
+  JSONFormatter f;
+  server->msg_latency->dump(&f);
+  stringstream ss;
+  f.flush(ss);
+  ASSERT_NE(string::npos, ss.str().find("\"name\":\"ping\""));
+  ASSERT_NE(string::npos, ss.str().find("osd.1 <-> client"));
+
+  client->shutdown();
+  client->wait();
+  server->shutdown();
+  server->wait();
+  delete client;
+  delete server;
+}
+
+
 class SyntheticWorkload;
 
 struct Payload {
@@ -17,6 +17,9 @@
 #include <errno.h>
 #include <signal.h>
 #include "osd/ECBackend.h"
+#include "osd/ECTransaction.h"
+#include "common/ceph_context.h"
+#include "test/erasure-code/ErasureCodeExample.h"
 #include "gtest/gtest.h"
 
 TEST(ECUtil, stripe_info_t)
@@ -58,3 +61,117 @@ TEST(ECUtil, stripe_info_t)
             make_pair((uint64_t)0, 2*swidth));
 }
 
+
+// k=2 m=1 xor code that can also update its coding chunk from deltas
+class ErasureCodeExampleDelta : public ErasureCodeExample {
+public:
+  bool supports_parity_delta() const override {
+    return true;
+  }
+  int apply_delta(const map<int, bufferptr> &in,
+		  map<int, bufferptr> *out) override {
+    for (auto &&d: in) {
+      for (auto &&c: *out) {
+	for (unsigned i = 0; i < c.second.length(); ++i)
+	  c.second.c_str()[i] ^= d.second.c_str()[i];
+      }
+    }
+    return 0;
+  }
+};
+
+class TestDpp : public DoutPrefixProvider {
+  CephContext *cct;
+public:
+  explicit TestDpp(CephContext *cct) : cct(cct) {}
+  string gen_prefix() const override { return "test "; }
+  CephContext *get_cct() const override { return cct; }
+  unsigned get_subsys() const override { return ceph_subsys_osd; }
+};
+
+TEST(ECTransaction, parity_delta_overwrite)
+{
+  CephContext *cct = new CephContext(CEPH_ENTITY_TYPE_OSD);
+  TestDpp dpp(cct);
+  const uint64_t chunk_size = 4096;
+  ECUtil::stripe_info_t sinfo(2, 2 * chunk_size);
+  ErasureCodeInterfaceRef ec_impl(new ErasureCodeExampleDelta);
+  pg_t pgid(0, 2);
+  hobject_t hoid = spg_t(pgid, shard_id_t::NO_SHARD).make_temp_hobject("obj");
+
+  // one existing stripe: chunk 0 is all 'a', chunk 1 all 'b'
+  ECUtil::HashInfoRef hinfo(new ECUtil::HashInfo(3));
+  hinfo->set_total_chunk_size_clear_hash(chunk_size);
+  hinfo->set_projected_total_logical_size(sinfo, 2 * chunk_size);
+  bufferptr old_data[2] = {
+    buffer::create(chunk_size), buffer::create(chunk_size)
+  };
+  bufferptr old_parity = buffer::create(chunk_size);
+  memset(old_data[0].c_str(), 'a', chunk_size);
+  memset(old_data[1].c_str(), 'b', chunk_size);
+  for (unsigned i = 0; i < chunk_size; ++i)
+    old_parity.c_str()[i] = 'a' ^ 'b';
+
+  // overwrite 200 bytes in the middle of chunk 0
+  PGTransactionUPtr t(new PGTransaction);
+  bufferlist bl;
+  bl.append(string(200, 'z'));
+  t->write(hoid, 100, bl.length(), bl);
+
+  ECTransaction::WritePlan plan = ECTransaction::get_write_plan(
+    sinfo,
+    std::move(t),
+    [&](const hobject_t &i) { return hinfo; },
+    &dpp);
+  ASSERT_EQ(1u, plan.to_read.count(hoid));
+  ECTransaction::plan_parity_delta(sinfo, ec_impl, plan);
+  ASSERT_EQ(set<int>{0}, plan.delta_chunks[hoid]);
+
+  // the delta read returns only data chunk 0 and the coding chunk
+  map<hobject_t,map<int,extent_map>> delta_extents;
+  bufferlist b0, b2;
+  b0.append(old_data[0]);
+  b2.append(old_parity);
+  delta_extents[hoid][0].insert(0, chunk_size, b0);
+  delta_extents[hoid][2].insert(0, chunk_size, b2);
+
+  vector<pg_log_entry_t> entries;
+  map<hobject_t,extent_map> written;
+  map<shard_id_t, ObjectStore::Transaction> transactions;
+  for (int i = 0; i < 3; ++i)
+    transactions[shard_id_t(i)];
+  set<hobject_t> temp_added, temp_removed;
+  ECTransaction::generate_transactions(
+    plan, ec_impl, pgid, false, sinfo,
+    map<hobject_t,extent_map>(), delta_extents, entries,
+    &written, &transactions, &temp_added, &temp_removed, &dpp);
+
+  map<int, bufferlist> writes;
+  for (auto &&st: transactions) {
+    auto i = st.second.begin();
+    while (i.have_op()) {
+      ObjectStore::Transaction::Op *op = i.decode_op();
+      if (op->op == ObjectStore::Transaction::OP_WRITE) {
+	ASSERT_EQ(0u, op->off);
+	ASSERT_EQ(chunk_size, op->len);
+	i.decode_bl(writes[st.first]);
+      } else if (op->op == ObjectStore::Transaction::OP_SETATTR) {
+	i.decode_string();
+	bufferlist attr;
+	i.decode_bl(attr);
+      }
+    }
+  }
+
+  // chunk 1 is neither read nor written
+  ASSERT_EQ(2u, writes.size());
+  ASSERT_EQ(0u, writes.count(1));
+  const char *data = writes[0].c_str();
+  const char *parity = writes[2].c_str();
+  for (unsigned i = 0; i < chunk_size; ++i) {
+    char expected = (i >= 100 && i < 300) ? 'z' : 'a';
+    ASSERT_EQ(expected, data[i]);
+    ASSERT_EQ(expected ^ 'b', parity[i]);
+  }
+  cct->put();
+}
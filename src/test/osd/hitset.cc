@@ -195,3 +195,114 @@ TEST_F(ExplicitObjectHitSetTest, RejectsNoMatch) {
   }
   EXPECT_EQ(matches, 0);
 }
+
+class CountMinHitSetTest : public testing::Test, public HitSetTestStrap {
+public:
+
+  CountMinHitSetTest()
+    : HitSetTestStrap(new HitSet(new CountMinHitSet(4, 1024, 1))) {}
+
+  CountMinHitSet *get_hitset() { return static_cast<CountMinHitSet*>(hitset->impl.get()); }
+};
+
+TEST_F(CountMinHitSetTest, Construct) {
+  ASSERT_EQ(hitset->impl->get_type(), HitSet::TYPE_COUNT_MIN);
+  ASSERT_TRUE(hitset->is_cumulative());
+}
+
+TEST_F(CountMinHitSetTest, InsertsMatch) {
+  fill(50);
+  verify_fill(50);
+  EXPECT_FALSE(hitset->is_full());
+  EXPECT_GE(hitset->approx_unique_insert_count(), 45u);
+  EXPECT_LE(hitset->approx_unique_insert_count(), 55u);
+}
+
+TEST_F(CountMinHitSetTest, Frequency) {
+  hobject_t hot(object_t("hot"), "", 0, 1234, 0, "");
+  hobject_t cold(object_t("cold"), "", 0, 5678, 0, "");
+  for (int i = 0; i < 10; ++i)
+    hitset->insert(hot);
+  hitset->insert(cold);
+  // count-min never undercounts
+  EXPECT_GE(hitset->estimate_count(hot), 10u);
+  EXPECT_GE(hitset->estimate_count(cold), 1u);
+  EXPECT_LT(hitset->estimate_count(cold), hitset->estimate_count(hot));
+}
+
+TEST_F(CountMinHitSetTest, Inherit) {
+  hobject_t hot(object_t("hot"), "", 0, 1234, 0, "");
+  for (int i = 0; i < 8; ++i)
+    hitset->insert(hot);
+  HitSet next(new CountMinHitSet(4, 1024, 1));
+  next.inherit(*hitset, .5);
+  EXPECT_EQ(4u, next.estimate_count(hot));
+  EXPECT_EQ(0u, next.insert_count());
+
+  // mismatched geometry is ignored
+  HitSet other(new CountMinHitSet(2, 1024, 1));
+  other.inherit(*hitset, .5);
+  EXPECT_EQ(0u, other.estimate_count(hot));
+}
+
+TEST_F(CountMinHitSetTest, EncodeDecode) {
+  // few counters set: sparse encoding
+  fill(20);
+  bufferlist bl;
+  hitset->encode(bl);
+  EXPECT_LT(bl.length(), 4u * 1024u);
+  HitSet copy;
+  bufferlist::iterator p = bl.begin();
+  copy.decode(p);
+  EXPECT_EQ(20u, copy.insert_count());
+  char buf[50];
+  for (unsigned i = 0; i < 20; ++i) {
+    sprintf(buf, "hitsettest_%u", i);
+    hobject_t obj(object_t(buf), "", 0, i, 0, "");
+    EXPECT_EQ(hitset->estimate_count(obj), copy.estimate_count(obj));
+  }
+
+  // hot object: dense encoding with 16-bit counters
+  HitSet dense(new CountMinHitSet(2, 64, 1));
+  hobject_t hot(object_t("hot"), "", 0, 1234, 0, "");
+  for (int i = 0; i < 1000; ++i)
+    dense.insert(hot);
+  for (unsigned i = 0; i < 200; ++i) {
+    sprintf(buf, "hitsettest_%u", i);
+    dense.insert(hobject_t(object_t(buf), "", 0, i, 0, ""));
+  }
+  bl.clear();
+  dense.encode(bl);
+  HitSet copy2;
+  p = bl.begin();
+  copy2.decode(p);
+  EXPECT_GE(copy2.estimate_count(hot), 1000u);
+  EXPECT_EQ(dense.estimate_count(hot), copy2.estimate_count(hot));
+}
+
+TEST_F(CountMinHitSetTest, InheritSaturates) {
+  hobject_t hot(object_t("hot"), "", 0, 1234, 0, "");
+  for (int i = 0; i < 40000; ++i)
+    hitset->insert(hot);
+  HitSet next(new CountMinHitSet(4, 1024, 1));
+  for (int i = 0; i < 40000; ++i)
+    next.insert(hot);
+  next.inherit(*hitset, 1.0);
+  EXPECT_EQ(65535u, next.estimate_count(hot));
+}
+
+TEST_F(CountMinHitSetTest, DecodeRejectsHuge) {
+  bufferlist bl;
+  ENCODE_START(1, 1, bl);
+  ::encode((uint32_t)0x10000, bl);     // depth
+  ::encode((uint32_t)0x10000, bl);     // width
+  ::encode((uint64_t)0, bl);           // seed
+  ::encode((uint64_t)0, bl);           // count
+  ::encode((__u8)1, bl);
+  ::encode(true, bl);
+  ::encode((uint32_t)0, bl);
+  ENCODE_FINISH(bl);
+  CountMinHitSet hs;
+  bufferlist::iterator p = bl.begin();
+  EXPECT_THROW(hs.decode(p), buffer::malformed_input);
+}
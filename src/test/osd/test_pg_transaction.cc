@@ -127,3 +127,41 @@ TEST(pgtransaction, clone_safe_create_traverse3)
       ++num;
     });
 }
+
+TEST(pgtransaction, append)
+{
+  hobject_t h;
+  PGTransaction t, t2;
+  bufferlist a, b, c, v1, v2;
+  a.append(string(10, 'a'));
+  b.append(string(10, 'b'));
+  c.append(string(5, 'c'));
+  v1.append("1");
+  v2.append("2");
+
+  t.write(h, 0, a.length(), a);
+  t.setattr(h, "x", v1);
+  t2.write(h, 5, b.length(), b);
+  t2.write(h, 20, c.length(), c);
+  t2.setattr(h, "x", v2);
+  map<string, bufferlist> keys;
+  keys["k"] = v1;
+  t2.omap_setkeys(h, keys);
+
+  t.append(std::move(t2));
+  ASSERT_TRUE(t2.empty());
+  ASSERT_EQ(t.op_map.size(), 1u);
+  auto &op = t.op_map[h];
+  ASSERT_TRUE(op.is_none());
+  ASSERT_EQ(op.attr_updates["x"]->to_str(), "2");
+  ASSERT_EQ(op.omap_updates.size(), 1u);
+  ASSERT_EQ(t.get_bytes_written(), 20u);
+
+  // later writes win where they overlap
+  using W = PGTransaction::ObjectOperation::BufferUpdate::Write;
+  string contents;
+  for (auto &&i : op.buffer_updates) {
+    contents.append(boost::get<W>(&i.get_val())->buffer.to_str());
+  }
+  ASSERT_EQ(contents, "aaaaabbbbbbbbbbccccc");
+}
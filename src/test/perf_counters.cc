@@ -19,6 +19,7 @@
 #include "common/perf_counters.h"
 #include "common/admin_socket_client.h"
 #include "common/ceph_context.h"
+#include "common/Clock.h"
 #include "common/config.h"
 #include "common/errno.h"
 #include "common/safe_io.h"
@@ -40,6 +41,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/un.h>
+#include <thread>
 #include <time.h>
 #include <unistd.h>
 
@@ -220,3 +222,78 @@ TEST(PerfCounters, ResetPerfCounters) {
   ASSERT_EQ("", client.do_request("{ \"prefix\": \"perf reset\", \"var\": \"test_perfcounter_1\", \"format\": \"json\" }", &msg));
   ASSERT_EQ(sd("{\"error\":\"Not find: test_perfcounter_1\"}"), msg);
 }
+
+enum {
+  TEST_PERFCOUNTERS3_ELEMENT_FIRST = 600,
+  TEST_PERFCOUNTERS3_ELEMENT_COUNT,
+  TEST_PERFCOUNTERS3_ELEMENT_LAT,
+  TEST_PERFCOUNTERS3_ELEMENT_LAST,
+};
+
+static PerfCounters* setup_test_perfcounter3(CephContext *cct, bool sharded)
+{
+  PerfCountersBuilder bld(cct, sharded ? "test_sharded" : "test_unsharded",
+	  TEST_PERFCOUNTERS3_ELEMENT_FIRST, TEST_PERFCOUNTERS3_ELEMENT_LAST);
+  bld.set_sharded(sharded);
+  bld.add_u64_counter(TEST_PERFCOUNTERS3_ELEMENT_COUNT, "count");
+  bld.add_time_avg(TEST_PERFCOUNTERS3_ELEMENT_LAT, "lat");
+  return bld.create_perf_counters();
+}
+
+static double hammer_perfcounter(PerfCounters *pc, int nthreads, int iters)
+{
+  utime_t start = ceph_clock_now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back([pc, iters] {
+	for (int i = 0; i < iters; ++i) {
+	  pc->inc(TEST_PERFCOUNTERS3_ELEMENT_COUNT);
+	  pc->tinc(TEST_PERFCOUNTERS3_ELEMENT_LAT, utime_t(0, 1));
+	}
+      });
+  }
+  for (auto& t : threads)
+    t.join();
+  return (double)(ceph_clock_now() - start);
+}
+
+TEST(PerfCounters, ShardedPerfCounters) {
+  PerfCountersCollection *coll = g_ceph_context->get_perfcounters_collection();
+  coll->clear();
+  PerfCounters* sharded = setup_test_perfcounter3(g_ceph_context, true);
+  PerfCounters* unsharded = setup_test_perfcounter3(g_ceph_context, false);
+  coll->add(sharded);
+  coll->add(unsharded);
+
+  const int nthreads = std::max(2u, std::thread::hardware_concurrency());
+  const int iters = 200000;
+  double s = hammer_perfcounter(sharded, nthreads, iters);
+  double u = hammer_perfcounter(unsharded, nthreads, iters);
+  std::cout << nthreads << " threads x " << iters << " inc+tinc: sharded "
+	    << s << "s, unsharded " << u << "s" << std::endl;
+
+  uint64_t total = (uint64_t)nthreads * iters;
+  ASSERT_EQ(total, sharded->get(TEST_PERFCOUNTERS3_ELEMENT_COUNT));
+  ASSERT_EQ(total, unsharded->get(TEST_PERFCOUNTERS3_ELEMENT_COUNT));
+  pair<uint64_t,uint64_t> a = sharded->get_tavg_ms(TEST_PERFCOUNTERS3_ELEMENT_LAT);
+  ASSERT_EQ(total, a.first);
+
+  AdminSocketClient client(get_rand_socket_path());
+  std::string msg;
+  ASSERT_EQ("", client.do_request("{ \"prefix\": \"perf dump\", \"format\": \"json\" }", &msg));
+  char expected[128];
+  snprintf(expected, sizeof(expected),
+	   "{\"count\":%" PRIu64 ",\"lat\":{\"avgcount\":%" PRIu64
+	   ",\"sum\":%" PRIu64 ".%09" PRIu64 "}}",
+	   total, total, total / 1000000000ull, total % 1000000000ull);
+  ASSERT_NE(std::string::npos,
+	    msg.find(std::string("\"test_sharded\":") + expected)) << msg;
+  ASSERT_NE(std::string::npos,
+	    msg.find(std::string("\"test_unsharded\":") + expected)) << msg;
+
+  sharded->reset();
+  ASSERT_EQ(0u, sharded->get(TEST_PERFCOUNTERS3_ELEMENT_COUNT));
+  sharded->inc(TEST_PERFCOUNTERS3_ELEMENT_COUNT, 5);
+  ASSERT_EQ(5u, sharded->get(TEST_PERFCOUNTERS3_ELEMENT_COUNT));
+  coll->clear();
+}
@@ -16,6 +16,8 @@
 
 #include <stdio.h>
 
+#include <thread>
+
 #include "global/global_init.h"
 #include "common/ceph_argparse.h"
 #include "global/global_context.h"
@@ -289,6 +291,93 @@ TEST(mempool, string_test)
   }
 }
 
+TEST(mempool, soft_limit)
+{
+  mempool::pool_t& pool = mempool::get_pool(mempool::unittest_1::id);
+  mempool::unittest_1::vector<char> v;
+  size_t calls = 0, seen_bytes = 0, seen_limit = 0;
+  int id = mempool::unittest_1::register_trimmer(
+    [&](size_t bytes, size_t limit) {
+      ++calls;
+      seen_bytes = bytes;
+      seen_limit = limit;
+      v.clear();
+      v.shrink_to_fit();
+    });
+
+  // no limit
+  v.resize(1 << 20);
+  EXPECT_FALSE(pool.check_soft_limit());
+  EXPECT_EQ(0u, calls);
+
+  // under the limit
+  pool.set_soft_limit(pool.allocated_bytes() + 4096);
+  EXPECT_FALSE(pool.check_soft_limit());
+  EXPECT_EQ(0u, calls);
+
+  // over it; the trimmer frees the vector
+  pool.set_soft_limit(1 << 19);
+  size_t before = pool.allocated_bytes();
+  EXPECT_TRUE(pool.check_soft_limit());
+  EXPECT_EQ(1u, calls);
+  EXPECT_EQ(before, seen_bytes);
+  EXPECT_EQ(1u << 19, seen_limit);
+  EXPECT_LT(pool.allocated_bytes(), 1u << 19);
+  EXPECT_FALSE(pool.check_soft_limit());
+
+  // unregistered trimmers are not called
+  mempool::unittest_1::unregister_trimmer(id);
+  v.resize(1 << 20);
+  EXPECT_TRUE(pool.check_soft_limit());
+  EXPECT_EQ(1u, calls);
+  pool.set_soft_limit(0);
+}
+
+TEST(mempool, set_soft_limits)
+{
+  ostringstream err;
+  ASSERT_EQ(0, mempool::set_soft_limits("unittest_1=1M,unittest_2=4096", &err));
+  EXPECT_EQ(1u << 20, mempool::get_pool(mempool::unittest_1::id).get_soft_limit());
+  EXPECT_EQ(4096u, mempool::get_pool(mempool::unittest_2::id).get_soft_limit());
+
+  // pools that are not listed lose their limit
+  ASSERT_EQ(0, mempool::set_soft_limits("unittest_2=1G", &err));
+  EXPECT_EQ(0u, mempool::get_pool(mempool::unittest_1::id).get_soft_limit());
+  EXPECT_EQ(1u << 30, mempool::get_pool(mempool::unittest_2::id).get_soft_limit());
+
+  // errors leave everything alone
+  EXPECT_EQ(-EINVAL, mempool::set_soft_limits("unittest_1=1M,nosuchpool=1", &err));
+  EXPECT_EQ(-EINVAL, mempool::set_soft_limits("unittest_1", &err));
+  EXPECT_EQ(-EINVAL, mempool::set_soft_limits("unittest_1=lots", &err));
+  EXPECT_EQ(0u, mempool::get_pool(mempool::unittest_1::id).get_soft_limit());
+  EXPECT_EQ(1u << 30, mempool::get_pool(mempool::unittest_2::id).get_soft_limit());
+
+  ASSERT_EQ(0, mempool::set_soft_limits("", &err));
+  EXPECT_EQ(0u, mempool::get_pool(mempool::unittest_2::id).get_soft_limit());
+}
+
+TEST(mempool, shard_per_thread)
+{
+  // threads are spread over the shards, so their counts do not end up
+  // in a single cacheline
+  mempool::pool_t& pool = mempool::get_pool(mempool::unittest_1::id);
+  const int n = 4;
+  std::set<mempool::shard_t*> shards;
+  std::mutex lock;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < n; ++i) {
+    threads.push_back(std::thread([&] {
+	  mempool::shard_t *s = pool.pick_a_shard();
+	  EXPECT_EQ(s, pool.pick_a_shard());
+	  std::lock_guard<std::mutex> l(lock);
+	  shards.insert(s);
+	}));
+  }
+  for (auto& t : threads)
+    t.join();
+  EXPECT_EQ((size_t)n, shards.size());
+}
+
 int main(int argc, char **argv)
 {
   vector<const char*> args;
@@ -3,6 +3,9 @@
 #include "common/WorkQueue.h"
 #include "common/ceph_argparse.h"
 
+#include <set>
+#include <thread>
+
 TEST(WorkQueue, StartStop)
 {
   ThreadPool tp(g_ceph_context, "foo", "tp_foo", 10, "");
@@ -53,3 +56,88 @@ TEST(WorkQueue, Resize)
   sleep(1);
   tp.stop();
 }
+
+class CountingWQ : public ThreadPool::PointerWQ<int> {
+public:
+  std::atomic<unsigned> processed = { 0 };
+  std::mutex lock;
+  std::set<pthread_t> threads;
+  unsigned sleep_us = 0;
+
+  CountingWQ(ThreadPool *tp)
+    : ThreadPool::PointerWQ<int>("CountingWQ", 100, 0, tp) {
+    tp->add_work_queue(this);
+  }
+protected:
+  void process(int *item) override {
+    if (sleep_us)
+      usleep(sleep_us);
+    {
+      std::lock_guard<std::mutex> l(lock);
+      threads.insert(pthread_self());
+    }
+    processed++;
+  }
+};
+
+TEST(WorkQueue, PointerWQ)
+{
+  for (auto batch : { "1", "8" }) {
+    g_conf->set_val("threadpool_dequeue_batch", batch);
+    g_conf->apply_changes(NULL);
+
+    ThreadPool tp(g_ceph_context, "pwq", "tp_pwq", 4);
+    CountingWQ wq(&tp);
+    tp.start();
+
+    const unsigned per_thread = 20000;
+    int item;
+    vector<std::thread> submitters;
+    for (int i = 0; i < 4; ++i)
+      submitters.push_back(std::thread([&] {
+	    for (unsigned j = 0; j < per_thread; ++j)
+	      wq.queue(&item);
+	  }));
+    for (auto& t : submitters)
+      t.join();
+    wq.drain();
+    ASSERT_EQ(4 * per_thread, wq.processed.load());
+    ASSERT_TRUE(wq.empty());
+    tp.stop();
+  }
+  g_conf->set_val("threadpool_dequeue_batch", "1");
+  g_conf->apply_changes(NULL);
+}
+
+TEST(WorkQueue, Steal)
+{
+  g_conf->set_val("threadpool_dequeue_batch", "64");
+  g_conf->apply_changes(NULL);
+
+  ThreadPool tp(g_ceph_context, "steal", "tp_steal", 4);
+  CountingWQ wq(&tp);
+  wq.sleep_us = 1000;
+  // whichever worker gets the pool lock first dequeues all of them; the
+  // others only get work by stealing it
+  int item;
+  for (int i = 0; i < 64; ++i)
+    wq.queue(&item);
+  tp.start();
+  wq.drain();
+  ASSERT_EQ(64u, wq.processed.load());
+  ASSERT_LT(1u, wq.threads.size());
+
+  // pause waits for what has already been dequeued locally
+  tp.pause();
+  for (int i = 0; i < 64; ++i)
+    wq.queue(&item);
+  usleep(10000);
+  ASSERT_EQ(64u, wq.processed.load());
+  tp.unpause();
+  wq.drain();
+  ASSERT_EQ(128u, wq.processed.load());
+  tp.stop();
+
+  g_conf->set_val("threadpool_dequeue_batch", "1");
+  g_conf->apply_changes(NULL);
+}